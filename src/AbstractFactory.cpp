@@ -47,6 +47,11 @@ template <> string SpatialNetwork<Synapse>::ClassName("SpatialSynapticNetwork");
 
 template <> string ODE::RungeKuttaSolver<double, double>::ClassName("ODERungeKuttaSolverDouble");
 template <> string ODE::EulerSolver<double, double>::ClassName("ODEEulerSolverDouble");
+template <> string ODE::RosenbrockSolver<double, double>::ClassName("ODERosenbrockSolverDouble");
+template <> string ODE::MultirateSolver<double, double>::ClassName("ODEMultirateSolverDouble");
+template <> string ODE::SplittingSolver<double, double>::ClassName("ODESplittingSolverDouble");
+template <> string ODE::RungeKuttaSolver<float, double>::ClassName("ODERungeKuttaSolverFloat");
+template <> string ODE::EulerSolver<float, double>::ClassName("ODEEulerSolverFloat");
 
 // Network Links
 template <> map<string, AbstractFactory<NetworkEdge>*> 
@@ -157,6 +162,8 @@ static DerivedFactory<SimulationManager, RepeatSimulation<ThresholdModel> > Repe
 static DerivedFactory<SimulationManager, RepeatSimulation<ModifiedThresholdModel> > RepeatModifThreshSimFact;
 static DerivedFactory<SimulationManager, RepeatSimulation<SecondOrdNeighbSERSModel> > RepeatSecondOrdSERSSimFact;
 static DerivedFactory<SimulationManager, RepeatSimulation<SimpleThresholdSERSModel> > RepeatSimpleThreshSERSSimFact;
+static DerivedFactory<SimulationManager, RepeatSimulation<BitSlicedThresholdModel> > RepeatBitSlicedThreshSimFact;
+static DerivedFactory<SimulationManager, RepeatSimulation<BitSlicedSERSModel> > RepeatBitSlicedSERSSimFact;
 static DerivedFactory<SimulationManager, RepeatSimulation<ChIModelThresholdDetermination> > RepeatChIThreshDetermSimFact;
 static DerivedFactory<SimulationManager, RepeatSimulation<NeuronNetModel> > RepeatNeuronNetSimFact;
 static DerivedFactory<SimulationManager, RepeatSimulation<AstroNeuroNetModel> > RepeatAstroNeuroSimFact;
@@ -168,6 +175,15 @@ template <> map<string, AbstractFactory<ODE::ODESolver<double, double> >* >
 	AbstractFactory<ODE::ODESolver<double, double> >::Factories = map<string, AbstractFactory<ODE::ODESolver<double, double> >* >();
 static DerivedFactory<ODE::ODESolver<double, double>, ODE::RungeKuttaSolver<double> > ODERungeKuttaSolverFact;
 static DerivedFactory<ODE::ODESolver<double, double>, ODE::EulerSolver<double> > ODEEulerSolverFact;
+static DerivedFactory<ODE::ODESolver<double, double>, ODE::RosenbrockSolver<double> > ODERosenbrockSolverFact;
+static DerivedFactory<ODE::ODESolver<double, double>, ODE::MultirateSolver<double> > ODEMultirateSolverFact;
+static DerivedFactory<ODE::ODESolver<double, double>, ODE::SplittingSolver<double> > ODESplittingSolverFact;
+// Single precision solvers, also registered under the name of their 
+// double precision counterpart (batches fall back to RK4 for the others)
+template <> map<string, AbstractFactory<ODE::ODESolver<float, double> >* >
+	AbstractFactory<ODE::ODESolver<float, double> >::Factories = map<string, AbstractFactory<ODE::ODESolver<float, double> >* >();
+static DerivedFactory<ODE::ODESolver<float, double>, ODE::RungeKuttaSolver<float> > ODERungeKuttaSolverFloatFact;
+static DerivedFactory<ODE::ODESolver<float, double>, ODE::EulerSolver<float> > ODEEulerSolverFloatFact;
 
 // ChI Models
 template <> map<string, AbstractFactory<ChIModel>*> 
@@ -274,6 +290,8 @@ void InitializeFactories()
 	AbstractFactory<SimulationManager>::Factories.insert(make_pair(RepeatSimulation<ChIModelThresholdDetermination>::ClassName, &RepeatChIThreshDetermSimFact));
 	AbstractFactory<SimulationManager>::Factories.insert(make_pair(RepeatSimulation<SecondOrdNeighbSERSModel>::ClassName, &RepeatSecondOrdSERSSimFact));
 	AbstractFactory<SimulationManager>::Factories.insert(make_pair(RepeatSimulation<SimpleThresholdSERSModel>::ClassName, &RepeatSimpleThreshSERSSimFact));
+	AbstractFactory<SimulationManager>::Factories.insert(make_pair(RepeatSimulation<BitSlicedThresholdModel>::ClassName, &RepeatBitSlicedThreshSimFact));
+	AbstractFactory<SimulationManager>::Factories.insert(make_pair(RepeatSimulation<BitSlicedSERSModel>::ClassName, &RepeatBitSlicedSERSSimFact));
 	AbstractFactory<SimulationManager>::Factories.insert(make_pair(RepeatSimulation<NeuronNetModel>::ClassName, &RepeatNeuronNetSimFact));
 	AbstractFactory<SimulationManager>::Factories.insert(make_pair(RepeatSimulation<AstroNeuroNetModel>::ClassName, &RepeatAstroNeuroSimFact));
 	AbstractFactory<SimulationManager>::Factories.insert(make_pair(RepeatSimulation<ChIModelStochasticRes>::ClassName, &RepeatChIStochResFact));
@@ -282,6 +300,13 @@ void InitializeFactories()
 	// ODE Solvers
 	AbstractFactory<ODE::ODESolver<double, double> >::Factories.insert(make_pair(ODE::RungeKuttaSolver<double>::ClassName, &ODERungeKuttaSolverFact));
 	AbstractFactory<ODE::ODESolver<double, double> >::Factories.insert(make_pair(ODE::EulerSolver<double>::ClassName, &ODEEulerSolverFact));
+	AbstractFactory<ODE::ODESolver<double, double> >::Factories.insert(make_pair(ODE::RosenbrockSolver<double>::ClassName, &ODERosenbrockSolverFact));
+	AbstractFactory<ODE::ODESolver<double, double> >::Factories.insert(make_pair(ODE::MultirateSolver<double>::ClassName, &ODEMultirateSolverFact));
+	AbstractFactory<ODE::ODESolver<double, double> >::Factories.insert(make_pair(ODE::SplittingSolver<double>::ClassName, &ODESplittingSolverFact));
+	AbstractFactory<ODE::ODESolver<float, double> >::Factories.insert(make_pair(ODE::RungeKuttaSolver<float>::ClassName, &ODERungeKuttaSolverFloatFact));
+	AbstractFactory<ODE::ODESolver<float, double> >::Factories.insert(make_pair(ODE::EulerSolver<float>::ClassName, &ODEEulerSolverFloatFact));
+	AbstractFactory<ODE::ODESolver<float, double> >::Factories.insert(make_pair(ODE::RungeKuttaSolver<double>::ClassName, &ODERungeKuttaSolverFloatFact));
+	AbstractFactory<ODE::ODESolver<float, double> >::Factories.insert(make_pair(ODE::EulerSolver<double>::ClassName, &ODEEulerSolverFloatFact));
 
 	// ChI Models
 	AbstractFactory<ChIModel>::Factories.insert(make_pair(ChIModel::ClassName, &StdChIModFact));
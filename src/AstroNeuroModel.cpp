@@ -172,11 +172,47 @@ void AstroNeuroNetModel::Initialize(ResultSaver saver)
 	astroNet->Initialize(saver);
 
 	SetUpModelsAndODEs();
+	buildCouplingTable();
 
 	// Initialize metrics
 	metrics.InitializeMetricsDefault();
 }
 
+//**********************************************************************
+// Synapse types and spill-over fractions are resolved here so that the
+// coupling pass does not need any RTTI
+//**********************************************************************
+void AstroNeuroNetModel::buildCouplingTable()
+{
+	assert(astrToSyn.size() == astroNet->GetNbCells());
+	couplAstro.resize(astrToSyn.size());
+	couplStart.assign(1, 0);
+	couplGlu.clear();
+	couplSpillOv.clear();
+	for (unsigned int i = 0 ; i < astrToSyn.size() ; ++i)
+	{
+		const ChICell & cell = *astroNet->cells[i];
+		couplAstro[i].caInd = cell.dynVals - this->vals + ChICell::Ca;
+		couplAstro[i].vbeta = cell.vbeta;
+		couplAstro[i].kR = cell.kR;
+		couplAstro[i].kP = cell.kP;
+		couplAstro[i].kpi = cell.kpi;
+
+		for (unsigned int j = 0 ; j < astrToSyn[i].size() ; ++j)
+		{
+			GlutamatergicSynapse *gluSyn = 
+				dynamic_cast<GlutamatergicSynapse *>(astrToSyn[i][j]);
+			// Non glutamatergic synapses do not induce IP3 production
+			if (gluSyn)
+			{
+				couplGlu.push_back(gluSyn->GetGluSource());
+				couplSpillOv.push_back(gluSyn->GetSpillOverFraction());
+			}
+		}
+		couplStart.push_back(couplGlu.size());
+	}
+}
+
 //**********************************************************************
 // Method called before solving the ODE problem
 //**********************************************************************
@@ -251,6 +287,9 @@ TRACE_DOWN("*** Simulation Ended ***")
 void AstroNeuroNetModel::UpdateVals(double t)
 {
 	tCurr = t; 
+	// The metrics of the sub models are scheduled by their own scheduler
+	neuronNet->NotifyNewStep(t);
+	astroNet->NotifyNewStep(t);
 	neuronNet->UpdateVals(t);
 	astroNet->UpdateVals(t);
 
@@ -258,6 +297,14 @@ void AstroNeuroNetModel::UpdateVals(double t)
 	ODE::ODEProblem<double, double>::UpdateVals(t);
 }
 
+//**********************************************************************
+// Neuron values come first in vals
+//**********************************************************************
+unsigned int AstroNeuroNetModel::GetNbFastVals() const
+{
+	return neuronNet->GetTotNbDynVals();
+}
+
 //**********************************************************************
 // Set all cells to equilibrium
 //**********************************************************************
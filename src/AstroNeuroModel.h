@@ -110,6 +110,8 @@ namespace AstroModel
 		virtual std::vector<Metric *> GetAllMetrics() const;
 		// Is the given cell currently stimulated ?
 		bool IsStimulated(unsigned int ind) const;
+		// Neuron network values are fast, astrocyte values are slow
+		virtual unsigned int GetNbFastVals() const;
 
 	protected:
 
@@ -123,6 +125,30 @@ namespace AstroModel
 
 		std::vector<std::vector<Synapse *> > astrToSyn;
 
+		//===========================================================||
+		// Neuron - astrocyte coupling table                         ||
+		//===========================================================||
+		// Per astrocyte parameters of the glutamate induced IP3
+		// production
+		struct AstroCoupling
+		{
+			unsigned int caInd; // Index of Ca in vals
+			double vbeta;
+			double kR;
+			double kP;
+			double kpi;
+		};
+		std::vector<AstroCoupling> couplAstro;
+		// CSR of astrToSyn, synapses of astrocyte i are in
+		// [couplStart[i], couplStart[i+1])
+		std::vector<unsigned int> couplStart;
+		std::vector<const double *> couplGlu;
+		std::vector<double> couplSpillOv;
+
+		// Builds the coupling table from astrToSyn, has to be called
+		// once the dynamic values are set
+		void buildCouplingTable();
+
 		//===========================================================||
 		// Network parameters                                        ||
 		//===========================================================||
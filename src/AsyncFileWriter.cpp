@@ -0,0 +1,389 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#include "AsyncFileWriter.h"
+
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <boost/filesystem/convenience.hpp>
+
+using namespace std;
+
+//********************************************************************//
+//**************** A S Y N C   F I L E   W R I T E R *****************//
+//********************************************************************//
+
+unsigned int AsyncFileWriter::nbWritersConf = 1;
+unsigned int AsyncFileWriter::queueSizeConf = ASYNC_WRITER_DEFAULT_QUEUE_SIZE;
+
+//**********************************************************************
+//**********************************************************************
+AsyncFileWriter & AsyncFileWriter::Instance()
+{
+	static AsyncFileWriter instance(nbWritersConf, queueSizeConf);
+	return instance;
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncFileWriter::Configure(unsigned int _nbWriters, unsigned int _queueSize)
+{
+	nbWritersConf = std::max(1u, _nbWriters);
+	queueSizeConf = std::max(2u, _queueSize);
+}
+
+//**********************************************************************
+//**********************************************************************
+AsyncFileWriter::AsyncFileWriter(unsigned int nbWriters, unsigned int queueSize) :
+	stopping(false), barriersDone(0)
+{
+	for (unsigned int i = 0 ; i < nbWriters ; ++i)
+		writers.push_back(new Writer(queueSize));
+	for (unsigned int i = 0 ; i < writers.size() ; ++i)
+		writers[i]->thread = std::thread(&AsyncFileWriter::writerLoop, this, writers[i]);
+}
+
+//**********************************************************************
+//**********************************************************************
+AsyncFileWriter::~AsyncFileWriter()
+{
+	Flush();
+	stopping = true;
+	for (unsigned int i = 0 ; i < writers.size() ; ++i)
+	{
+		writers[i]->cond.notify_one();
+		writers[i]->thread.join();
+		delete writers[i];
+	}
+	// Errors that were never collected by a Flush call
+	for (unsigned int i = 0 ; i < errors.size() ; ++i)
+		cerr << errors[i] << endl;
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncFileWriter::Append(const std::string & path, std::string & data)
+{
+	if (data.empty())
+		return;
+	WriteRequest req(WriteRequest::Append, path);
+	req.payload.swap(data);
+	submit(req);
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncFileWriter::AppendFile(const std::string & dest, const std::string & src)
+{
+	WriteRequest req(WriteRequest::AppendFile, dest);
+	req.payload = src;
+	submit(req);
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncFileWriter::MakeDir(const std::string & path)
+{
+	WriteRequest req(WriteRequest::MakeDir, path);
+	submit(req);
+}
+
+//**********************************************************************
+//**********************************************************************
+bool AsyncFileWriter::Flush(std::vector<std::string> *errs)
+{
+	static std::mutex flushMutex;
+	std::lock_guard<std::mutex> flushLock(flushMutex);
+	{
+		std::lock_guard<std::mutex> lock(barrierMutex);
+		barriersDone = 0;
+	}
+	for (unsigned int i = 0 ; i < writers.size() ; ++i)
+	{
+		WriteRequest req(WriteRequest::Barrier);
+		while (not writers[i]->queue.TryPush(req))
+			std::this_thread::yield();
+		writers[i]->cond.notify_one();
+	}
+	{
+		std::unique_lock<std::mutex> lock(barrierMutex);
+		while (barriersDone < writers.size())
+			barrierCond.wait(lock);
+	}
+
+	std::lock_guard<std::mutex> lock(errorMutex);
+	bool ok = errors.empty();
+	if (errs)
+		errs->insert(errs->end(), errors.begin(), errors.end());
+	else
+		for (unsigned int i = 0 ; i < errors.size() ; ++i)
+			cerr << errors[i] << endl;
+	errors.clear();
+	return ok;
+}
+
+//**********************************************************************
+//**********************************************************************
+bool AsyncFileWriter::CreateDir(const std::string & path)
+{
+	boost::system::error_code ec;
+	if (boost::filesystem::exists(path, ec))
+		return boost::filesystem::is_directory(path, ec);
+	boost::filesystem::create_directories(path, ec);
+	return not ec;
+}
+
+//**********************************************************************
+// Routes the request to the writer in charge of its path
+//**********************************************************************
+void AsyncFileWriter::submit(WriteRequest & req)
+{
+	Writer *w = writers[std::hash<std::string>()(req.path) % writers.size()];
+	// Bounded queue : wait for the writer to catch up if it is full
+	while (not w->queue.TryPush(req))
+		std::this_thread::yield();
+	if (w->sleeping.load())
+		w->cond.notify_one();
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncFileWriter::writerLoop(Writer *w)
+{
+	WriteRequest req;
+	while (true)
+	{
+		if (w->queue.TryPop(req))
+		{
+			process(w, req);
+			continue;
+		}
+		if (stopping.load())
+			break;
+		std::unique_lock<std::mutex> lock(w->mutex);
+		w->sleeping = true;
+		// The timeout covers notifications sent between TryPop and wait
+		w->cond.wait_for(lock, std::chrono::milliseconds(1));
+		w->sleeping = false;
+	}
+	closeFiles(w);
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncFileWriter::process(Writer *w, WriteRequest & req)
+{
+	switch (req.type)
+	{
+		case WriteRequest::Append:
+		{
+			std::ofstream *file = getFile(w, req.path);
+			if (file)
+			{
+				file->write(req.payload.data(), req.payload.size());
+				if (not file->good())
+					addError("Couldn't write to file : " + req.path);
+			}
+			break;
+		}
+		case WriteRequest::AppendFile:
+		{
+			std::ofstream *file = getFile(w, req.path);
+			std::ifstream src(req.payload.c_str(), ios_base::binary);
+			if (file and src.good())
+			{
+				if (src.peek() != std::ifstream::traits_type::eof())
+					*file << src.rdbuf();
+				if (not file->good())
+					addError("Couldn't write to file : " + req.path);
+				src.close();
+				remove(req.payload.c_str());
+			}
+			else if (file)
+				addError("Couldn't read file : " + req.payload);
+			break;
+		}
+		case WriteRequest::MakeDir:
+			if (w->knownDirs.find(req.path) == w->knownDirs.end())
+			{
+				if (CreateDir(req.path))
+					w->knownDirs.insert(req.path);
+				else
+					addError("Couldn't create directory : " + req.path);
+			}
+			break;
+		case WriteRequest::Barrier:
+		{
+			closeFiles(w);
+			std::lock_guard<std::mutex> lock(barrierMutex);
+			++barriersDone;
+			barrierCond.notify_all();
+			break;
+		}
+	}
+	req.payload.clear();
+}
+
+//**********************************************************************
+// Returns an open stream on path, creating the directory if needed
+//**********************************************************************
+std::ofstream * AsyncFileWriter::getFile(Writer *w, const std::string & path)
+{
+	std::map<std::string, std::ofstream*>::iterator it = w->openFiles.find(path);
+	if (it != w->openFiles.end())
+		return it->second;
+
+	std::string dir = path.substr(0, path.find_last_of('/'));
+	if ((dir != path) and (w->knownDirs.find(dir) == w->knownDirs.end()))
+	{
+		if (not CreateDir(dir))
+		{
+			addError("Couldn't create directory : " + dir);
+			return 0;
+		}
+		w->knownDirs.insert(dir);
+	}
+	std::ofstream *file = new std::ofstream(path.c_str(), ios_base::app);
+	if (not file->is_open())
+	{
+		delete file;
+		addError("Couldn't open file : " + path);
+		return 0;
+	}
+	w->openFiles[path] = file;
+	return file;
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncFileWriter::closeFiles(Writer *w)
+{
+	for (std::map<std::string, std::ofstream*>::iterator it = w->openFiles.begin() ;
+			it != w->openFiles.end() ; ++it)
+	{
+		it->second->close();
+		if (it->second->fail())
+			addError("Couldn't close file : " + it->first);
+		delete it->second;
+	}
+	w->openFiles.clear();
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncFileWriter::addError(const std::string & err)
+{
+	std::lock_guard<std::mutex> lock(errorMutex);
+	errors.push_back(err);
+}
+
+//********************************************************************//
+//***************** A S Y N C   S T R E A M   B U F ******************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+AsyncStreamBuf::AsyncStreamBuf(unsigned int _chunkSize) : chunkSize(_chunkSize)
+{
+	setp(0, 0);
+}
+
+//**********************************************************************
+//**********************************************************************
+AsyncStreamBuf::~AsyncStreamBuf()
+{
+	Close();
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncStreamBuf::Open(const std::string & _path)
+{
+	Close();
+	path = _path;
+	if (buffer.empty())
+	{
+		buffer.resize(chunkSize);
+		setp(&buffer[0], &buffer[0] + buffer.size());
+	}
+}
+
+//**********************************************************************
+//**********************************************************************
+void AsyncStreamBuf::Close()
+{
+	submit();
+	path = "";
+}
+
+//**********************************************************************
+// Hands the current chunk to the writer pool
+//**********************************************************************
+void AsyncStreamBuf::submit()
+{
+	if ((pptr() != pbase()) and (path != ""))
+	{
+		std::string data(pbase(), pptr());
+		AsyncFileWriter::Instance().Append(path, data);
+	}
+	if (not buffer.empty())
+		setp(&buffer[0], &buffer[0] + buffer.size());
+}
+
+//**********************************************************************
+//**********************************************************************
+AsyncStreamBuf::int_type AsyncStreamBuf::overflow(int_type c)
+{
+	// No file has been opened yet
+	if (buffer.empty())
+		return traits_type::eof();
+	submit();
+	if (not traits_type::eq_int_type(c, traits_type::eof()))
+	{
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+//**********************************************************************
+//**********************************************************************
+std::streamsize AsyncStreamBuf::xsputn(const char *s, std::streamsize n)
+{
+	std::streamsize done = 0;
+	if (buffer.empty())
+		return 0;
+	while (done < n)
+	{
+		if (pptr() == epptr())
+			submit();
+		std::streamsize nb = std::min(n - done, (std::streamsize)(epptr() - pptr()));
+		traits_type::copy(pptr(), s + done, nb);
+		pbump(nb);
+		done += nb;
+	}
+	return n;
+}
+
+//**********************************************************************
+//**********************************************************************
+int AsyncStreamBuf::sync()
+{
+	submit();
+	return 0;
+}
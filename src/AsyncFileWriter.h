@@ -0,0 +1,256 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#ifndef ASYNCFILEWRITER_H
+#define ASYNCFILEWRITER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <fstream>
+#include <streambuf>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <assert.h>
+
+#define ASYNC_WRITER_DEFAULT_QUEUE_SIZE 1024
+#define ASYNC_WRITER_DEFAULT_CHUNK_SIZE 65536
+
+/**********************************************************************/
+/* Bounded lock-free multi-producer multi-consumer queue              */
+/**********************************************************************/
+// Ring buffer with one sequence number per cell. The capacity is
+// rounded up to a power of two.
+template <typename T> class BoundedQueue
+{
+public:
+	BoundedQueue(unsigned int _capacity = ASYNC_WRITER_DEFAULT_QUEUE_SIZE) :
+		enqueuePos(0), dequeuePos(0)
+	{
+		size_t capacity = 2;
+		while (capacity < _capacity)
+			capacity *= 2;
+		mask = capacity - 1;
+		buffer = new Cell[capacity];
+		for (size_t i = 0 ; i < capacity ; ++i)
+			buffer[i].seq.store(i, std::memory_order_relaxed);
+	}
+	~BoundedQueue()
+	{
+		delete[] buffer;
+	}
+
+	// Moves val into the queue, returns false if the queue is full
+	bool TryPush(T & val)
+	{
+		Cell *cell;
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &buffer[pos & mask];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			long int diff = (long int)seq - (long int)pos;
+			if (diff == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+		cell->data = std::move(val);
+		cell->seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+	// Moves the oldest element into val, returns false if the queue is empty
+	bool TryPop(T & val)
+	{
+		Cell *cell;
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &buffer[pos & mask];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			long int diff = (long int)seq - (long int)(pos + 1);
+			if (diff == 0)
+			{
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = dequeuePos.load(std::memory_order_relaxed);
+		}
+		val = std::move(cell->data);
+		cell->seq.store(pos + mask + 1, std::memory_order_release);
+		return true;
+	}
+	// Approximate emptiness test (exact when no push / pop is in progress)
+	bool Empty() const
+	{
+		return enqueuePos.load(std::memory_order_acquire) ==
+			dequeuePos.load(std::memory_order_acquire);
+	}
+
+protected:
+	struct Cell
+	{
+		std::atomic<size_t> seq;
+		T data;
+	};
+
+	Cell *buffer;
+	size_t mask;
+	std::atomic<size_t> enqueuePos;
+	std::atomic<size_t> dequeuePos;
+
+private:
+	BoundedQueue(const BoundedQueue &);
+	BoundedQueue & operator=(const BoundedQueue &);
+};
+
+/**********************************************************************/
+/* Write request handled by the writer threads                        */
+/**********************************************************************/
+struct WriteRequest
+{
+	enum Type { Append, AppendFile, MakeDir, Barrier };
+
+	Type type;
+	std::string path;    // destination file (or directory)
+	std::string payload; // data to append (or source file for AppendFile)
+
+	WriteRequest(Type _t = Barrier, const std::string & _p = "") :
+		type(_t), path(_p) {}
+};
+
+/**********************************************************************/
+/* Pool of background writer threads                                  */
+/**********************************************************************/
+// Requests on a given path are always routed to the same writer, so
+// that data written to a file keeps its submission order.
+class AsyncFileWriter
+{
+public:
+	// Returns the process wide writer pool (threads are started on first use)
+	static AsyncFileWriter & Instance();
+	// Sets the number of writer threads and queue sizes, has no effect
+	// once the pool has been started.
+	static void Configure(unsigned int _nbWriters, unsigned int _queueSize);
+
+	~AsyncFileWriter();
+
+	// Queues data to be appended to the given file
+	void Append(const std::string & path, std::string & data);
+	// Queues the appending of file src at the end of file dest, src is
+	// removed afterwards
+	void AppendFile(const std::string & dest, const std::string & src);
+	// Queues the creation of a directory
+	void MakeDir(const std::string & path);
+	// Blocks until all previously queued requests have been processed
+	// and all files have been closed. Returns false if errors occured
+	// since the last call, errors are then appended to errs.
+	bool Flush(std::vector<std::string> *errs = 0);
+
+	// Creates a directory and all its parents if needed
+	static bool CreateDir(const std::string & path);
+
+protected:
+	struct Writer
+	{
+		BoundedQueue<WriteRequest> queue;
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::atomic<bool> sleeping;
+		std::map<std::string, std::ofstream*> openFiles;
+		std::set<std::string> knownDirs;
+
+		Writer(unsigned int qs) : queue(qs), sleeping(false) {}
+	};
+
+	std::vector<Writer*> writers;
+	std::atomic<bool> stopping;
+
+	// Barrier handling
+	std::mutex barrierMutex;
+	std::condition_variable barrierCond;
+	unsigned int barriersDone;
+
+	// Errors
+	std::mutex errorMutex;
+	std::vector<std::string> errors;
+
+	static unsigned int nbWritersConf;
+	static unsigned int queueSizeConf;
+
+	AsyncFileWriter(unsigned int nbWriters, unsigned int queueSize);
+
+	void submit(WriteRequest & req);
+	void writerLoop(Writer *w);
+	void process(Writer *w, WriteRequest & req);
+	std::ofstream * getFile(Writer *w, const std::string & path);
+	void closeFiles(Writer *w);
+	void addError(const std::string & err);
+
+private:
+	AsyncFileWriter(const AsyncFileWriter &);
+	AsyncFileWriter & operator=(const AsyncFileWriter &);
+};
+
+/**********************************************************************/
+/* Stream buffer forwarding its content to the writer pool            */
+/**********************************************************************/
+// Data is accumulated locally and handed to the writer threads by
+// chunks, so that the simulation thread never waits for the disk.
+class AsyncStreamBuf : public std::streambuf
+{
+public:
+	AsyncStreamBuf(unsigned int _chunkSize = ASYNC_WRITER_DEFAULT_CHUNK_SIZE);
+	virtual ~AsyncStreamBuf();
+
+	// Submits pending data and redirects the buffer to a new file
+	void Open(const std::string & _path);
+	// Submits pending data
+	void Close();
+	inline const std::string & GetPath() const { return path; }
+
+protected:
+	std::string path;
+	unsigned int chunkSize;
+	std::vector<char> buffer; // Allocated when a file is first opened
+
+	void submit();
+
+	virtual int_type overflow(int_type c);
+	virtual std::streamsize xsputn(const char *s, std::streamsize n);
+	// std::flush and std::endl hand the pending data to the writers
+	virtual int sync();
+
+private:
+	AsyncStreamBuf(const AsyncStreamBuf &);
+	AsyncStreamBuf & operator=(const AsyncStreamBuf &);
+};
+
+#endif
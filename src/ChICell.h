@@ -30,6 +30,8 @@ namespace ODE
 	// Forward declarations
 	class ChICellFunct;
 	class ChINetworkFunct;
+	struct ChICellKernel;
+	struct KChICellKernel;
 }
 
 namespace AstroModel
@@ -56,6 +58,10 @@ namespace AstroModel
 		friend class ExtraCellGluStim;
 		friend class PoissonianStimStrat;
 		friend class ODE::AstroNeuronNetFunc;
+		template <typename Val> friend class ChIModelBatch;
+		friend class AstroNeuroNetModel;
+		friend struct ODE::ChICellKernel;
+		friend struct ODE::KChICellKernel;
 
 	public:
 		static std::string ClassName;
@@ -24,8 +24,14 @@
 #include "ChIModelMetrics.h"
 #include "StimulationMetrics.h"
 #include "ErrorCodes.h"
+#include "ParallelTools.h"
 
 #include <assert.h>
+#include <float.h>
+#include <algorithm>
+#include <map>
+#include <typeinfo>
+#include <math.h>
 
 using namespace AstroModel;
 using namespace std;
@@ -43,9 +49,15 @@ ChIModel::ChIModel(ParamHandler & h) :
 	ODENetworkDynamicsModel<CouplingFunction, ChICell>::ODENetworkDynamicsModel(h),
 	StimulableCellNetwork::StimulableCellNetwork(h),
 	C0(2.0e-03), d1(0.13e-03), d2(1.049e-03), d3(0.9434e-03), 
-	d5(0.08234e-03), v3k(4.5e-03), K3k(0.7e-03), r5p(0.21)
+	d5(0.08234e-03), v3k(4.5e-03), K3k(0.7e-03), r5p(0.21), activeSetOn(false), 
+	validOn(false), validRecording(false)
 {
+	useActiveSet = h.getParam<bool>("-ActiveSet", 0);
+	activeSetTol = h.getParam<double>("-ActiveSet", 1);
+	activeSetWakeFlux = h.getParam<double>("-ActiveSet", 2);
+	activeSetValidate = h.getParam<bool>("-ActiveSet", 3);
 	TRACE("*** Initializing ChI Model ***")
+	metrics.SetScheduler(&metricScheduler);
 	SetFunct(new ODE::ChINetworkFunct(*this), true);
 }
 
@@ -54,8 +66,14 @@ ChIModel::ChIModel(ParamHandler & h) :
 //**********************************************************************
 ChIModel::ChIModel(std::ifstream & stream, ParamHandler & h) : 
 	ODENetworkDynamicsModel<CouplingFunction, ChICell>::ODENetworkDynamicsModel(h),
-	StimulableCellNetwork::StimulableCellNetwork(h)
+	StimulableCellNetwork::StimulableCellNetwork(h), activeSetOn(false), validOn(false), 
+	validRecording(false)
 {
+	useActiveSet = h.getParam<bool>("-ActiveSet", 0);
+	activeSetTol = h.getParam<double>("-ActiveSet", 1);
+	activeSetWakeFlux = h.getParam<double>("-ActiveSet", 2);
+	activeSetValidate = h.getParam<bool>("-ActiveSet", 3);
+	metrics.SetScheduler(&metricScheduler);
 	if (not LoadFromStream(stream))
 		cerr << "Failed to load the model !" << endl;
 }
@@ -82,7 +100,11 @@ void ChIModel::SetUpCellsAndODEs(unsigned int nbCells)
 void ChIModel::Initialize(ResultSaver saver)
 {
 	ODENetworkDynamicsModel<CouplingFunction, ChICell>::Initialize(saver);
-	Stimulable::Initialize();
+	StimulableCellNetwork::Initialize();
+	coupling.Invalidate();
+	activeSetOn = false;
+	// Specialised network function if the cell and link types allow it
+	SetFunct(ODE::CreateNetworkRHS(*this), true);
 
 	// Initialize metrics
 	metrics.InitializeMetricsDefault();
@@ -108,6 +130,10 @@ bool ChIModel::PreSimulationCall(ResultSaver saver)
 		isPreRunning = false;
 	}
 	ODE::ODEProblem<double, double>::UseCurrentValsAsInitVals();
+	if (useActiveSet and not (validOn and validRecording))
+		initActiveSet();
+	if (validOn)
+		initValidation();
 
 	// Save wanted data
 	ok &= metrics.ComputeMetrics<NeedFrequentUpdateMetric>(*this);
@@ -124,6 +150,12 @@ bool ChIModel::PostSimulationCall(ResultSaver saver)
 
 TRACE_UP("*** Computing and saving after simulation ChIMetrics ***")
 	ok &= ODENetworkDynamicsModel<CouplingFunction, ChICell>::PostSimulationCall(saver);
+	// Propagation distances are only computed on activations, their last
+	// sample is taken when the simulation stops (possibly before tEnd)
+	PropagationDistance *propDist = 
+		GetSpecificMetric<Metric, PropagationDistance>(GetAllMetrics());
+	if (propDist)
+		ok &= propDist->ComputeMetric(*this);
 	ok &= metrics.ComputeMetrics<ChIModelAfterSimMetric>(*this);
 	ok &= metrics.SaveMetrics<ChIModelAfterSimMetric>(saver);
 TRACE_DOWN("*** After simulation metric data saved ***")
@@ -144,14 +176,448 @@ TRACE_DOWN("*** Finished saving dynamic data ***")
 //**********************************************************************
 void ChIModel::ComputeFluxes(double )
 {
-	const std::vector<std::vector<unsigned int> > & neighbors = network->GetAllNeighbors();
-	for (unsigned int i = 0 ;  i < neighbors.size() ; ++i)
+	// The fluxes of frozen cells are refreshed once per step by 
+	// updateActiveSet
+	if (activeSetOn)
+	{
+		for (unsigned int k = 0 ; k < activeCells.size() ; ++k)
+		{
+			cells[activeCells[k]]->totFlux = compCouplingFlux(activeCells[k]);
+			cells[activeCells[k]]->caSpontLeak = false;
+		}
+		return;
+	}
+
+	for (unsigned int i = 0 ;  i < cells.size() ; ++i)
+	{
+		cells[i]->totFlux = compCouplingFlux(i);
+		cells[i]->caSpontLeak = false;
+	}
+}
+
+//**********************************************************************
+// Gap junction flux going out of cell i
+//**********************************************************************
+double ChIModel::compCouplingFlux(unsigned int i) const
+{
+	const std::vector<unsigned int> & neighbors = network->GetNeighbors(i);
+	double flux = 0;
+	for (unsigned int j = 0 ; j < neighbors.size() ; ++j)
+		if (not IsLinkBlocked(i, neighbors[j]))
+			flux += (*((*network)[i][neighbors[j]]))(
+				cells[i]->dynVals[ChICell::IP3] - cells[neighbors[j]]->dynVals[ChICell::IP3]);
+	return flux;
+}
+
+//**********************************************************************
+// Fills the jacobian at the current values. Fluxes are frozen while 
+// the kinetics of each cell are differentiated numerically, so that the
+// (non smooth) coupling functions never see the perturbations. The
+// fluxes are the ones of the last function evaluation (at the current
+// values), stimulation strategies are not called again.
+//**********************************************************************
+bool ChIModel::CompJacobian(double t, ODE::SparseMatrix<double> & jac)
+{
+	unsigned int bs = GetJacobianBlockSize();
+	const double sqrtEps = sqrt(DBL_EPSILON);
+	vector<double> v(bs), f0(bs), f1(bs);
+
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
+	{
+		const double *y = vals + i * bs;
+		for (unsigned int k = 0 ; k < bs ; ++k)
+			v[k] = y[k];
+		cells[i]->funct->CompFunc(t, &v[0], &f0[0]);
+		for (unsigned int k = 0 ; k < bs ; ++k)
+		{
+			v[k] = y[k] + sqrtEps * std::max(fabs(y[k]), 1e-3);
+			double eps = v[k] - y[k];
+			cells[i]->funct->CompFunc(t, &v[0], &f1[0]);
+			for (unsigned int r = 0 ; r < bs ; ++r)
+			{
+				int pos = jac.Find(i * bs + r, i * bs + k);
+				if (pos >= 0)
+					jac.values[pos] = (f1[r] - f0[r]) / eps;
+			}
+			v[k] = y[k];
+		}
+	}
+	addCouplingJacobian(jac);
+
+	// Frozen cells have null derivatives
+	if (activeSetOn)
+		for (unsigned int i = 0 ; i < cells.size() ; ++i)
+			if (not cellActive[i])
+				for (unsigned int pos = jac.rowStart[i * bs] ; pos < jac.rowStart[(i + 1) * bs] ; ++pos)
+					jac.values[pos] = 0;
+	return true;
+}
+
+//**********************************************************************
+// Only stimulation fluxes are kept in totFlux during split steps
+//**********************************************************************
+bool ChIModel::PrepareSplitStep(double t)
+{
+	// The coupling integrator works on the whole network and doesn't 
+	// know about blocked gap junctions. This is checked before stimulating
+	// since the fallback step stimulates cells itself (cells decoupled by
+	// this stimulation are thus only seen at the next step).
+	if (activeSetOn or HasBlockedLinks())
+		return false;
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
 	{
 		cells[i]->totFlux = 0;
 		cells[i]->caSpontLeak = false;
+	}
+	Stimulate(t);
+	coupling.Reset();
+	return true;
+}
+
+//**********************************************************************
+//**********************************************************************
+void ChIModel::CompLocalFunc(double t, unsigned int i, const double *v, double *f) const
+{
+	cells[i]->funct->CompFunc(t, v, f);
+}
+
+//**********************************************************************
+//**********************************************************************
+void ChIModel::IntegrateCoupling(double , double h)
+{
+	coupling.Integrate(*network, vals, GetJacobianBlockSize(), ChICell::IP3, h);
+}
+
+//**********************************************************************
+// totFlux gets the mean gap junction flux over the step
+//**********************************************************************
+void ChIModel::FinishSplitStep(double , double h)
+{
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
+		cells[i]->totFlux += coupling.GetOutflow(i) / h;
+}
+
+//**********************************************************************
+// Cells that changed since t are the active ones and the ones that were
+// frozen after t
+//**********************************************************************
+bool ChIModel::GetBlocksChangedSince(double t, std::vector<unsigned int> & blocks) const
+{
+	if (not activeSetOn)
+		return false;
+	blocks = activeCells;
+	std::vector<std::pair<double, unsigned int> >::const_iterator it = 
+		std::lower_bound(freezeEvents.begin(), freezeEvents.end(), std::make_pair(t, 0u));
+	for ( ; it != freezeEvents.end() ; ++it)
+		blocks.push_back(it->second);
+	return true;
+}
+
+//**********************************************************************
+// Active set integration. Cells at rest are frozen : their derivatives
+// are not computed and considered null. A frozen cell i satisfies 
+//   |y_i - y_i*| <= tol |y_i*|  (component wise, y* being the rest state)
+// and sees a gap junction flux and a stimulation flux that both depart
+// from rest by less than wakeFlux. Linearizing the kinetics at rest 
+// (jacobian J_i, stable), the true values of the cell then stay within
+//   tol |y_i*| + 2 wakeFlux |J_i^-1 e_IP3|
+// of rest, the frozen values being within tol |y_i*| of it. While frozen,
+// a cell thus departs from the full integration by at most
+//   2 tol |y_i*| + 2 wakeFlux |J_i^-1 e_IP3|
+// whatever the time it spends frozen. Waking up is done at the end of 
+// the step, delaying the response of a cell by at most one time step. 
+// With tol = 0 and wakeFlux = 0, only cells exactly at rest are frozen
+// and the full integration is recovered.
+//**********************************************************************
+void ChIModel::initActiveSet()
+{
+	restVals.assign(vals, vals + nbVals);
+	restFlux.resize(cells.size());
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
+		restFlux[i] = compCouplingFlux(i);
+
+	cellActive.assign(cells.size(), 1);
+	cellStimulated.assign(cells.size(), 0);
+	activeCells.resize(cells.size());
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
+		activeCells[i] = i;
+	stimulatedCells.clear();
+	freezeEvents.clear();
+	activeSetOn = true;
+}
+
+//**********************************************************************
+// Only active cells and their neighbors are visited
+//**********************************************************************
+void ChIModel::updateActiveSet(double t)
+{
+	std::vector<unsigned int> newActive;
+	newActive.reserve(activeCells.size());
+
+	// Stimulated cells are always active
+	for (unsigned int k = 0 ; k < stimulatedCells.size() ; ++k)
+		if (not cellActive[stimulatedCells[k]])
+		{
+			cellActive[stimulatedCells[k]] = 1;
+			newActive.push_back(stimulatedCells[k]);
+		}
+
+	unsigned int nbActive = activeCells.size();
+	for (unsigned int k = 0 ; k < nbActive ; ++k)
+	{
+		unsigned int i = activeCells[k];
+		// Wakes up neighbors if the flux they receive isn't the resting one.
+		// Only frozen cells next to active ones see their flux change, it
+		// is refreshed here so that GetTotalFlux stays exact for them.
+		const std::vector<unsigned int> & neighbors = network->GetNeighbors(i);
+		for (unsigned int j = 0 ; j < neighbors.size() ; ++j)
+			if (not cellActive[neighbors[j]])
+			{
+				cells[neighbors[j]]->totFlux = compCouplingFlux(neighbors[j]);
+				if (fabs(cells[neighbors[j]]->totFlux - restFlux[neighbors[j]]) > activeSetWakeFlux)
+				{
+					cellActive[neighbors[j]] = 1;
+					newActive.push_back(neighbors[j]);
+				}
+			}
+
+		if (isCellAtRest(i))
+		{
+			cellActive[i] = 0;
+			freezeEvents.push_back(std::make_pair(t, i));
+		}
+		else
+			newActive.push_back(i);
+	}
+	activeCells.swap(newActive);
+
+	for (unsigned int k = 0 ; k < stimulatedCells.size() ; ++k)
+		cellStimulated[stimulatedCells[k]] = 0;
+	stimulatedCells.clear();
+}
+
+//**********************************************************************
+//**********************************************************************
+bool ChIModel::isCellAtRest(unsigned int i) const
+{
+	if (cellStimulated[i])
+		return false;
+
+	unsigned int bs = GetJacobianBlockSize();
+	for (unsigned int k = i * bs ; k < (i + 1) * bs ; ++k)
+		if (fabs(vals[k] - restVals[k]) > activeSetTol * fabs(restVals[k]))
+			return false;
+
+	if (fabs(compCouplingFlux(i) - restFlux[i]) > activeSetWakeFlux)
+		return false;
+
+	// IP3 differences with neighbors
+	const std::vector<unsigned int> & neighbors = network->GetNeighbors(i);
+	double restIP3 = restVals[i * bs + ChICell::IP3];
+	for (unsigned int j = 0 ; j < neighbors.size() ; ++j)
+	{
+		double diff = cells[i]->dynVals[ChICell::IP3] - cells[neighbors[j]]->dynVals[ChICell::IP3];
+		double restDiff = restIP3 - restVals[neighbors[j] * bs + ChICell::IP3];
+		if (fabs(diff - restDiff) > activeSetTol * fabs(restIP3))
+			return false;
+	}
+	return true;
+}
+
+//**********************************************************************
+// Active set validation. The same run is integrated fully, recording 
+// the values every nOut steps, and then with the active set. At each
+// sampling time, the deviation of each variable of each frozen cell is
+// compared to the bound of this cell (see initActiveSet), J_i being 
+// computed by finite differences at rest. Active cells have no bound of
+// their own, their largest deviation is only reported.
+//**********************************************************************
+void ChIModel::SetActiveSetValidationPass(bool fullIntegration)
+{
+	validOn = true;
+	validRecording = fullIntegration;
+	validCursor = 0;
+	if (fullIntegration)
+		validRef.clear();
+	unsigned int bs = GetJacobianBlockSize();
+	validMaxDev.assign(bs, 0);
+	validBoundAtMax.assign(bs, 0);
+	validMaxRatio.assign(bs, 0);
+	validMaxActiveDev.assign(bs, 0);
+}
+
+//**********************************************************************
+// Called after the pre run, the current state being the resting one
+//**********************************************************************
+void ChIModel::initValidation()
+{
+	validNextSample = tCurr;
+	if (validRecording)
+		return;
+
+	unsigned int bs = GetJacobianBlockSize();
+	const double sqrtEps = sqrt(DBL_EPSILON);
+	vector<double> v(bs), f0(bs), f1(bs), jac(bs * bs), x(bs);
+
+	validBound.resize(nbVals);
+	ComputeFluxes(tCurr);
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
+	{
+		const double *y = vals + i * bs;
+		for (unsigned int k = 0 ; k < bs ; ++k)
+			v[k] = y[k];
+		cells[i]->funct->CompFunc(tCurr, &v[0], &f0[0]);
+		for (unsigned int k = 0 ; k < bs ; ++k)
+		{
+			v[k] = y[k] + sqrtEps * std::max(fabs(y[k]), 1e-3);
+			double eps = v[k] - y[k];
+			cells[i]->funct->CompFunc(tCurr, &v[0], &f1[0]);
+			for (unsigned int r = 0 ; r < bs ; ++r)
+				jac[r * bs + k] = (f1[r] - f0[r]) / eps;
+			v[k] = y[k];
+		}
+		// Steady response to a unit IP3 flux
+		bool regular = solveDense(jac, bs, ChICell::IP3, x);
+		for (unsigned int k = 0 ; k < bs ; ++k)
+			validBound[i * bs + k] = 2.0 * activeSetTol * fabs(y[k]) + 
+				(regular ? 2.0 * activeSetWakeFlux * fabs(x[k]) : HUGE_VAL);
+	}
+}
+
+//**********************************************************************
+// Solves a x = e_col by gaussian elimination with partial pivoting, a 
+// being a n x n row major matrix. Returns false if a is singular.
+//**********************************************************************
+bool ChIModel::solveDense(std::vector<double> a, unsigned int n, unsigned int col, 
+	std::vector<double> & x)
+{
+	x.assign(n, 0);
+	x[col] = 1;
+	for (unsigned int c = 0 ; c < n ; ++c)
+	{
+		unsigned int piv = c;
+		for (unsigned int r = c + 1 ; r < n ; ++r)
+			if (fabs(a[r * n + c]) > fabs(a[piv * n + c]))
+				piv = r;
+		if (a[piv * n + c] == 0)
+			return false;
+		for (unsigned int k = 0 ; k < n ; ++k)
+			std::swap(a[c * n + k], a[piv * n + k]);
+		std::swap(x[c], x[piv]);
+		for (unsigned int r = c + 1 ; r < n ; ++r)
+		{
+			double m = a[r * n + c] / a[c * n + c];
+			for (unsigned int k = c ; k < n ; ++k)
+				a[r * n + k] -= m * a[c * n + k];
+			x[r] -= m * x[c];
+		}
+	}
+	for (unsigned int c = n ; c-- > 0 ; )
+	{
+		for (unsigned int k = c + 1 ; k < n ; ++k)
+			x[c] -= a[c * n + k] * x[k];
+		x[c] /= a[c * n + c];
+	}
+	return true;
+}
+
+//**********************************************************************
+//**********************************************************************
+void ChIModel::updateValidation(double t)
+{
+	if (t < validNextSample)
+		return;
+	while (validNextSample <= t)
+		validNextSample += nOut * GetIntegrStep();
+
+	if (validRecording)
+	{
+		validRef.insert(validRef.end(), vals, vals + nbVals);
+		return;
+	}
+	// Adaptive solvers may not sample the same number of times
+	if (validCursor + nbVals > validRef.size())
+		return;
+
+	unsigned int bs = GetJacobianBlockSize();
+	const double *ref = &validRef[validCursor];
+	validCursor += nbVals;
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
+		for (unsigned int k = i * bs ; k < (i + 1) * bs ; ++k)
+		{
+			double dev = fabs(vals[k] - ref[k]);
+			if (activeSetOn and cellActive[i])
+			{
+				validMaxActiveDev[k - i * bs] = std::max(validMaxActiveDev[k - i * bs], dev);
+				continue;
+			}
+			double ratio = (validBound[k] > 0) ? dev / validBound[k] : ((dev > 0) ? HUGE_VAL : 0);
+			if (ratio > validMaxRatio[k - i * bs])
+				validMaxRatio[k - i * bs] = ratio;
+			if (dev > validMaxDev[k - i * bs])
+			{
+				validMaxDev[k - i * bs] = dev;
+				validBoundAtMax[k - i * bs] = validBound[k];
+			}
+		}
+}
+
+//**********************************************************************
+// Saves, for each variable, the largest deviation of frozen cells, their
+// bound at that time, the largest deviation to bound ratio and the 
+// largest deviation of active cells
+//**********************************************************************
+bool ChIModel::ReportActiveSetValidation(ResultSaver saver) const
+{
+	static const char *varNames[] = {"Ca", "h", "IP3"};
+	bool ok = true;
+
+	if (validCursor == 0)
+		cerr << "Warning : no sample to validate the active set integration against" << endl;
+	std::ostream *stream = 0;
+	std::string validName("ActiveSetValidation");
+	if (saver.isSaving(validName))
+	{
+		stream = &saver.getStream();
+		*stream << "Var\tMaxFrozenDev\tBoundAtMaxDev\tMaxDevToBound\tMaxActiveDev" << endl;
+	}
+	for (unsigned int k = 0 ; k < validMaxDev.size() ; ++k)
+	{
+		std::string name = (k < 3) ? varNames[k] : StringifyFixed(k);
+		TRACE(name << " : max frozen dev = " << validMaxDev[k] << " max dev to bound = " << 
+			validMaxRatio[k] << " max active dev = " << validMaxActiveDev[k])
+		if (stream)
+			*stream << name << "\t" << validMaxDev[k] << "\t" << validBoundAtMax[k] << 
+				"\t" << validMaxRatio[k] << "\t" << validMaxActiveDev[k] << endl;
+		if (validMaxRatio[k] > 1)
+		{
+			cerr << "Error : active set deviation of frozen " << name << " (" << validMaxDev[k] << 
+				") exceeds its error bound" << endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+//**********************************************************************
+// IP3 fluxes : d(totFlux_i) / d(IP3_i) = sum_j g_ij'(IP3_i - IP3_j)
+//**********************************************************************
+void ChIModel::addCouplingJacobian(ODE::SparseMatrix<double> & jac) const
+{
+	unsigned int bs = GetJacobianBlockSize();
+	const std::vector<std::vector<unsigned int> > & neighbors = network->GetAllNeighbors();
+	for (unsigned int i = 0 ;  i < neighbors.size() ; ++i)
+	{
+		unsigned int row = i * bs + ChICell::IP3;
 		for (unsigned int j = 0 ; j < neighbors[i].size() ; ++j)
-			cells[i]->totFlux += (*((*network)[i][neighbors[i][j]]))(
-					cells[i]->dynVals[ChICell::IP3] - cells[neighbors[i][j]]->dynVals[ChICell::IP3]);
+		{
+			if (IsLinkBlocked(i, neighbors[i][j]))
+				continue;
+			double dFlux = (*network)[i][neighbors[i][j]]->Derivative(
+				cells[i]->dynVals[ChICell::IP3] - cells[neighbors[i][j]]->dynVals[ChICell::IP3]);
+			jac.values[jac.Find(row, row)] -= dFlux;
+			jac.values[jac.Find(row, neighbors[i][j] * bs + ChICell::IP3)] += dFlux;
+		}
 	}
 }
 
@@ -161,7 +627,13 @@ void ChIModel::ComputeFluxes(double )
 void ChIModel::ModifFluxes(unsigned int i, double flux)
 {
 	//assert(i < cells.size());
-	cells[i]->totFlux += flux;
+	if (activeSetOn and (fabs(flux) > activeSetWakeFlux) and (not cellStimulated[i]))
+	{
+		cellStimulated[i] = 1;
+		stimulatedCells.push_back(i);
+	}
+	if ((not activeSetOn) or cellActive[i])
+		cells[i]->totFlux += flux;
 }
 
 //**********************************************************************
@@ -169,6 +641,11 @@ void ChIModel::ModifFluxes(unsigned int i, double flux)
 //**********************************************************************
 void ChIModel::StimSpontaneousCa(unsigned int i)
 {
+	if (activeSetOn and (not cellStimulated[i]))
+	{
+		cellStimulated[i] = 1;
+		stimulatedCells.push_back(i);
+	}
 	cells[i]->caSpontLeak = true;
 }
 
@@ -307,6 +784,29 @@ double ChIModel::GetExcDynVal(unsigned int cellNb) const
 	return GetDynVal(cellNb, ChICell::Ca);
 }
 
+//********************************************************************//
+// Position of the excitable values in vals
+//********************************************************************//
+bool ChIModel::GetExcDynValLayout(unsigned int & offset, unsigned int & stride) const
+{
+	offset = ChICell::Ca;
+	stride = ChICell::NbValsPerCell;
+	return true;
+}
+
+//**********************************************************************
+// Files saved by the metrics of src are reported by the ones of dst
+//**********************************************************************
+static void pullSavedFilePaths(const ChIModel & dst, const ChIModel & src)
+{
+	std::vector<Metric *> dstMetrics = dst.GetAllMetrics();
+	std::vector<Metric *> srcMetrics = src.GetAllMetrics();
+	for (unsigned int i = 0 ; i < dstMetrics.size() ; ++i)
+		for (unsigned int j = 0 ; j < srcMetrics.size() ; ++j)
+			if (srcMetrics[j]->GetClassName() == dstMetrics[i]->GetClassName())
+				dstMetrics[i]->PullSavedFilePathsFrom(*srcMetrics[j]);
+}
+
 //********************************************************************//
 //* C H I  M O D E L   T H R E S H O L D   D E T E R M I N A T I O N *//
 //********************************************************************//
@@ -317,9 +817,12 @@ string ChIModelThresholdDetermination::ClassName = "ChIModelThresholdDeterminati
 // Default Constructor
 //**********************************************************************
 ChIModelThresholdDetermination::ChIModelThresholdDetermination(ParamHandler & h) :
-	ChIModel(h)
+	ChIModel(h), isProbe(false), probeFinished(false), probeStimulated(false), 
+	prevTime(0), probeMetr(0)
 {
-
+	bisect = h.getParam<bool>("-ThreshDetermBisect", 0);
+	nbProbeThreads = h.getParam<int>("-ThreshDetermBisect", 1);
+	restTol = h.getParam<double>("-ThreshDetermBisect", 2);
 }
 
 //**********************************************************************
@@ -327,9 +830,12 @@ ChIModelThresholdDetermination::ChIModelThresholdDetermination(ParamHandler & h)
 //**********************************************************************
 ChIModelThresholdDetermination::ChIModelThresholdDetermination(
 	std::ifstream & stream, ParamHandler & h) :
-	ChIModel(stream, h)
+	ChIModel(stream, h), isProbe(false), probeFinished(false), 
+	probeStimulated(false), prevTime(0), probeMetr(0)
 {
-	
+	bisect = h.getParam<bool>("-ThreshDetermBisect", 0);
+	nbProbeThreads = h.getParam<int>("-ThreshDetermBisect", 1);
+	restTol = h.getParam<double>("-ThreshDetermBisect", 2);
 }
 
 //**********************************************************************
@@ -354,6 +860,9 @@ TRACE_UP("*** Saving metric data ***")
 	this->metrics.ComputeMetrics<ChIModelStaticMetric>(*this);
 TRACE_DOWN("*** Metric data saved ***")
 
+	if (bisect)
+		return returnVal | simulateBisection(saver);
+
 	// There should be only one stimulation strategy for this model
 	assert(stimStrats.size() == 1);
 
@@ -404,6 +913,163 @@ TRACE_DOWN("*** Threshold determination data saved ***")
 	return returnVal;
 }
 
+//**********************************************************************
+// Bisection on the number of stimulated cells : each round simulates
+// up to nbProbeThreads probes at once and narrows ]lo, hi] so that lo
+// doesn't make the reference cell spike and hi does. Assumes that 
+// spiking is monotone in the number of stimulated cells.
+//**********************************************************************
+int ChIModelThresholdDetermination::simulateBisection(ResultSaver saver)
+{
+	int returnVal = 0;
+
+	ThresholdDetermination *threshMetr = 
+		GetSpecificMetric<Metric, ThresholdDetermination>(this->GetAllMetrics());
+	assert(threshMetr);
+
+	unsigned int k = this->GetNetwork().GetNodeDegree(0);
+	unsigned int nbProbes = std::max(1u, nbProbeThreads);
+	unsigned int lo = 0, hi = k + 1;
+	// Record of each probed number of stimulated cells
+	std::map<unsigned int, ThresholdDetermination> records;
+	// Probe of the current upper bound, or of k if nothing spiked yet
+	ChIModelThresholdDetermination *best = 0;
+	ProbeTask task;
+
+	while (hi - lo > 1)
+	{
+		// k is probed in the first round so that there is always a 
+		// simulation to save
+		std::vector<unsigned int> nbStims;
+		if (records.empty())
+		{
+			nbStims.push_back(k);
+			for (unsigned int m = 1 ; (m < nbProbes) and (m < k) ; ++m)
+				nbStims.push_back((m * k) / nbProbes);
+		}
+		else
+		{
+			unsigned int n = std::min(nbProbes, hi - lo - 1);
+			for (unsigned int m = 1 ; m <= n ; ++m)
+				nbStims.push_back(lo + (m * (hi - lo)) / (n + 1));
+		}
+		std::sort(nbStims.begin(), nbStims.end());
+		nbStims.erase(std::unique(nbStims.begin(), nbStims.end()), nbStims.end());
+
+		// Probes are created in the main thread, cells initialization
+		// uses the global random generator
+		task.probes.clear();
+		for (unsigned int m = 0 ; m < nbStims.size() ; ++m)
+			task.probes.push_back(createProbe(nbStims[m]));
+		ParallelFor(task.probes.size(), nbProbes, task);
+
+		for (unsigned int m = 0 ; m < nbStims.size() ; ++m)
+		{
+			records[nbStims[m]].AddSimulation(*(task.probes[m]->probeMetr), 
+				nbStims[m], GetDegree(), GetNbDerivs());
+			if (task.probes[m]->probeMetr->HasSpiked() and (nbStims[m] < hi))
+				hi = nbStims[m];
+		}
+		for (unsigned int m = 0 ; m < nbStims.size() ; ++m)
+			if ((nbStims[m] < hi) and (nbStims[m] > lo))
+				lo = nbStims[m];
+
+		for (unsigned int m = 0 ; m < task.probes.size() ; ++m)
+		{
+			if ((nbStims[m] == hi) or ((nbStims[m] == k) and not best))
+			{
+				delete best;
+				best = task.probes[m];
+			}
+			else
+				delete task.probes[m];
+		}
+	}
+	assert(best);
+
+	// Probed simulations, in increasing number of stimulated cells
+	for (std::map<unsigned int, ThresholdDetermination>::const_iterator it = 
+		records.begin() ; it != records.end() ; ++it)
+		threshMetr->AddSimulation(it->second, it->first, GetDegree(), GetNbDerivs());
+
+	// Dynamic data of the threshold simulation
+	if (not best->metrics.SaveMetrics<ChIModelDynMetric>(saver))
+		returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+	if (not best->stimStrats[0]->SaveMetrics(saver))
+		returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+	if (not best->ODE::ODEProblem<double, double>::SaveMetrics(saver))
+		returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+
+	// Files saved by the probe are reported by the model metrics
+	pullSavedFilePaths(*this, *best);
+	delete best;
+
+TRACE_UP("*** Saving threshold determination data ***")
+	if (not this->metrics.SaveMetrics<ChIModelThreshDetermMetric>(saver))
+		returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+TRACE_DOWN("*** Threshold determination data saved ***")
+
+	return returnVal;
+}
+
+//**********************************************************************
+// Returns a replica of the model initialized for nbStim stimulated cells
+//**********************************************************************
+ChIModelThresholdDetermination * ChIModelThresholdDetermination::createProbe(
+	unsigned int nbStim)
+{
+	ChIModelThresholdDetermination *probe = CreateReplica(*this, param);
+
+	probe->Initialize();
+	probe->network->ComputeMetrics();
+	probe->isProbe = true;
+	probe->probeMetr = 
+		GetSpecificMetric<Metric, ThresholdDetermination>(probe->GetAllMetrics());
+	assert(probe->probeMetr and (probe->stimStrats.size() == 1));
+
+	ThresholdDeterminationStimStrat *specStimStrat = 
+		dynamic_cast<ThresholdDeterminationStimStrat *>(probe->stimStrats[0]);
+	assert(specStimStrat);
+	specStimStrat->SetStimulatedCells(nbStim);
+	for (unsigned int j = 0 ; j < probe->cells.size() ; ++j)
+		probe->cells[j]->Initialize();
+	probe->metrics.InitializeMetrics<ChIModelDynMetric>();
+	specStimStrat->Initialize();
+	probe->prevVals.assign(probe->vals, probe->vals + probe->GetNbVals());
+	probe->prevTime = probe->tStart;
+
+	return probe;
+}
+
+//**********************************************************************
+// Notifies the model that all values have been updated for timestep t
+//**********************************************************************
+void ChIModelThresholdDetermination::UpdateVals(double t)
+{
+	ChIModel::UpdateVals(t);
+	if (isProbe and not probeFinished)
+		probeFinished = probeMetr->HasSpiked() or isBackToRest(t);
+}
+
+//**********************************************************************
+// The stimulated cells stop being stimulated once they fired, the 
+// reference cell can't spike anymore when the network has settled
+//**********************************************************************
+bool ChIModelThresholdDetermination::isBackToRest(double t)
+{
+	bool stimulated = false;
+	for (unsigned int i = 0 ; (i < GetNbCells()) and not stimulated ; ++i)
+		stimulated = IsStimulated(i);
+	probeStimulated |= stimulated;
+
+	bool atRest = probeStimulated and not stimulated and (t > prevTime);
+	for (unsigned int i = 0 ; (i < prevVals.size()) and atRest ; ++i)
+		atRest = (fabs(vals[i] - prevVals[i]) <= restTol * (t - prevTime) * fabs(prevVals[i]));
+	prevVals.assign(vals, vals + prevVals.size());
+	prevTime = t;
+	return atRest;
+}
+
 //**********************************************************************
 // Returns the network central node degree
 //**********************************************************************
@@ -438,6 +1104,7 @@ ChIModelStochasticRes::ChIModelStochasticRes(ParamHandler & h) :
 {
 	signalStimStratClassName = param.getParam<std::string>("-StochRes", 0);
 	noiseStimStratClassName = param.getParam<std::string>("-StochRes", 1);
+	concurrent = param.getParam<bool>("-StochResConcurrent");
 }
 
 //**********************************************************************
@@ -450,6 +1117,7 @@ ChIModelStochasticRes::ChIModelStochasticRes(
 TRACE("Building stoch res")
 	if (not LoadFromStream(stream))
 		cerr << "Failed to load the model !" << endl;
+	concurrent = param.getParam<bool>("-StochResConcurrent");
 }
 
 //**********************************************************************
@@ -457,7 +1125,41 @@ TRACE("Building stoch res")
 //**********************************************************************
 ChIModelStochasticRes::~ChIModelStochasticRes()
 {
+	for (unsigned int i = 0 ; i < replicas.size() ; ++i)
+		delete replicas[i];
+}
+
+//**********************************************************************
+// Replicas are initialized from the same random state as the model so 
+// that they build the same network and cells
+//**********************************************************************
+void ChIModelStochasticRes::Initialize(ResultSaver saver)
+{
+	if (not concurrent)
+	{
+		ChIModel::Initialize(saver);
+		return;
+	}
 
+	gsl_rng *rngBefore = gsl_rng_clone(globalRNG.rng);
+	ChIModel::Initialize(saver);
+	gsl_rng *rngAfter = gsl_rng_clone(globalRNG.rng);
+
+	while (replicas.size() < 2)
+	{
+		replicas.push_back(CreateReplica(*this, param));
+		replicas.back()->concurrent = false;
+	}
+	for (unsigned int i = 0 ; i < replicas.size() ; ++i)
+	{
+		SyncModelParams(*this, *replicas[i]);
+		gsl_rng_memcpy(globalRNG.rng, rngBefore);
+		replicas[i]->Initialize();
+	}
+
+	gsl_rng_memcpy(globalRNG.rng, rngAfter);
+	gsl_rng_free(rngBefore);
+	gsl_rng_free(rngAfter);
 }
 
 //**********************************************************************
@@ -465,6 +1167,9 @@ ChIModelStochasticRes::~ChIModelStochasticRes()
 //**********************************************************************
 int ChIModelStochasticRes::Simulate(ResultSaver saver)
 {
+	if (concurrent)
+		return simulateConcurrent(saver);
+
 	int returnVal = 0;
 
 	this->metrics.InitializeMetrics<ChIModelDynMetric>();
@@ -538,6 +1243,131 @@ int ChIModelStochasticRes::Simulate(ResultSaver saver)
 	return returnVal;
 }
 
+//**********************************************************************
+// The three variants are prepared in the order of Simulate, so that 
+// they draw the same random numbers, and are then simulated at once.
+// The signal only and noise only variants run on the replicas, the
+// signal and noise one on the model itself.
+//**********************************************************************
+int ChIModelStochasticRes::simulateConcurrent(ResultSaver saver)
+{
+	int returnVal = 0;
+	assert(replicas.size() == 2);
+	ChIModelStochasticRes *signalOnly = replicas[0];
+	ChIModelStochasticRes *noiseOnly = replicas[1];
+
+	this->metrics.InitializeMetrics<ChIModelDynMetric>();
+	PreSimulationCall(saver);
+
+	// The random draws of the replicas pre simulation calls are discarded
+	gsl_rng *rngState = gsl_rng_clone(globalRNG.rng);
+	for (unsigned int i = 0 ; i < replicas.size() ; ++i)
+	{
+		replicas[i]->metrics.InitializeMetrics<ChIModelDynMetric>();
+		replicas[i]->PreSimulationCall(ResultSaver::NullSaver);
+		gsl_rng_memcpy(globalRNG.rng, rngState);
+	}
+	gsl_rng_free(rngState);
+
+	std::vector<RandomStimStrat *> sequences(stimStrats.size(), 0);
+
+	signalOnly->InitializeDynVals();
+	signalOnly->setActivations(true, false);
+	signalOnly->prepareStimStrats(sequences);
+
+	noiseOnly->resetVariant(saver);
+	noiseOnly->setActivations(false, true);
+	noiseOnly->prepareStimStrats(sequences);
+
+	resetVariant(saver);
+	setActivations(true, true);
+	prepareStimStrats(sequences);
+
+	VariantTask task;
+	task.models.push_back(signalOnly);
+	task.models.push_back(noiseOnly);
+	task.models.push_back(this);
+	ParallelFor(task.models.size(), task.models.size(), task);
+
+	// Results are gathered in the order of Simulate, where activated 
+	// cells are recorded through the three variants
+	const char *names[] = {"Signal_only", "Noise_only", "Signal_and_noise"};
+	for (unsigned int i = 0 ; i < task.models.size() ; ++i)
+	{
+		ActivatedCells *actCells = 
+			GetSpecificMetric<Metric, ActivatedCells>(task.models[i]->GetAllMetrics());
+		if (actCells and (i > 0))
+			actCells->PrependActivationsOf(*GetSpecificMetric<Metric, ActivatedCells>(
+				task.models[i - 1]->GetAllMetrics()));
+		StimulatedCells::NewStimulationsFile();
+		this->metrics.ComputeMetrics<StochResMetric>(*task.models[i]);
+		task.models[i]->PostSimulationCall(saver(names[i]));
+		if (task.models[i] != this)
+			pullSavedFilePaths(*this, *task.models[i]);
+	}
+
+	// Replicas are left at equilibrium like the model, their random 
+	// draws are discarded
+	rngState = gsl_rng_clone(globalRNG.rng);
+	for (unsigned int i = 0 ; i < replicas.size() ; ++i)
+	{
+		replicas[i]->resetVariant(ResultSaver::NullSaver);
+		gsl_rng_memcpy(globalRNG.rng, rngState);
+	}
+	gsl_rng_free(rngState);
+	resetVariant(saver);
+
+	if (not PostSimulationCall(saver))
+		returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+
+	return returnVal;
+}
+
+//**********************************************************************
+// Activates or deactivates the signal and noise strategies
+//**********************************************************************
+void ChIModelStochasticRes::setActivations(bool signal, bool noise)
+{
+	ParamHandler params = BuildModelParamHandler();
+	params.SetVal(signalStimStratClassName + "_Activ", signal ? "1" : "0");
+	params.SetVal(noiseStimStratClassName + "_Activ", noise ? "1" : "0");
+}
+
+//**********************************************************************
+// Resets the model between two variants
+//**********************************************************************
+void ChIModelStochasticRes::resetVariant(ResultSaver saver)
+{
+	InitializeDynVals();
+	SetAllCellsToEquilibrium();
+	this->metrics.InitializeMetrics<ChIModelDynMetric>();
+	ODE::ODEProblem<double, double>::Initialize(saver);
+}
+
+//**********************************************************************
+// In Simulate, random strategies are initialized with the same random
+// sequence, which is drawn during the first variant where they are
+// active. The other strategies draw theirs again for each variant.
+//**********************************************************************
+void ChIModelStochasticRes::prepareStimStrats(std::vector<RandomStimStrat *> & sequences)
+{
+	InitializeStimStrats(true);
+	for (unsigned int i = 0 ; i < stimStrats.size() ; ++i)
+	{
+		if (stimStratActMask[i] == 0)
+			continue;
+		RandomStimStrat *randStrat = dynamic_cast<RandomStimStrat*>(stimStrats[i]);
+		if (randStrat and sequences[i])
+			randStrat->InitializeWithRandomSequenceOf(*sequences[i]);
+		else
+		{
+			stimStrats[i]->DrawRandomSequence(*this);
+			if (randStrat)
+				sequences[i] = randStrat;
+		}
+	}
+}
+
 //**********************************************************************
 // Initialize stimulation strategies
 //**********************************************************************
@@ -581,3 +1411,354 @@ bool ChIModelStochasticRes::SaveToStream(std::ofstream & stream) const
 	return ok and stream.good();
 }
 
+
+//********************************************************************//
+//****************** C H I  M O D E L   B A T C H ********************//
+//********************************************************************//
+
+//**********************************************************************
+// Constructor
+//**********************************************************************
+template <typename Val>
+ChIModelBatch<Val>::ChIModelBatch(const std::vector<ChIModel *> & _replicas, 
+	ParamHandler & h) : ODE::ODEProblem<Val, double>(0, h), 
+	replicas(_replicas), nbCells(0), stimDue(false)
+{
+	assert(not replicas.empty());
+	this->SetFunct(new ODE::ChIBatchNetworkFunct<Val>(*this), true);
+
+	// Implicit, multirate and splitting solvers only exist in double 
+	// precision, the explicit Runge Kutta solver is used instead
+	if (not this->solver)
+	{
+		AbstractFactory<ODE::ODESolver<Val, double> > *fact = 
+			AbstractFactory<ODE::ODESolver<Val, double> >::Factories[ODE::RungeKuttaSolver<Val>::ClassName];
+		if (fact)
+		{
+			std::cerr << "Warning : " << h.getParam<std::string>("-SolverClass") << 
+				" can't integrate batches in this precision, using " << 
+				ODE::RungeKuttaSolver<Val>::ClassName << " instead" << std::endl;
+			this->solver = fact->Create();
+			this->solver->SetStepSize(h.getParam<double>("-Step"));
+		}
+	}
+}
+
+//**********************************************************************
+// Destructor
+//**********************************************************************
+template <typename Val>
+ChIModelBatch<Val>::~ChIModelBatch()
+{
+}
+
+//**********************************************************************
+// Derived models change the cell kinetics or the simulation scheme, and
+// frozen cells of the active set aren't handled. Implicit solvers are
+// left to the replicas : the values of a cell aren't contiguous in the
+// batch, so the block Jacobi preconditioner would only see diagonals.
+//**********************************************************************
+template <typename Val>
+bool ChIModelBatch<Val>::CanBatch(const ChIModel *model)
+{
+	return model and (model->GetClassName() == ChIModel::ClassName) and 
+		(not model->useActiveSet) and 
+		not (model->solver and model->solver->UsesJacobian());
+}
+
+//**********************************************************************
+// Launch simulation. Replicas that don't share the same network are 
+// simulated one after the other.
+//**********************************************************************
+template <typename Val>
+int ChIModelBatch<Val>::Simulate(const std::vector<ResultSaver> & savers)
+{
+	int returnVal = 0;
+	assert(savers.size() == replicas.size());
+
+	// Without a solver, replicas are integrated by their own
+	if ((not sharesNetwork()) or (not this->solver))
+	{
+		if (sizeof(Val) < sizeof(double))
+			std::cerr << "Warning : replicas don't share the same network or can't "
+				"be integrated in single precision, they are simulated in double "
+				"precision" << std::endl;
+		for (unsigned int r = 0 ; r < replicas.size() ; ++r)
+			returnVal |= replicas[r]->Simulate(savers[r]);
+		return returnVal;
+	}
+
+	for (unsigned int r = 0 ; r < replicas.size() ; ++r)
+		replicas[r]->PreSimulationCall(savers[r]);
+
+	this->tStart = replicas[0]->GetTStart();
+	this->tEnd = replicas[0]->GetTEnd();
+	this->integrStep = replicas[0]->GetIntegrStep();
+	this->tCurr = this->tStart;
+	setUpLanes();
+	gatherVals();
+	stimDue = true;
+
+	// Simulate
+TRACE_UP("*** Starting batch simulation of " << replicas.size() << " replicas tStart = " << this->tStart << " tEnd = " << this->tEnd << " ***")
+	this->solver->SetStepSize(this->integrStep);
+	this->solver->Solve(*this, this->tStart, this->tEnd);
+TRACE_DOWN("*** Batch simulation Ended ***")
+
+	scatterVals(this->vals);
+	for (unsigned int r = 0 ; r < replicas.size() ; ++r)
+	{
+		// Each replica saves in its own run directory
+		StimulatedCells::NewStimulationsFile();
+		if (not replicas[r]->PostSimulationCall(savers[r]))
+			returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+	}
+
+	return returnVal;
+}
+
+//**********************************************************************
+// Replicas metrics are computed on their own values, their fluxes being
+// the ones of the last evaluation
+//**********************************************************************
+template <typename Val>
+void ChIModelBatch<Val>::UpdateVals(double t)
+{
+	const unsigned int B = replicas.size();
+	this->tCurr = t;
+	scatterVals(this->vals);
+	for (unsigned int r = 0 ; r < B ; ++r)
+	{
+		std::vector<ChICell *> & cells = replicas[r]->cells;
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+			cells[i]->totFlux = totFlux[i * B + r];
+		replicas[r]->NotifyNewStep(t);
+		replicas[r]->UpdateVals(t);
+	}
+	stimDue = true;
+}
+
+//**********************************************************************
+// Gap junction fluxes are computed for all replicas while traversing
+// the network once, stimulation fluxes of the step are then added.
+//**********************************************************************
+template <typename Val>
+void ChIModelBatch<Val>::ComputeFluxes(double t, const Val *v)
+{
+	if (stimDue)
+	{
+		stimulate(t);
+		stimDue = false;
+	}
+
+	const unsigned int B = replicas.size();
+	const Val *IP3 = v + ChICell::IP3 * nbCells * B;
+	if (linkClass == SigmoidCoupling::ClassName)
+		addCouplingFluxes<SigmoidCoupling>(IP3);
+	else if (linkClass == LinearCoupling::ClassName)
+		addCouplingFluxes<LinearCoupling>(IP3);
+	else
+	{
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+		{
+			Val *flux = &totFlux[i * B];
+			for (unsigned int r = 0 ; r < B ; ++r)
+				flux[r] = 0;
+			for (unsigned int l = linkStart[i] ; l < linkStart[i + 1] ; ++l)
+			{
+				const Val *IP3j = IP3 + linkTarget[l] * B;
+				const Val *open = &linkOpen[l * B];
+				for (unsigned int r = 0 ; r < B ; ++r)
+					flux[r] += open[r] * (Val) (*links[l * B + r])(IP3[i * B + r] - IP3j[r]);
+			}
+		}
+	}
+
+	for (unsigned int k = 0 ; k < totFlux.size() ; ++k)
+		totFlux[k] += stimFlux[k];
+}
+
+//**********************************************************************
+// Blocked links are multiplied by 0 so that the inner loop has no 
+// branches
+//**********************************************************************
+template <typename Val>
+template <typename Link>
+void ChIModelBatch<Val>::addCouplingFluxes(const Val *IP3)
+{
+	const unsigned int B = replicas.size();
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+	{
+		Val *flux = &totFlux[i * B];
+		const Val *IP3i = IP3 + i * B;
+		for (unsigned int r = 0 ; r < B ; ++r)
+			flux[r] = 0;
+		for (unsigned int l = linkStart[i] ; l < linkStart[i + 1] ; ++l)
+		{
+			const Val *IP3j = IP3 + linkTarget[l] * B;
+			const Val *F = &linkF[l * B];
+			const Val *thresh = &linkThresh[l * B];
+			const Val *scale = &linkScale[l * B];
+			const Val *open = &linkOpen[l * B];
+			for (unsigned int r = 0 ; r < B ; ++r)
+				flux[r] += open[r] * Link::Flux(F[r], thresh[r], scale[r], IP3i[r] - IP3j[r]);
+		}
+	}
+}
+
+//**********************************************************************
+// Stimulation strategies read the values of the replicas (scattered at
+// the end of the previous step) and add their fluxes to totFlux. Links
+// blocked by the stimulations are only seen from this step.
+//**********************************************************************
+template <typename Val>
+void ChIModelBatch<Val>::stimulate(double t)
+{
+	const unsigned int B = replicas.size();
+	bool blocked = false;
+	for (unsigned int r = 0 ; r < B ; ++r)
+	{
+		std::vector<ChICell *> & cells = replicas[r]->cells;
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+		{
+			cells[i]->totFlux = 0;
+			cells[i]->caSpontLeak = false;
+		}
+		replicas[r]->Stimulate(t);
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+		{
+			stimFlux[i * B + r] = cells[i]->totFlux;
+			Jspont[i * B + r] = cells[i]->caSpontLeak ? cells[i]->rL : 0;
+			gluIP3Prod[i * B + r] = cells[i]->gluIP3Prod;
+		}
+		blocked |= replicas[r]->HasBlockedLinks();
+	}
+
+	if (blocked)
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+			for (unsigned int l = linkStart[i] ; l < linkStart[i + 1] ; ++l)
+				for (unsigned int r = 0 ; r < B ; ++r)
+					linkOpen[l * B + r] = 
+						replicas[r]->IsLinkBlocked(i, linkTarget[l]) ? 0 : 1;
+}
+
+//**********************************************************************
+//**********************************************************************
+template <typename Val>
+bool ChIModelBatch<Val>::sharesNetwork() const
+{
+	const std::vector<std::vector<unsigned int> > & neighbors = 
+		replicas[0]->network->GetAllNeighbors();
+	for (unsigned int r = 1 ; r < replicas.size() ; ++r)
+		if ((replicas[r]->cells.size() != replicas[0]->cells.size()) or
+				(replicas[r]->network->GetAllNeighbors() != neighbors))
+			return false;
+	return true;
+}
+
+//**********************************************************************
+// Parameters that are squared (or more) in ChICellFunct are stored 
+// already raised to the appropriate power
+//**********************************************************************
+template <typename Val>
+void ChIModelBatch<Val>::setUpLanes()
+{
+	const unsigned int B = replicas.size();
+	nbCells = replicas[0]->cells.size();
+	this->AllocateMemory(ChICell::NbValsPerCell * nbCells * B);
+
+	// Network
+	const std::vector<std::vector<unsigned int> > & neighbors = 
+		replicas[0]->network->GetAllNeighbors();
+	linkStart.assign(1, 0);
+	linkTarget.clear();
+	links.clear();
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+	{
+		for (unsigned int j = 0 ; j < neighbors[i].size() ; ++j)
+		{
+			linkTarget.push_back(neighbors[i][j]);
+			for (unsigned int r = 0 ; r < B ; ++r)
+				links.push_back((*replicas[r]->network)[i][neighbors[i][j]]);
+		}
+		linkStart.push_back(linkTarget.size());
+	}
+	linkOpen.assign(links.size(), 1);
+
+	// Links of a single class are handled by a specialised kernel
+	bool sigmoid = not links.empty(), linear = not links.empty();
+	for (unsigned int l = 0 ; l < links.size() ; ++l)
+	{
+		sigmoid &= (typeid(*links[l]) == typeid(SigmoidCoupling));
+		linear &= (typeid(*links[l]) == typeid(LinearCoupling));
+	}
+	linkClass = sigmoid ? SigmoidCoupling::ClassName : 
+		(linear ? LinearCoupling::ClassName : "");
+	linkF.resize(links.size());
+	linkThresh.assign(links.size(), 0);
+	linkScale.assign(links.size(), 0);
+	for (unsigned int l = 0 ; l < links.size() ; ++l)
+	{
+		linkF[l] = links[l]->GetStrength();
+		if (linkClass == SigmoidCoupling::ClassName)
+		{
+			linkThresh[l] = static_cast<const SigmoidCoupling *>(links[l])->GetThreshold();
+			linkScale[l] = static_cast<const SigmoidCoupling *>(links[l])->GetScale();
+		}
+	}
+
+	// Model parameters
+	C0.resize(B); d1.resize(B); d2.resize(B); d3.resize(B); 
+	d5.resize(B); v3k.resize(B); K3k4.resize(B); r5p.resize(B);
+	for (unsigned int r = 0 ; r < B ; ++r)
+	{
+		const ChIModel & m = *replicas[r];
+		C0[r] = m.C0; d1[r] = m.d1; d2[r] = m.d2; d3[r] = m.d3; d5[r] = m.d5;
+		v3k[r] = m.v3k; K3k4[r] = INTPOW4(m.K3k); r5p[r] = m.r5p;
+	}
+
+	// Cell parameters
+	unsigned int NB = nbCells * B;
+	c1.resize(NB); rC.resize(NB); rL.resize(NB); vER.resize(NB); a2.resize(NB);
+	Ker2.resize(NB); vd.resize(NB); Kplcd2.resize(NB); kd.resize(NB); k3.resize(NB);
+	totFlux.assign(NB, 0); stimFlux.assign(NB, 0); Jspont.assign(NB, 0); gluIP3Prod.assign(NB, 0);
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+		for (unsigned int r = 0 ; r < B ; ++r)
+		{
+			const ChICell & c = *replicas[r]->cells[i];
+			unsigned int ind = i * B + r;
+			c1[ind] = c.c1; rC[ind] = c.rC; rL[ind] = c.rL; vER[ind] = c.vER; 
+			a2[ind] = c.a2; Ker2[ind] = INTPOW2(c.Ker); vd[ind] = c.vd; 
+			Kplcd2[ind] = INTPOW2(c.Kplcd); kd[ind] = c.kd; k3[ind] = c.k3;
+		}
+}
+
+//**********************************************************************
+//**********************************************************************
+template <typename Val>
+void ChIModelBatch<Val>::gatherVals()
+{
+	const unsigned int B = replicas.size();
+	for (unsigned int r = 0 ; r < B ; ++r)
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+			for (unsigned int k = 0 ; k < ChICell::NbValsPerCell ; ++k)
+				this->vals[(k * nbCells + i) * B + r] = 
+					replicas[r]->vals[i * ChICell::NbValsPerCell + k];
+	this->UseCurrentValsAsInitVals();
+}
+
+//**********************************************************************
+//**********************************************************************
+template <typename Val>
+void ChIModelBatch<Val>::scatterVals(const Val *v)
+{
+	const unsigned int B = replicas.size();
+	for (unsigned int r = 0 ; r < B ; ++r)
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+			for (unsigned int k = 0 ; k < ChICell::NbValsPerCell ; ++k)
+				replicas[r]->vals[i * ChICell::NbValsPerCell + k] = 
+					v[(k * nbCells + i) * B + r];
+}
+
+template class AstroModel::ChIModelBatch<double>;
+template class AstroModel::ChIModelBatch<float>;
@@ -34,6 +34,8 @@ namespace ODE
 	// Forward declarations
 	class ChICellFunct;
 	class ChINetworkFunct;
+	template <typename Val> class ChIBatchNetworkFunct;
+	struct ChICellKernel;
 }
 
 namespace AstroModel
@@ -57,7 +59,11 @@ namespace AstroModel
 		friend class ODE::KChICellFunct;
 		friend class ODE::KChINetworkFunct;
 		friend class ODE::AstroNeuronNetFunc;
+		template <typename Val> friend class ODE::ChIBatchNetworkFunct;
 		friend class KChICell;
+		template <typename Val> friend class ChIModelBatch;
+		friend class AstroNeuroNetModel;
+		friend struct ODE::ChICellKernel;
 
 		friend class PoissonianStimStrat;
 
@@ -98,6 +104,23 @@ namespace AstroModel
 		//===========================================================||
 		// Computes fluxes across cells
 		virtual void ComputeFluxes(double t);
+		// Jacobian for implicit solvers : cell kinetics by finite
+		// differences, gap junction coupling from coupling derivatives
+		virtual bool CompJacobian(double t, ODE::SparseMatrix<double> & jac);
+		// Operator splitting : IP3 diffusion is integrated separately 
+		// from cell kinetics, stimulations are frozen during a step
+		virtual bool PrepareSplitStep(double t);
+		virtual void CompLocalFunc(double t, unsigned int i, const double *v, double *f) const;
+		virtual void IntegrateCoupling(double t, double h);
+		virtual void FinishSplitStep(double t, double h);
+		// Active set integration : cells that may have changed since t
+		virtual bool GetBlocksChangedSince(double t, std::vector<unsigned int> & blocks) const;
+		// Active set validation : the full integration records reference 
+		// values that the active set integration is then compared to
+		bool IsValidatingActiveSet() const { return useActiveSet and activeSetValidate; }
+		void SetActiveSetValidationPass(bool fullIntegration);
+		// Returns false if the error bound was exceeded
+		bool ReportActiveSetValidation(ResultSaver saver) const;
 
 		//===========================================================||
 		// Setters and callbacks                                     ||
@@ -112,6 +135,10 @@ namespace AstroModel
 			tCurr = t; 
 			if (not isPreRunning)
 			{
+				if (validOn)
+					updateValidation(t);
+				if (activeSetOn)
+					updateActiveSet(t);
 				metrics.ComputeMetrics<ChIModelNeedFrequentUpdateMetric>(*this);
 				metrics.ComputeMetrics<ChIModelDynMetric>(*this);
 				ODENetworkDynamicsModel<CouplingFunction, ChICell>::UpdateVals(t);
@@ -138,6 +165,8 @@ namespace AstroModel
 		virtual double GetTotalFlux(unsigned int i) const;
 		// Return the dynamic value that constitutes the excitable part of the system
 		virtual double GetExcDynVal(unsigned int cellNb) const;
+		// Position of the excitable values in vals
+		virtual bool GetExcDynValLayout(unsigned int & offset, unsigned int & stride) const;
 
 		// Returns a const ref on the network
 		virtual const AbstractNetwork & GetNetwork() const 
@@ -160,12 +189,34 @@ namespace AstroModel
 		// Is the given cell currently stimulated ?
 		virtual bool IsStimulated(unsigned int ind) const
 			{ return Stimulable::IsStimulated(ind); }
+		// Is the given cell or one of its neighbors currently stimulated ?
+		virtual bool IsStimulatedOrAdjacent(unsigned int ind) const
+			{ return StimulableCellNetwork::IsStimulatedOrAdjacent(ind); }
 
 
 	protected:
 
 		virtual double getModelVersionNum() const { return 0.2; }
 
+		// Adds the derivatives of the intercellular fluxes to jac
+		virtual void addCouplingJacobian(ODE::SparseMatrix<double> & jac) const;
+
+		// Gap junction flux going out of cell i
+		double compCouplingFlux(unsigned int i) const;
+		// Takes the current state as the resting state, all cells are active
+		void initActiveSet();
+		// Freezes resting cells and wakes the ones reached by a wave
+		void updateActiveSet(double t);
+		// Is cell i close enough to rest to be frozen ?
+		bool isCellAtRest(unsigned int i) const;
+		// Starts recording or comparing values for the validation
+		void initValidation();
+		// Records or compares values at sampling times
+		void updateValidation(double t);
+		// Solves a x = e_col for a small dense matrix
+		static bool solveDense(std::vector<double> a, unsigned int n, unsigned int col, 
+			std::vector<double> & x);
+
 		//===========================================================||
 		// Network parameters                                        ||
 		//===========================================================||
@@ -181,6 +232,35 @@ namespace AstroModel
 		//===========================================================||
 		// Associated ODE Problem                                    ||
 		//===========================================================||
+		CouplingIntegrator coupling; // Used by splitting solvers
+
+		//===========================================================||
+		// Active set integration                                    ||
+		//===========================================================||
+		bool useActiveSet;         // Only integrate cells away from rest
+		double activeSetTol;       // Relative distance to rest of frozen cells
+		double activeSetWakeFlux;  // Flux deviation waking a frozen cell
+		bool activeSetOn;          // Set up after the pre run
+		std::vector<char> cellActive;
+		std::vector<char> cellStimulated;
+		std::vector<unsigned int> activeCells;
+		std::vector<unsigned int> stimulatedCells;
+		std::vector<double> restVals;
+		std::vector<double> restFlux;
+		// (time, cell) pairs, in chronological order
+		std::vector<std::pair<double, unsigned int> > freezeEvents;
+
+		bool activeSetValidate;    // Compare to the full integration
+		bool validOn;              // Set by SetActiveSetValidationPass
+		bool validRecording;       // Full integration pass
+		double validNextSample;
+		unsigned int validCursor;
+		std::vector<double> validRef;    // Full integration values
+		std::vector<double> validBound;  // Deviation bound of frozen values
+		std::vector<double> validMaxDev; // For each variable, frozen cells
+		std::vector<double> validBoundAtMax;
+		std::vector<double> validMaxRatio;
+		std::vector<double> validMaxActiveDev;
 
 		//===========================================================||
 		// Metrics                                                   ||
@@ -221,9 +301,48 @@ namespace AstroModel
 		// Returns the number of derivations (sinks) for stim cells
 		virtual unsigned int GetNbDerivs() const;
 
+		//===========================================================||
+		// Setters and callbacks                                     ||
+		//===========================================================||
+		// Notifies the model that all values have been updated for timestep t
+		virtual void UpdateVals(double t);
+		// Probes stop as soon as the outcome of their simulation is known
+		virtual bool IsFinished() const { return probeFinished; }
+
 	protected:
+		// Bisection parameters
+		bool bisect;                 // Searches the threshold by bisection
+		unsigned int nbProbeThreads; // Number of probes simulated at once
+		double restTol;              // Relative rate under which a probe is at rest
+
+		// Probe state
+		bool isProbe;
+		bool probeFinished;
+		bool probeStimulated;
+		double prevTime;
+		std::vector<double> prevVals;
+		ThresholdDetermination *probeMetr;
 
 		virtual double getModelVersionNum() const { return 1.2; }
+
+		// Simulation with one model per number of stimulated cells, the
+		// threshold is searched by bisection
+		int simulateBisection(ResultSaver saver);
+		// Returns a new model simulating nbStim stimulated cells
+		ChIModelThresholdDetermination * createProbe(unsigned int nbStim);
+		// True if no cell is stimulated anymore and values barely change
+		bool isBackToRest(double t);
+
+		// Probes simulated by ParallelFor
+		struct ProbeTask
+		{
+			std::vector<ChIModelThresholdDetermination *> probes;
+			void operator()(unsigned int ind, unsigned int )
+			{ 
+				ChIModelThresholdDetermination *p = probes[ind];
+				p->solver->Solve(*p, p->tStart, p->tEnd);
+			}
+		};
 	};
 
 /**********************************************************************/
@@ -248,6 +367,8 @@ namespace AstroModel
 		//===========================================================||
 		// Return class name
 		virtual std::string GetClassName() const { return ClassName; }
+		// Initializes the model
+		virtual void Initialize(ResultSaver saver = ResultSaver::NullSaver);
 		// Launch simulation
 		virtual int Simulate(ResultSaver saver);
 		// Initialize Stimulation strategies 
@@ -269,6 +390,119 @@ namespace AstroModel
 
 		std::string signalStimStratClassName;
 		std::string noiseStimStratClassName;
+
+		// Variants run concurrently, the signal only and noise only ones
+		// on replicas initialized like the model
+		bool concurrent;
+		std::vector<ChIModelStochasticRes *> replicas;
+
+		// Simulation of the three variants on separate threads
+		int simulateConcurrent(ResultSaver saver);
+		// Activates or deactivates the signal and noise strategies
+		void setActivations(bool signal, bool noise);
+		// Resets the model between two variants
+		void resetVariant(ResultSaver saver);
+		// Initializes the strategies of a variant and draws their random
+		// sequences, random strategies reuse the sequence drawn by the 
+		// first variant where they were active
+		void prepareStimStrats(std::vector<RandomStimStrat *> & sequences);
+
+		// Variants simulated by ParallelFor
+		struct VariantTask
+		{
+			std::vector<ChIModelStochasticRes *> models;
+			void operator()(unsigned int ind, unsigned int )
+			{ 
+				ChIModelStochasticRes *m = models[ind];
+				m->solver->Solve(*m, m->tStart, m->tEnd);
+			}
+		};
+	};
+
+/**********************************************************************/
+/* ChI Model Batch                                                    */
+/**********************************************************************/
+	// Integrates several replicas of a ChIModel sharing the same network
+	// structure as a single ODE problem. Values are interleaved 
+	// (vals[(var * nbCells + cell) * nbReplicas + replica]) so that cell
+	// kinetics are computed for all replicas in the same inner loop, and
+	// gap junction fluxes by a kernel specialised on the coupling class.
+	// Stimulations and metrics are still handled by each replica, 
+	// stimulations being applied once per step (at its start) as with 
+	// splitting solvers.
+	// Val is the type of the integrated values, of the fluxes and of the
+	// per cell and per link parameters : with Val = float the whole state
+	// and its derivatives stay in single precision (time is kept in 
+	// double), values are only converted to double once per step, for 
+	// the replicas. Instantiated for double and float.
+	template <typename Val = double>
+	class ChIModelBatch : public ODE::ODEProblem<Val, double>
+	{
+		template <typename V> friend class ODE::ChIBatchNetworkFunct;
+
+	public:
+		//===========================================================||
+		// Constructors / Destructor                                 ||
+		//===========================================================||
+		ChIModelBatch(const std::vector<ChIModel *> & _replicas, 
+			ParamHandler & h = ParamHandler::GlobalParams);
+		virtual ~ChIModelBatch();
+
+		//===========================================================||
+		// Standard model methods                                    ||
+		//===========================================================||
+		// Can replicas of the given model be batched ?
+		static bool CanBatch(const ChIModel *model);
+		// Launch simulation of all replicas (they must be initialized)
+		int Simulate(const std::vector<ResultSaver> & savers);
+		// Notifies all replicas that values have been updated
+		virtual void UpdateVals(double t);
+		// Computes the fluxes of all replicas at values v, replicas are
+		// stimulated at the first call of each step
+		void ComputeFluxes(double t, const Val *v);
+
+		//===========================================================||
+		// Getters                                                   ||
+		//===========================================================||
+		inline unsigned int GetNbReplicas() const { return replicas.size(); }
+		inline unsigned int GetNbCells() const { return nbCells; }
+
+	protected:
+		// Do all replicas have the same neighbors ?
+		bool sharesNetwork() const;
+		// Builds the links and per replica parameters tables
+		void setUpLanes();
+		// Copies values from the replicas / to the replicas
+		void gatherVals();
+		void scatterVals(const Val *v);
+		// Stimulations of all replicas for the step starting at t
+		void stimulate(double t);
+		// Gap junction fluxes with links of class Link
+		template <typename Link>
+		void addCouplingFluxes(const Val *IP3);
+
+		std::vector<ChIModel *> replicas;
+		unsigned int nbCells;
+		bool stimDue; // Replicas are stimulated by the next ComputeFluxes
+
+		//===========================================================||
+		// Shared network                                            ||
+		//===========================================================||
+		std::vector<unsigned int> linkStart;  // First link of each cell
+		std::vector<unsigned int> linkTarget; // Neighbor of each link
+		std::vector<const CouplingFunction *> links; // [link][replica]
+		// Links of a single class have their parameters stored [link][replica]
+		std::string linkClass;
+		std::vector<Val> linkF, linkThresh, linkScale;
+		std::vector<Val> linkOpen; // 0 if blocked, 1 otherwise
+
+		//===========================================================||
+		// Per replica values ([cell][replica] or [replica])         ||
+		//===========================================================||
+		std::vector<Val> c1, rC, rL, vER, a2, Ker2, vd, Kplcd2, kd, k3;
+		std::vector<Val> C0, d1, d2, d3, d5, v3k, K3k4, r5p;
+		std::vector<Val> Jspont, gluIP3Prod;
+		std::vector<Val> totFlux, stimFlux;
 	};
 }
 
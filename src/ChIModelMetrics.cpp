@@ -39,6 +39,87 @@ string FourierTransform::ClassName(FOURIER_TRANSFORM_METRIC);
 string WaveletTransform::ClassName(WAVELET_TRANSFORM_METRIC);
 string StochResMetric::ClassName(STOCH_RES_METRIC);
 
+//********************************************************************//
+//********* T H R E S H O L D   C R O S S I N G   D E T E C T O R ****//
+//********************************************************************//
+
+//**********************************************************************
+// Compares all values with the threshold, the list of cells above the
+// threshold is only rebuilt if a cell crossed it (in any direction).
+//**********************************************************************
+void ThresholdCrossingDetector::Detect(const AbstractODENetDynProblem & model, double thresh)
+{
+	unsigned int nbCells = model.GetNbCells();
+	if (currVals.size() != nbCells)
+	{
+		currVals.assign(nbCells, 0);
+		prevVals.assign(nbCells, 0);
+		above.assign(nbCells, 0);
+		newAbove.assign(nbCells, 0);
+		aboveCells.clear();
+		hasPrev = false;
+	}
+	double t = model.GetTime();
+
+	unsigned int offset, stride;
+	if (model.GetExcDynValLayout(offset, stride))
+	{
+		const double *v = model.vals + offset;
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+			currVals[i] = v[i * stride];
+	}
+	else
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+			currVals[i] = model.GetExcDynVal(i);
+
+	unsigned char changed = 0;
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+	{
+		newAbove[i] = (currVals[i] > thresh);
+		changed |= newAbove[i] ^ above[i];
+	}
+
+	newCrossings.clear();
+	if (changed)
+	{
+		aboveCells.clear();
+		for (unsigned int i = 0 ; i < nbCells ; ++i)
+		{
+			if (not newAbove[i])
+				continue;
+			aboveCells.push_back(i);
+			if (not above[i])
+			{
+				// Linear interpolation of the crossing time
+				double tc = t;
+				if (hasPrev and (currVals[i] != prevVals[i]))
+					tc = lastTime + (t - lastTime) * (thresh - prevVals[i]) / 
+						(currVals[i] - prevVals[i]);
+				newCrossings.push_back(ThresholdCrossing(i, tc));
+			}
+		}
+	}
+
+	above.swap(newAbove);
+	prevVals.swap(currVals);
+	lastTime = t;
+	hasPrev = true;
+}
+
+//**********************************************************************
+//**********************************************************************
+void ThresholdCrossingDetector::Clear()
+{
+	currVals.clear();
+	prevVals.clear();
+	above.clear();
+	newAbove.clear();
+	aboveCells.clear();
+	newCrossings.clear();
+	lastTime = 0;
+	hasPrev = false;
+}
+
 //********************************************************************//
 //****************** A C T I V A T E D   C E L L S *******************//
 //********************************************************************//
@@ -52,27 +133,31 @@ ADD_METRIC_DEPENDENCY(ACTIVATED_CELLS_METRICS, DEGREE_DISTRIBUTION_NETWORK_METRI
 // Default Constructor
 //**********************************************************************
 ActivatedCells::ActivatedCells(ParamHandler & h) : lastTime(0), 
-	tStart(-DEFAULT_MAX_VAL), tEnd(-DEFAULT_MAX_VAL)
+	tStart(-DEFAULT_MAX_VAL), tEnd(-DEFAULT_MAX_VAL), ringPos(0),
+	trackInfluxes(true), influxTrackingSet(false)
 {
 	activThresh = h.getParam<double>("-activParams", 0);
 	freqEstTimeWin = h.getParam<double>("-activParams", 1);
 	fluxComputingDelay = h.getParam<double>("-activParams", 2);
+	SetUpdatePeriod(h.getParam<double>("-activSamplingPeriod", 0));
 }
 
 //**********************************************************************
 // Full constructor
 //**********************************************************************
-ActivatedCells::ActivatedCells(double _at, double _fetw, double _fcd) : 
+ActivatedCells::ActivatedCells(double _at, double _fetw, double _fcd, double _sp) : 
 	activThresh(_at), freqEstTimeWin(_fetw), fluxComputingDelay(_fcd), 
-	totNbCells(0), lastTime(0), tStart(-DEFAULT_MAX_VAL), tEnd(-DEFAULT_MAX_VAL)
+	totNbCells(0), lastTime(0), tStart(-DEFAULT_MAX_VAL), tEnd(-DEFAULT_MAX_VAL),
+	ringPos(0), trackInfluxes(true), influxTrackingSet(false)
 {
-
+	SetUpdatePeriod(_sp);
 }
 
 //**********************************************************************
 // Constructor from stream
 //**********************************************************************
-ActivatedCells::ActivatedCells(std::ifstream & stream)
+ActivatedCells::ActivatedCells(std::ifstream & stream) : ringPos(0),
+	trackInfluxes(true), influxTrackingSet(false)
 {
 	LoadFromStream(stream);
 }
@@ -83,26 +168,35 @@ ActivatedCells::ActivatedCells(std::ifstream & stream)
 //bool ActivatedCells::ComputeMetric(const ChIModel & model)
 bool ActivatedCells::ComputeMetric(const AbstractODENetDynProblem & model)
 {
+	// Influxes are only needed by wave front detection
+	if (not influxTrackingSet)
+	{
+		trackInfluxes = GetSpecificMetric<Metric, WaveFrontDetect>(model.GetAllMetrics());
+		influxTrackingSet = true;
+	}
+
 	if (lastActivatedTime.size() != model.GetNbCells())
 		lastActivatedTime = std::vector<double>(model.GetNbCells(), -1.0); 
 	if (tmpOutFluxes.size() != model.GetNbCells())
 		tmpOutFluxes = std::vector<double>(model.GetNbCells(), 0.0); 
-	if (tmpInFluxes.size() != model.GetNbCells())
-		tmpInFluxes = std::vector<std::vector<double> >(model.GetNbCells(), 
-			std::vector<double>((int)(fluxComputingDelay / model.GetIntegrStep()), 0.0));
-
-	if (totalInFluxes.size() != model.GetNbCells())
-		totalInFluxes = std::vector<std::vector<double> >(
-			model.GetNbCells(), std::vector<double>());
-	if (maxInFluxInTimeWin.size() != model.GetNbCells())
-		maxInFluxInTimeWin = std::vector<std::pair<double, double> >(
-			model.GetNbCells(), std::make_pair(0.0, 0.0));
-	if (neighborSpikeTimes.size() != model.GetNbCells())
-		neighborSpikeTimes = std::vector<std::queue<double> >(
-			model.GetNbCells(), std::queue<double>());
-	if (influxAfterSpike.size() != model.GetNbCells())
-		influxAfterSpike = std::vector<std::vector<double> >(
-			model.GetNbCells(), std::vector<double>());
+	if (trackInfluxes)
+	{
+		if (tmpInFluxes.size() != model.GetNbCells())
+			tmpInFluxes = std::vector<std::vector<double> >(model.GetNbCells(), 
+				std::vector<double>((int)(fluxComputingDelay / GetSamplingStep(model.GetIntegrStep())), 0.0));
+		if (totalInFluxes.size() != model.GetNbCells())
+			totalInFluxes = std::vector<std::vector<double> >(
+				model.GetNbCells(), std::vector<double>());
+		if (maxInFluxInTimeWin.size() != model.GetNbCells())
+			maxInFluxInTimeWin = std::vector<std::pair<double, double> >(
+				model.GetNbCells(), std::make_pair(0.0, 0.0));
+		if (neighborSpikeTimes.size() != model.GetNbCells())
+			neighborSpikeTimes = std::vector<std::queue<double> >(
+				model.GetNbCells(), std::queue<double>());
+		if (influxAfterSpike.size() != model.GetNbCells())
+			influxAfterSpike = std::vector<std::vector<double> >(
+				model.GetNbCells(), std::vector<double>());
+	}
 
 	if (tStart == -DEFAULT_MAX_VAL)
 		tStart = model.GetTStart();
@@ -111,75 +205,90 @@ bool ActivatedCells::ComputeMetric(const AbstractODENetDynProblem & model)
 
 	double t = model.GetTime();
 	double tmpFlux;
-	int nOut = 1;
+	totNbCells = model.GetNbCells();
 
-	if (((int)(t / model.GetIntegrStep())) % nOut == 0)
+	if (trackInfluxes)
 	{
-		totNbCells = model.GetNbCells();
+		// One slot of the influx buffers per sampled step
+		if (t > lastTime)
+			++ringPos;
+		unsigned int slot = ringPos % tmpInFluxes[0].size();
+
 		for (unsigned int i = 0 ; i < model.GetNbCells() ; ++i)
 		{
 			tmpFlux = std::max(0.0, - model.GetTotalFlux(i)) * (t - lastTime);
 			// Compute maxInFluxInTimeWin
-			maxInFluxInTimeWin[i].first += tmpFlux - 
-				tmpInFluxes[i][((int)(t / model.GetIntegrStep())) % tmpInFluxes[i].size()];
+			maxInFluxInTimeWin[i].first += tmpFlux - tmpInFluxes[i][slot];
 			if (maxInFluxInTimeWin[i].first > maxInFluxInTimeWin[i].second)
 				maxInFluxInTimeWin[i].second = maxInFluxInTimeWin[i].first;
 
 			// In any case compute influxes
-			tmpInFluxes[i][((int)(t / model.GetIntegrStep())) % tmpInFluxes[i].size()] = tmpFlux;
+			tmpInFluxes[i][slot] = tmpFlux;
 
 			// If a neighbor has just spiked exactly fluxComputingDelay seconds ago
 			while (not neighborSpikeTimes[i].empty() and neighborSpikeTimes[i].front() + fluxComputingDelay <= t) {
 				influxAfterSpike[i].push_back(ComputeSum(tmpInFluxes[i]));
 				neighborSpikeTimes[i].pop();
 			}
+		}
+	}
 
-			if (model.GetExcDynVal(i) > activThresh)
+	// Only the cells above the threshold are visited
+	detector.Detect(model, activThresh);
+	crossings.insert(crossings.end(), detector.GetNewCrossings().begin(),
+		detector.GetNewCrossings().end());
+	const std::vector<unsigned int> & aboveCells = detector.GetAboveCells();
+	for (unsigned int k = 0 ; k < aboveCells.size() ; ++k)
+	{
+		unsigned int i = aboveCells[k];
+		// Check if it has already been marked as activated
+		if (lastActivatedTime[i] < 0)
+		{
+			lastActivatedTime[i] = t;
+			markedCells.insert(i);
+			tmpOutFluxes[i] = 0;
+			if (trackInfluxes)
 			{
-				// Check if it has already been marked as activated
-				if (lastActivatedTime[i] < 0)
-				{
-					lastActivatedTime[i] = t;
-					tmpOutFluxes[i] = 0;
-					// Compute cumulated influxes
-					totalInFluxes[i].push_back(ComputeSum(tmpInFluxes[i]));
-					// Add Spike time to neighbors
-					const std::vector<unsigned int> & neighbs = model.GetNeighbors(i);
-					for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
-						neighborSpikeTimes[neighbs[j]].push(t);
-				}
-				// if last added time is different
-				if (activations.empty() or (activations.back().time != model.GetTime()))
-					activations.push_back(TimedActivations(model.GetTime()));
-				activations.back().cells.push_back(i);
-				cumulActivCells.insert(i);
+				// Compute cumulated influxes
+				totalInFluxes[i].push_back(ComputeSum(tmpInFluxes[i]));
+				// Add Spike time to neighbors
+				const std::vector<unsigned int> & neighbs = model.GetNeighbors(i);
+				for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+					neighborSpikeTimes[neighbs[j]].push(t);
 			}
+		}
+		// if last added time is different
+		if (activations.empty() or (activations.back().time != t))
+		{
+			activations.push_back(TimedActivations(t));
+			RaiseEvents(CellActivationEvent);
+		}
+		activations.back().cells.push_back(i);
+		cumulActivCells.insert(i);
+	}
 
-
-			// If cell is marked as recently activated, compute its fluxes
-			if (lastActivatedTime[i] >= 0)
+	// Compute the fluxes of the recently activated cells
+	for (std::set<unsigned int>::iterator it = markedCells.begin() ; it != markedCells.end() ; )
+	{
+		unsigned int i = *it;
+		// If delay of fluxes computing is over, un mark the cell and store the flux and degree
+		if ((t - lastActivatedTime[i]) > fluxComputingDelay)
+		{
+			// Check that the cell is not stimulated and not a neighbor of a stimulated cell
+			if (not model.IsStimulatedOrAdjacent(i))
 			{
-				// If delay of fluxes computing is over, un mark the cell and store the flux and degree
-				if ((t - lastActivatedTime[i]) > fluxComputingDelay)
-				{
-					// Check that the cell is not stimulated and not a neighbor of a stimulated cell
-					bool discard = model.IsStimulated(i);
-					const std::vector<unsigned int> & neighbs = model.GetNeighbors(i);
-					for (unsigned int j = 0 ; (not discard) and (j < neighbs.size()) ; ++j)
-						discard |= model.IsStimulated(neighbs[j]);
-					if (not discard)
-					{
-						DegreeDistrComp  & degreeMetr = 
-							*GetSpecificMetric<Metric, DegreeDistrComp>(model.GetAllMetrics());
-						totalFluxes.push_back(std::make_pair(degreeMetr[i], tmpOutFluxes[i]));
-					}
-					lastActivatedTime[i] = -1.0;
-					tmpOutFluxes[i] = 0;
-				}
-				else
-					tmpOutFluxes[i] += std::max(0.0, model.GetTotalFlux(i)) * (t - lastTime);
-
+				DegreeDistrComp  & degreeMetr = 
+					*GetSpecificMetric<Metric, DegreeDistrComp>(model.GetAllMetrics());
+				totalFluxes.push_back(std::make_pair(degreeMetr[i], tmpOutFluxes[i]));
 			}
+			lastActivatedTime[i] = -1.0;
+			tmpOutFluxes[i] = 0;
+			markedCells.erase(it++);
+		}
+		else
+		{
+			tmpOutFluxes[i] += std::max(0.0, model.GetTotalFlux(i)) * (t - lastTime);
+			++it;
 		}
 	}
 
@@ -197,7 +306,7 @@ bool ActivatedCells::SaveMetric(ResultSaver saver) const
 	std::string activCellsName("ActivatedCells");
 	if (saver.isSaving(activCellsName) and not activations.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(activCellsName, saver.getCurrFile());
 
 		stream << "Time\tNbCurrActiv\tNbCumulActiv" << endl;
@@ -225,10 +334,24 @@ bool ActivatedCells::SaveMetric(ResultSaver saver) const
 		allSaved &= stream.good();
 	}
 
+	std::string crossingsName("ActivationCrossings");
+	if (saver.isSaving(crossingsName) and not crossings.empty())
+	{
+		ostream & stream = saver.getStream();
+		this->AddSavedFile(crossingsName, saver.getCurrFile());
+
+		stream << "Time\tCellId" << endl;
+
+		for (unsigned int i = 0 ; i < crossings.size() ; ++i)
+			stream << crossings[i].time << "\t" << crossings[i].cell << endl;
+
+		allSaved &= stream.good();
+	}
+
 	std::string outFluxesName("OutFluxesFull");
 	if (saver.isSaving(outFluxesName) and not totalFluxes.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(outFluxesName, saver.getCurrFile());
 
 		stream << "k\tOutFlux" << endl;
@@ -264,6 +387,11 @@ void ActivatedCells::Initialize()
 	lastTime = 0;
 	tStart = -DEFAULT_MAX_VAL;
 	tEnd = -DEFAULT_MAX_VAL;
+	ringPos = 0;
+	detector.Clear();
+	crossings.clear();
+	markedCells.clear();
+	influxTrackingSet = false;
 }
 
 //**********************************************************************
@@ -271,7 +399,8 @@ void ActivatedCells::Initialize()
 //**********************************************************************
 Metric * ActivatedCells::BuildCopy() const
 {
-	return new ActivatedCells(activThresh, freqEstTimeWin, fluxComputingDelay); 
+	return new ActivatedCells(activThresh, freqEstTimeWin, fluxComputingDelay, 
+		updatePeriod); 
 }
 
 //**********************************************************************
@@ -322,6 +451,46 @@ bool ActivatedCells::SaveToStream(std::ofstream & stream) const
 	return stream.good();
 }
 
+//**********************************************************************
+// Returns the time between two computations of the metric
+//**********************************************************************
+double ActivatedCells::GetSamplingStep(double integrStep) const
+{
+	if (updatePeriod <= 0)
+		return integrStep;
+	return std::max(1.0, floor(updatePeriod / integrStep + 0.5)) * integrStep;
+}
+
+//**********************************************************************
+// Only the recorded data is merged, the state of cells being activated
+// is the one of this metric
+//**********************************************************************
+void ActivatedCells::PrependActivationsOf(const ActivatedCells & previous)
+{
+	std::vector<TimedActivations> tmpActiv(previous.activations);
+	for (unsigned int i = 0 ; i < activations.size() ; ++i)
+	{
+		if (not tmpActiv.empty() and (tmpActiv.back().time == activations[i].time))
+			tmpActiv.back().cells.insert(tmpActiv.back().cells.end(),
+				activations[i].cells.begin(), activations[i].cells.end());
+		else
+			tmpActiv.push_back(activations[i]);
+	}
+	activations.swap(tmpActiv);
+
+	crossings.insert(crossings.begin(), previous.crossings.begin(), 
+		previous.crossings.end());
+	totalFluxes.insert(totalFluxes.begin(), previous.totalFluxes.begin(), 
+		previous.totalFluxes.end());
+	cumulActivCells.insert(previous.cumulActivCells.begin(), 
+		previous.cumulActivCells.end());
+	if (totalInFluxes.size() == previous.totalInFluxes.size())
+		for (unsigned int i = 0 ; i < totalInFluxes.size() ; ++i)
+			totalInFluxes[i].insert(totalInFluxes[i].begin(), 
+				previous.totalInFluxes[i].begin(), previous.totalInFluxes[i].end());
+	freqEstim.clear();
+}
+
 //**********************************************************************
 // Compute and return the time dependent frequency estimations
 //**********************************************************************
@@ -423,6 +592,10 @@ PropagationDistance::PropagationDistance(ParamHandler & h) :
 	startRatio = h.getParam<std::vector<double> >("-propSaveRatio", 0);
 	endRatio   = h.getParam<std::vector<double> >("-propSaveRatio", 1);
 	stepRatio  = h.getParam<std::vector<double> >("-propSaveRatio", 2);
+
+	// Only new activations need to be processed
+	SetUpdatePeriod(0);
+	SetEventTriggers(CellActivationEvent);
 }
 
 //**********************************************************************
@@ -433,6 +606,8 @@ PropagationDistance::PropagationDistance(double _miD, double _maD,
 	indActiv(0), maxDelay(_maD), minDelay(_miD), instDistTimeWindow(_idtw),
 	cellDistIncr(_cdi), allMergeInOne(_amio), lastTime(0)
 {
+	SetUpdatePeriod(0);
+	SetEventTriggers(CellActivationEvent);
 }
 
 //**********************************************************************
@@ -440,6 +615,8 @@ PropagationDistance::PropagationDistance(double _miD, double _maD,
 //**********************************************************************
 PropagationDistance::PropagationDistance(std::ifstream & stream)
 {
+	SetUpdatePeriod(0);
+	SetEventTriggers(CellActivationEvent);
 	LoadFromStream(stream);
 }
 
@@ -460,13 +637,18 @@ bool PropagationDistance::ComputeMetric(const ChIModel & model)
 	assert(activCells);
 
 	if (isInWaveSince.size() != model.GetNbCells())
+	{
 		isInWaveSince = vector<pair<bool, double> >(model.GetNbCells(),
 			make_pair<bool, double>(false, 0));
+		cellEntries = vector<vector<WaveEntry> >(model.GetNbCells());
+		initiatedWaves = vector<vector<unsigned int> >(model.GetNbCells());
+	}
 
 	const std::vector<TimedActivations> & activ = activCells->GetActivations();
 	unsigned int currCell;
 	double t = model.GetTime();
 	lastTime = t;
+	std::vector<unsigned int> parentEntries;
 	// For each non analysed activation steps
 	for (; indActiv < activ.size() ; ++indActiv)
 	{
@@ -478,105 +660,75 @@ bool PropagationDistance::ComputeMetric(const ChIModel & model)
 			if ((not isInWaveSince[currCell].first) or (isInWaveSince[currCell].second + minDelay < t))
 			{
 				isInWaveSince[currCell].first  = false;
-				// For each wave
-				for (unsigned int w = 0 ; (w < waves.size()) and not isInWaveSince[currCell].first ; ++w)
+				parentEntries.clear();
+				if (allMergeInOne)
 				{
-					// If the currCell was the initiator of the wave and the wave isn't finished
-					if ((currCell == waves[w].initiator) and (waves[w].structure.back().lastActiv + maxDelay >=t))
+					// All the cells of the first wave are parents
+					if (not waves.empty())
 					{
-						waves[w].structure.push_back(CellToCellPropagation(currCell, t));
-						isInWaveSince[currCell].first  = true;
+						if ((currCell == waves[0].initiator) and (waves[0].structure.back().lastActiv + maxDelay >=t))
+							joinWave(model, currCell, 0, parentEntries, t);
+						else
+						{
+							for (unsigned int f = 0 ; f < waves[0].structure.size() ; ++f)
+								parentEntries.push_back(f);
+							joinWave(model, currCell, 0, parentEntries, t);
+						}
 					}
-					else
+				}
+				else
+				{
+					// Find the first wave that can be joined : either a wave 
+					// initiated by the cell, or a wave containing a recently 
+					// activated neighbor
+					unsigned int bestW = waves.size();
+					bool asInitiator = false;
+					for (unsigned int k = 0 ; k < initiatedWaves[currCell].size() ; ++k)
 					{
-						// For each cells in the wave w
-						unsigned int wCell = waves[w].structure[0].ind;
-						for (unsigned int f = 0 ; f < waves[w].structure.size() ; ++f)
+						unsigned int w = initiatedWaves[currCell][k];
+						if ((w < bestW) and (waves[w].structure.back().lastActiv + maxDelay >= t))
 						{
-							wCell = waves[w].structure[f].ind;
-							// If the current cell is linked to a cell in the wave w that was activated not too long ago
-							if (allMergeInOne or ((waves[w].structure[f].lastActiv + maxDelay >= t) and 
-								model.GetNetwork().AreConnected(currCell, wCell)))
-							{
-								// If the current cell has already been added
-								if (waves[w].structure.back().ind == currCell)
-								{
-									// Add a parent to the current cell in the wave
-									// if it is not already a parent
-									if (find(waves[w].structure.back().parents.begin(),
-											waves[w].structure.back().parents.end(), wCell) == 
-											waves[w].structure.back().parents.end())
-										waves[w].structure.back().parents.push_back(wCell);
-									// Add currCell as a children to the parent
-									waves[w].structure[f].children.push_back(currCell);
-									// Update cell metric measure (cellDist)
-									waves[w].structure.back().distToInitiator = 
-										min(waves[w].structure.back().distToInitiator,
-										waves[w].structure[f].distToInitiator + cellDistIncr);
-									waves[w].propagation.back().cellDist = 
-										max(waves[w].propagation.back().cellDist,
-										waves[w].structure.back().distToInitiator);
-								}
-								else
-								{
-									// Add the current cell to the wave w
-									double cellDistParent = waves[w].structure[f].distToInitiator;
-									CellToCellPropagation tempCell(currCell, wCell, cellDistParent + cellDistIncr, t);
-									waves[w].AddCell(tempCell);
-
-									double spatialDist = max(waves[w].propagation.back().spatialDist, 
-										model.GetDistance(waves[w].initiator, currCell));
-
-									double instSpatialDist = model.GetDistance(waves[w].initiator, currCell);
-									for (unsigned int k = 0 ; k < waves[w].propagation.size() ; ++k)
-									{
-										if (t - waves[w].propagation[k].time < instDistTimeWindow)
-											instSpatialDist = max(waves[w].propagation[k].instSpatialDist, instSpatialDist);
-									}
-
-									double cellDist = max(waves[w].propagation.back().cellDist, 
-										waves[w].structure.back().distToInitiator);
-
-									// Add propagation mark
-									waves[w].propagation.push_back(TimedPropagation(t, spatialDist, instSpatialDist, cellDist, waves[w].GetCellNb()));
-								}
-								// Add the cell as a child of it's latest added parent
-								waves[w].structure[f].children.push_back(currCell);
-								isInWaveSince[currCell].first  = true;
-							}
+							bestW = w;
+							asInitiator = true;
 						}
 					}
-					// if the cell was added to the current wave and all its parents have been added
-					if (isInWaveSince[currCell].first)
+					const std::vector<unsigned int> & neighbs = model.GetNeighbors(currCell);
+					unsigned int firstCandW = waves.size();
+					for (unsigned int n = 0 ; n < neighbs.size() ; ++n)
 					{
-						double averageDelay = 0;
-						double averageSpatialDist = 0;
-						unsigned int nbParentsConsidered = 0;
-						// For each parent cell
-						for (unsigned int p = 0 ; p < waves[w].structure.back().parents.size() ; ++p)
+						const std::vector<WaveEntry> & entries = cellEntries[neighbs[n]];
+						// Entries are chronological, only the recent ones are considered
+						for (int e = entries.size() - 1 ; (e >= 0) and (waves[entries[e].first].
+							structure[entries[e].second].lastActiv + maxDelay >= t) ; --e)
 						{
-							double parentActTime = -1;
-							// Find corresponding entry in waves[w].structure, starting from the end
-							for (int pp = waves[w].structure.size() - 1 ; (pp >= 0) and (parentActTime == -1) ; --pp)
+							if (entries[e].first < bestW)
 							{
-								// Consider only parents which are closer to the initiator
-								if ((waves[w].structure[pp].ind == waves[w].structure.back().parents[p]) 
-									and (waves[w].structure[pp].distToInitiator < waves[w].structure.back().distToInitiator))
-								{
-									parentActTime = waves[w].structure[pp].lastActiv;
-									averageDelay += t - parentActTime;
-									averageSpatialDist += model.GetDistance(waves[w].structure[pp].ind, currCell);
-									++nbParentsConsidered;
-								}
+								bestW = entries[e].first;
+								asInitiator = false;
 							}
+							// Waves meeting on the same cell collide
+							if (firstCandW == waves.size())
+								firstCandW = entries[e].first;
+							else if (entries[e].first != firstCandW)
+								mergeWaveGroups(firstCandW, entries[e].first);
 						}
-						if ((nbParentsConsidered > 0) and (averageDelay > 0))
+					}
+					if (bestW < waves.size())
+					{
+						if (not asInitiator)
 						{
-							averageDelay /= (double) nbParentsConsidered;
-							averageSpatialDist /= (double) nbParentsConsidered;
-							waves[w].structure.back().localTopoSpeed = 1.0 / averageDelay;
-							waves[w].structure.back().localSpatialSpeed = averageSpatialDist / averageDelay;
+							for (unsigned int n = 0 ; n < neighbs.size() ; ++n)
+							{
+								const std::vector<WaveEntry> & entries = cellEntries[neighbs[n]];
+								for (int e = entries.size() - 1 ; (e >= 0) and (waves[entries[e].first].
+									structure[entries[e].second].lastActiv + maxDelay >= t) ; --e)
+									if (entries[e].first == bestW)
+										parentEntries.push_back(entries[e].second);
+							}
+							// Parents are handled in the order of the wave structure
+							std::sort(parentEntries.begin(), parentEntries.end());
 						}
+						joinWave(model, currCell, bestW, parentEntries, t);
 					}
 				}
 				// If the cell couldn't be linked to any wave
@@ -584,6 +736,9 @@ bool PropagationDistance::ComputeMetric(const ChIModel & model)
 				{
 					// Create a new wave with the cell as an initiator
 					waves.push_back(TimedWave(currCell, t));
+					waveGroups.push_back(waves.size() - 1);
+					cellEntries[currCell].push_back(WaveEntry(waves.size() - 1, 0));
+					initiatedWaves[currCell].push_back(waves.size() - 1);
 
 					isInWaveSince[currCell].first  = true;
 				}
@@ -595,6 +750,147 @@ bool PropagationDistance::ComputeMetric(const ChIModel & model)
 	return true;
 }
 
+//**********************************************************************
+// Adds currCell to wave w. parentEntries are the indices of the
+// structure entries the cell is linked to (empty if the cell is the
+// initiator of the wave).
+//**********************************************************************
+void PropagationDistance::joinWave(const ChIModel & model, unsigned int currCell, 
+	unsigned int w, const std::vector<unsigned int> & parentEntries, double t)
+{
+	if (parentEntries.empty())
+	{
+		waves[w].structure.push_back(CellToCellPropagation(currCell, t));
+		cellEntries[currCell].push_back(WaveEntry(w, waves[w].structure.size() - 1));
+		isInWaveSince[currCell].first  = true;
+	}
+	unsigned int nbEntries = parentEntries.size();
+	unsigned int selfEntry = waves[w].structure.size();
+	for (unsigned int k = 0 ; k <= nbEntries ; ++k)
+	{
+		unsigned int f;
+		if (k < nbEntries)
+			f = parentEntries[k];
+		// The entry of the cell itself is a parent if it is connected to itself
+		else if ((selfEntry < waves[w].structure.size()) and (allMergeInOne or 
+				model.GetNetwork().AreConnected(currCell, currCell)))
+			f = selfEntry;
+		else
+			break;
+
+		unsigned int wCell = waves[w].structure[f].ind;
+		// If the current cell has already been added
+		if (waves[w].structure.back().ind == currCell)
+		{
+			// Add a parent to the current cell in the wave
+			// if it is not already a parent
+			if (find(waves[w].structure.back().parents.begin(),
+					waves[w].structure.back().parents.end(), wCell) == 
+					waves[w].structure.back().parents.end())
+				waves[w].structure.back().parents.push_back(wCell);
+			// Add currCell as a children to the parent
+			waves[w].structure[f].children.push_back(currCell);
+			// Update cell metric measure (cellDist)
+			waves[w].structure.back().distToInitiator = 
+				min(waves[w].structure.back().distToInitiator,
+				waves[w].structure[f].distToInitiator + cellDistIncr);
+			waves[w].propagation.back().cellDist = 
+				max(waves[w].propagation.back().cellDist,
+				waves[w].structure.back().distToInitiator);
+		}
+		else
+		{
+			// Add the current cell to the wave w
+			double cellDistParent = waves[w].structure[f].distToInitiator;
+			CellToCellPropagation tempCell(currCell, wCell, cellDistParent + cellDistIncr, t);
+			waves[w].AddCell(tempCell);
+			cellEntries[currCell].push_back(WaveEntry(w, waves[w].structure.size() - 1));
+			selfEntry = waves[w].structure.size() - 1;
+
+			double spatialDist = max(waves[w].propagation.back().spatialDist, 
+				model.GetDistance(waves[w].initiator, currCell));
+
+			double instSpatialDist = model.GetDistance(waves[w].initiator, currCell);
+			for (unsigned int p = 0 ; p < waves[w].propagation.size() ; ++p)
+			{
+				if (t - waves[w].propagation[p].time < instDistTimeWindow)
+					instSpatialDist = max(waves[w].propagation[p].instSpatialDist, instSpatialDist);
+			}
+
+			double cellDist = max(waves[w].propagation.back().cellDist, 
+				waves[w].structure.back().distToInitiator);
+
+			// Add propagation mark
+			waves[w].propagation.push_back(TimedPropagation(t, spatialDist, instSpatialDist, cellDist, waves[w].GetCellNb()));
+		}
+		// Add the cell as a child of it's latest added parent
+		waves[w].structure[f].children.push_back(currCell);
+		isInWaveSince[currCell].first  = true;
+	}
+
+	// Local speeds, computed from the parents closer to the initiator
+	double averageDelay = 0;
+	double averageSpatialDist = 0;
+	unsigned int nbParentsConsidered = 0;
+	const CellToCellPropagation & last = waves[w].structure.back();
+	for (unsigned int p = 0 ; p < last.parents.size() ; ++p)
+	{
+		// Find the latest corresponding entry in the wave
+		const std::vector<WaveEntry> & entries = cellEntries[last.parents[p]];
+		for (int e = entries.size() - 1 ; e >= 0 ; --e)
+		{
+			if ((entries[e].first == w) and (waves[w].structure[entries[e].second].
+				distToInitiator < last.distToInitiator))
+			{
+				averageDelay += t - waves[w].structure[entries[e].second].lastActiv;
+				averageSpatialDist += model.GetDistance(last.parents[p], currCell);
+				++nbParentsConsidered;
+				break;
+			}
+		}
+	}
+	if ((nbParentsConsidered > 0) and (averageDelay > 0))
+	{
+		averageDelay /= (double) nbParentsConsidered;
+		averageSpatialDist /= (double) nbParentsConsidered;
+		waves[w].structure.back().localTopoSpeed = 1.0 / averageDelay;
+		waves[w].structure.back().localSpatialSpeed = averageSpatialDist / averageDelay;
+	}
+}
+
+//**********************************************************************
+// Union-find : merges the groups of two colliding waves
+//**********************************************************************
+void PropagationDistance::mergeWaveGroups(unsigned int w1, unsigned int w2)
+{
+	unsigned int r1 = GetWaveGroup(w1);
+	unsigned int r2 = GetWaveGroup(w2);
+	// The oldest wave represents the group
+	if (r1 < r2)
+		waveGroups[r2] = r1;
+	else if (r2 < r1)
+		waveGroups[r1] = r2;
+}
+
+//**********************************************************************
+// Returns the representative of the group of colliding waves
+//**********************************************************************
+unsigned int PropagationDistance::GetWaveGroup(unsigned int w) const
+{
+	assert(w < waveGroups.size());
+	unsigned int root = w;
+	while (waveGroups[root] != root)
+		root = waveGroups[root];
+	// Path compression
+	while (waveGroups[w] != root)
+	{
+		unsigned int next = waveGroups[w];
+		waveGroups[w] = root;
+		w = next;
+	}
+	return root;
+}
+
 //**********************************************************************
 // Save propagation distances
 //**********************************************************************
@@ -608,7 +904,7 @@ bool PropagationDistance::SaveMetric(ResultSaver saver) const
 	std::string spikingCoherenceName("SpikingCoherence");
 	if (saver.isSaving(fullWavesName) and not waves.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(fullWavesName, saver.getCurrFile());
 
 		stream << "WaveId\tCellId\tTime\tParents\tChildren" << endl;
@@ -626,7 +922,7 @@ bool PropagationDistance::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(waveMetricsName) and not waves.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(waveMetricsName, saver.getCurrFile());
 
 		stream << "WaveId\tTime\tSpatialDist\tInstSpatialDist\tCellDist\tCellNb\tWaveSpeed" << endl;
@@ -647,7 +943,7 @@ bool PropagationDistance::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(waveSummaryName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(waveSummaryName, saver.getCurrFile());
 
 		stream << "WaveId\tSize\tTotalSize\tMeanTopoSpeed\tMeanSpatialSpeed\tTopoExtent\tSpatialExtent" << endl;
@@ -683,7 +979,7 @@ bool PropagationDistance::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(spikingCoherenceName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(spikingCoherenceName, saver.getCurrFile());
 
 		stream << "WaveId\tTopoDist\tNbActCells\tStdDevFirstActTimes\ttMin\ttMax\tMaxMinFirstActTimesRatio" << endl;
@@ -700,6 +996,18 @@ bool PropagationDistance::SaveMetric(ResultSaver saver) const
 
 		allSaved &= stream.good();
 	}
+	std::string waveGroupsName("WaveGroups");
+	if (saver.isSaving(waveGroupsName) and not waveGroups.empty())
+	{
+		ostream & stream = saver.getStream();
+		this->AddSavedFile(waveGroupsName, saver.getCurrFile());
+
+		stream << "WaveId\tGroupId" << endl;
+		for (unsigned int w = 0 ; w < waveGroups.size() ; ++w)
+			stream << w << "\t" << GetWaveGroup(w) << endl;
+
+		allSaved &= stream.good();
+	}
 
 	return allSaved;
 }
@@ -713,6 +1021,9 @@ void PropagationDistance::Initialize()
 	indActiv = 0;
 	isInWaveSince.clear();
 	waves.clear();
+	cellEntries.clear();
+	initiatedWaves.clear();
+	waveGroups.clear();
 }
 
 //**********************************************************************
@@ -863,18 +1174,19 @@ bool PropagationDistance::SaveToStream(std::ofstream & stream) const
 //**********************************************************************
 // Default Constructor
 //**********************************************************************
-ConcentrationMetrics::ConcentrationMetrics(ParamHandler & h) : nOut(0)
+ConcentrationMetrics::ConcentrationMetrics(ParamHandler & h)
 {
     savingStep = h.getParam<double>("-SavingStep", 0);
+	SetUpdatePeriod(savingStep);
 }
 
 //**********************************************************************
 // Full constructor
 //**********************************************************************
 ConcentrationMetrics::ConcentrationMetrics(double _ss) : 
-	nOut(0), savingStep(_ss)
+	savingStep(_ss)
 {
-
+	SetUpdatePeriod(savingStep);
 }
 
 //**********************************************************************
@@ -894,17 +1206,27 @@ bool ConcentrationMetrics::ComputeMetric(const ODE::ODEProblem<double,
 {
 	if (valNames.empty())
 		valNames = prob.valNames;
-	double t = prob.GetTime();
-	if (nOut == 0)
-		nOut = max(1, (int) floor(savingStep / prob.GetIntegrStep()));
 
-	if (((int)(t / prob.GetIntegrStep())) % nOut == 0)
+	// Called every savingStep by the metric scheduler
+	std::vector<unsigned int> blocks;
+	if (concentrations.empty() or 
+		not prob.GetBlocksChangedSince(concentrations.back().first, blocks))
 	{
 		concentrations.push_back(make_pair(prob.GetTime(), 
 			std::vector<double>(prob.GetNbVals(), 0)));
 		for (unsigned int c = 0 ; c < prob.GetNbVals() ; ++c)
 			concentrations.back().second[c] = prob.GetVal(c);
 	}
+	else
+	{
+		// Active set integration : frozen cells kept their values
+		unsigned int bs = prob.GetJacobianBlockSize();
+		concentrations.push_back(make_pair(prob.GetTime(), concentrations.back().second));
+		std::vector<double> & concs = concentrations.back().second;
+		for (unsigned int b = 0 ; b < blocks.size() ; ++b)
+			for (unsigned int c = blocks[b] * bs ; c < (blocks[b] + 1) * bs ; ++c)
+				concs[c] = prob.GetVal(c);
+	}
 
 	return true;
 }
@@ -919,7 +1241,7 @@ bool ConcentrationMetrics::SaveMetric(ResultSaver saver) const
 	std::string concentrationsName("Concentrations");
 	if (saver.isSaving(concentrationsName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(concentrationsName, saver.getCurrFile());
 
 		stream << "Time";
@@ -947,7 +1269,6 @@ bool ConcentrationMetrics::SaveMetric(ResultSaver saver) const
 void ConcentrationMetrics::Initialize()
 {
 	Metric::Initialize();
-	nOut = 0;
 	concentrations.clear();
 	valNames.clear();
 }
@@ -991,6 +1312,7 @@ Metric * ConcentrationMetrics::BuildCopy() const
 bool ConcentrationMetrics::LoadFromStream(std::ifstream & stream)
 {
 	stream >> savingStep;
+	SetUpdatePeriod(savingStep);
 	this->Initialize();
 	return stream.good() and not stream.eof();
 }
@@ -1091,7 +1413,7 @@ bool FunctionalTopoMetric::SaveMetric(ResultSaver saver) const
 		connecByThreshName = it->first + "_ConnecByThresh";
 		if (saver.isSaving(connecByThreshName))
 		{
-			ofstream & stream = saver.getStream();
+			ostream & stream = saver.getStream();
 			this->AddSavedFile(connecByThreshName, saver.getCurrFile());
 
 			stream << "Threshold\tMeanDeg\tMeanPathLength\tUnconRatio\tHCCEstim\tEfficiency" 
@@ -1117,7 +1439,7 @@ bool FunctionalTopoMetric::SaveMetric(ResultSaver saver) const
 		rocDataName = it->first + "_ROCData";
 		if (saver.isSaving(rocDataName))
 		{
-			ofstream & stream = saver.getStream();
+			ostream & stream = saver.getStream();
 			this->AddSavedFile(rocDataName, saver.getCurrFile());
 
 			stream << "FalsePositiveRatio\tTruePositiveRatio" << std::endl;
@@ -1828,7 +2150,7 @@ bool CorrelationsMetric::SaveMetric(ResultSaver saver) const
 	std::string zeroLagCorrelMatName("ZeroLagCorrelationMatrix");
 	if (saver.isSaving(zeroLagCorrelMatName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(zeroLagCorrelMatName, saver.getCurrFile());
 
 		allSaved &= SaveFullMatrix(stream, zeroLagCorr);
@@ -1837,7 +2159,7 @@ bool CorrelationsMetric::SaveMetric(ResultSaver saver) const
 	std::string maxCorrelValsMatName("MaxCorrelationValuesMatrix");
 	if (saver.isSaving(maxCorrelValsMatName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(maxCorrelValsMatName, saver.getCurrFile());
 
 		allSaved &= SaveFullMatrix(stream, maxCrossCorrVals);
@@ -1846,7 +2168,7 @@ bool CorrelationsMetric::SaveMetric(ResultSaver saver) const
 	std::string maxCorrelLagsMatName("MaxCorrelationLagsMatrix");
 	if (saver.isSaving(maxCorrelLagsMatName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(maxCorrelLagsMatName, saver.getCurrFile());
 
 		allSaved &= SaveFullMatrix(stream, maxCrossCorrLags);
@@ -1855,7 +2177,7 @@ bool CorrelationsMetric::SaveMetric(ResultSaver saver) const
 	std::string maxCorrelValsNoZeroMatName("MaxCorrelationValuesNoZeroMatrix");
 	if (saver.isSaving(maxCorrelValsNoZeroMatName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(maxCorrelValsNoZeroMatName, saver.getCurrFile());
 
 		allSaved &= SaveFullMatrix(stream, maxCrossCorrValsNoZero);
@@ -1864,7 +2186,7 @@ bool CorrelationsMetric::SaveMetric(ResultSaver saver) const
 	std::string maxCorrelLagsNoZeroMatName("MaxCorrelationNoZeroLagsMatrix");
 	if (saver.isSaving(maxCorrelLagsNoZeroMatName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(maxCorrelLagsNoZeroMatName, saver.getCurrFile());
 
 		allSaved &= SaveFullMatrix(stream, maxCrossCorrLagsNoZero);
@@ -1873,7 +2195,7 @@ bool CorrelationsMetric::SaveMetric(ResultSaver saver) const
 	std::string zeroCorrelCommonNeighbName("CommonNeighbsZeroCorrel");
 	if (saver.isSaving(zeroCorrelCommonNeighbName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(zeroCorrelCommonNeighbName, saver.getCurrFile());
 
 		stream << "NbCommonNeighbs\tZeroLagCorrel" << std::endl;
@@ -1889,7 +2211,7 @@ bool CorrelationsMetric::SaveMetric(ResultSaver saver) const
 	std::string directionalityMatName("CorrelDirectionalityMatrix");
 	if (saver.isSaving(directionalityMatName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(directionalityMatName, saver.getCurrFile());
 
 		allSaved &= SaveFullMatrix(stream, directionnality);
@@ -2322,7 +2644,7 @@ bool TransferEntropyMetric::SaveMetric(ResultSaver saver) const
 	std::string transferEntropyFullMatName("TransferEntropyFullMat");
 	if (saver.isSaving(transferEntropyFullMatName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(transferEntropyFullMatName, saver.getCurrFile());
 
 		allSaved &= SaveFullMatrix(stream, transferEntropy);
@@ -2655,7 +2977,9 @@ ADD_METRIC_DEPENDENCY(THRESHOLD_DETERMINATION_METRIC, ACTIVATED_CELLS_METRICS)
 //**********************************************************************
 ThresholdDetermination::ThresholdDetermination() 
 {
-
+	// Only new activations can make the reference cell spike
+	SetUpdatePeriod(0);
+	SetEventTriggers(CellActivationEvent);
 }
 
 //**********************************************************************
@@ -2663,6 +2987,8 @@ ThresholdDetermination::ThresholdDetermination()
 //**********************************************************************
 ThresholdDetermination::ThresholdDetermination(std::ifstream & stream)
 {
+	SetUpdatePeriod(0);
+	SetEventTriggers(CellActivationEvent);
 	LoadFromStream(stream);
 }
 
@@ -2705,6 +3031,30 @@ bool ThresholdDetermination::ComputeMetric(const ChIModel & model)
 	return true;
 }
 
+//**********************************************************************
+// Used to gather the probes of a bisection run in stimulation order
+//**********************************************************************
+void ThresholdDetermination::AddSimulation(const ThresholdDetermination & other, 
+	double nbStim, double nbNeighb, double nbDeriv)
+{
+	if (other.spiked.empty())
+	{
+		spiked.push_back(false);
+		timeSpiked.push_back(-1);
+		nbStims.push_back(nbStim);
+		nbNeighbs.push_back(nbNeighb);
+		nbDerivs.push_back(nbDeriv);
+	}
+	else
+	{
+		spiked.push_back(other.spiked.back());
+		timeSpiked.push_back(other.timeSpiked.back());
+		nbStims.push_back(other.nbStims.back());
+		nbNeighbs.push_back(other.nbNeighbs.back());
+		nbDerivs.push_back(other.nbDerivs.back());
+	}
+}
+
 //**********************************************************************
 // Save the activated cells
 //**********************************************************************
@@ -2715,7 +3065,7 @@ bool ThresholdDetermination::SaveMetric(ResultSaver saver) const
 	std::string ThreshDetermName("ThresholdDetermination");
 	if (saver.isSaving(ThreshDetermName) and not spiked.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(ThreshDetermName, saver.getCurrFile());
 
 		stream << "HasSpiked\tSpikeTime\tThreshold\tSecondNeighbThresh" << endl;
@@ -2736,7 +3086,7 @@ bool ThresholdDetermination::SaveMetric(ResultSaver saver) const
 	std::string ThreshDetermFullName("ThresholdDeterminationFull");
 	if (saver.isSaving(ThreshDetermFullName) and not spiked.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(ThreshDetermFullName, saver.getCurrFile());
 
 		stream << "HasSpiked\tSpikeTime\tnbStims\tnbNeighbs" << endl;
@@ -3018,7 +3368,7 @@ bool WaveFrontDetect::SaveMetric(ResultSaver saver) const
 	std::string fullFrontierCellsName("FullFrontierCells");
 	if (saver.isSaving(fullFrontierCellsName) and not frontiers.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(fullFrontierCellsName, saver.getCurrFile());
 		
 		stream << "IdWave\tIdCell\tIsOnFront\tDegree\tIncomingFlux\tActualInFlux\tDistToInit" << std::endl;
@@ -3055,7 +3405,7 @@ bool WaveFrontDetect::SaveMetric(ResultSaver saver) const
 	std::string frontierCellsStatsName("FrontierCellsStats");
 	if (saver.isSaving(frontierCellsStatsName) and not frontiers.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(frontierCellsStatsName, saver.getCurrFile());
 		
 		stream 
@@ -3353,8 +3703,7 @@ ADD_METRIC_DEPENDENCY(FOURIER_TRANSFORM_METRIC, CONCENTRATIONS_METRIC)
 //**********************************************************************
 // Default Constructor
 //**********************************************************************
-FourierTransform::FourierTransform(ParamHandler & h) :
-	wavetable(0), workspace(0), sigData_comp(0)
+FourierTransform::FourierTransform(ParamHandler & h)
 {
 	std::vector<std::string> names = 
 		h.getParam<std::vector<std::string> >("-FourierTransform", 0);
@@ -3373,13 +3722,13 @@ FourierTransform::FourierTransform(ParamHandler & h) :
 	stfftWinSize = h.getParam<double>("-FourierTransUseShortTimeFFT", 1);
 	stfftWinStep = h.getParam<double>("-FourierTransUseShortTimeFFT", 2);
 	domFreqThreshRat = h.getParam<double>("-FourierTransUseShortTimeFFT", 3);
+	nbThreads = std::max(1, h.getParam<int>("-SpectraThreads", 0));
 }
 
 //**********************************************************************
 // Constructor from stream
 //**********************************************************************
-FourierTransform::FourierTransform(std::ifstream & stream) :
-	wavetable(0), workspace(0), sigData_comp(0)
+FourierTransform::FourierTransform(std::ifstream & stream) : nbThreads(1)
 {
 	LoadFromStream(stream);
 }
@@ -3389,12 +3738,8 @@ FourierTransform::FourierTransform(std::ifstream & stream) :
 //**********************************************************************
 FourierTransform::~FourierTransform()
 {
-	if (sigData_comp)
-		delete[] sigData_comp;
-	if (wavetable)
-		gsl_fft_complex_wavetable_free(wavetable);
-	if (workspace)
-		gsl_fft_complex_workspace_free(workspace);
+	for (unsigned int i = 0 ; i < fftWorkspaces.size() ; ++i)
+		delete fftWorkspaces[i];
 }
 
 //**********************************************************************
@@ -3463,18 +3808,17 @@ TRACE(stfftWinSize << " // " << deltaT)
 
 			//centerAndNormSig(totSig);
 
+			std::vector<SpectrumTask> tasks;
 			// If short time FFT is needed
 			if (useShortTimeFFT)
 			{
 				initializeSpectrum(it->first, stfftDiscrWinSize, deltaT);
-				double nbwins = 0;
 				for (unsigned int t = 0 ; t <= (totSig.size() - stfftDiscrWinSize) ;
 					t += stfftDiscrWinStep)
-				{
-					computeAndAddSpectrum(totSig, t, t + stfftDiscrWinSize, it->first);
-					++nbwins;
-				}
+					tasks.push_back(SpectrumTask(&totSig, t));
+				computeSpectra(tasks, stfftDiscrWinSize, it->first);
 				// Normalize spectrum
+				double nbwins = tasks.size();
 				for (unsigned int i = 0 ; i < spectrums[it->first].size() ; ++i)
 					spectrums[it->first][i].second /= nbwins;
 			}
@@ -3482,53 +3826,61 @@ TRACE(stfftWinSize << " // " << deltaT)
 			else
 			{
 				initializeSpectrum(it->first, totSig.size(), deltaT);
-				computeAndAddSpectrum(totSig, 0, totSig.size(), it->first);
+				tasks.push_back(SpectrumTask(&totSig, 0));
+				computeSpectra(tasks, totSig.size(), it->first);
 			}
 		}
 		else // Separated sub signals, resulting spectrum is mean spectrum
 		{
 			// Merged signal :
-			if (useShortTimeFFT)
-				initializeSpectrum(it->first, stfftDiscrWinSize, deltaT);
-			else
-				initializeSpectrum(it->first, timeLen, deltaT);
+			unsigned int len = useShortTimeFFT ? stfftDiscrWinSize : timeLen;
+			initializeSpectrum(it->first, len, deltaT);
 
-			// Compute spectrum sur each sub signal
-			double nbComps = 0;
+			// All windows of all sub signals are computed as one batch
+			std::vector<SpectrumTask> tasks;
 			for (unsigned int i = 0 ; i < sigInds.size() ; ++i)
 			{
 				if (useShortTimeFFT)
 				{
 					for (unsigned int t = 0 ; t <= (timeLen - stfftDiscrWinSize) ; 
 						t += stfftDiscrWinStep)
-					{
-						spectrograms[it->first].push_back(
-							std::vector<double>(spectrums[it->first].size(), 0));
-						for (unsigned int j = 0 ; j < spectrums[it->first].size() ; ++j)
-							spectrograms[it->first].back()[j] = spectrums[it->first][j].second;
-						computeAndAddSpectrum(concentr[sigInds[i]], t, 
-							t + stfftDiscrWinSize, it->first);
-						++nbComps;
-						for (unsigned int j = 0 ; j < spectrums[it->first].size() ; ++j)
-							spectrograms[it->first].back()[j] = 
-								spectrums[it->first][j].second - spectrograms[it->first].back()[j];
-						if ((ComputeMax(concentr[sigInds[i]], t, t + stfftDiscrWinSize) - 
-							ComputeMin(concentr[sigInds[i]], t, t + stfftDiscrWinSize)) > 
-							domFreqThreshRat * totAmplAcrossSigs)
-						{
-							unsigned int indMax = GetIndiceMax(spectrograms[it->first].back(), 
-								0, spectrograms[it->first].back().size() / 2);
-							dominantFrequencies[it->first].push_back(
-								spectrums[it->first][indMax].first);
-						}
-						else
-							dominantFrequencies[it->first].push_back(0);
-					}
+						tasks.push_back(SpectrumTask(&concentr[sigInds[i]], t));
 				}
 				else
+					tasks.push_back(SpectrumTask(&concentr[sigInds[i]], 0));
+			}
+			// Each window spectrum is directly written in its spectrogram row
+			unsigned int firstRow = 0;
+			if (useShortTimeFFT)
+			{
+				std::vector<std::vector<double> > & spectro = spectrograms[it->first];
+				firstRow = spectro.size();
+				spectro.resize(firstRow + tasks.size(), 
+					std::vector<double>(spectrums[it->first].size(), 0));
+				for (unsigned int k = 0 ; k < tasks.size() ; ++k)
+					tasks[k].row = &spectro[firstRow + k][0];
+			}
+			computeSpectra(tasks, len, it->first);
+			double nbComps = tasks.size();
+
+			if (useShortTimeFFT)
+			{
+				const std::vector<std::vector<double> > & spectro = spectrograms[it->first];
+				for (unsigned int k = 0 ; k < tasks.size() ; ++k)
 				{
-					computeAndAddSpectrum(concentr[sigInds[i]], 0, timeLen, it->first);
-					++nbComps;
+					const std::vector<double> & sig = *tasks[k].sig;
+					unsigned int t = tasks[k].iStart;
+					if ((ComputeMax(sig, t, t + stfftDiscrWinSize) - 
+						ComputeMin(sig, t, t + stfftDiscrWinSize)) > 
+						domFreqThreshRat * totAmplAcrossSigs)
+					{
+						unsigned int indMax = GetIndiceMax(spectro[firstRow + k], 
+							0, spectro[firstRow + k].size() / 2);
+						dominantFrequencies[it->first].push_back(
+							spectrums[it->first][indMax].first);
+					}
+					else
+						dominantFrequencies[it->first].push_back(0);
 				}
 			}
 			// Normalize to mean
@@ -3560,29 +3912,49 @@ void FourierTransform::initializeSpectrum(const std::string & specName,
 	}
 }
 
+//**********************************************************************
+// Compute the spectra of all tasks and add them to spectrums. Tasks are
+// split between threads, each thread sums its spectra in its own 
+// accumulator and accumulators are then added in thread order.
+//**********************************************************************
+void FourierTransform::computeSpectra(const std::vector<SpectrumTask> & tasks, 
+	unsigned int len, const std::string & specName)
+{
+	unsigned int nbWorkers = GetNbParallelWorkers(tasks.size(), nbThreads);
+	while (fftWorkspaces.size() < nbWorkers)
+		fftWorkspaces.push_back(new RealFFTWorkspace());
+	threadSpectrums.resize(nbWorkers);
+	for (unsigned int k = 0 ; k < nbWorkers ; ++k)
+		threadSpectrums[k].assign(len, 0);
+
+	SpectrumBatch batch(*this, tasks, len, fftPlans.Get(len));
+	ParallelFor(tasks.size(), nbWorkers, batch);
+
+	std::vector<std::pair<double, double> > & spec = spectrums[specName];
+	for (unsigned int k = 0 ; k < nbWorkers ; ++k)
+		for (unsigned int j = 0 ; j < len ; ++j)
+			spec[j].second += threadSpectrums[k][j];
+}
+
+//**********************************************************************
+//**********************************************************************
+void FourierTransform::SpectrumBatch::operator()(unsigned int task, unsigned int thread)
+{
+	const SpectrumTask & st = tasks[task];
+	ft.computeAndAddSpectrum(*st.sig, st.iStart, st.iStart + len, 
+		&ft.threadSpectrums[thread][0], st.row, *ft.fftWorkspaces[thread], wavetable);
+}
+
 //**********************************************************************
 // Compute spectrum on the given signal delimited by iStart and iEnd, 
-// add the spectrum to spectrums
+// add the spectrum to spec
 //**********************************************************************
 void FourierTransform::computeAndAddSpectrum(const std::vector<double> & sig, 
-	unsigned int iStart, unsigned int iEnd, const std::string & specName)
+	unsigned int iStart, unsigned int iEnd, double *spec, double *row, 
+	RealFFTWorkspace & ws, const gsl_fft_real_wavetable * wavetable) const
 {
-	// Check that subsig length is correct
-	if ((iEnd - iStart) != n)
-	{
-		n = iEnd - iStart;
-
-		if (sigData_comp)
-			delete[] sigData_comp;
-		if (wavetable)
-			gsl_fft_complex_wavetable_free(wavetable);
-		if (workspace)
-			gsl_fft_complex_workspace_free(workspace);
-
-		sigData_comp = new double[2 * n];
-		wavetable = gsl_fft_complex_wavetable_alloc(n);
-		workspace = gsl_fft_complex_workspace_alloc(n);
-	}
+	unsigned int n = iEnd - iStart;
+	double *sigData = ws.GetBuffer(n);
 
 	double meanVal = 0;
 	double maxVal = sig[0];
@@ -3598,23 +3970,21 @@ void FourierTransform::computeAndAddSpectrum(const std::vector<double> & sig,
 	}
 	meanVal /= (double)(iEnd - iStart);
 
-	// Fill complex table
+	// Fill real table
 	for (unsigned int t = 0 ; t < n ; ++t)
-	{
-		// Re Part
-		sigData_comp[2*t] = (sig[iStart + t] - meanVal) / (maxVal - minVal);
-		// Im Part
-		sigData_comp[2*t+1] = 0;
-	}
+		sigData[t] = (sig[iStart + t] - meanVal) / (maxVal - minVal);
 
 	// Compute actual fourier transform
-	gsl_fft_complex_forward(sigData_comp, 1, n, wavetable, workspace);
+	ws.Transform(wavetable);
 
-	// Copy FFT to vector
+	// Add FFT to spectrum
 	for (unsigned int j = 0 ; j < n ; ++j)
-		spectrums[specName][j].second += 
-			sqrt(sigData_comp[2*j]*sigData_comp[2*j] +
-			sigData_comp[2*j+1]*sigData_comp[2*j+1]);
+	{
+		double modulus = ws.Modulus(j);
+		spec[j] += modulus;
+		if (row)
+			row[j] = modulus;
+	}
 }
 
 //**********************************************************************
@@ -3627,7 +3997,7 @@ bool FourierTransform::SaveMetric(ResultSaver saver) const
 	std::string FourDomFreqName("FourierDominantFrequencies");
 	if (saver.isSaving(FourDomFreqName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(FourDomFreqName, saver.getCurrFile());
 
 		for (std::map<std::string, std::vector<double> >::const_iterator it = 
@@ -3660,7 +4030,7 @@ bool FourierTransform::SaveMetric(ResultSaver saver) const
 	std::string FullSpectrogramName("FullFourierSpectrogram");
 	if (saver.isSaving(FullSpectrogramName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(FullSpectrogramName, saver.getCurrFile());
 	
 		for (std::map<std::string, std::vector<std::vector<double> > >::const_iterator it = 
@@ -3673,7 +4043,7 @@ bool FourierTransform::SaveMetric(ResultSaver saver) const
 	std::string fullFourTransName("FullFourierTransform");
 	if (saver.isSaving(fullFourTransName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(fullFourTransName, saver.getCurrFile());
 
 		for (std::map<std::string, std::vector<std::pair<double, double> > >::
@@ -3834,7 +4204,7 @@ ADD_METRIC_DEPENDENCY(WAVELET_TRANSFORM_METRIC, CONCENTRATIONS_METRIC)
 // Default Constructor
 //**********************************************************************
 WaveletTransform::WaveletTransform(ParamHandler & h) :
-	wavelet(0), workspace(0), sigData(0), n(0), newN(0), nbLevels(0)
+	wavelet(0), n(0), newN(0), nbLevels(0)
 {
 	std::vector<std::string> names = 
 		h.getParam<std::vector<std::string> >("-WaveletTransformElems", 0);
@@ -3846,6 +4216,7 @@ WaveletTransform::WaveletTransform(ParamHandler & h) :
 	stepFreqToSave = h.getParam<double>("-WaveletTransform", 2);
 	domFreqThreshRat = h.getParam<double>("-WaveletTransform", 3);
 	powrThreshFract = h.getParam<double>("-WaveletTransform", 4);
+	nbThreads = std::max(1, h.getParam<int>("-SpectraThreads", 0));
 
 	for (unsigned int i = 0 ; i < names.size() ; ++i)
 		elems[names[i]].push_back(totElems[i]);
@@ -3855,7 +4226,7 @@ WaveletTransform::WaveletTransform(ParamHandler & h) :
 // Constructor from stream
 //**********************************************************************
 WaveletTransform::WaveletTransform(std::ifstream & stream) :
-	wavelet(0), workspace(0), sigData(0), n(0), newN(0), nbLevels(0)
+	nbThreads(1), wavelet(0), n(0), newN(0), nbLevels(0)
 {
 	LoadFromStream(stream);
 }
@@ -3865,12 +4236,10 @@ WaveletTransform::WaveletTransform(std::ifstream & stream) :
 //**********************************************************************
 WaveletTransform::~WaveletTransform()
 {
-	if (sigData)
-		delete[] sigData;
 	if (wavelet)
 		gsl_wavelet_free(wavelet);
-	if (workspace)
-		gsl_wavelet_workspace_free(workspace);
+	for (unsigned int i = 0 ; i < wvltWorkspaces.size() ; ++i)
+		delete wvltWorkspaces[i];
 }
 
 //**********************************************************************
@@ -3939,91 +4308,72 @@ bool WaveletTransform::ComputeMetric(const ODE::ODEProblem<double, double> & pro
 		}
 		double totAmplAcrossSigs = sigAmp[maxAmplInd];
 
-		// Compute wavelet transforms
+		// Don't compute wavelet transform if the signal amplitude is too small
+		std::vector<const std::vector<double> *> sigs;
 		for (unsigned int i = 0 ; i < sigInds.size() ; ++i)
-		{
-			// Don't compute wavelet transform if the signal amplitude is too small
 			if (sigAmp[i] > domFreqThreshRat*totAmplAcrossSigs)
-			{
-				computeAndAddSpectrogram(concentr[sigInds[i]], 0, concentr[sigInds[i]].size(),
-					it->first, samplingFreq);
-				computeAndAddDominantFrequencies(it->first, spectrograms[it->first].size() - 1);
-			}
+				sigs.push_back(&concentr[sigInds[i]]);
+		if (sigs.empty())
+			continue;
+
+		// All signals have the same length
+		if (timeLen != n)
+		{
+			n = timeLen;
+			double expo = gsl_sf_log((double)n) / gsl_sf_log(2.0);
+			nbLevels = floor(expo);
+			newN = pow(2, nbLevels);
 		}
+		if (not wavelet)
+			wavelet = gsl_wavelet_alloc(gsl_wavelet_daubechies, 4);
+		unsigned int nbWorkers = GetNbParallelWorkers(sigs.size(), nbThreads);
+		while (wvltWorkspaces.size() < nbWorkers)
+			wvltWorkspaces.push_back(new WaveletWorkspace());
+
+		// Compute wavelet transforms, each one in its own spectrogram
+		unsigned int firstSpectro = spectrograms[it->first].size();
+		spectrograms[it->first].resize(firstSpectro + sigs.size());
+		SpectrogramBatch batch(*this, sigs, samplingFreq, &spectrograms[it->first][firstSpectro]);
+		ParallelFor(sigs.size(), nbWorkers, batch);
+
+		for (unsigned int i = 0 ; i < sigs.size() ; ++i)
+			computeAndAddDominantFrequencies(it->first, firstSpectro + i);
 	}
 
 	return true;
 }
 
 //**********************************************************************
-// Compute spectrum on the given signal delimited by iStart and iEnd, 
-// add the spectrum to spectrums
 //**********************************************************************
-void WaveletTransform::computeAndAddSpectrogram(const std::vector<double> & sig, 
-	unsigned int iStart, unsigned int iEnd, const std::string & specName, double samplingFreq)
+void WaveletTransform::SpectrogramBatch::operator()(unsigned int task, unsigned int thread)
 {
-	// Check that subsig length is correct
-	if ((iEnd - iStart) != n)
-	{
-		n = iEnd - iStart;
-
-		if (sigData)
-			delete[] sigData;
-		if (wavelet)
-			gsl_wavelet_free(wavelet);
-		if (workspace)
-			gsl_wavelet_workspace_free(workspace);
-
-		double expo = gsl_sf_log((double)n) / gsl_sf_log(2.0);
-		nbLevels = floor(expo);
-		newN = pow(2, nbLevels);
-		sigData = new double[newN];
-
-		wavelet = gsl_wavelet_alloc(gsl_wavelet_daubechies, 4);
-		workspace = gsl_wavelet_workspace_alloc(n);
-	}
-
-	// Compute the interpolation for upsampling
-	double *xa = new double[n];
-	double *ya = new double[n];
-	for (unsigned int i = iStart ; i < iEnd ; ++i)
-	{
-		xa[i] = i - iStart;
-		ya[i] = sig[i];
-	}
-
-	gsl_interp *interp = gsl_interp_alloc(gsl_interp_linear, n);
-	gsl_interp_init(interp, xa, ya, n);
-	gsl_interp_accel *tmpAcc = gsl_interp_accel_alloc();
-
-
-	// Upsampling of signal to make it a power of 2
-	for (unsigned int i = 0 ; i < newN ; ++i)
-	{
-		sigData[i] = gsl_interp_eval(interp, xa, ya, ((double)i)/((double)newN - 1.0)*((double)n - 1.0), tmpAcc);
-	}
-
-	delete[] xa;
-	delete[] ya;
-	gsl_interp_accel_free(tmpAcc);
-	gsl_interp_free(interp);
+	wt.computeAndAddSpectrogram(*sigs[task], 0, sigs[task]->size(), spectros[task],
+		samplingFreq, *wt.wvltWorkspaces[thread]);
+}
 
-	// Compute actual wavelet transform
-	gsl_wavelet_transform_forward(wavelet, sigData, 1, newN, workspace);
+//**********************************************************************
+// Compute spectrogram on the given signal delimited by iStart and iEnd, 
+// store it in spectro (n, newN and nbLevels must be set)
+//**********************************************************************
+void WaveletTransform::computeAndAddSpectrogram(const std::vector<double> & sig, 
+	unsigned int iStart, unsigned int iEnd, Spectrogram & spectro, 
+	double samplingFreq, WaveletWorkspace & ws) const
+{
+	assert((iEnd - iStart) == n);
+	const double *sigData = ws.Transform(wavelet, sig, iStart, iEnd, newN);
 
 	// Copy wavelet transform to spectrogram
 	unsigned int ind = 1;
 	double freq;
 	double corrSamplFreq = samplingFreq * ((double)newN / (double)n);
-	spectrograms[specName].push_back(std::vector<std::pair<double, std::vector<double> > >());
+	spectro.clear();
 	for (unsigned int l = 0 ; l < nbLevels ; ++l)
 	{
 		freq = (corrSamplFreq / pow(2, nbLevels - l + 1) + 
 			corrSamplFreq / pow(2, nbLevels - l)) / 2.0;
-		spectrograms[specName].back().push_back(make_pair(freq, 
-			std::vector<double>(pow(2,l), 0)));
+		spectro.push_back(make_pair(freq, std::vector<double>(pow(2,l), 0)));
 		for (unsigned int i = 0 ; i < pow(2,l) ; ++i)
-			spectrograms[specName].back().back().second[i] = sigData[ind++];
+			spectro.back().second[i] = sigData[ind++];
 	}
 }
 
@@ -4110,7 +4460,7 @@ bool WaveletTransform::SaveMetric(ResultSaver saver) const
 			for (unsigned int i = 0 ; i < it->second.size() ; ++i)
 			{
 				ResultSaver tmpSav = saver(it->first + "/" + StringifyFixed(i));
-				ofstream & stream = tmpSav.getStream();
+				ostream & stream = tmpSav.getStream();
 				this->AddSavedFile(WaveletSpectroName, tmpSav.getCurrFile());
 				assert(stream.good());
 				// Format : columns are time and rows are levels
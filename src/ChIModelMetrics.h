@@ -20,14 +20,11 @@
 #include "MetricComputeStrat.h"
 #include "Network.h"
 #include "ODEProblems.h"
+#include "SpectralTools.h"
 
 #include <vector>
 #include <queue>
 
-// Needed to avoid conflicting declarations between wavelet and fft
-#define GSL_DISABLE_DEPRECATED
-#include <gsl/gsl_wavelet.h>
-#include <gsl/gsl_fft_complex.h>
 
 namespace AstroModel
 {
@@ -87,6 +84,42 @@ namespace AstroModel
 		std::vector<unsigned int> cells;
 	};
 
+	class ThresholdCrossing
+	{
+	public:
+		ThresholdCrossing(unsigned int _c, double _t) : cell(_c), time(_t) {}
+		unsigned int cell;
+		double time; // Linearly interpolated within the integration step
+	};
+
+	// Detects the upward threshold crossings of the excitable variable.
+	// Values are read directly from the ODE values when the model 
+	// exposes their layout, and compared all at once.
+	class ThresholdCrossingDetector
+	{
+	public:
+		ThresholdCrossingDetector() : lastTime(0), hasPrev(false) {}
+		// Compares the current values with the threshold
+		void Detect(const AbstractODENetDynProblem & model, double thresh);
+		void Clear();
+		// Crossings detected by the last call to Detect
+		inline const std::vector<ThresholdCrossing> & GetNewCrossings() const
+			{ return newCrossings; }
+		// Cells currently above the threshold, in increasing order
+		inline const std::vector<unsigned int> & GetAboveCells() const
+			{ return aboveCells; }
+
+	protected:
+		std::vector<double> currVals;
+		std::vector<double> prevVals;
+		std::vector<unsigned char> above;
+		std::vector<unsigned char> newAbove;
+		std::vector<unsigned int> aboveCells;
+		std::vector<ThresholdCrossing> newCrossings;
+		double lastTime;
+		bool hasPrev;
+	};
+
 	class TimedPropagation
 	{
 	public:
@@ -159,7 +192,7 @@ namespace AstroModel
 		// Default constructor
 		ActivatedCells(ParamHandler & h = ParamHandler::GlobalParams);
 		// Full constructor
-		ActivatedCells(double _at, double _fetw, double _fcd);
+		ActivatedCells(double _at, double _fetw, double _fcd, double _sp = -1);
 		// Constructor from stream
 		ActivatedCells(std::ifstream & stream);
 
@@ -191,12 +224,20 @@ namespace AstroModel
 		virtual double GetMeanFreqEst() const;
 		// Return the mean influx in cells before firing 
 		virtual double ComputeMeanInflux(unsigned int i) const;
+		// Returns the time between two computations of the metric
+		double GetSamplingStep(double integrStep) const;
+		// Puts the activations recorded by previous before the ones of 
+		// this metric, as if both had been recorded without initialization
+		void PrependActivationsOf(const ActivatedCells & previous);
 
 		//===========================================================||
 		// Accessors                                                 ||
 		//===========================================================||
 		inline const std::vector<TimedActivations> & GetActivations() const
 			{ return activations; }
+		// All upward threshold crossings, in chronological order
+		inline const std::vector<ThresholdCrossing> & GetCrossings() const
+			{ return crossings; }
 		inline int GetCumulActCells() const 
 			{ return cumulActivCells.size(); }
 		inline double GetMaxInfluxInTimeWin(unsigned int i) const;
@@ -224,6 +265,14 @@ namespace AstroModel
 		double lastTime;
 		double tStart;
 		double tEnd;
+		unsigned int ringPos;
+
+		ThresholdCrossingDetector detector;
+		std::vector<ThresholdCrossing> crossings;
+		std::set<unsigned int> markedCells; // lastActivatedTime >= 0
+		// Influxes are only tracked when a metric needs them
+		bool trackInfluxes;
+		bool influxTrackingSet;
 	};
 
 /**********************************************************************/
@@ -269,8 +318,13 @@ namespace AstroModel
 		inline unsigned int size() const { return waves.size(); }
 		const TimedWave & operator[](unsigned int ind) const;
 		double GetMaxDelay() const { return maxDelay; }
+		// Returns the representative of the group of colliding waves
+		unsigned int GetWaveGroup(unsigned int w) const;
 	
 	protected:
+		// (wave, index in the wave structure)
+		typedef std::pair<unsigned int, unsigned int> WaveEntry;
+
 		unsigned int indActiv;
 		double maxDelay;
 		double minDelay;
@@ -280,6 +334,12 @@ namespace AstroModel
 		std::vector<std::pair<bool, double> > isInWaveSince;
 
 		std::vector<TimedWave> waves;
+		// Structure entries of each cell, in chronological order
+		std::vector<std::vector<WaveEntry> > cellEntries;
+		// Waves initiated by each cell
+		std::vector<std::vector<unsigned int> > initiatedWaves;
+		// Union-find forest of colliding waves
+		mutable std::vector<unsigned int> waveGroups;
 
 		std::vector<double> startQuant;
 		std::vector<double> endQuant;
@@ -290,6 +350,11 @@ namespace AstroModel
 		std::vector<double> stepRatio;
 
 		double lastTime;
+
+		// Adds currCell to wave w, with the given parents entries
+		void joinWave(const ChIModel & model, unsigned int currCell, 
+			unsigned int w, const std::vector<unsigned int> & parentEntries, double t);
+		void mergeWaveGroups(unsigned int w1, unsigned int w2);
 	};
 
 /**********************************************************************/
@@ -343,7 +408,6 @@ namespace AstroModel
 		double GetSavingStep() const { return savingStep; }
 
 	protected:
-		unsigned int nOut;
 		double savingStep;
 		mutable std::vector<TimedConcentrations> concentrations;
 		mutable std::vector<std::string> valNames;
@@ -727,6 +791,10 @@ namespace AstroModel
 		// Accessors                                                 ||
 		//===========================================================||
 		bool HasSpiked() { return spiked.empty() ? false : spiked.back(); }
+		// Adds the last simulation of another metric, or a simulation
+		// without spike if it has none
+		void AddSimulation(const ThresholdDetermination & other, 
+			double nbStim, double nbNeighb, double nbDeriv);
 		double GetSecondNeighbThresh() const;
 		double GetSecondNeighbThreshUnderTime(double time) const;
 
@@ -888,19 +956,49 @@ namespace AstroModel
 
 		std::map<std::string, std::vector<double> > dominantFrequencies;
 
-		// Internal fourier transform data
-		gsl_fft_complex_wavetable * wavetable;
-		gsl_fft_complex_workspace * workspace;
-		double *sigData_comp;
-		unsigned int n;
+		// Number of threads computing the spectra
+		unsigned int nbThreads;
+		// Internal fourier transform data (wavetables are shared,
+		// workspaces and accumulated spectra are per thread)
+		RealFFTPlanCache fftPlans;
+		std::vector<RealFFTWorkspace *> fftWorkspaces;
+		std::vector<std::vector<double> > threadSpectrums;
+
+		// Sub signal sig[iStart, iStart + len[ whose spectrum is needed, 
+		// the spectrum is also copied to row if it isn't null
+		struct SpectrumTask
+		{
+			const std::vector<double> *sig;
+			unsigned int iStart;
+			double *row;
+			SpectrumTask(const std::vector<double> *_s, unsigned int _i, double *_r = 0) :
+				sig(_s), iStart(_i), row(_r) {}
+		};
+		// Batch of tasks run by ParallelFor
+		struct SpectrumBatch
+		{
+			FourierTransform & ft;
+			const std::vector<SpectrumTask> & tasks;
+			unsigned int len;
+			const gsl_fft_real_wavetable *wavetable;
+			SpectrumBatch(FourierTransform & _ft, const std::vector<SpectrumTask> & _t,
+				unsigned int _l, const gsl_fft_real_wavetable *_w) : 
+				ft(_ft), tasks(_t), len(_l), wavetable(_w) {}
+			void operator()(unsigned int task, unsigned int thread);
+		};
 
 		// Initilize spectrum with frequency values and put spectrum vals to 0
 		void initializeSpectrum(const std::string & specName, unsigned int len, double dt);
+		// Compute the spectra of all tasks (sub signals of length len) 
+		// and add them to spectrums
+		void computeSpectra(const std::vector<SpectrumTask> & tasks, unsigned int len,
+			const std::string & specName);
 		// Compute spectrum on the given signal delimited by iStart and iEnd, 
-		// add the spectrum to spectrums
+		// add the spectrum to spec
 		void computeAndAddSpectrum(	
 			const std::vector<double> & sig, unsigned int iStart, unsigned int iEnd, 
-			const std::string & specName);
+			double *spec, double *row, RealFFTWorkspace & ws, 
+			const gsl_fft_real_wavetable * wavetable) const;
 	};
 
 /**********************************************************************/
@@ -962,21 +1060,36 @@ namespace AstroModel
 
 		std::map<std::string, unsigned int> totNbSignals;
 
-		// Internal fourier transform data
+		// Number of threads computing the spectrograms
+		unsigned int nbThreads;
+		// Internal wavelet transform data (one workspace per thread)
 		gsl_wavelet *wavelet;
-		gsl_wavelet_workspace *workspace;
-		double *sigData;
+		std::vector<WaveletWorkspace *> wvltWorkspaces;
+		// Signal length, resampled length (power of 2) and number of levels
 		unsigned int n;
 		unsigned int newN;
 		unsigned int nbLevels;
 
+		typedef std::vector<std::pair<double, std::vector<double> > > Spectrogram;
+		// Batch of signals run by ParallelFor
+		struct SpectrogramBatch
+		{
+			WaveletTransform & wt;
+			const std::vector<const std::vector<double> *> & sigs;
+			double samplingFreq;
+			Spectrogram *spectros;
+			SpectrogramBatch(WaveletTransform & _wt, const std::vector<const std::vector<double> *> & _s,
+				double _sf, Spectrogram *_sp) : wt(_wt), sigs(_s), samplingFreq(_sf), spectros(_sp) {}
+			void operator()(unsigned int task, unsigned int thread);
+		};
+
 		// Initilize spectrum with frequency values and put spectrum vals to 0
 		//void initializeSpectrum(const std::string & specName, unsigned int len, double dt);
 
-		// Compute spectrogram on the given signal delimited by iStart and iEnd and add it to spectrograms 
+		// Compute spectrogram on the given signal delimited by iStart and iEnd and store it in spectro
 		void computeAndAddSpectrogram(	
 			const std::vector<double> & sig, unsigned int iStart, unsigned int iEnd, 
-			const std::string & specName, double samplingFreq);
+			Spectrogram & spectro, double samplingFreq, WaveletWorkspace & ws) const;
 
 		// Compute dominant frequencies on the given signal and indice in spectrogram
 		// (to be called after computeAndAddSpectrogram)
@@ -36,6 +36,8 @@ template <> string RepeatSimulation<ThresholdModel>::ClassName("RepeatSimulation
 template <> string RepeatSimulation<ModifiedThresholdModel>::ClassName("RepeatSimulationModifiedThresholdModel");
 template <> string RepeatSimulation<SecondOrdNeighbSERSModel>::ClassName("RepeatSimulationSecondOrdNeighbSERSModel");
 template <> string RepeatSimulation<SimpleThresholdSERSModel>::ClassName("RepeatSimulationSimpleThresholdSERSModel");
+template <> string RepeatSimulation<BitSlicedThresholdModel>::ClassName("RepeatSimulationBitSlicedThresholdModel");
+template <> string RepeatSimulation<BitSlicedSERSModel>::ClassName("RepeatSimulationBitSlicedSERSModel");
 template <> string RepeatSimulation<ChIModelThresholdDetermination >::ClassName("RepeatSimulationChIModelThresholdDetermination");
 template <> string RepeatSimulation<ChIModelStochasticRes>::ClassName("RepeatSimulationChIModelStochasticResonance");
 template <> string RepeatSimulation<FireDiffuseModel>::ClassName("RepeatSimulationFireDiffuseModel");
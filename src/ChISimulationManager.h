@@ -25,6 +25,9 @@
 #include "AbstractFactory.h"
 #include "ErrorCodes.h"
 #include "NeuronNetModels.h"
+#include "ChIModel.h"
+
+#include <gsl/gsl_rng.h>
 
 namespace AstroModel
 {
@@ -57,6 +60,9 @@ namespace AstroModel
 		// Default Constructor
 		RepeatSimulation(ParamHandler & h = ParamHandler::GlobalParams) : model(0), freeModel(false), handler(h)
 		{
+			batchSize = handler.getParam<unsigned int>("-BatchReplicas", 0);
+			singlePrec = handler.getParam<bool>("-SinglePrecision", 0);
+			validatePrec = handler.getParam<bool>("-SinglePrecision", 1);
 			runStart = 0;
 			runEnd = handler.getParam<unsigned int>("-repeat", 0) - 1;
 			InitializeStandard();
@@ -66,6 +72,9 @@ namespace AstroModel
 			ParamHandler & _h = ParamHandler::GlobalParams) :
 			model(0), freeModel(false), runStart(_rs), runEnd(_re), handler(_h)
 		{
+			batchSize = handler.getParam<unsigned int>("-BatchReplicas", 0);
+			singlePrec = handler.getParam<bool>("-SinglePrecision", 0);
+			validatePrec = handler.getParam<bool>("-SinglePrecision", 1);
 			InitializeStandard();
 		}
 		// Constructor from stream
@@ -73,13 +82,17 @@ namespace AstroModel
 			ParamHandler & _h = ParamHandler::GlobalParams) :
 			model(0), freeModel(false), runStart(0), runEnd(0), handler(_h)
 		{
+			batchSize = handler.getParam<unsigned int>("-BatchReplicas", 0);
+			singlePrec = handler.getParam<bool>("-SinglePrecision", 0);
+			validatePrec = handler.getParam<bool>("-SinglePrecision", 1);
 			InitializeStandard();
 			LoadFromStream(stream);
 		}
 		// Copy Constructor
 		RepeatSimulation(const RepeatSimulation<ModelType> & _m) :
 			model(_m.model), freeModel(false), runStart(_m.runStart), 
-			runEnd(_m.runEnd), handler(_m.handler)
+			runEnd(_m.runEnd), batchSize(_m.batchSize), singlePrec(_m.singlePrec),
+			validatePrec(_m.validatePrec), handler(_m.handler)
 		{
 			for (unsigned int i = 0 ; i < _m.metrics.size() ; ++i)
 				metrics.push_back(std::make_pair(_m.metrics[i].first, false));
@@ -138,19 +151,40 @@ TRACE("Model deleted")
 			// Metric initialization
 			metrics.InitializeMetricsDefault();
 
-			for (unsigned int run = runStart ; run <= runEnd ; ++run)
+			if (singlePrec and not ChIModelBatch<>::CanBatch(dynamic_cast<ChIModel *>(model)))
+				std::cerr << "Warning : " << ModelType::ClassName << " with this solver "
+					"can't be batched, -SinglePrecision is ignored and runs are "
+					"simulated in double precision" << std::endl;
+
+			for (unsigned int run = runStart ; run <= runEnd ; )
 			{
+				unsigned int nbRuns = std::min(std::max(batchSize, 1u), runEnd - run + 1);
+				if (((nbRuns > 1) or singlePrec) and 
+					ChIModelBatch<>::CanBatch(dynamic_cast<ChIModel *>(model)))
+				{
+					returnVal |= launchBatch(saver, run, nbRuns);
+					run += nbRuns;
+					continue;
+				}
+
 				TRACE_UP("Starting run " << run << ".")
 
-				// Initializing model
-				model->Initialize(saver("Run" + StringifyFixed(run)));
-				// Simulation
-				returnVal |= model->Simulate(saver("Run" + StringifyFixed(run)));
+				ChIModel *chiModel = dynamic_cast<ChIModel *>(model);
+				if (chiModel and chiModel->IsValidatingActiveSet())
+					returnVal |= launchActiveSetValidation(saver("Run" + StringifyFixed(run)), chiModel);
+				else
+				{
+					// Initializing model
+					model->Initialize(saver("Run" + StringifyFixed(run)));
+					// Simulation
+					returnVal |= model->Simulate(saver("Run" + StringifyFixed(run)));
+				}
 				// Computing metrics
 				if (not metrics.ComputeMetricsDefault(*this))
 					returnVal |= SIMULATION_METRIC_COMPUTATION_PROBLEM;
 
 				TRACE_DOWN("Run " << run << " ended.")
+				++run;
 			}
 
 		//==============================//
@@ -243,6 +277,9 @@ TRACE("Model deleted")
 
 		unsigned int runStart;
 		unsigned int runEnd;
+		unsigned int batchSize; // Number of runs integrated together
+		bool singlePrec;        // Batches are integrated in float
+		bool validatePrec;      // Float runs are compared to double ones
 
 		ParamHandler &handler;
 
@@ -270,6 +307,179 @@ TRACE(ModelType::ClassName)
 			}
 		}
 
+		// Runs nbRuns runs as a single batched ODE problem (cf ChIModelBatch).
+		// Only the runs of a repeat simulation are batched, the points of a
+		// grid search are still simulated one after the other.
+		int launchBatch(ResultSaver saver, unsigned int firstRun, unsigned int nbRuns)
+		{
+			int returnVal = 0;
+			TRACE_UP("Starting runs " << firstRun << " to " << firstRun + nbRuns - 1 << " in a batch.")
+
+			std::vector<ModelType *> runModels(1, model);
+			std::vector<ChIModel *> replicas;
+			std::vector<ResultSaver> savers;
+			bool validate = singlePrec and validatePrec;
+			for (unsigned int k = 0 ; k < nbRuns ; ++k)
+			{
+				if (k > 0)
+					runModels.push_back(CreateReplica(*model, handler));
+				replicas.push_back(dynamic_cast<ChIModel *>(runModels[k]));
+				savers.push_back(saver("Run" + StringifyFixed(firstRun + k)));
+				if (not validate)
+					runModels[k]->Initialize(savers[k]);
+			}
+
+			// The double baseline is run first, replicas are then initialized
+			// again from the same random state
+			std::vector<std::map<std::string, double> > baseStats;
+			if (validate)
+			{
+				gsl_rng *rngState = gsl_rng_clone(globalRNG.rng);
+				std::vector<ResultSaver> baseSavers;
+				for (unsigned int k = 0 ; k < nbRuns ; ++k)
+				{
+					baseSavers.push_back(savers[k]("DoubleBaseline"));
+					runModels[k]->Initialize(baseSavers[k]);
+				}
+				ChIModelBatch<double> baseline(replicas, handler);
+				returnVal |= baseline.Simulate(baseSavers);
+				for (unsigned int k = 0 ; k < nbRuns ; ++k)
+					baseStats.push_back(getPropagationStats(runModels[k]));
+
+				gsl_rng_memcpy(globalRNG.rng, rngState);
+				gsl_rng_free(rngState);
+				for (unsigned int k = 0 ; k < nbRuns ; ++k)
+					runModels[k]->Initialize(savers[k]);
+			}
+
+			if (singlePrec)
+			{
+				ChIModelBatch<float> batch(replicas, handler);
+				returnVal |= batch.Simulate(savers);
+			}
+			else
+			{
+				ChIModelBatch<double> batch(replicas, handler);
+				returnVal |= batch.Simulate(savers);
+			}
+
+			if (not baseStats.empty())
+			{
+				std::vector<std::map<std::string, double> > stats;
+				for (unsigned int k = 0 ; k < nbRuns ; ++k)
+					stats.push_back(getPropagationStats(runModels[k]));
+				reportPrecision(saver("Runs_" + StringifyFixed(firstRun) + "_to_" + 
+					StringifyFixed(firstRun + nbRuns - 1)), baseStats, stats);
+			}
+
+			// Simulation metrics see each run in turn
+			ModelType *mainModel = model;
+			for (unsigned int k = 0 ; k < nbRuns ; ++k)
+			{
+				model = runModels[k];
+				if (not metrics.ComputeMetricsDefault(*this))
+					returnVal |= SIMULATION_METRIC_COMPUTATION_PROBLEM;
+			}
+			model = mainModel;
+
+			// Files saved by the replicas are reported by the main model metrics
+			std::vector<Metric *> modelMetrics = model->GetAllMetrics();
+			for (unsigned int k = 1 ; k < nbRuns ; ++k)
+			{
+				std::vector<Metric *> replicaMetrics = runModels[k]->GetAllMetrics();
+				for (unsigned int i = 0 ; i < modelMetrics.size() ; ++i)
+					for (unsigned int j = 0 ; j < replicaMetrics.size() ; ++j)
+						if (replicaMetrics[j]->GetClassName() == modelMetrics[i]->GetClassName())
+							modelMetrics[i]->PullSavedFilePathsFrom(*replicaMetrics[j]);
+				delete runModels[k];
+			}
+
+			TRACE_DOWN("Runs " << firstRun << " to " << firstRun + nbRuns - 1 << " ended.")
+			return returnVal;
+		}
+
+		// Runs the full integration and then the active set one from the 
+		// same random state, the latter being checked against its error bound
+		int launchActiveSetValidation(ResultSaver saver, ChIModel *chiModel)
+		{
+			int returnVal = 0;
+			gsl_rng *rngState = gsl_rng_clone(globalRNG.rng);
+
+			chiModel->SetActiveSetValidationPass(true);
+			model->Initialize(saver("FullIntegration"));
+			returnVal |= model->Simulate(saver("FullIntegration"));
+
+			gsl_rng_memcpy(globalRNG.rng, rngState);
+			gsl_rng_free(rngState);
+
+			chiModel->SetActiveSetValidationPass(false);
+			model->Initialize(saver);
+			returnVal |= model->Simulate(saver);
+
+			if (not chiModel->ReportActiveSetValidation(saver))
+				returnVal |= ACTIVE_SET_BOUND_EXCEEDED;
+			return returnVal;
+		}
+
+		// Wave speeds and propagation distances computed by the metrics of m
+		std::map<std::string, double> getPropagationStats(const ModelType *m) const
+		{
+			std::map<std::string, double> res;
+			std::vector<Metric *> modelMetrics = m->GetAllMetrics();
+			for (unsigned int i = 0 ; i < modelMetrics.size() ; ++i)
+			{
+				std::map<std::string, double> tmp = modelMetrics[i]->GetScalarStatsToSave();
+				for (std::map<std::string, double>::const_iterator it = tmp.begin() ; it != tmp.end() ; ++it)
+					if (it->first.compare(0, 9, "PropDist_") == 0)
+						res[it->first] = it->second;
+			}
+			return res;
+		}
+
+		// Deviation of the float runs from the double baseline, for each
+		// statistic the mean absolute and the largest relative deviations
+		// over the runs are given
+		void reportPrecision(ResultSaver saver, 
+			const std::vector<std::map<std::string, double> > & base,
+			const std::vector<std::map<std::string, double> > & stats) const
+		{
+			std::map<std::string, std::pair<double, double> > dev;
+			for (unsigned int k = 0 ; k < base.size() ; ++k)
+				for (std::map<std::string, double>::const_iterator it = base[k].begin() ; 
+					it != base[k].end() ; ++it)
+				{
+					std::map<std::string, double>::const_iterator f = stats[k].find(it->first);
+					if (f == stats[k].end())
+						continue;
+					double absDev = fabs(f->second - it->second);
+					double relDev = (it->second != 0) ? absDev / fabs(it->second) : 
+						((absDev != 0) ? 1.0 : 0.0);
+					std::pair<double, double> & d = dev[it->first];
+					d.first += absDev / (double) base.size();
+					d.second = std::max(d.second, relDev);
+				}
+
+			if (dev.empty())
+				std::cerr << "Warning : no propagation statistics to validate single "
+					"precision against" << std::endl;
+			std::ostream *stream = 0;
+			std::string validName("PrecisionValidation");
+			if (saver.isSaving(validName))
+			{
+				stream = &saver.getStream();
+				*stream << "Stat\tMeanAbsDev\tMaxRelDev" << std::endl;
+			}
+			for (std::map<std::string, std::pair<double, double> >::const_iterator it = dev.begin() ; 
+				it != dev.end() ; ++it)
+			{
+				TRACE(it->first << " : mean abs dev = " << it->second.first << 
+					" max rel dev = " << it->second.second)
+				if (stream)
+					*stream << it->first << "\t" << it->second.first << "\t" << 
+						it->second.second << std::endl;
+			}
+		}
+
 		// Returns true if debug mode is on
 		inline bool DebugMode() const { return handler.getParam<bool>("-debug"); }
 	};
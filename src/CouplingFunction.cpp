@@ -211,8 +211,16 @@ SigmoidCoupling::SigmoidCoupling(std::ifstream & stream)
 //**********************************************************************
 double SigmoidCoupling::operator()(double DIP3) const
 {
-	return F / 2.0 * (1.0 + fast_tanh((fabs(DIP3) - IP3Thresh) / IP3Scale))
-		* ((DIP3 > 0) ? 1.0 : -1.0);
+	return Flux(DIP3);
+}
+
+//**********************************************************************
+// Sigmoid derivative (the jump at DIP3 = 0 is ignored)
+//**********************************************************************
+double SigmoidCoupling::Derivative(double DIP3) const
+{
+	double th = tanh((fabs(DIP3) - IP3Thresh) / IP3Scale);
+	return F / (2.0 * IP3Scale) * (1.0 - th * th);
 }
 
 //**********************************************************************
@@ -304,7 +312,15 @@ LinearCoupling::LinearCoupling(std::ifstream & stream)
 //**********************************************************************
 double LinearCoupling::operator()(double DIP3) const
 {
-	return F * DIP3;
+	return Flux(DIP3);
+}
+
+//**********************************************************************
+// Linear function derivative
+//**********************************************************************
+double LinearCoupling::Derivative(double ) const
+{
+	return F;
 }
 
 //**********************************************************************
@@ -336,3 +352,116 @@ bool LinearCoupling::SaveToStream(std::ofstream & stream) const
 	return true;
 }
 
+
+//********************************************************************//
+//*************** C O U P L I N G   I N T E G R A T O R **************//
+//********************************************************************//
+
+//**********************************************************************
+// Builds the laplacian if all links are linear
+//**********************************************************************
+void CouplingIntegrator::setUp(const Network<CouplingFunction> & net)
+{
+	nbNodes = net.size();
+	matStep = 0;
+	linear = true;
+	vector<vector<unsigned int> > pattern(nbNodes);
+	for (unsigned int i = 0 ; i < nbNodes ; ++i)
+	{
+		pattern[i] = net.GetNeighbors(i);
+		pattern[i].push_back(i);
+		for (unsigned int j = 0 ; j < net.GetNeighbors(i).size() ; ++j)
+			linear &= (dynamic_cast<const LinearCoupling *>(net[i][net.GetNeighbors(i)[j]]) != 0);
+	}
+	x0.assign(nbNodes, 0);
+	x1.assign(nbNodes, 0);
+	rhs.assign(nbNodes, 0);
+	flux.assign(nbNodes, 0);
+	if (outflow.size() != nbNodes)
+		outflow.assign(nbNodes, 0);
+	if (not linear)
+		return;
+
+	L.SetPattern(pattern);
+	for (unsigned int i = 0 ; i < nbNodes ; ++i)
+	{
+		const vector<unsigned int> & neighbs = net.GetNeighbors(i);
+		for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+		{
+			double F = net[i][neighbs[j]]->GetStrength();
+			L.values[L.Find(i, i)] += F;
+			L.values[L.Find(i, neighbs[j])] -= F;
+		}
+	}
+	A = L;
+}
+
+//**********************************************************************
+//**********************************************************************
+void CouplingIntegrator::compFluxes(const Network<CouplingFunction> & net, 
+	const double *x, double *fl) const
+{
+	for (unsigned int i = 0 ; i < nbNodes ; ++i)
+	{
+		const vector<unsigned int> & neighbs = net.GetNeighbors(i);
+		fl[i] = 0;
+		for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+			fl[i] += (*(net[i][neighbs[j]]))(x[i] - x[neighbs[j]]);
+	}
+}
+
+//**********************************************************************
+//**********************************************************************
+void CouplingIntegrator::Integrate(const Network<CouplingFunction> & net, 
+	double *vals, unsigned int stride, unsigned int offset, double h)
+{
+	if (nbNodes != net.size())
+		setUp(net);
+	for (unsigned int i = 0 ; i < nbNodes ; ++i)
+		x0[i] = vals[i * stride + offset];
+
+	if (linear)
+	{
+		// (I + h/2 L) x1 = (I - h/2 L) x0
+		if (matStep != h)
+		{
+			for (unsigned int p = 0 ; p < A.values.size() ; ++p)
+				A.values[p] = h / 2.0 * L.values[p];
+			for (unsigned int i = 0 ; i < nbNodes ; ++i)
+				A.values[A.Find(i, i)] += 1.0;
+			precond.Factorize(A, 1);
+			matStep = h;
+		}
+		L.Multiply(&x0[0], &rhs[0]);
+		for (unsigned int i = 0 ; i < nbNodes ; ++i)
+		{
+			rhs[i] = x0[i] - h / 2.0 * rhs[i];
+			x1[i] = x0[i];
+		}
+		if (ODE::SolveBiCGSTAB(A, precond, &rhs[0], &x1[0], 1e-12, 200) < 0)
+			cerr << "Warning : coupling linear solver did not converge" << endl;
+	}
+	else
+	{
+		// Explicit midpoint
+		compFluxes(net, &x0[0], &flux[0]);
+		for (unsigned int i = 0 ; i < nbNodes ; ++i)
+			x1[i] = x0[i] - h / 2.0 * flux[i];
+		compFluxes(net, &x1[0], &flux[0]);
+		for (unsigned int i = 0 ; i < nbNodes ; ++i)
+			x1[i] = x0[i] - h * flux[i];
+	}
+
+	for (unsigned int i = 0 ; i < nbNodes ; ++i)
+	{
+		outflow[i] += x0[i] - x1[i];
+		vals[i * stride + offset] = x1[i];
+	}
+}
+
+//**********************************************************************
+//**********************************************************************
+void CouplingIntegrator::Reset()
+{
+	std::fill(outflow.begin(), outflow.end(), 0);
+}
@@ -19,7 +19,11 @@
 
 #include "Savable.h"
 #include "ParamHandler.h"
+#include "SparseLinearSolvers.h"
+#include "utility.h"
+#include <cmath>
 #include <string>
+#include <vector>
 
 namespace AstroModel
 {
@@ -69,6 +73,8 @@ namespace AstroModel
 		//===========================================================||
 		// Coupling Function operator (returns the flux)
 		virtual double operator()(double DIP3) const = 0;
+		// Derivative of the flux with respect to DIP3
+		virtual double Derivative(double DIP3) const = 0;
 
 		// Build parameter handling object, handles static default params
 		virtual ParamHandler BuildModelParamHandler();
@@ -132,6 +138,19 @@ namespace AstroModel
 		//===========================================================||
 		// Coupling Function operator (returns the flux)
 		virtual double operator()(double DIP3) const;
+		// Non virtual version of operator(), for specialised kernels
+		inline double Flux(double DIP3) const
+			{ return Flux<double>(F, IP3Thresh, IP3Scale, DIP3); }
+		// Flux of a link with the given parameters, for batched kernels
+		// (computed in the precision of V)
+		template <typename V>
+		static inline V Flux(V _F, V _thresh, V _scale, V DIP3)
+		{
+			return _F / (V) 2.0 * ((V) 1.0 + fast_tanh((std::fabs(DIP3) - _thresh) / _scale))
+				* ((DIP3 > 0) ? (V) 1.0 : (V) -1.0);
+		}
+		// Derivative of the flux with respect to DIP3
+		virtual double Derivative(double DIP3) const;
 		// Loads the coupling function from a stream
 		virtual bool LoadFromStream(std::ifstream & stream);
 		// Saves the coupling function to a stream
@@ -143,6 +162,12 @@ namespace AstroModel
 		// Update edge values in case parameters were changed
 		virtual void UpdateEdge();
 
+		//===========================================================||
+		// Accessors                                                 ||
+		//===========================================================||
+		inline double GetThreshold() const { return IP3Thresh; }
+		inline double GetScale() const { return IP3Scale; }
+
 	protected:
 		//===========================================================||
 		// Parameters                                                ||
@@ -183,6 +208,13 @@ namespace AstroModel
 		//===========================================================||
 		// Coupling Function operator (returns the flux)
 		virtual double operator()(double DIP3) const;
+		// Non virtual version of operator(), for specialised kernels
+		inline double Flux(double DIP3) const { return F * DIP3; }
+		// Flux of a link with the given parameters, for batched kernels
+		template <typename V>
+		static inline V Flux(V _F, V , V , V DIP3) { return _F * DIP3; }
+		// Derivative of the flux with respect to DIP3
+		virtual double Derivative(double DIP3) const;
 		// Loads the coupling function from a stream
 		virtual bool LoadFromStream(std::ifstream & stream);
 		// Saves the coupling function to a stream
@@ -228,6 +260,43 @@ namespace AstroModel
 		bool activated;
 	};
 
+/**********************************************************************/
+/* Coupling only integrator (operator splitting)                      */
+/**********************************************************************/
+	// Integrates dx_i/dt = - sum_j g_ij(x_i - x_j) over the network, 
+	// where x_i = vals[i * stride + offset]. If all links are linear, 
+	// Crank-Nicolson steps are used (unconditionally stable), otherwise 
+	// explicit midpoint steps. The quantity that left each node is 
+	// accumulated until Reset is called.
+	class CouplingIntegrator
+	{
+	public:
+		CouplingIntegrator() : nbNodes(0), linear(false), matStep(0) {}
+
+		void Integrate(const Network<CouplingFunction> & net, double *vals, 
+			unsigned int stride, unsigned int offset, double h);
+		// Clears the accumulated quantities
+		void Reset();
+		// Forces the matrix to be rebuilt (network changes)
+		void Invalidate() { nbNodes = 0; }
+		// Quantity that left node i since the last call to Reset
+		inline double GetOutflow(unsigned int i) const 
+			{ return (i < outflow.size()) ? outflow[i] : 0; }
+
+	protected:
+		unsigned int nbNodes;
+		bool linear;
+		double matStep;
+		ODE::SparseMatrix<double> A; // I + h/2 L (linear case)
+		ODE::SparseMatrix<double> L; // Laplacian (linear case)
+		ODE::BlockJacobiPreconditioner<double> precond;
+		std::vector<double> x0, x1, rhs, flux;
+		std::vector<double> outflow;
+
+		void setUp(const Network<CouplingFunction> & net);
+		void compFluxes(const Network<CouplingFunction> & net, const double *x, double *fl) const;
+	};
+
 }
 
 #endif
@@ -30,5 +30,7 @@
 #define GRIDSEARCH_METRIC_COMPUTATION_PROBLEM 10
 #define GRIDSEARCH_METRIC_SAVING_PROBLEM      11
 #define MODEL_METRIC_SAVING_PROBLEM           12
+#define RESULT_SAVING_PROBLEM                 13
+#define ACTIVE_SET_BOUND_EXCEEDED             14
 
 #endif
@@ -19,6 +19,8 @@
 
 #include "ErrorCodes.h"
 
+#include <math.h>
+
 using namespace AstroModel;
 using namespace std;
 
@@ -184,6 +186,35 @@ void FireDiffuseCell::SetValNamesPostfix(std::string pf)
 	model->AddPostfixToValName(dynVals + C, pf + "_C");
 }
 
+//********************************************************************//
+//************** S P A R S E   C E L L   V A L U E S *****************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+double SparseCellVals::Scale(double f, double floor, const std::vector<bool> & keep)
+{
+	double maxAbs = 0;
+	unsigned int kept = 0;
+	for (unsigned int k = 0 ; k < ind.size() ; ++k)
+	{
+		unsigned int i = ind[k];
+		v[i] *= f;
+		if (keep[i] or (fabs(v[i]) > floor))
+		{
+			ind[kept++] = i;
+			maxAbs = std::max(maxAbs, fabs(v[i]));
+		}
+		else
+		{
+			v[i] = 0;
+			in[i] = false;
+		}
+	}
+	ind.resize(kept);
+	return maxAbs;
+}
+
 //********************************************************************//
 //************* F I R E   D I F F U S E   M O D E L ******************//
 //********************************************************************//
@@ -195,9 +226,14 @@ string FireDiffuseModel::ClassName = "FireDiffuseModel";
 //**********************************************************************
 FireDiffuseModel::FireDiffuseModel(ParamHandler & h) : 
 	ODENetworkDynamicsModel<CouplingFunction, FireDiffuseCell>::ODENetworkDynamicsModel(h),
-	StimulableCellNetwork::StimulableCellNetwork(h)
+	StimulableCellNetwork::StimulableCellNetwork(h), eventDrivenOn(false),
+	valFloor(0), normA(0)
 {
 	TRACE("*** Initializing Fire Diffuse Model ***")
+	useEventDriven = h.getParam<bool>("-FireDiffuseEventDriven", 0);
+	eventSampleStep = h.getParam<double>("-FireDiffuseEventDriven", 1);
+	eventTol = h.getParam<double>("-FireDiffuseEventDriven", 2);
+	metrics.SetScheduler(&metricScheduler);
 	SetFunct(new ODE::FireDiffuseNetFunct(*this), true);
 }
 
@@ -206,8 +242,13 @@ FireDiffuseModel::FireDiffuseModel(ParamHandler & h) :
 //**********************************************************************
 FireDiffuseModel::FireDiffuseModel(std::ifstream & stream, ParamHandler & h) : 
 	ODENetworkDynamicsModel<CouplingFunction, FireDiffuseCell>::ODENetworkDynamicsModel(h),
-	StimulableCellNetwork::StimulableCellNetwork(h)
+	StimulableCellNetwork::StimulableCellNetwork(h), eventDrivenOn(false),
+	valFloor(0), normA(0)
 {
+	useEventDriven = h.getParam<bool>("-FireDiffuseEventDriven", 0);
+	eventSampleStep = h.getParam<double>("-FireDiffuseEventDriven", 1);
+	eventTol = h.getParam<double>("-FireDiffuseEventDriven", 2);
+	metrics.SetScheduler(&metricScheduler);
 	if (not LoadFromStream(stream))
 		cerr << "Failed to load the model !" << endl;
 
@@ -235,7 +276,10 @@ void FireDiffuseModel::SetUpCellsAndODEs(unsigned int nbCells)
 void FireDiffuseModel::Initialize(ResultSaver saver)
 {
 	ODENetworkDynamicsModel<CouplingFunction, FireDiffuseCell>::Initialize(saver);
-	Stimulable::Initialize();
+	StimulableCellNetwork::Initialize();
+	coupling.Invalidate();
+	// Specialised network function if the cell and link types allow it
+	SetFunct(ODE::CreateNetworkRHS(*this), true);
 
 	// Initialize metrics
 	metrics.InitializeMetricsDefault();
@@ -286,6 +330,288 @@ TRACE_DOWN("*** Finished saving dynamic data ***")
 	return ok;
 }
 
+//**********************************************************************
+// Launch simulation
+//**********************************************************************
+int FireDiffuseModel::Simulate(ResultSaver saver)
+{
+	if (not (useEventDriven and canUseEventDriven()))
+		return ODENetworkDynamicsModel<CouplingFunction, FireDiffuseCell>::Simulate(saver);
+
+	int returnVal = 0;
+
+	PreSimulationCall(saver);
+
+	// Simulate
+TRACE_UP("*** Starting Event Driven Simulation tStart = " << tStart << " tEnd = " << tEnd << " ***")
+	simulateEventDriven();
+TRACE_DOWN("*** Simulation Ended ***")
+
+	if (not PostSimulationCall(saver))
+		returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+
+	return returnVal;
+}
+
+//**********************************************************************
+// Returns true if all links are linear and thresholds positive (cells
+// with null values can then be left out). Cells with neither activation
+// delay nor refractory period would fire again and again at the same
+// time (the solver only lets them fire once per step).
+//**********************************************************************
+bool FireDiffuseModel::canUseEventDriven() const
+{
+	bool exact = true;
+	for (unsigned int i = 0 ; (i < cells.size()) and exact ; ++i)
+	{
+		exact = (cells[i]->thresh > 0) and 
+			((cells[i]->activDelay > 0) or (cells[i]->tauRefr > 0));
+		const std::vector<unsigned int> & neighbs = network->GetNeighbors(i);
+		for (unsigned int j = 0 ; (j < neighbs.size()) and exact ; ++j)
+			exact = (dynamic_cast<const LinearCoupling *>((*network)[i][neighbs[j]]) != 0);
+	}
+	return exact;
+}
+
+//**********************************************************************
+// Between firings the dynamics are linear : dC/dt = A C - s, with A 
+// the degradation and the graph laplacian, and s the stimulation 
+// fluxes, frozen over at most one Step as in the splitting solvers. 
+// The values are advanced exactly (up to eventTol) on the cells that
+// hold non zero values. Activation delays and refractory periods are 
+// timers in a queue. Metrics see the values every eventSampleStep.
+//**********************************************************************
+void FireDiffuseModel::simulateEventDriven()
+{
+	unsigned int nbCells = cells.size();
+
+	// Linear operator
+	outStrengths.assign(nbCells, std::vector<double>());
+	inStrengths.assign(nbCells, std::vector<double>());
+	normA = 0;
+	double minThresh = cells.empty() ? 1.0 : cells[0]->thresh;
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+	{
+		const std::vector<unsigned int> & neighbs = network->GetNeighbors(i);
+		double rowNorm = fabs(cells[i]->degrad);
+		for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+		{
+			const CouplingFunction *back = (*network)[neighbs[j]][i];
+			outStrengths[i].push_back((*network)[i][neighbs[j]]->GetStrength());
+			inStrengths[i].push_back(back ? back->GetStrength() : 0.0);
+			rowNorm += 2.0 * fabs(outStrengths[i].back());
+		}
+		normA = std::max(normA, rowNorm);
+		minThresh = std::min(minThresh, cells[i]->thresh);
+	}
+	valFloor = eventTol * minThresh;
+
+	stateVec.Reset(nbCells);
+	term.Reset(nbCells);
+	nextTerm.Reset(nbCells);
+	subIncr.Reset(nbCells);
+	incr.Reset(nbCells);
+	activeCells.clear();
+	isActive.assign(nbCells, false);
+	fluxCells.clear();
+	isFluxCell.assign(nbCells, false);
+
+	// Pending activations and refractory periods
+	timers.Reset(nbCells);
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+	{
+		cells[i]->totFlux = 0;
+		if (cells[i]->dynVals[FireDiffuseCell::C] != 0)
+			activate(i);
+		if (not cells[i]->willActivate and (cells[i]->dynVals[FireDiffuseCell::C] >= cells[i]->thresh) 
+			and ((tStart - cells[i]->refractTime) > cells[i]->tauRefr))
+		{
+			cells[i]->willActivate = true;
+			cells[i]->actTime = tStart;
+		}
+		if (cells[i]->willActivate)
+			timers.Update(i, cells[i]->actTime + cells[i]->activDelay);
+		else if (cells[i]->refractTime + cells[i]->tauRefr > tStart)
+			timers.Update(i, cells[i]->refractTime + cells[i]->tauRefr);
+	}
+
+	double sampleStep = (eventSampleStep > 0) ? eventSampleStep : integrStep;
+	unsigned long int nbSamples = 0;
+	double tNow = tStart;
+	eventDrivenOn = true;
+	for (double tSample = tStart ; tSample <= tEnd ; 
+		tSample = tStart + (++nbSamples) * sampleStep)
+	{
+		while (tNow < tSample)
+		{
+			prepareInputs(tNow);
+			double tNext = tSample;
+			if (not fluxCells.empty())
+				tNext = std::min(tNext, tNow + integrStep);
+			if (not timers.Empty())
+				tNext = std::min(tNext, std::max(tNow, timers.TopKey()));
+
+			advanceLinear(tNext - tNow);
+			detectCrossings(tNow, tNext);
+			tNow = tNext;
+
+			while ((not timers.Empty()) and (timers.TopKey() <= tNow))
+				processTimer(timers.Top(), timers.TopKey());
+		}
+
+		metricScheduler.SetTime(tSample, sampleStep);
+		UpdateVals(tSample);
+	}
+	eventDrivenOn = false;
+}
+
+//**********************************************************************
+// Stimulation strategies only add fluxes to the cells they stimulate
+//**********************************************************************
+void FireDiffuseModel::prepareInputs(double t)
+{
+	for (unsigned int k = 0 ; k < fluxCells.size() ; ++k)
+	{
+		cells[fluxCells[k]]->totFlux = 0;
+		isFluxCell[fluxCells[k]] = false;
+	}
+	fluxCells.clear();
+	Stimulate(t);
+}
+
+//**********************************************************************
+// C(t + h) = C(t) + h phi1(h A) (A C(t) - s), phi1 is expanded in 
+// Taylor series over substeps such that |h A| <= 1. Each term only 
+// reaches one more neighbor, values below valFloor are only kept on
+// active cells. The series stops once its terms are below valFloor.
+//**********************************************************************
+void FireDiffuseModel::advanceLinear(double h)
+{
+	incr.Clear();
+	if ((h <= 0) or (activeCells.empty() and fluxCells.empty()))
+		return;
+
+	unsigned int nbSub = std::max(1.0, ceil(h * normA));
+	double hs = h / ((double) nbSub);
+	for (unsigned int sub = 0 ; sub < nbSub ; ++sub)
+	{
+		stateVec.Clear();
+		for (unsigned int k = 0 ; k < activeCells.size() ; ++k)
+			stateVec.Add(activeCells[k], cells[activeCells[k]]->dynVals[FireDiffuseCell::C]);
+
+		term.Clear();
+		applyLinearOp(stateVec, term);
+		for (unsigned int k = 0 ; k < fluxCells.size() ; ++k)
+			term.Add(fluxCells[k], - cells[fluxCells[k]]->totFlux);
+		double termMax = term.Scale(hs, valFloor, isActive);
+
+		subIncr.Clear();
+		for (unsigned int n = 1 ; ; ++n)
+		{
+			for (unsigned int k = 0 ; k < term.ind.size() ; ++k)
+				subIncr.Add(term.ind[k], term.v[term.ind[k]]);
+			if (termMax <= valFloor)
+				break;
+			nextTerm.Clear();
+			applyLinearOp(term, nextTerm);
+			termMax = nextTerm.Scale(hs / ((double) n + 1.0), valFloor, isActive);
+			term.Swap(nextTerm);
+		}
+
+		for (unsigned int k = 0 ; k < subIncr.ind.size() ; ++k)
+		{
+			unsigned int i = subIncr.ind[k];
+			cells[i]->dynVals[FireDiffuseCell::C] += subIncr.v[i];
+			incr.Add(i, subIncr.v[i]);
+			activate(i);
+		}
+	}
+
+	// Flush negligible values
+	unsigned int kept = 0;
+	for (unsigned int k = 0 ; k < activeCells.size() ; ++k)
+	{
+		unsigned int i = activeCells[k];
+		if ((fabs(cells[i]->dynVals[FireDiffuseCell::C]) > valFloor) or isFluxCell[i])
+			activeCells[kept++] = i;
+		else
+		{
+			cells[i]->dynVals[FireDiffuseCell::C] = 0;
+			isActive[i] = false;
+		}
+	}
+	activeCells.resize(kept);
+}
+
+//**********************************************************************
+// out += - degrad x - L x
+//**********************************************************************
+void FireDiffuseModel::applyLinearOp(const SparseCellVals & x, SparseCellVals & out) const
+{
+	for (unsigned int k = 0 ; k < x.ind.size() ; ++k)
+	{
+		unsigned int i = x.ind[k];
+		double xi = x.v[i];
+		out.Add(i, - cells[i]->degrad * xi);
+		const std::vector<unsigned int> & neighbs = network->GetNeighbors(i);
+		for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+			if (not IsLinkBlocked(i, neighbs[j]))
+			{
+				out.Add(i, - outStrengths[i][j] * xi);
+				out.Add(neighbs[j], inStrengths[i][j] * xi);
+			}
+	}
+}
+
+//**********************************************************************
+// Cells at zero are below their (positive) threshold, only active 
+// cells are checked. The crossing time is linearly interpolated.
+//**********************************************************************
+void FireDiffuseModel::detectCrossings(double t0, double t1)
+{
+	for (unsigned int k = 0 ; k < incr.ind.size() ; ++k)
+	{
+		unsigned int i = incr.ind[k];
+		FireDiffuseCell & cell = *cells[i];
+		double c1 = cell.dynVals[FireDiffuseCell::C];
+		if (cell.willActivate or (c1 < cell.thresh) or 
+			(timers.GetKey(i) != HUGE_VAL))
+			continue;
+		double c0 = c1 - incr.v[i];
+		double tCross = t0;
+		if (c0 < cell.thresh)
+			tCross += (t1 - t0) * (cell.thresh - c0) / (c1 - c0);
+		cell.willActivate = true;
+		cell.actTime = tCross;
+		timers.Update(i, std::max(t1, tCross + cell.activDelay));
+	}
+}
+
+//**********************************************************************
+// A pending cell fires, a refractory cell that is still above its 
+// threshold starts its activation delay
+//**********************************************************************
+void FireDiffuseModel::processTimer(unsigned int i, double t)
+{
+	FireDiffuseCell & cell = *cells[i];
+	if (cell.willActivate)
+	{
+		cell.refractTime = t;
+		cell.dynVals[FireDiffuseCell::C] = cell.actQuant;
+		cell.willActivate = false;
+		activate(i);
+		timers.Update(i, t + cell.tauRefr);
+	}
+	else if (cell.dynVals[FireDiffuseCell::C] >= cell.thresh)
+	{
+		cell.willActivate = true;
+		cell.actTime = t;
+		timers.Update(i, t + cell.activDelay);
+	}
+	else
+		timers.Update(i, HUGE_VAL);
+}
+
 //**********************************************************************
 // Computes fluxes across cells
 //**********************************************************************
@@ -295,17 +621,62 @@ void FireDiffuseModel::ComputeFluxes(double )
 	{
 		cells[i]->totFlux = 0;
 		for (unsigned int j = 0 ; j < network->GetNeighbors(i).size() ; ++j)
-			cells[i]->totFlux += (*((*network)[i][network->GetNeighbors(i)[j]]))(
+			if (not IsLinkBlocked(i, network->GetNeighbors(i)[j]))
+				cells[i]->totFlux += (*((*network)[i][network->GetNeighbors(i)[j]]))(
 					cells[i]->dynVals[FireDiffuseCell::C] - cells[network->GetNeighbors(i)[j]]->dynVals[FireDiffuseCell::C]);
 	}
 }
 
+//**********************************************************************
+// Only stimulation fluxes are kept in totFlux during split steps
+//**********************************************************************
+bool FireDiffuseModel::PrepareSplitStep(double t)
+{
+	// The coupling integrator doesn't know about blocked gap junctions,
+	// checked before stimulating since the fallback step stimulates too
+	if (HasBlockedLinks())
+		return false;
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
+		cells[i]->totFlux = 0;
+	Stimulate(t);
+	coupling.Reset();
+	return true;
+}
+
+//**********************************************************************
+//**********************************************************************
+void FireDiffuseModel::CompLocalFunc(double t, unsigned int i, const double *v, double *f) const
+{
+	cells[i]->funct->CompFunc(t, v, f);
+}
+
+//**********************************************************************
+//**********************************************************************
+void FireDiffuseModel::IntegrateCoupling(double , double h)
+{
+	coupling.Integrate(*network, vals, GetJacobianBlockSize(), FireDiffuseCell::C, h);
+}
+
+//**********************************************************************
+// totFlux gets the mean diffusion flux over the step
+//**********************************************************************
+void FireDiffuseModel::FinishSplitStep(double , double h)
+{
+	for (unsigned int i = 0 ; i < cells.size() ; ++i)
+		cells[i]->totFlux += coupling.GetOutflow(i) / h;
+}
+
 //**********************************************************************
 // Changes the flux of a cell
 //**********************************************************************
 void FireDiffuseModel::ModifFluxes(unsigned int i, double flux)
 {
 	cells[i]->totFlux += flux;
+	if (eventDrivenOn and not isFluxCell[i])
+	{
+		isFluxCell[i] = true;
+		fluxCells.push_back(i);
+	}
 }
 
 //**********************************************************************
@@ -318,7 +689,8 @@ void FireDiffuseModel::UpdateVals(double t)
 	{
 		ODENetworkDynamicsModel<CouplingFunction, FireDiffuseCell>::UpdateVals(t);
 
-		for (unsigned int i = 0 ; i < cells.size() ; ++i)
+		// Firings are events in event driven mode
+		for (unsigned int i = 0 ; (i < cells.size()) and not eventDrivenOn ; ++i)
 		{
 			if (not cells[i]->willActivate and (cells[i]->dynVals[0] >= cells[i]->thresh) and ((tCurr - cells[i]->refractTime) > cells[i]->tauRefr))
 			{
@@ -442,3 +814,13 @@ double FireDiffuseModel::GetExcDynVal(unsigned int cellNb) const
 	return GetDynVal(cellNb, FireDiffuseCell::C);
 }
 
+//********************************************************************//
+// Position of the excitable values in vals
+//********************************************************************//
+bool FireDiffuseModel::GetExcDynValLayout(unsigned int & offset, unsigned int & stride) const
+{
+	offset = FireDiffuseCell::C;
+	stride = FireDiffuseCell::NbValsPerCell;
+	return true;
+}
+
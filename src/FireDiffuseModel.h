@@ -27,6 +27,7 @@
 #include "MetricComputeStrat.h"
 #include "ChIModelMetrics.h"
 #include "StimulationMetrics.h"
+#include "IndexedHeap.h"
 
 #define FIREDIFFUSEMODEL_NBVALS_PER_CELL 1
 
@@ -44,6 +45,7 @@ namespace AstroModel
 		friend class ODE::FireDiffuseNetFunct;
 		friend class ODE::FireDiffuseCellFunct;
 		friend class FireDiffuseModel;
+		friend struct ODE::FireDiffuseCellKernel;
 
 	public:
 		static std::string ClassName;
@@ -145,6 +147,51 @@ namespace AstroModel
 		double totFlux;  // Total fluxes of messenger from the cell
 	};
 
+/**********************************************************************/
+/* Sparse vector of cell values                                       */
+/**********************************************************************/
+	// Only the cells in ind can hold non zero values
+	struct SparseCellVals
+	{
+		std::vector<double> v;
+		std::vector<unsigned int> ind;
+		std::vector<bool> in;
+
+		void Reset(unsigned int nbCells)
+		{
+			v.assign(nbCells, 0);
+			in.assign(nbCells, false);
+			ind.clear();
+		}
+		inline void Add(unsigned int i, double x)
+		{
+			if (not in[i])
+			{
+				in[i] = true;
+				ind.push_back(i);
+			}
+			v[i] += x;
+		}
+		void Clear()
+		{
+			for (unsigned int k = 0 ; k < ind.size() ; ++k)
+			{
+				v[ind[k]] = 0;
+				in[ind[k]] = false;
+			}
+			ind.clear();
+		}
+		inline void Swap(SparseCellVals & o)
+		{
+			v.swap(o.v);
+			ind.swap(o.ind);
+			in.swap(o.in);
+		}
+		// Multiplies by f and drops the values below floor, except
+		// on the cells to keep. Returns the largest absolute value
+		double Scale(double f, double floor, const std::vector<bool> & keep);
+	};
+
 /**********************************************************************/
 /* Fire Diffuse Model                                                 */
 /**********************************************************************/
@@ -156,6 +203,7 @@ namespace AstroModel
 		// Friend declarations                                       ||
 		//===========================================================||
 		friend class ODE::FireDiffuseNetFunct;
+		friend struct ODE::FireDiffuseCellKernel;
 
 	public:
 		static std::string ClassName;
@@ -182,6 +230,8 @@ namespace AstroModel
 		virtual bool PreSimulationCall(ResultSaver saver);
 		// Method called after solving the ODE problem
 		virtual bool PostSimulationCall(ResultSaver saver);
+		// Launch simulation
+		virtual int Simulate(ResultSaver saver);
 		// Loads the model from a stream
 		virtual bool LoadFromStream(std::ifstream & stream);
 		// Load funct from stream
@@ -194,6 +244,12 @@ namespace AstroModel
 		//===========================================================||
 		// Computes fluxes across cells
 		virtual void ComputeFluxes(double t);
+		// Operator splitting : diffusion is integrated separately from 
+		// degradation, stimulations are frozen during a step
+		virtual bool PrepareSplitStep(double t);
+		virtual void CompLocalFunc(double t, unsigned int i, const double *v, double *f) const;
+		virtual void IntegrateCoupling(double t, double h);
+		virtual void FinishSplitStep(double t, double h);
 
 		//===========================================================||
 		// Setters and callbacks                                     ||
@@ -223,6 +279,8 @@ namespace AstroModel
 		virtual double GetTotalFlux(unsigned int i) const;
 		// Return the dynamic value that constitutes the excitable part of the system
 		virtual double GetExcDynVal(unsigned int cellNb) const;
+		// Position of the excitable values in vals
+		virtual bool GetExcDynValLayout(unsigned int & offset, unsigned int & stride) const;
 
 		// Returns a const ref on the network
 		virtual const AbstractNetwork & GetNetwork() const 
@@ -245,6 +303,9 @@ namespace AstroModel
 		// Is the given cell currently stimulated ?
 		virtual bool IsStimulated(unsigned int ind) const
 			{ return Stimulable::IsStimulated(ind); }
+		// Is the given cell or one of its neighbors currently stimulated ?
+		virtual bool IsStimulatedOrAdjacent(unsigned int ind) const
+			{ return StimulableCellNetwork::IsStimulatedOrAdjacent(ind); }
 
 	protected:
 
@@ -258,6 +319,50 @@ namespace AstroModel
 		// Associated ODE Problem                                    ||
 		//===========================================================||
 		ODE::ODESolver<double, double> * solver;
+		CouplingIntegrator coupling; // Used by splitting solvers
+
+		//===========================================================||
+		// Event driven simulation                                   ||
+		//===========================================================||
+		bool useEventDriven;    // Exact integration between firing events
+		double eventSampleStep; // Period of the metric updates (0 : Step)
+		double eventTol;        // Relative truncation and flush tolerance
+		bool eventDrivenOn;
+		double valFloor;        // Values below it are dropped
+		double normA;           // Infinity norm of the linear operator
+		IndexedHeap timers;     // End of activation delay or refractory period
+		std::vector<std::vector<double> > outStrengths; // Link (i, neighb)
+		std::vector<std::vector<double> > inStrengths;  // Link (neighb, i)
+		std::vector<unsigned int> activeCells; // Cells with non zero C
+		std::vector<bool> isActive;
+		std::vector<unsigned int> fluxCells;   // Stimulated cells
+		std::vector<bool> isFluxCell;
+		SparseCellVals stateVec, term, nextTerm, subIncr, incr;
+
+		// Returns true if all links are linear, thresholds positive and
+		// cells can't fire twice at the same time
+		bool canUseEventDriven() const;
+		// Jumps from event to event instead of using the solver
+		void simulateEventDriven();
+		// Frozen stimulation fluxes for the segment starting at t
+		void prepareInputs(double t);
+		// Exact advance of the linear dynamics over h
+		void advanceLinear(double h);
+		// out += A x (degradation and diffusion)
+		void applyLinearOp(const SparseCellVals & x, SparseCellVals & out) const;
+		// Starts the activation delay of the cells that crossed their
+		// threshold during [t0, t1]
+		void detectCrossings(double t0, double t1);
+		// Firing and end of refractory period of cell i at time t
+		void processTimer(unsigned int i, double t);
+		inline void activate(unsigned int i)
+		{
+			if (not isActive[i])
+			{
+				isActive[i] = true;
+				activeCells.push_back(i);
+			}
+		}
 
 		//===========================================================||
 		// Metrics                                                   ||
@@ -0,0 +1,119 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#include "IndexedHeap.h"
+
+#include <math.h>
+#include <assert.h>
+
+using namespace AstroModel;
+using namespace std;
+
+// Position of the items that are not in the heap
+static const unsigned int NotInHeap = (unsigned int) -1;
+
+//********************************************************************//
+//******************** I N D E X E D   H E A P ***********************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+void IndexedHeap::Reset(unsigned int nbItems)
+{
+	heap.clear();
+	heap.reserve(nbItems);
+	pos.assign(nbItems, NotInHeap);
+	keys.assign(nbItems, HUGE_VAL);
+}
+
+//**********************************************************************
+// The last item takes the place of a removed one and is sifted from 
+// there
+//**********************************************************************
+void IndexedHeap::Update(unsigned int item, double key)
+{
+	assert(item < pos.size());
+	double oldKey = keys[item];
+	keys[item] = key;
+	if (pos[item] == NotInHeap)
+	{
+		if (key == HUGE_VAL)
+			return;
+		heap.push_back(item);
+		pos[item] = heap.size() - 1;
+		siftUp(heap.size() - 1);
+	}
+	else if (key == HUGE_VAL)
+	{
+		unsigned int p = pos[item];
+		unsigned int last = heap.back();
+		heap.pop_back();
+		pos[item] = NotInHeap;
+		if (p < heap.size())
+		{
+			place(last, p);
+			siftUp(p);
+			siftDown(pos[last]);
+		}
+	}
+	else if (key < oldKey)
+		siftUp(pos[item]);
+	else
+		siftDown(pos[item]);
+}
+
+//**********************************************************************
+//**********************************************************************
+void IndexedHeap::place(unsigned int item, unsigned int p)
+{
+	heap[p] = item;
+	pos[item] = p;
+}
+
+//**********************************************************************
+//**********************************************************************
+void IndexedHeap::siftUp(unsigned int p)
+{
+	unsigned int item = heap[p];
+	while (p > 0)
+	{
+		unsigned int parent = (p - 1) / 2;
+		if (not before(item, heap[parent]))
+			break;
+		place(heap[parent], p);
+		p = parent;
+	}
+	place(item, p);
+}
+
+//**********************************************************************
+//**********************************************************************
+void IndexedHeap::siftDown(unsigned int p)
+{
+	unsigned int item = heap[p];
+	unsigned int n = heap.size();
+	while (2 * p + 1 < n)
+	{
+		unsigned int child = 2 * p + 1;
+		if ((child + 1 < n) and before(heap[child + 1], heap[child]))
+			++child;
+		if (not before(heap[child], item))
+			break;
+		place(heap[child], p);
+		p = child;
+	}
+	place(item, p);
+}
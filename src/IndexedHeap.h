@@ -0,0 +1,60 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+
+#ifndef INDEXEDHEAP_H
+#define INDEXEDHEAP_H
+
+#include <vector>
+
+namespace AstroModel
+{
+/**********************************************************************/
+/* Binary min heap of items with updatable keys                       */
+/**********************************************************************/
+	// Items are indices in [0, nbItems[, each one is at most once in the
+	// heap. Its key can be lowered or raised in O(log N). Equal keys are
+	// ordered by item index.
+	class IndexedHeap
+	{
+	public:
+		IndexedHeap() {}
+
+		// Empties the heap, for items in [0, nbItems[
+		void Reset(unsigned int nbItems);
+		// Inserts the item or changes its key, an infinite key removes it
+		void Update(unsigned int item, double key);
+
+		inline bool Empty() const { return heap.empty(); }
+		inline unsigned int Top() const { return heap[0]; }
+		inline double TopKey() const { return keys[heap[0]]; }
+		// Key of the item, infinite if not in the heap
+		inline double GetKey(unsigned int item) const { return keys[item]; }
+
+	protected:
+		std::vector<unsigned int> heap; // Items in heap order
+		std::vector<unsigned int> pos;  // Position of each item in heap
+		std::vector<double> keys;
+
+		inline bool before(unsigned int a, unsigned int b) const
+			{ return (keys[a] < keys[b]) or ((keys[a] == keys[b]) and (a < b)); }
+		void place(unsigned int item, unsigned int p);
+		void siftUp(unsigned int p);
+		void siftDown(unsigned int p);
+	};
+}
+
+#endif
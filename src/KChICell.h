@@ -26,6 +26,7 @@ namespace ODE
 	// Forward declarations
 	class KChICellFunct;
 	class KChINetworkFunct;
+	struct KChICellKernel;
 }
 
 namespace AstroModel
@@ -42,6 +43,7 @@ namespace AstroModel
 		friend class ODE::KChICellFunct;
 		friend class ODE::KChINetworkFunct;
 		friend class KChIModel;
+		friend struct ODE::KChICellKernel;
 
 	public:
 		static std::string ClassName;
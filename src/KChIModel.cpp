@@ -57,6 +57,8 @@ KChIModel::KChIModel(ParamHandler & h) :
 	KBasalPerm(DefaultKBasalPerm)
 {
 	TRACE("*** Initializing KChI Model ***")
+	// K+ fluxes aren't handled by the active set
+	useActiveSet = false;
 	SetUpCellsAndODEs(cells.size());
 }
 
@@ -66,7 +68,7 @@ KChIModel::KChIModel(ParamHandler & h) :
 KChIModel::KChIModel(std::ifstream & stream, ParamHandler & h) : 
 	ChIModel(stream, h)
 {
-
+	useActiveSet = false;
 }
 
 //**********************************************************************
@@ -137,55 +139,118 @@ void KChIModel::ComputeOtherParameters()
 //**********************************************************************
 void KChIModel::ComputeFluxes(double )
 {
-	static double perm;
-	static double v;
 	KChICell *kcell;
 
 	for (unsigned int i = 0 ;  i < network->size() ; ++i)
 	{
 		kcell = dynamic_cast<KChICell *>(cells[i]);
 		assert(kcell);
-		cells[i]->totFlux = 0;
-		cells[i]->caSpontLeak = false;
-		kcell->KFluxIn = 0;
-		kcell->KFluxOut = 0;
+		resetFluxes(i);
 		for (unsigned int j = 0 ; j < network->GetNeighbors(i).size() ; ++j)
-		{
-			// Compute permeability between i and j
-			switch (GJCComp) {
-				case KChIModel::SimpleEq:
-					perm = /*IP3BasalPerm * */ std::min(cells[i]->dynVals[KChICell::Gp], 
-						cells[network->GetNeighbors(i)[j]]->dynVals[KChICell::Gp]) * (alphaP - alphaM) + alphaM;
-					break;
-				case KChIModel::DoubleEq:
-					perm = /*IP3BasalPerm * */ (std::min(
-						cells[i]->dynVals[KChICell::Gp] * (alphaP - 1.0) + 
-						cells[i]->dynVals[KChICell::Gm] * (alphaM - 1.0), 
-						cells[network->GetNeighbors(i)[j]]->dynVals[KChICell::Gp] * (alphaP - 1.0) + 
-						cells[network->GetNeighbors(i)[j]]->dynVals[KChICell::Gm] * (alphaM - 1.0)) + 1.0);
-					break;
-				default:
-					perm = 1.0;
-			}
-			cells[i]->totFlux += Sij / kcell->VolCyt * IP3BasalPerm * perm * 
+			addLinkFluxes(*kcell, i, network->GetNeighbors(i)[j], 
+				IsLinkBlocked(i, network->GetNeighbors(i)[j]) ? 0.0 :
 				(*((*network)[i][network->GetNeighbors(i)[j]]))(cells[i]->dynVals[ChICell::IP3] - 
-				cells[network->GetNeighbors(i)[j]]->dynVals[ChICell::IP3]);
-			
-			if (fabs(cells[i]->dynVals[KChICell::Vm] - 
-				cells[network->GetNeighbors(i)[j]]->dynVals[KChICell::Vm]) > KDiffVoltThr)
-			{
-				v = FoRT * (cells[i]->dynVals[KChICell::Vm] - 
-					cells[network->GetNeighbors(i)[j]]->dynVals[KChICell::Vm]);
-				kcell->KFluxIn += Sij * KBasalPerm * perm * v * 
-					(cells[i]->dynVals[KChICell::Ki] - 
-					 cells[network->GetNeighbors(i)[j]]->dynVals[KChICell::Ki] * gsl_sf_exp(-v)
-					) / (1.0 - gsl_sf_exp(-v));
-			}
-			else
+				cells[network->GetNeighbors(i)[j]]->dynVals[ChICell::IP3]));
+	}
+}
+
+//**********************************************************************
+//**********************************************************************
+void KChIModel::resetFluxes(unsigned int i)
+{
+	KChICell *kcell = static_cast<KChICell *>(cells[i]);
+	cells[i]->totFlux = 0;
+	cells[i]->caSpontLeak = false;
+	kcell->KFluxIn = 0;
+	kcell->KFluxOut = 0;
+}
+
+//**********************************************************************
+//**********************************************************************
+void KChIModel::addLinkFluxes(KChICell & kcell, unsigned int i, unsigned int j, 
+	double couplFlux)
+{
+	double perm = computePermeability(i, j);
+	cells[i]->totFlux += Sij / kcell.VolCyt * IP3BasalPerm * perm * couplFlux;
+
+	if (fabs(cells[i]->dynVals[KChICell::Vm] - cells[j]->dynVals[KChICell::Vm]) > KDiffVoltThr)
+	{
+		double v = FoRT * (cells[i]->dynVals[KChICell::Vm] - cells[j]->dynVals[KChICell::Vm]);
+		kcell.KFluxIn += Sij * KBasalPerm * perm * v * 
+			(cells[i]->dynVals[KChICell::Ki] - cells[j]->dynVals[KChICell::Ki] * gsl_sf_exp(-v)
+			) / (1.0 - gsl_sf_exp(-v));
+	}
+	else
+	{
+		kcell.KFluxIn += Sij * KBasalPerm * perm * (cells[i]->dynVals[KChICell::Ki] - 
+				cells[j]->dynVals[KChICell::Ki]);
+	}
+}
+
+//**********************************************************************
+// Gap junction permeability between i and j
+//**********************************************************************
+double KChIModel::computePermeability(unsigned int i, unsigned int j) const
+{
+	switch (GJCComp) {
+		case KChIModel::SimpleEq:
+			return /*IP3BasalPerm * */ std::min(cells[i]->dynVals[KChICell::Gp], 
+				cells[j]->dynVals[KChICell::Gp]) * (alphaP - alphaM) + alphaM;
+		case KChIModel::DoubleEq:
+			return /*IP3BasalPerm * */ (std::min(
+				cells[i]->dynVals[KChICell::Gp] * (alphaP - 1.0) + 
+				cells[i]->dynVals[KChICell::Gm] * (alphaM - 1.0), 
+				cells[j]->dynVals[KChICell::Gp] * (alphaP - 1.0) + 
+				cells[j]->dynVals[KChICell::Gm] * (alphaM - 1.0)) + 1.0);
+		default:
+			return 1.0;
+	}
+}
+
+//**********************************************************************
+// Derivatives of IP3 and K+ intercellular fluxes with respect to IP3 
+// and Ki. Permeabilities and voltages are considered constant during 
+// the step (the solver only needs an approximate jacobian).
+//**********************************************************************
+void KChIModel::addCouplingJacobian(ODE::SparseMatrix<double> & jac) const
+{
+	unsigned int bs = GetJacobianBlockSize();
+	for (unsigned int i = 0 ;  i < network->size() ; ++i)
+	{
+		const KChICell *kcell = dynamic_cast<const KChICell *>(cells[i]);
+		assert(kcell);
+		unsigned int rowIP3 = i * bs + KChICell::IP3;
+		unsigned int rowKi  = i * bs + KChICell::Ki;
+		unsigned int rowVm  = i * bs + KChICell::Vm;
+		const std::vector<unsigned int> & neighbs = network->GetNeighbors(i);
+		for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+		{
+			const ChICell & other = *cells[neighbs[j]];
+			double perm = computePermeability(i, neighbs[j]);
+
+			// IP3 flux
+			double dFlux = IsLinkBlocked(i, neighbs[j]) ? 0.0 : 
+				Sij / kcell->VolCyt * IP3BasalPerm * perm * 
+				(*network)[i][neighbs[j]]->Derivative(cells[i]->dynVals[ChICell::IP3] - 
+				other.dynVals[ChICell::IP3]);
+			jac.values[jac.Find(rowIP3, rowIP3)] -= dFlux;
+			jac.values[jac.Find(rowIP3, neighbs[j] * bs + KChICell::IP3)] += dFlux;
+
+			// K+ flux (KFluxIn enters the Ki and Vm equations)
+			double dKi = Sij * KBasalPerm * perm;
+			double dKj = dKi;
+			if (fabs(cells[i]->dynVals[KChICell::Vm] - other.dynVals[KChICell::Vm]) > KDiffVoltThr)
 			{
-				kcell->KFluxIn += Sij * KBasalPerm * perm * (cells[i]->dynVals[KChICell::Ki] - 
-						cells[network->GetNeighbors(i)[j]]->dynVals[KChICell::Ki]);
+				double v = FoRT * (cells[i]->dynVals[KChICell::Vm] - other.dynVals[KChICell::Vm]);
+				dKi *= v / (1.0 - gsl_sf_exp(-v));
+				dKj *= v * gsl_sf_exp(-v) / (1.0 - gsl_sf_exp(-v));
 			}
+			unsigned int colKi = rowKi;
+			unsigned int colKj = neighbs[j] * bs + KChICell::Ki;
+			jac.values[jac.Find(rowKi, colKi)] -= dKi / kcell->VolCyt;
+			jac.values[jac.Find(rowKi, colKj)] += dKj / kcell->VolCyt;
+			jac.values[jac.Find(rowVm, colKi)] -= GSL_CONST_MKSA_FARADAY * dKi / kcell->Cap;
+			jac.values[jac.Find(rowVm, colKj)] += GSL_CONST_MKSA_FARADAY * dKj / kcell->Cap;
 		}
 	}
 }
@@ -319,3 +384,13 @@ unsigned int KChIModel::GetTotNbDynVals() const
 	return cells.size() * KCHIMODEL_NBVALS_PER_CELL;
 }
 
+//********************************************************************//
+// Position of the excitable values in vals
+//********************************************************************//
+bool KChIModel::GetExcDynValLayout(unsigned int & offset, unsigned int & stride) const
+{
+	offset = ChICell::Ca;
+	stride = KCHIMODEL_NBVALS_PER_CELL;
+	return true;
+}
+
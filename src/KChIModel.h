@@ -24,10 +24,13 @@ namespace ODE
 	// Forward declarations
 	class KChICellFunct;
 	class KChINetworkFunct;
+	struct KChICellKernel;
 }
 
 namespace AstroModel
 {
+	// Forward declarations
+	class KChICell;
 
 // Do not use this in simulation, model not correctly calibrated yet
 /**********************************************************************/
@@ -41,6 +44,7 @@ namespace AstroModel
 		friend class ODE::KChICellFunct;
 		friend class ODE::KChINetworkFunct;
 		friend class KChICell;
+		friend struct ODE::KChICellKernel;
 
 	public:
 		static std::string ClassName;
@@ -81,6 +85,8 @@ namespace AstroModel
 		//===========================================================||
 		// Computes fluxes across cells
 		virtual void ComputeFluxes(double t);
+		// K+ fluxes aren't handled by the coupling integrator
+		virtual bool PrepareSplitStep(double ) { return false; }
 
 		//===========================================================||
 		// Setters and callbacks                                     ||
@@ -103,6 +109,8 @@ namespace AstroModel
 		// Gives the total number of desired dyn vals (not equivalent to GetNbVals
 		// from OPEProblem<double, double>
 		virtual unsigned int GetTotNbDynVals() const;
+		// Position of the excitable values in vals
+		virtual bool GetExcDynValLayout(unsigned int & offset, unsigned int & stride) const;
 
 	protected:
 		static double DefaultSij;
@@ -123,6 +131,17 @@ namespace AstroModel
 
 		virtual double getModelVersionNum() const { return 4.2; }
 
+		// Gap junction permeability between i and j
+		double computePermeability(unsigned int i, unsigned int j) const;
+		// Clears the intercellular fluxes of cell i
+		void resetFluxes(unsigned int i);
+		// Adds the IP3 and K+ fluxes from cell i to cell j, given the
+		// value of the coupling function between them
+		void addLinkFluxes(KChICell & kcell, unsigned int i, unsigned int j, 
+			double couplFlux);
+		// Adds the derivatives of the intercellular fluxes to jac
+		virtual void addCouplingJacobian(ODE::SparseMatrix<double> & jac) const;
+
 		//===========================================================||
 		// Network parameters                                        ||
 		//===========================================================||
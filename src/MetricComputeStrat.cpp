@@ -18,6 +18,9 @@
 #include "AbstractFactory.h"
 #include "utility.h"
 
+#include <math.h>
+#include <limits.h>
+
 using namespace AstroModel;
 using namespace std;
 
@@ -102,3 +105,123 @@ std::string Metric::ModifStatName(std::string str) const
 	return optStatParamAddName + str;
 }
 
+
+//********************************************************************//
+//******************* M E T R I C   S C H E D U L E R ****************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+MetricScheduler::MetricScheduler() : step(0), run(0), lastTime(0), 
+	integrStep(1), timeSet(false)
+{
+	for (unsigned int i = 0 ; i < NbMetricEvents ; ++i)
+		eventCounts[i] = 0;
+}
+
+//**********************************************************************
+//**********************************************************************
+void MetricScheduler::SetTime(double t, double _integrStep)
+{
+	integrStep = _integrStep;
+	if (not timeSet)
+		timeSet = true;
+	else if (t < lastTime)
+	{
+		step = 0;
+		++run;
+	}
+	else if (t > lastTime)
+		++step;
+	lastTime = t;
+}
+
+//**********************************************************************
+//**********************************************************************
+void MetricScheduler::RaiseEvents(unsigned int events)
+{
+	for (unsigned int i = 0 ; (i < NbMetricEvents) and events ; ++i, events >>= 1)
+		if (events & 1)
+			++eventCounts[i];
+}
+
+//**********************************************************************
+//**********************************************************************
+unsigned long int MetricScheduler::GetEventCount(unsigned int events) const
+{
+	unsigned long int count = 0;
+	for (unsigned int i = 0 ; (i < NbMetricEvents) and events ; ++i, events >>= 1)
+		if (events & 1)
+			count += eventCounts[i];
+	return count;
+}
+
+//**********************************************************************
+//**********************************************************************
+unsigned long int MetricScheduler::GetStepPeriod(double period) const
+{
+	return std::max(1l, (long int) floor(period / integrStep + 0.5));
+}
+
+//********************************************************************//
+//********** N E E D   F R E Q U E N T   U P D A T E   M E T R I C ***//
+//********************************************************************//
+
+//**********************************************************************
+// Returns true if the period is elapsed or if a trigger event was
+// raised since the last computation
+//**********************************************************************
+bool NeedFrequentUpdateMetric::IsDue(const MetricScheduler & sched)
+{
+	if (updatePeriod < 0)
+		return true;
+
+	if (sched.GetRun() != run)
+	{
+		run = sched.GetRun();
+		nextStep = 0;
+	}
+	unsigned long int evCount = sched.GetEventCount(eventTriggers);
+	if (sched.GetStep() >= nextStep)
+	{
+		nextStep = (updatePeriod > 0) ? 
+			sched.GetStep() + sched.GetStepPeriod(updatePeriod) : ULONG_MAX;
+		eventsSeen = evCount;
+		return true;
+	}
+	if (evCount != eventsSeen)
+	{
+		eventsSeen = evCount;
+		return true;
+	}
+	return false;
+}
+
+//**********************************************************************
+//**********************************************************************
+bool NeedFrequentUpdateMetric::WillBeDue(const MetricScheduler & sched) const
+{
+	if (updatePeriod < 0)
+		return true;
+	if (sched.GetRun() != run)
+		return true;
+	return (sched.GetStep() >= nextStep) or 
+		(sched.GetEventCount(eventTriggers) != eventsSeen);
+}
+
+//**********************************************************************
+//**********************************************************************
+unsigned int NeedFrequentUpdateMetric::PullRaisedEvents()
+{
+	unsigned int tmp = raisedEvents;
+	raisedEvents = NoMetricEvent;
+	return tmp;
+}
+
+//**********************************************************************
+//**********************************************************************
+void NeedFrequentUpdateMetric::ResetSchedule()
+{
+	nextStep = 0;
+	raisedEvents = NoMetricEvent;
+}
@@ -52,6 +52,12 @@ namespace AstroModel
 			savedFilePaths.clear();
 			return temp; 
 		}
+		// Takes over the saved file paths of another metric
+		virtual void PullSavedFilePathsFrom(Metric & other)
+		{
+			std::vector<std::pair<std::string, std::string> > temp = other.PullSavedFilePaths();
+			savedFilePaths.insert(savedFilePaths.end(), temp.begin(), temp.end());
+		}
 		virtual void Initialize() { }
 		virtual Metric * BuildCopy() const = 0;
 		virtual ParamHandler BuildModelParamHandler();
@@ -73,10 +79,82 @@ namespace AstroModel
 		virtual bool HasFileBeenSaved(std::string fileName) const;
 	};
 
+/**********************************************************************/
+/* Events that can trigger frequently updated metrics                 */
+/**********************************************************************/
+	enum MetricEvent
+	{
+		NoMetricEvent       = 0,
+		CellActivationEvent = 1 << 0, // At least one cell is above threshold
+		NbMetricEvents      = 1
+	};
+
+/**********************************************************************/
+/* Integration step counter shared by the metrics of a model          */
+/**********************************************************************/
+	class MetricScheduler
+	{
+	public:
+		MetricScheduler();
+
+		// Notifies the scheduler that values were computed for time t.
+		// Calls with the same time belong to the same step, a decreasing
+		// time starts a new run.
+		void SetTime(double t, double _integrStep);
+		void RaiseEvents(unsigned int events);
+
+		inline unsigned long int GetStep() const { return step; }
+		inline unsigned int GetRun() const { return run; }
+		// Total number of events of the given types raised so far
+		unsigned long int GetEventCount(unsigned int events) const;
+		// Number of steps corresponding to the given time period
+		unsigned long int GetStepPeriod(double period) const;
+
+	protected:
+		unsigned long int step;
+		unsigned int run;
+		double lastTime;
+		double integrStep;
+		bool timeSet;
+		unsigned long int eventCounts[NbMetricEvents];
+	};
+
 /**********************************************************************/
 /* Empty classes for multiple inheritance                             */
 /**********************************************************************/
-	class NeedFrequentUpdateMetric {};
+	// Metric computed during the simulation. By default it is computed
+	// each time the model is updated, a period and trigger events can be
+	// declared so that it is only computed when needed.
+	class NeedFrequentUpdateMetric
+	{
+	public:
+		NeedFrequentUpdateMetric() : updatePeriod(-1), 
+			eventTriggers(NoMetricEvent), raisedEvents(NoMetricEvent),
+			nextStep(0), eventsSeen(0), run(0) {}
+		virtual ~NeedFrequentUpdateMetric() {}
+
+		// Returns true if the metric has to be computed at the current step
+		bool IsDue(const MetricScheduler & sched);
+		// Same as IsDue, without updating the schedule
+		bool WillBeDue(const MetricScheduler & sched) const;
+		// Returns and clears the events raised during the last computation
+		unsigned int PullRaisedEvents();
+		void ResetSchedule();
+
+	protected:
+		double updatePeriod;        // < 0 : each update, 0 : events only
+		unsigned int eventTriggers; // MetricEvent flags
+		unsigned int raisedEvents;
+
+		inline void SetUpdatePeriod(double _p) { updatePeriod = _p; }
+		inline void SetEventTriggers(unsigned int _e) { eventTriggers = _e; }
+		inline void RaiseEvents(unsigned int _e) { raisedEvents |= _e; }
+
+	private:
+		unsigned long int nextStep;
+		unsigned long int eventsSeen;
+		unsigned int run;
+	};
 	class StaticMetric {};
 	class AfterSimMetric {};
 	class DynMetric : public NeedFrequentUpdateMetric {};
@@ -100,6 +178,7 @@ namespace AstroModel
 	class SortedMetrics : public std::vector<std::pair<SpecificMetric<ObjectT> *, bool> >, SaveAndLoadFromStream
 	{
 	public:
+		SortedMetrics() : scheduler(0) {}
 		// Destructor
 		virtual ~SortedMetrics()
 		{
@@ -167,23 +246,57 @@ TRACE(_m->GetClassName() << " successfully added to " << caller->GetClassName())
 		inline bool ComputeMetricsDefault(const ObjectT & caller) const
 		{ return ComputeMetrics<SpecificMetric<ObjectT> >(caller); }
 
+		// Sets the scheduler used to skip frequently updated metrics that
+		// are not due (no scheduling if null)
+		inline void SetScheduler(MetricScheduler *_s) { scheduler = _s; }
+
 		// Compute all metrics of given type
 		template <typename MetrType>
 		bool ComputeMetrics(const ObjectT & caller) const
 		{
 			MetrType *ptr = 0;
+			NeedFrequentUpdateMetric *freqPtr = 0;
 			bool ok = true;
 			for (typename std::vector<std::pair<SpecificMetric<ObjectT> *, bool> >::const_iterator it = this->begin() ; 
 					(it != this->end()) ; ++it)
 			{
 				if ((ptr = dynamic_cast<MetrType *>(it->first)))
 				{
-					ok &= it->first->ComputeMetric(caller);
+					if (scheduler and (freqPtr = dynamic_cast<NeedFrequentUpdateMetric *>(it->first)))
+					{
+						if (freqPtr->IsDue(*scheduler))
+						{
+							ok &= it->first->ComputeMetric(caller);
+							scheduler->RaiseEvents(freqPtr->PullRaisedEvents());
+						}
+					}
+					else
+						ok &= it->first->ComputeMetric(caller);
 				}
 			}
 			return ok;
 		}
 
+		// Returns true if a metric of given type would be computed by
+		// ComputeMetrics at the current step
+		template <typename MetrType>
+		bool AnyDue() const
+		{
+			NeedFrequentUpdateMetric *freqPtr = 0;
+			for (typename std::vector<std::pair<SpecificMetric<ObjectT> *, bool> >::const_iterator it = this->begin() ; 
+					(it != this->end()) ; ++it)
+			{
+				if (dynamic_cast<MetrType *>(it->first))
+				{
+					if (not scheduler or 
+						not (freqPtr = dynamic_cast<NeedFrequentUpdateMetric *>(it->first)) or
+						freqPtr->WillBeDue(*scheduler))
+						return true;
+				}
+			}
+			return false;
+		}
+
 		bool SaveMetricsDefault(ResultSaver saver) const
 		{ return SaveMetrics<SpecificMetric<ObjectT> >(saver); }
 
@@ -212,11 +325,16 @@ TRACE(_m->GetClassName() << " successfully added to " << caller->GetClassName())
 		void InitializeMetrics() const
 		{
 			MetrType *ptr = 0;
+			NeedFrequentUpdateMetric *freqPtr = 0;
 			for (typename std::vector<std::pair<SpecificMetric<ObjectT> *, bool> >::const_iterator it = this->begin() ; 
 					(it != this->end()) ; ++it)
 			{
 				if ((ptr = dynamic_cast<MetrType *>(it->first)))
+				{
 					ptr->Initialize();
+					if ((freqPtr = dynamic_cast<NeedFrequentUpdateMetric *>(it->first)))
+						freqPtr->ResetSchedule();
+				}
 			}
 		}
 
@@ -307,6 +425,7 @@ TRACE(metrName)
 
 	protected:
 		std::vector<Metric*> metricsRaw;
+		MetricScheduler *scheduler;
 	};
 }
 
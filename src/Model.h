@@ -115,6 +115,54 @@ namespace AstroModel
 		ParamHandler & param;
 	};
 
+/**********************************************************************/
+/* Model replicas                                                     */
+/**********************************************************************/
+	// Copies the parameters of src that differ in dst (grid searches 
+	// change them after the model creation)
+	template <typename ModelType> 
+	void SyncModelParams(ModelType & src, ModelType & dst)
+	{
+		ParamHandler srcParams = src.BuildModelParamHandler();
+		ParamHandler dstParams = dst.BuildModelParamHandler();
+		std::vector<std::string> names = srcParams.GetParamNames();
+		for (unsigned int i = 0 ; i < names.size() ; ++i)
+			for (unsigned int ind = 0 ; ind < srcParams.GetNbParamsForName(names[i]) ; ++ind)
+			{
+				std::string val = srcParams.getStringParam(names[i], ind);
+				if (val != dstParams.getStringParam(names[i], ind))
+					dstParams.SetVal(names[i], val.c_str(), ind);
+			}
+	}
+
+	// Builds a model with the same parameters and metrics as model
+	template <typename ModelType> 
+	ModelType * CreateReplica(ModelType & model, ParamHandler & h)
+	{
+		ModelType *replica;
+		if (h.getParam<bool>("-modelLoad"))
+		{
+			std::ifstream loadStream(h.getParam<std::string>("-modelLoad", 1).c_str());
+			replica = new ModelType(loadStream, h);
+		}
+		else
+			replica = new ModelType(h);
+
+		SyncModelParams(model, *replica);
+
+		std::vector<Metric *> modelMetrics = model.GetAllMetrics();
+		for (unsigned int i = 0 ; i < modelMetrics.size() ; ++i)
+		{
+			std::vector<Metric *> replicaMetrics = replica->GetAllMetrics();
+			bool found = false;
+			for (unsigned int j = 0 ; (j < replicaMetrics.size()) and not found ; ++j)
+				found = (replicaMetrics[j]->GetClassName() == modelMetrics[i]->GetClassName());
+			if (not found)
+				replica->AddMetric(modelMetrics[i]->BuildCopy(), true);
+		}
+		return replica;
+	}
+
 /**********************************************************************/
 /* Network dynamics model                                             */
 /**********************************************************************/
@@ -259,7 +307,10 @@ namespace AstroModel
 	{
 	public:
 		AbstractODENetDynProblem(ParamHandler & h = ParamHandler::GlobalParams) :
-			ODE::ODEProblem<double, double>::ODEProblem(0, h) {}
+			ODE::ODEProblem<double, double>::ODEProblem(0, h) 
+		{
+			metrics.SetScheduler(&metricScheduler);
+		}
 
 		// Initializes the model
 		virtual void Initialize(ResultSaver saver = ResultSaver::NullSaver)
@@ -334,8 +385,21 @@ namespace AstroModel
 		virtual double GetTotalFlux(unsigned int i) const = 0;
 		// Return the dynamic value that constitutes the excitable part of the system
 		virtual double GetExcDynVal(unsigned int cellNb) const = 0;
+		// Position of the excitable values in vals (cell i is at 
+		// vals[offset + i * stride]), returns false if unknown
+		virtual bool GetExcDynValLayout(unsigned int & , unsigned int & ) const
+			{ return false; }
 		// Is the given cell currently stimulated ?
 		virtual bool IsStimulated(unsigned int ind) const = 0;
+		// Is the given cell or one of its neighbors currently stimulated ?
+		virtual bool IsStimulatedOrAdjacent(unsigned int ind) const
+		{
+			bool isStim = IsStimulated(ind);
+			const std::vector<unsigned int> & neighbs = GetNeighbors(ind);
+			for (unsigned int j = 0 ; (not isStim) and (j < neighbs.size()) ; ++j)
+				isStim = IsStimulated(neighbs[j]);
+			return isStim;
+		}
 		// Returns all metrics and submetrics
 		virtual std::vector<Metric *> GetAllMetrics() const
 		{
@@ -384,11 +448,13 @@ namespace AstroModel
 
 			// Initialize ODEProblem
 			SetUpCellsAndODEs(nbCells);
+			metrics.SetScheduler(&(this->metricScheduler));
 		}
 		// Constructor from stream
 		ODENetworkDynamicsModel(std::ifstream & stream, ParamHandler & h = ParamHandler::GlobalParams) :
 			NetworkDynamicsModel<NetworkEdges>::NetworkDynamicsModel(h), AbstractODENetDynProblem(h)//ODE::ODEProblem<double, double>(h)
 		{
+			metrics.SetScheduler(&(this->metricScheduler));
 			//if (not this->LoadFromStream(stream))
 			if (not ODENetworkDynamicsModel<NetworkEdges, NodeType>::LoadFromStream(stream))
 				std::cerr << "Failed to load the model !" << std::endl;
@@ -642,6 +708,29 @@ namespace AstroModel
 		// Returns the neighbors of cell i
 		virtual const std::vector<unsigned int> & GetNeighbors(unsigned int i) const
 			{ return NetworkDynamicsModel<NetworkEdges>::GetNeighbors(i); }
+		// Each cell only depends on its own values and on the ones of its
+		// neighbors (dense block per cell)
+		virtual bool GetJacobianPattern(std::vector<std::vector<unsigned int> > & pattern) const
+		{
+			unsigned int bs = GetJacobianBlockSize();
+			pattern.assign(this->nbVals, std::vector<unsigned int>());
+			for (unsigned int i = 0 ; i < cells.size() ; ++i)
+			{
+				std::vector<unsigned int> blockCells(GetNeighbors(i));
+				blockCells.push_back(i);
+				std::sort(blockCells.begin(), blockCells.end());
+				std::vector<unsigned int> cols;
+				for (unsigned int k = 0 ; k < blockCells.size() ; ++k)
+					for (unsigned int j = 0 ; j < bs ; ++j)
+						cols.push_back(blockCells[k] * bs + j);
+				for (unsigned int j = 0 ; j < bs ; ++j)
+					pattern[i * bs + j] = cols;
+			}
+			return not cells.empty();
+		}
+		// Values of a cell are contiguous
+		virtual unsigned int GetJacobianBlockSize() const
+			{ return cells.empty() ? 1 : this->nbVals / cells.size(); }
 
 	protected:
 		// Cells
@@ -99,7 +99,7 @@ bool DegreeDistrComp::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(degreeDistrName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(degreeDistrName, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < degrees.size() ; ++i)
@@ -109,7 +109,7 @@ bool DegreeDistrComp::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(strengthsDistrName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(strengthsDistrName, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < totLinkStrengths.size() ; ++i)
@@ -119,7 +119,7 @@ bool DegreeDistrComp::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(degreeDistrStatsName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(degreeDistrStatsName, saver.getCurrFile());
 
 		stream << "MeanDegree\tStdDevDegree\t"
@@ -286,7 +286,7 @@ bool ClusteringCoeffs::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(clustCoeffDistrName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(clustCoeffDistrName, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < clustCoeffs.size() ; ++i)
@@ -296,7 +296,7 @@ bool ClusteringCoeffs::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(hierarchClustCoeffName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(hierarchClustCoeffName, saver.getCurrFile());
 
 		stream << "Start\tEnd\tHierarchClustCoeff" << endl;
@@ -434,7 +434,7 @@ bool AllPairDistances::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(fullAllPairDistName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(fullAllPairDistName, saver.getCurrFile());
 
 		SaveFullMatrix(stream, distances);
@@ -443,7 +443,7 @@ bool AllPairDistances::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(pathLengthInfosName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(pathLengthInfosName, saver.getCurrFile());
 
 		stream << "AvgPathLength\tStdDevPathLength\tRatioUnconnected" << std::endl;
@@ -543,7 +543,7 @@ bool AdjMatrixComp::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(fulladjacencyMatrixName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(fulladjacencyMatrixName, saver.getCurrFile());
 
 		SaveFullMatrix(stream, adjMat);
@@ -553,7 +553,7 @@ bool AdjMatrixComp::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(sparseAdjacencyMatrixname))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(sparseAdjacencyMatrixname, saver.getCurrFile());
 
 		SaveSparseMatrix(stream, adjMat);
@@ -666,7 +666,7 @@ bool PositionsComp::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(positionsName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(positionsName, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < positions.size() ; ++i)
@@ -682,7 +682,7 @@ bool PositionsComp::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(cellToCellDistName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(cellToCellDistName, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < distances.size() ; ++i)
@@ -1059,7 +1059,7 @@ bool NetworkDimensions::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(networkDimensionsName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(networkDimensionsName, saver.getCurrFile());
 
 		stream << "rStart\trEnd\tstdDim\tstdDevStdDim\tstdPrefact\tstdDevStdPrefact\t"
@@ -1088,7 +1088,7 @@ bool NetworkDimensions::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(netDimFullDataName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(netDimFullDataName, saver.getCurrFile());
 
 		stream << "r\tNbNodes\tNbIntra\tNbOut\tShellNodes\tShellIntra\tShellOut\tNbPoints\tNbNodesPrev\tNbIntraPrev\tNbOutPrev\t" << std::endl;
@@ -1121,7 +1121,7 @@ bool NetworkDimensions::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(netDimFinalValuesName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(netDimFinalValuesName, saver.getCurrFile());
 
 		stream << "d\tC\tdprime\tE\tF\tD\tad\tbd\taL\tbL\taC\tbC\tzetaEst\t" << std::endl;
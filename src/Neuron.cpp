@@ -18,6 +18,10 @@
 #include "Synapse.h"
 #include "NeuronNetModels.h"
 
+#include <math.h>
+#include <algorithm>
+#include <gsl/gsl_sf_exp.h>
+
 using namespace AstroModel;
 using namespace std;
 
@@ -106,6 +110,19 @@ const NeuronNetModel * Neuron::GetModel() const
 	return model;
 }
 
+//**********************************************************************
+// Queued spikes are delivered after their axonal delay
+//**********************************************************************
+void Neuron::sendSpike(double t)
+{
+	SpikeQueue *queue = model ? model->GetSpikeQueue() : 0;
+	for (unsigned int i = 0 ; i < axonSyn.size() ; ++i)
+		if (queue)
+			queue->Push(t + axonSyn[i]->GetDelay(), axonSyn[i]->GetIndex());
+		else
+			axonSyn[i]->PresynSpike(t);
+}
+
 //********************************************************************//
 //******* D U M M Y   N E U R O N   ( S P I K E   T R A I N ) ********//
 //********************************************************************//
@@ -219,9 +236,36 @@ void DummyNeuron::SetValNamesPostfix(std::string pf)
 void DummyNeuron::ForceSpiking(double t)
 {
 	dynVals[0] = 0;
-	// For each axonal synapse
-	for (unsigned int i = 0 ; i < axonSyn.size() ; ++i)
-		axonSyn[i]->PresynSpike(t);
+	sendSpike(t);
+}
+
+//**********************************************************************
+// The depolarized state only lasts until the next update
+//**********************************************************************
+void DummyNeuron::AdvanceExactly(double dt)
+{
+	if (dt > 0)
+		dynVals[V] = -1.0;
+}
+
+//**********************************************************************
+//**********************************************************************
+bool DummyNeuron::GetNextSpikeTime(double t, double tMax, double & tSpike) const
+{
+	if ((nextSpike < spikingTimes.size()) and (spikingTimes[nextSpike] <= tMax))
+	{
+		tSpike = std::max(t, spikingTimes[nextSpike]);
+		return true;
+	}
+	return false;
+}
+
+//**********************************************************************
+//**********************************************************************
+void DummyNeuron::SpikeEvent(double )
+{
+	ForceSpiking(spikingTimes[nextSpike]);
+	++nextSpike;
 }
 
 //**********************************************************************
@@ -411,9 +455,93 @@ void SFALIFNeuron::ForceSpiking(double t)
 {
 	dynVals[V] = Vr;
 	dynVals[w] += b;
-	// For each axonal synapse
-	for (unsigned int i = 0 ; i < axonSyn.size() ; ++i)
-		axonSyn[i]->PresynSpike(t);
+	sendSpike(t);
+}
+
+//**********************************************************************
+// Between spikes, with a = gL / C and k = 1 / tauw :
+//   w(t) = w0 exp(-k t)
+//   V(t) = Vinf + A exp(-k t) + (V0 - Vinf - A) exp(-a t)
+// with Vinf = E0 + I / gL and A = - w0 / (C (a - k))
+//**********************************************************************
+double SFALIFNeuron::exactV(double V0, double w0, double dt) const
+{
+	double a = gL / C;
+	double k = 1.0 / tauw;
+	double Vinf = E0 + inputCurr / gL;
+
+	if (a == k)
+		return Vinf + (V0 - Vinf - w0 / C * dt) * gsl_sf_exp(-a * dt);
+
+	double A = - w0 / (C * (a - k));
+	return Vinf + A * gsl_sf_exp(-k * dt) + (V0 - Vinf - A) * gsl_sf_exp(-a * dt);
+}
+
+//**********************************************************************
+//**********************************************************************
+void SFALIFNeuron::AdvanceExactly(double dt)
+{
+	dynVals[V] = exactV(dynVals[V], dynVals[w], dt);
+	dynVals[w] = dynVals[w] * gsl_sf_exp(-dt / tauw);
+}
+
+//**********************************************************************
+// V(t) has at most one extremum, the interval on which V is monotonic
+// and crosses Vt is bisected down to the time resolution
+//**********************************************************************
+bool SFALIFNeuron::GetNextSpikeTime(double t, double tMax, double & tSpike) const
+{
+	const double & V0 = dynVals[V];
+	const double & w0 = dynVals[w];
+
+	if (V0 >= Vt)
+	{
+		tSpike = t;
+		return true;
+	}
+	if (tMax <= t)
+		return false;
+
+	double a = gL / C;
+	double k = 1.0 / tauw;
+	double Vinf = E0 + inputCurr / gL;
+
+	// Extremum of V
+	double tExtr = -1;
+	if ((a != k) and (w0 != 0))
+	{
+		double A = - w0 / (C * (a - k));
+		double ratio = - a * (V0 - Vinf - A) / (k * A);
+		if (ratio > 0)
+			tExtr = log(ratio) / (a - k);
+	}
+	else if (w0 != 0)
+		tExtr = (V0 - Vinf) * C / w0 + 1.0 / a;
+
+	double lo = 0;
+	double hi = tMax - t;
+	if ((tExtr > 0) and (tExtr < hi))
+	{
+		if (exactV(V0, w0, tExtr) >= Vt)
+			hi = tExtr;
+		else
+			lo = tExtr;
+	}
+	if (exactV(V0, w0, hi) < Vt)
+		return false;
+
+	for (unsigned int i = 0 ; (i < 200) and (t + lo < t + hi) ; ++i)
+	{
+		double mid = 0.5 * (lo + hi);
+		if ((mid <= lo) or (mid >= hi))
+			break;
+		if (exactV(V0, w0, mid) >= Vt)
+			hi = mid;
+		else
+			lo = mid;
+	}
+	tSpike = t + hi;
+	return true;
 }
 
 //**********************************************************************
@@ -61,6 +61,20 @@ namespace AstroModel
 
 		virtual void ForceSpiking(double t) = 0;
 
+		//===========================================================||
+		// Event driven simulation                                   ||
+		//===========================================================||
+		// Returns true if the dynamics can be solved exactly between
+		// spikes
+		virtual bool HasExactSolution() const { return false; }
+		// Advances the dynamical values by dt, no spike can occur
+		virtual void AdvanceExactly(double ) {}
+		// Gives the time of the next spike if it happens before tMax
+		virtual bool GetNextSpikeTime(double , double , double & ) const
+			{ return false; }
+		// Emits the spike found by GetNextSpikeTime
+		virtual void SpikeEvent(double t) { ForceSpiking(t); }
+
 		//===========================================================||
 		// Special model parameters handling method                  ||
 		//===========================================================||
@@ -77,6 +91,8 @@ namespace AstroModel
 		virtual void AddAxonSyn(Synapse *_s);
 		virtual void ClearSynapses();
 		virtual const NeuronNetModel * GetModel() const;
+		inline const std::vector<Synapse *> & GetAxonSynapses() const
+			{ return axonSyn; }
 
 	protected:
 		//===========================================================||
@@ -89,6 +105,10 @@ namespace AstroModel
 		std::vector<Synapse *> dendrSyn;
 		// Pointers to synapses formed by the axon
 		std::vector<Synapse *> axonSyn;
+
+		// Sends a spike to the axonal synapses (through the model spike
+		// queue if there is one)
+		void sendSpike(double t);
 	};
 
 /**********************************************************************/
@@ -140,6 +160,16 @@ namespace AstroModel
 		// Forces the neuron into emitting a spike, regardless of its state
 		virtual void ForceSpiking(double t);
 
+		//===========================================================||
+		// Event driven simulation                                   ||
+		//===========================================================||
+		virtual bool HasExactSolution() const { return true; }
+		// Gets the neuron back to polarized state
+		virtual void AdvanceExactly(double dt);
+		// Next spike of the spike train
+		virtual bool GetNextSpikeTime(double t, double tMax, double & tSpike) const;
+		virtual void SpikeEvent(double t);
+
 		//===========================================================||
 		// Standard Save and Load methods                            ||
 		//===========================================================||
@@ -231,6 +261,15 @@ namespace AstroModel
 		// Forces the neuron into emitting a spike, regardless of its state
 		virtual void ForceSpiking(double t);
 
+		//===========================================================||
+		// Event driven simulation                                   ||
+		//===========================================================||
+		// V and w are linear between spikes
+		virtual bool HasExactSolution() const { return true; }
+		virtual void AdvanceExactly(double dt);
+		// Exact threshold crossing time
+		virtual bool GetNextSpikeTime(double t, double tMax, double & tSpike) const;
+
 		//===========================================================||
 		// Standard Save and Load methods                            ||
 		//===========================================================||
@@ -282,6 +321,9 @@ namespace AstroModel
 		double *dynVals; // Dynamic values
 		bool freeDynVals;
 		unsigned int nbDynVals;
+
+		// Membrane potential dt after (V0, w0) in the absence of spikes
+		double exactV(double V0, double w0, double dt) const;
 	};
 }
 
@@ -22,6 +22,8 @@
 #include "ChIModelMetrics.h"
 
 #include <assert.h>
+#include <queue>
+#include <algorithm>
 
 using namespace AstroModel;
 using namespace std;
@@ -38,12 +40,16 @@ std::string NeuronNetModel::ClassName = "NeuronNetModel";
 NeuronNetModel::NeuronNetModel(ParamHandler & h) : 
 	NetworkDynamicsModel::NetworkDynamicsModel(h),
 	ODE::ODEProblem<double, double>::ODEProblem(0, h),
-	solver(0)
+	solver(0), eventDrivenOn(false), spikeQueue(new SpikeQueue)
 {
 	TRACE("*** Creating Neuron Net Model ***")
 
 	neuronClassName = param.getParam<std::string>("-NeuronClass");
 	synapseClassName = param.getParam<std::string>("-SynapseClass");
+	useEventDriven = param.getParam<bool>("-NeuronEventDriven", 0);
+	eventSampleStep = param.getParam<double>("-NeuronEventDriven", 1);
+	synDelay = param.getParam<double>("-SynapticDelay", 0);
+	synDelayJitter = param.getParam<double>("-SynapticDelay", 1);
 	network->SetEdgeClassName(synapseClassName);
 
 	// Initialize ODEProblem
@@ -71,8 +77,12 @@ NeuronNetModel::NeuronNetModel(ParamHandler & h) :
 NeuronNetModel::NeuronNetModel(std::ifstream & stream, ParamHandler & h) : 
 	NetworkDynamicsModel::NetworkDynamicsModel(h),
 	ODE::ODEProblem<double, double>::ODEProblem(0),
-	solver(0)
+	solver(0), eventDrivenOn(false), spikeQueue(new SpikeQueue)
 {
+	useEventDriven = h.getParam<bool>("-NeuronEventDriven", 0);
+	eventSampleStep = h.getParam<double>("-NeuronEventDriven", 1);
+	synDelay = h.getParam<double>("-SynapticDelay", 0);
+	synDelayJitter = h.getParam<double>("-SynapticDelay", 1);
 	if (not this->LoadFromStream(stream))
 		cerr << "Failed to load the model !" << endl;
 }
@@ -88,6 +98,8 @@ NeuronNetModel::~NeuronNetModel()
 
 	// Neurons
 	ClearNeurons();
+
+	delete spikeQueue;
 }
 
 //**********************************************************************
@@ -126,6 +138,11 @@ void NeuronNetModel::SetUpODEsAndSynapticStruct()
 	// Calls SetVals with 0 / 0 arguments (default args)
 	// So that it doesn't change the allocated vals.
 	SetVals();
+
+	// Axonal delays
+	for (unsigned int i = 0 ; i < synapses.size() ; ++i)
+		synapses[i]->SetDelay(synDelay + 
+			((synDelayJitter > 0) ? synDelayJitter * UnifRand() : 0));
 }
 
 //**********************************************************************
@@ -182,6 +199,7 @@ void NeuronNetModel::SetVals(double *_vals, unsigned int _nbVals)
 	{
 		synapses[i]->SetDynVals(this->vals + nbSynDynVals, false);
 		synapses[i]->SetModel(this);
+		synapses[i]->SetIndex(i);
 		synapses[i]->SetValNamesPostfix(synapses[i]->GetClassName() + "_" +
 			StringifyFixed(i));
 		nbSynDynVals += synapses[i]->GetNbDynVal();
@@ -226,6 +244,13 @@ void NeuronNetModel::InitializeDynVals()
 bool NeuronNetModel::PreSimulationCall(ResultSaver saver)
 {
 	bool ok = true;
+
+	// Spike queue spans the largest axonal delay
+	double maxDelay = 0;
+	for (unsigned int i = 0 ; i < synapses.size() ; ++i)
+		maxDelay = std::max(maxDelay, synapses[i]->GetDelay());
+	spikeQueue->SetUp(tStart, integrStep, maxDelay);
+
 	// Save wanted data
 TRACE_UP("*** Saving metric data ***")
 	ok &= this->network->ComputeAndSaveMetrics(saver);
@@ -246,6 +271,8 @@ TRACE_UP("*** Computing and saving after simulation metric ***")
 	ok &= metrics.SaveMetrics<AfterSimMetric>(saver);
 TRACE_DOWN("*** After simulation metric data saved ***")
 
+TRACE("*** " << spikeQueue->GetNbDelivered() << " spikes delivered ***")
+
 	// Save computed dynamic data and metrics
 TRACE("*** Saving dynamic data ***")
 	ok &= metrics.SaveMetrics<DynMetric>(saver);
@@ -266,8 +293,13 @@ int NeuronNetModel::Simulate(ResultSaver saver)
 
 	// Simulate
 TRACE_UP("*** Starting Simulation tStart = " << tStart << " tEnd = " << tEnd << " ***")
-	assert(solver);
-	solver->Solve(*this, tStart, tEnd);
+	if (useEventDriven and canUseEventDriven())
+		simulateEventDriven();
+	else
+	{
+		assert(solver);
+		solver->Solve(*this, tStart, tEnd);
+	}
 TRACE_DOWN("*** Simulation Ended ***")
 
 	if (not PostSimulationCall(saver))
@@ -276,20 +308,156 @@ TRACE_DOWN("*** Simulation Ended ***")
 	return returnVal;
 }
 
+//**********************************************************************
+// Returns true if all neurons and synapses can be solved exactly
+//**********************************************************************
+bool NeuronNetModel::canUseEventDriven() const
+{
+	bool exact = true;
+	for (unsigned int i = 0 ; (i < neurons.size()) and exact ; ++i)
+		exact = neurons[i]->HasExactSolution();
+	for (unsigned int i = 0 ; (i < synapses.size()) and exact ; ++i)
+		exact = synapses[i]->HasExactSolution();
+	return exact;
+}
+
+//**********************************************************************
+// Neurons only interact through spikes : each value is advanced 
+// exactly from event to event. Spike times are kept in a priority 
+// queue, predictions are invalidated when their neuron spikes. Neurons
+// and synapses are only advanced when an event reaches them, or at the
+// samples (every eventSampleStep, integration step by default) where a 
+// metric is due. Spikes after the last sample are processed up to tEnd.
+//**********************************************************************
+void NeuronNetModel::simulateEventDriven()
+{
+	typedef std::pair<double, unsigned int> SpikeEvent;
+	std::priority_queue<SpikeEvent, std::vector<SpikeEvent>, 
+		std::greater<SpikeEvent> > spikes;
+
+	neurLastT.assign(neurons.size(), tStart);
+	synLastT.assign(synapses.size(), tStart);
+	std::vector<double> nextSpikes(neurons.size(), tStart - 1.0);
+	double tSpike;
+	for (unsigned int i = 0 ; i < neurons.size() ; ++i)
+		if (neurons[i]->GetNextSpikeTime(tStart, tEnd, tSpike))
+		{
+			nextSpikes[i] = tSpike;
+			spikes.push(SpikeEvent(tSpike, i));
+		}
+
+	double sampleStep = (eventSampleStep > 0) ? eventSampleStep : integrStep;
+	unsigned long int nbSamples = 0;
+	eventDrivenOn = true;
+	for (double tSample = tStart ; ; tSample = tStart + (++nbSamples) * sampleStep)
+	{
+		bool last = (tSample > tEnd);
+		double tLimit = last ? tEnd : tSample;
+		while ((not spikes.empty()) and (spikes.top().first <= tLimit))
+		{
+			SpikeEvent ev = spikes.top();
+			spikes.pop();
+			unsigned int i = ev.second;
+			// Outdated prediction
+			if (ev.first != nextSpikes[i])
+				continue;
+
+			advanceNeuron(i, ev.first);
+			neurons[i]->SpikeEvent(ev.first);
+			deliverSpikes(ev.first);
+
+			if (neurons[i]->GetNextSpikeTime(ev.first, tEnd, tSpike))
+			{
+				nextSpikes[i] = tSpike;
+				spikes.push(SpikeEvent(tSpike, i));
+			}
+			else
+				nextSpikes[i] = tStart - 1.0;
+		}
+
+		deliverSpikes(tLimit);
+		if (last)
+			break;
+		tCurr = tSample;
+		metricScheduler.SetTime(tSample, sampleStep);
+		if (metrics.AnyDue<NeedFrequentUpdateMetric>() or 
+			ODE::ODEProblem<double, double>::metrics.AnyDue<NeedFrequentUpdateMetric>())
+		{
+			advanceAll(tSample);
+			UpdateVals(tSample);
+		}
+	}
+	// After simulation metrics see the values at tEnd
+	tCurr = tEnd;
+	advanceAll(tEnd);
+	eventDrivenOn = false;
+}
+
+//**********************************************************************
+// Both directions of an undirected link share the same synapse, which 
+// is only advanced once
+//**********************************************************************
+void NeuronNetModel::advanceAll(double t)
+{
+	for (unsigned int i = 0 ; i < neurons.size() ; ++i)
+		advanceNeuron(i, t);
+	for (unsigned int i = 0 ; i < synapses.size() ; ++i)
+		if (synapses[i]->GetIndex() == i)
+			advanceSynapse(i, t);
+}
+
+//**********************************************************************
+//**********************************************************************
+void NeuronNetModel::advanceNeuron(unsigned int i, double t)
+{
+	if (t > neurLastT[i])
+	{
+		neurons[i]->AdvanceExactly(t - neurLastT[i]);
+		neurLastT[i] = t;
+	}
+}
+
+//**********************************************************************
+//**********************************************************************
+void NeuronNetModel::advanceSynapse(unsigned int i, double t)
+{
+	if (t > synLastT[i])
+	{
+		synapses[i]->AdvanceExactly(t - synLastT[i]);
+		synLastT[i] = t;
+	}
+}
+
+//**********************************************************************
+// Delivers the queued spikes due at t, in synapse order. In event 
+// driven mode synapses are first advanced to the spike time.
+//**********************************************************************
+void NeuronNetModel::deliverSpikes(double t)
+{
+	const std::vector<SpikeQueue::Spike> & due = spikeQueue->PopDue(t);
+	for (unsigned int i = 0 ; i < due.size() ; ++i)
+	{
+		if (eventDrivenOn)
+			advanceSynapse(due[i].syn, due[i].t);
+		synapses[due[i].syn]->PresynSpike(due[i].t);
+	}
+}
+
 //**********************************************************************
 // Notifies the model that all values have been updated for timestep t
 //**********************************************************************
 void NeuronNetModel::UpdateVals(double t)
 {
 	tCurr = t; 
-	// Check if neurons fired
-	for (unsigned int i = 0 ; i < neurons.size() ; ++i)
+	// Check if neurons fired (spikes are events in event driven mode)
+	for (unsigned int i = 0 ; (i < neurons.size()) and not eventDrivenOn ; ++i)
 	{
 		if (neurons[i]->CheckForSpiking(t))
 		{
 			//TRACE("t = " << t << " // Spike ! // " << i)
 		}
 	}
+	deliverSpikes(t);
 
 	metrics.ComputeMetrics<NeedFrequentUpdateMetric>(*this);
 	ODE::ODEProblem<double, double>::UpdateVals(t);
@@ -24,6 +24,7 @@
 #include "MetricComputeStrat.h"
 #include "Synapse.h"
 #include "Neuron.h"
+#include "SpikeQueue.h"
 
 namespace ODE
 {
@@ -130,6 +131,8 @@ namespace AstroModel
 		virtual Synapse * GetSynapse(unsigned int ind);
 		// Return the indice of the given synapse
 		virtual unsigned int GetSynInd(Synapse *) const;
+		// Queue through which neurons send their spikes
+		inline SpikeQueue * GetSpikeQueue() const { return spikeQueue; }
 
 	protected:
 
@@ -150,6 +153,35 @@ namespace AstroModel
 		//===========================================================||
 		ODE::ODESolver<double, double> * solver;
 
+		//===========================================================||
+		// Event driven simulation                                   ||
+		//===========================================================||
+		bool useEventDriven;    // Exact integration between spikes
+		double eventSampleStep; // Period of the metric updates (0 : integrStep)
+		bool eventDrivenOn;
+		std::vector<double> neurLastT; // Time of the neurons values
+		std::vector<double> synLastT;  // Time of the synapses values
+
+		// Returns true if all neurons and synapses can be solved exactly
+		bool canUseEventDriven() const;
+		// Jumps from spike to spike instead of using the solver
+		void simulateEventDriven();
+		// Exact advance of a neuron or synapse to time t
+		void advanceNeuron(unsigned int i, double t);
+		void advanceSynapse(unsigned int i, double t);
+		// Advances all neurons and synapses to time t
+		void advanceAll(double t);
+
+		//===========================================================||
+		// Spike delivery                                            ||
+		//===========================================================||
+		SpikeQueue *spikeQueue;
+		double synDelay;       // Axonal delay of all synapses
+		double synDelayJitter; // Uniform random delay added to synDelay
+
+		// Delivers the queued spikes due at t
+		void deliverSpikes(double t);
+
 		//===========================================================||
 		// Metrics                                                   ||
 		//===========================================================||
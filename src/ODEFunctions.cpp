@@ -30,6 +30,8 @@
 #include <gsl/gsl_sf_exp.h>
 
 #include <math.h>
+#include <algorithm>
+#include <typeinfo>
 
 using namespace ODE;
 using namespace AstroModel;
@@ -43,6 +45,8 @@ std::string SFALIFNeuronFunct::ClassName = "SFALIFNeuronFunct";
 std::string DummyNeuronFunct::ClassName = "DummyNeuronFunct";
 std::string ChINetworkFunct::ClassName = "ChINetworkFunct";
 std::string KChINetworkFunct::ClassName = "KChINetworkFunct";
+template <> std::string ChIBatchNetworkFunct<double>::ClassName = "ChIBatchNetworkFunct";
+template <> std::string ChIBatchNetworkFunct<float>::ClassName = "ChIBatchNetworkFunctFloat";
 std::string NeuronNetworkFunc::ClassName = "NeuronNetworkFunc";
 std::string AstroNeuronNetFunc::ClassName = "AstroNeuronNetFunc";
 std::string FireDiffuseCellFunct::ClassName = "FireDiffuseCellFunc";
@@ -75,22 +79,22 @@ ChINetworkFunct::ChINetworkFunct(AstroModel::ChIModel & _model) : model(_model)
 //**********************************************************************
 void ChICellFunct::CompFunc(const double &, const double *v, double *f) const
 {
-	static double Ca2;
-	static double Ca4;
-	static double Q2;
-	static double hInf; 
-	static double tauH; 
-	static double mInf; 
-	static double nInf; 
-	static double chanProb;
-	static double Jchan;
-	static double Jleak;
-	static double Jpump;
-	static double Jspont;
-	static double Pplcd;
-	static double D5p;  
-	static double D3k;  
-	static double dIP3i;
+	double Ca2;
+	double Ca4;
+	double Q2;
+	double hInf; 
+	double tauH; 
+	double mInf; 
+	double nInf; 
+	double chanProb;
+	double Jchan;
+	double Jleak;
+	double Jpump;
+	double Jspont;
+	double Pplcd;
+	double D5p;  
+	double D3k;  
+	double dIP3i;
 
 	double & diffCa    = f[0];
 	double & diffh     = f[1];
@@ -136,10 +140,111 @@ void ChINetworkFunct::CompFunc(const double & t, const double *v, double *f) con
 	model.ComputeFluxes(t);
 	model.Stimulate(t);
 
+	// Frozen cells (cf ChIModel::updateActiveSet) don't move
+	if (model.activeSetOn)
+	{
+		std::fill(f, f + model.GetNbVals(), 0.0);
+		for (unsigned int k = 0 ; k < model.activeCells.size() ; ++k)
+		{
+			unsigned int i = model.activeCells[k];
+			model.cells[i]->funct->CompFunc(t, v + i * dynValDim, f + i * dynValDim);
+		}
+		return;
+	}
+
 	for (unsigned int i = 0 ; i < model.cells.size() ; ++i)
 		model.cells[i]->funct->CompFunc(t, v + i * dynValDim, f + i * dynValDim);
 }
 
+//********************************************************************//
+//**************** C H I  M O D E L   B A T C H **********************//
+//********************************************************************//
+
+//**********************************************************************
+// Constructor
+//**********************************************************************
+template <typename Val>
+ChIBatchNetworkFunct<Val>::ChIBatchNetworkFunct(AstroModel::ChIModelBatch<Val> & _batch) : 
+	batch(_batch)
+{
+
+}
+
+//**********************************************************************
+// Values of replica r for cell i are at (var * N + i) * B + r, the inner
+// loop runs over replicas and has no dependencies between iterations.
+// Operations are done in the same order as in ChICellFunct.
+//**********************************************************************
+template <typename Val>
+void ChIBatchNetworkFunct<Val>::CompFunc(const double & t, const Val *v, Val *f) const
+{
+	batch.ComputeFluxes(t, v);
+
+	const unsigned int B = batch.GetNbReplicas();
+	const unsigned int NB = batch.GetNbCells() * B;
+	const Val *Ca  = v + AstroModel::ChICell::Ca * NB;
+	const Val *h   = v + AstroModel::ChICell::h * NB;
+	const Val *IP3 = v + AstroModel::ChICell::IP3 * NB;
+	Val *diffCa  = f + AstroModel::ChICell::Ca * NB;
+	Val *diffh   = f + AstroModel::ChICell::h * NB;
+	Val *diffIP3 = f + AstroModel::ChICell::IP3 * NB;
+
+	const Val *C0  = &batch.C0[0];
+	const Val *d1  = &batch.d1[0];
+	const Val *d2  = &batch.d2[0];
+	const Val *d3  = &batch.d3[0];
+	const Val *d5  = &batch.d5[0];
+	const Val *v3k = &batch.v3k[0];
+	const Val *K3k4 = &batch.K3k4[0];
+	const Val *r5p = &batch.r5p[0];
+	const Val one = 1;
+
+	for (unsigned int o = 0 ; o < NB ; o += B)
+	{
+		const Val *c1 = &batch.c1[o];
+		const Val *rC = &batch.rC[o];
+		const Val *rL = &batch.rL[o];
+		const Val *vER = &batch.vER[o];
+		const Val *a2 = &batch.a2[o];
+		const Val *Ker2 = &batch.Ker2[o];
+		const Val *vd = &batch.vd[o];
+		const Val *Kplcd2 = &batch.Kplcd2[o];
+		const Val *kd = &batch.kd[o];
+		const Val *k3 = &batch.k3[o];
+		const Val *totFlux = &batch.totFlux[o];
+		const Val *Jspont = &batch.Jspont[o];
+		const Val *gluIP3Prod = &batch.gluIP3Prod[o];
+
+		for (unsigned int r = 0 ; r < B ; ++r)
+		{
+			Val Q2   = d2[r] * (IP3[o + r] + d1[r]) / (IP3[o + r] + d3[r]);
+			Val hInf = Q2 / (Q2 + Ca[o + r]);
+			Val tauH = one / (a2[r] * (Q2 + Ca[o + r]));
+			Val mInf = IP3[o + r] / (IP3[o + r] + d1[r]);
+			Val nInf = Ca[o + r] / (Ca[o + r] + d5[r]);
+
+			Val Ca2 = Ca[o + r] * Ca[o + r];
+			Val Ca4 = Ca2 * Ca2;
+			Val chanProb = mInf * nInf * h[o + r];
+			Val Jchan = rC[r] * (C0[r] - (one + c1[r]) * Ca[o + r]) * 
+				chanProb * chanProb * chanProb;
+			Val Jleak = rL[r] * (C0[r] - (one + c1[r]) * Ca[o + r]);
+			Val Jpump = vER[r] * Ca2 / (Ker2[r] + Ca2);
+
+			Val Pplcd = vd[r] * kd[r] / (kd[r] + IP3[o + r]) * Ca2 / (Ca2 + Kplcd2[r]);
+			Val D5p   = r5p[r] * IP3[o + r];
+			Val D3k   = v3k[r] * Ca4 / (Ca4 + K3k4[r]) * IP3[o + r] / (IP3[o + r] + k3[r]);
+
+			diffCa[o + r]  = Jchan + Jleak - Jpump + Jspont[r];
+			diffh[o + r]   = (hInf - h[o + r]) / tauH;
+			diffIP3[o + r] = (Pplcd - D3k - D5p) - totFlux[r] + gluIP3Prod[r];
+		}
+	}
+}
+
+template class ODE::ChIBatchNetworkFunct<double>;
+template class ODE::ChIBatchNetworkFunct<float>;
+
 //********************************************************************//
 //******************** K C H I  M O D E L ****************************//
 //********************************************************************//
@@ -470,32 +575,51 @@ AstroNeuronNetFunc::AstroNeuronNetFunc(AstroModel::AstroNeuroNetModel & _model)
 // Function network operator, it returns the derivatives of every dynVal
 //**********************************************************************
 void AstroNeuronNetFunc::CompFunc(const double & t, const double *v, double *f) const
+{
+	CompFastFunc(t, v, f);
+	CompSlowFunc(t, v, f);
+}
+
+//**********************************************************************
+// Derivatives of the neuron network values
+//**********************************************************************
+void AstroNeuronNetFunc::CompFastFunc(const double & t, const double *v, double *f) const
 {
 	model.neuronNet->function->CompFunc(t, v, f);
-	unsigned int nbDynVal = model.neuronNet->GetTotNbDynVals();
+}
 
-	double DefaultSpillOvFract = 0.025;
-	GlutamatergicSynapse *gluSyn = 0;
-	TMSynapse *tmSyn = 0;
-	double glu = 0;
-	double Calc = 0.0;
-	for (unsigned int i = 0 ; i < model.astrToSyn.size() ; ++i)
+//**********************************************************************
+// Derivatives of the astrocyte network values, glutamate is read from
+// the current synapse values
+//**********************************************************************
+void AstroNeuronNetFunc::CompSlowFunc(const double & t, const double *v, double *f) const
+{
+	unsigned int nbDynVal = model.neuronNet->GetTotNbDynVals();
+	assert(model.couplStart.size() == model.astrToSyn.size() + 1);
+
+	// Spilled over glutamate of every synapse, raised to the Hill
+	// coefficient 0.7 (x^0.7 = exp(0.7 log(x)), 0 for x = 0). The power
+	// has its own loop, vectorized (vector exp and log of libmvec) when
+	// compiled with -ffast-math. A lookup table isn't used : glutamate
+	// spans several decades and the Hill term would lose its accuracy.
+	unsigned int nbCoupl = model.couplGlu.size();
+	gluHill.resize(nbCoupl);
+	for (unsigned int k = 0 ; k < nbCoupl ; ++k)
+		gluHill[k] = model.couplSpillOv[k] * *model.couplGlu[k];
+	for (unsigned int k = 0 ; k < nbCoupl ; ++k)
+		gluHill[k] = (gluHill[k] > 0) ? exp(0.7 * log(gluHill[k])) : 0;
+
+	double Calc, KHill, sum;
+	for (unsigned int i = 0 ; i < model.couplAstro.size() ; ++i)
 	{
-		model.astroNet->cells[i]->gluIP3Prod = 0;
-		Calc = v[model.astroNet->cells[i]->dynVals - model.vals + ChICell::Ca];
-		for (unsigned int j = 0 ; j < model.astrToSyn[i].size() ; ++j)
-		{
-			gluSyn = dynamic_cast<GlutamatergicSynapse *>(model.astrToSyn[i][j]);
-			if (gluSyn)
-			{
-				tmSyn = dynamic_cast<TMSynapse *>(gluSyn);
-				glu = (tmSyn ? tmSyn->spillOvFract : DefaultSpillOvFract) * gluSyn->GetGluVal();
-			}	
-			model.astroNet->cells[i]->gluIP3Prod += 
-				model.astroNet->cells[i]->vbeta * (pow(glu, 0.7) / 
-				(pow(glu, 0.7) + pow(model.astroNet->cells[i]->kR + 
-					model.astroNet->cells[i]->kP*(Calc / (Calc + model.astroNet->cells[i]->kpi)), 0.7)));
-		}
+		const AstroModel::AstroNeuroNetModel::AstroCoupling & astr = 
+			model.couplAstro[i];
+		Calc = v[astr.caInd];
+		KHill = pow(astr.kR + astr.kP * (Calc / (Calc + astr.kpi)), 0.7);
+		sum = 0;
+		for (unsigned int k = model.couplStart[i] ; k < model.couplStart[i+1] ; ++k)
+			sum += gluHill[k] / (gluHill[k] + KHill);
+		model.astroNet->cells[i]->gluIP3Prod = astr.vbeta * sum;
 	}
 
 	model.astroNet->function->CompFunc(t, v + nbDynVal, f + nbDynVal);
@@ -545,3 +669,243 @@ void FireDiffuseNetFunct::CompFunc(const double & t, const double *v, double *f)
 	for (unsigned int i = 0 ; i < model.cells.size() ; ++i)
 		model.cells[i]->funct->CompFunc(t, v + i * dynValDim, f + i * dynValDim);
 }
+
+//********************************************************************//
+//************ S P E C I A L I S E D   N E T W O R K S ***************//
+//********************************************************************//
+
+//**********************************************************************
+// ChI cells, the coupling flux only depends on IP3
+//**********************************************************************
+struct ODE::ChICellKernel
+{
+	typedef AstroModel::ChIModel Model;
+	static const unsigned int Stride = CHIMODEL_NBVALS_PER_CELL;
+
+	// Model classes that do not change the way derivatives are computed
+	static bool AcceptsModel(const Model & model)
+	{
+		return ((typeid(model) == typeid(AstroModel::ChIModel)) or
+			(typeid(model) == typeid(AstroModel::ChIModelThresholdDetermination)) or
+			(typeid(model) == typeid(AstroModel::ChIModelStochasticRes))) and
+			not model.useActiveSet;
+	}
+	static bool AcceptsCell(const Model & model, unsigned int i)
+	{
+		return (typeid(*model.cells[i]) == typeid(AstroModel::ChICell)) and
+			(typeid(*model.cells[i]->funct) == typeid(ChICellFunct));
+	}
+	static inline unsigned int NbCells(const Model & model) 
+		{ return model.cells.size(); }
+	static inline const double * CoupledVals(const Model & model) 
+		{ return model.cells[0]->dynVals + AstroModel::ChICell::IP3; }
+	template <typename Link>
+	static inline void CompCouplingFlux(Model & model, unsigned int i, 
+		const double *x, const unsigned int *targ, const Link * const *lnk, 
+		unsigned int nb)
+	{
+		double flux = 0;
+		for (unsigned int k = 0 ; k < nb ; ++k)
+			if (not model.IsLinkBlocked(i, targ[k]))
+				flux += lnk[k]->Flux(x[i * Stride] - x[targ[k] * Stride]);
+		model.cells[i]->totFlux = flux;
+		model.cells[i]->caSpontLeak = false;
+	}
+	static inline void CompCell(const Model & model, unsigned int i, 
+		const double & t, const double *v, double *f)
+	{
+		static_cast<const ChICellFunct *>(model.cells[i]->funct)->
+			ChICellFunct::CompFunc(t, v, f);
+	}
+};
+
+//**********************************************************************
+// KChI cells, permeabilities and K+ fluxes are computed by the model
+//**********************************************************************
+struct ODE::KChICellKernel
+{
+	typedef AstroModel::KChIModel Model;
+	static const unsigned int Stride = KCHIMODEL_NBVALS_PER_CELL;
+
+	static bool AcceptsModel(const Model & model)
+	{
+		return typeid(model) == typeid(AstroModel::KChIModel);
+	}
+	static bool AcceptsCell(const Model & model, unsigned int i)
+	{
+		return (typeid(*model.cells[i]) == typeid(AstroModel::KChICell)) and
+			(typeid(*model.cells[i]->funct) == typeid(KChICellFunct));
+	}
+	static inline unsigned int NbCells(const Model & model) 
+		{ return model.cells.size(); }
+	static inline const double * CoupledVals(const Model & model) 
+		{ return model.cells[0]->dynVals + AstroModel::ChICell::IP3; }
+	template <typename Link>
+	static inline void CompCouplingFlux(Model & model, unsigned int i, 
+		const double *x, const unsigned int *targ, const Link * const *lnk, 
+		unsigned int nb)
+	{
+		AstroModel::KChICell & kcell = 
+			*static_cast<AstroModel::KChICell *>(model.cells[i]);
+		model.resetFluxes(i);
+		for (unsigned int k = 0 ; k < nb ; ++k)
+			model.addLinkFluxes(kcell, i, targ[k], model.IsLinkBlocked(i, targ[k]) ? 
+				0.0 : lnk[k]->Flux(x[i * Stride] - x[targ[k] * Stride]));
+	}
+	// The cell function only uses t for debug traces
+	static inline void CompCell(const Model & model, unsigned int i, 
+		const double & , const double *v, double *f)
+	{
+		static_cast<const KChICellFunct *>(model.cells[i]->funct)->
+			KChICellFunct::CompFunc(0, v, f);
+	}
+};
+
+//**********************************************************************
+// Fire diffuse cells
+//**********************************************************************
+struct ODE::FireDiffuseCellKernel
+{
+	typedef AstroModel::FireDiffuseModel Model;
+	static const unsigned int Stride = FIREDIFFUSEMODEL_NBVALS_PER_CELL;
+
+	static bool AcceptsModel(const Model & model)
+	{
+		return typeid(model) == typeid(AstroModel::FireDiffuseModel);
+	}
+	static bool AcceptsCell(const Model & model, unsigned int i)
+	{
+		return (typeid(*model.cells[i]) == typeid(AstroModel::FireDiffuseCell)) and
+			(typeid(*model.cells[i]->funct) == typeid(FireDiffuseCellFunct));
+	}
+	static inline unsigned int NbCells(const Model & model) 
+		{ return model.cells.size(); }
+	static inline const double * CoupledVals(const Model & model) 
+		{ return model.cells[0]->dynVals + AstroModel::FireDiffuseCell::C; }
+	template <typename Link>
+	static inline void CompCouplingFlux(Model & model, unsigned int i, 
+		const double *x, const unsigned int *targ, const Link * const *lnk, 
+		unsigned int nb)
+	{
+		double flux = 0;
+		for (unsigned int k = 0 ; k < nb ; ++k)
+			if (not model.IsLinkBlocked(i, targ[k]))
+				flux += lnk[k]->Flux(x[i * Stride] - x[targ[k] * Stride]);
+		model.cells[i]->totFlux = flux;
+	}
+	static inline void CompCell(const Model & model, unsigned int i, 
+		const double & t, const double *v, double *f)
+	{
+		model.cells[i]->funct->FireDiffuseCellFunct::CompFunc(t, v, f);
+	}
+};
+
+template <> std::string NetworkRHS<ChICellKernel, SigmoidCoupling>::ClassName = 
+	"ChISigmoidNetworkRHS";
+template <> std::string NetworkRHS<ChICellKernel, LinearCoupling>::ClassName = 
+	"ChILinearNetworkRHS";
+template <> std::string NetworkRHS<KChICellKernel, SigmoidCoupling>::ClassName = 
+	"KChISigmoidNetworkRHS";
+template <> std::string NetworkRHS<FireDiffuseCellKernel, LinearCoupling>::ClassName = 
+	"FireDiffuseLinearNetworkRHS";
+
+//**********************************************************************
+// Constructor, flattens the network
+//**********************************************************************
+template <typename CellKernel, typename Link>
+NetworkRHS<CellKernel, Link>::NetworkRHS(Model & _model) : model(_model)
+{
+	assert(Accepts(model));
+	const Network<CouplingFunction> & net = 
+		model.NetworkDynamicsModel<CouplingFunction>::GetNetwork();
+	linkStart.assign(1, 0);
+	for (unsigned int i = 0 ; i < net.size() ; ++i)
+	{
+		const std::vector<unsigned int> & neighbors = net.GetNeighbors(i);
+		for (unsigned int j = 0 ; j < neighbors.size() ; ++j)
+		{
+			linkTarget.push_back(neighbors[j]);
+			links.push_back(static_cast<const Link *>(net[i][neighbors[j]]));
+		}
+		linkStart.push_back(links.size());
+	}
+}
+
+//**********************************************************************
+// Every cell and every link have to be of the exact expected types,
+// subclasses could override the derivatives
+//**********************************************************************
+template <typename CellKernel, typename Link>
+bool NetworkRHS<CellKernel, Link>::Accepts(const Model & _model)
+{
+	if (not CellKernel::AcceptsModel(_model) or not _model.IsNetworkTopoDefined())
+		return false;
+	const Network<CouplingFunction> & net = 
+		_model.NetworkDynamicsModel<CouplingFunction>::GetNetwork();
+	if ((net.size() == 0) or (net.size() != CellKernel::NbCells(_model)))
+		return false;
+	for (unsigned int i = 0 ; i < net.size() ; ++i)
+	{
+		if (not CellKernel::AcceptsCell(_model, i))
+			return false;
+		const std::vector<unsigned int> & neighbors = net.GetNeighbors(i);
+		for (unsigned int j = 0 ; j < neighbors.size() ; ++j)
+			if (typeid(*net[i][neighbors[j]]) != typeid(Link))
+				return false;
+	}
+	return true;
+}
+
+//**********************************************************************
+// Same operations in the same order as the generic network functions
+//**********************************************************************
+template <typename CellKernel, typename Link>
+void NetworkRHS<CellKernel, Link>::CompFunc(const double & t, const double *v, double *f) const
+{
+	const unsigned int nbCells = CellKernel::NbCells(model);
+	const double *x = CellKernel::CoupledVals(model);
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+		CellKernel::CompCouplingFlux(model, i, x, &linkTarget[0] + linkStart[i], 
+			&links[0] + linkStart[i], linkStart[i + 1] - linkStart[i]);
+
+	model.Stimulate(t);
+
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+		CellKernel::CompCell(model, i, t, v + i * CellKernel::Stride, 
+			f + i * CellKernel::Stride);
+}
+
+template class ODE::NetworkRHS<ChICellKernel, SigmoidCoupling>;
+template class ODE::NetworkRHS<ChICellKernel, LinearCoupling>;
+template class ODE::NetworkRHS<KChICellKernel, SigmoidCoupling>;
+template class ODE::NetworkRHS<FireDiffuseCellKernel, LinearCoupling>;
+
+//**********************************************************************
+// Falls back on the generic network functions
+//**********************************************************************
+Function<double> * ODE::CreateNetworkRHS(AstroModel::ChIModel & model)
+{
+	AstroModel::KChIModel *kmodel = dynamic_cast<AstroModel::KChIModel *>(&model);
+	if (kmodel)
+	{
+		if (NetworkRHS<KChICellKernel, SigmoidCoupling>::Accepts(*kmodel))
+			return new NetworkRHS<KChICellKernel, SigmoidCoupling>(*kmodel);
+		return new KChINetworkFunct(*kmodel);
+	}
+
+	if (NetworkRHS<ChICellKernel, SigmoidCoupling>::Accepts(model))
+		return new NetworkRHS<ChICellKernel, SigmoidCoupling>(model);
+	if (NetworkRHS<ChICellKernel, LinearCoupling>::Accepts(model))
+		return new NetworkRHS<ChICellKernel, LinearCoupling>(model);
+	return new ChINetworkFunct(model);
+}
+
+//**********************************************************************
+// Falls back on the generic network function
+//**********************************************************************
+Function<double> * ODE::CreateNetworkRHS(AstroModel::FireDiffuseModel & model)
+{
+	if (NetworkRHS<FireDiffuseCellKernel, LinearCoupling>::Accepts(model))
+		return new NetworkRHS<FireDiffuseCellKernel, LinearCoupling>(model);
+	return new FireDiffuseNetFunct(model);
+}
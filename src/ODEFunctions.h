@@ -34,6 +34,7 @@ namespace AstroModel
 	class ChICell;
 	class KChICell;
 	class ChIModel;
+	template <typename Val> class ChIModelBatch;
 	class KChIModel;
 	class Neuron;
 	class Synapse;
@@ -47,6 +48,14 @@ namespace AstroModel
 	class FireDiffuseCell;
 }
 
+namespace ODE
+{
+	// Cell kernels of NetworkRHS
+	struct ChICellKernel;
+	struct KChICellKernel;
+	struct FireDiffuseCellKernel;
+}
+
 namespace ODE
 {
 	/******************************************************************/
@@ -58,6 +67,13 @@ namespace ODE
 		typedef Val TVal;
 
 		virtual void CompFunc(const TimeT & t, const Val *v, Val *f) const = 0;
+		// Multirate integration : derivatives of the fast values only 
+		// and of the slow values only (see ODEProblem::GetNbFastVals).
+		// Both compute everything by default.
+		virtual void CompFastFunc(const TimeT & t, const Val *v, Val *f) const
+			{ CompFunc(t, v, f); }
+		virtual void CompSlowFunc(const TimeT & t, const Val *v, Val *f) const
+			{ CompFunc(t, v, f); }
 		// Return class name
 		virtual std::string GetClassName() const = 0;
 
@@ -196,6 +212,26 @@ namespace ODE
 		virtual void CompFunc(const double & t, const double *v, double *f) const;
 	};
 
+	/******************************************************************/
+	/* ChI Batch Network Function                                     */
+	/******************************************************************/
+	template <typename Val = double>
+	class ChIBatchNetworkFunct : public Function<Val, double>
+	{
+	protected:
+		AstroModel::ChIModelBatch<Val> & batch;
+
+	public:
+		static std::string ClassName;
+
+		ChIBatchNetworkFunct(AstroModel::ChIModelBatch<Val> & _batch);
+
+		// Return class name
+		virtual std::string GetClassName() const { return ClassName; }
+		// Same kinetics as ChICellFunct, for all replicas at once
+		virtual void CompFunc(const double & t, const Val *v, Val *f) const;
+	};
+
 	/******************************************************************/
 	/* KChI Network Function                                          */
 	/******************************************************************/
@@ -239,6 +275,8 @@ namespace ODE
 	{
 	protected:
 		AstroModel::AstroNeuroNetModel & model;
+		// Hill terms of the synapses glutamate, in coupling table order
+		mutable std::vector<double> gluHill;
 
 	public:
 		static std::string ClassName;
@@ -248,6 +286,10 @@ namespace ODE
 		// Return class name
 		virtual std::string GetClassName() const { return ClassName; }
 		virtual void CompFunc(const double & t, const double *v, double *f) const;
+		// Neurons and synapses
+		virtual void CompFastFunc(const double & t, const double *v, double *f) const;
+		// Glutamate induced IP3 production and astrocytes
+		virtual void CompSlowFunc(const double & t, const double *v, double *f) const;
 	};
 
 	/******************************************************************/
@@ -286,6 +328,44 @@ namespace ODE
 		virtual std::string GetClassName() const { return ClassName; }
 		virtual void CompFunc(const double & t, const double *v, double *f) const;
 	};
+
+	/******************************************************************/
+	/* Specialised network function                                   */
+	/******************************************************************/
+	// Computes the same derivatives as the network functions above for
+	// models in which every cell and every link have the exact types 
+	// expected by CellKernel and Link. Cell and coupling functions are 
+	// called non virtually and the coupling loop runs on a flat copy of
+	// the adjacency lists. Only instantiated in ODEFunctions.cpp, use
+	// CreateNetworkRHS to get one.
+	template <typename CellKernel, typename Link>
+	class NetworkRHS : public Function<double>
+	{
+	public:
+		typedef typename CellKernel::Model Model;
+		static std::string ClassName;
+
+		NetworkRHS(Model & _model);
+
+		// Can the current network of the model be handled ?
+		static bool Accepts(const Model & _model);
+
+		// Return class name
+		virtual std::string GetClassName() const { return ClassName; }
+		virtual void CompFunc(const double & t, const double *v, double *f) const;
+
+	protected:
+		Model & model;
+		// Links of cell i are in [linkStart[i], linkStart[i+1])
+		std::vector<unsigned int> linkStart;
+		std::vector<unsigned int> linkTarget;
+		std::vector<const Link *> links;
+	};
+
+	// Network function of the model, specialised if the cell and link
+	// types allow it. Has to be called again if the network changes.
+	Function<double> * CreateNetworkRHS(AstroModel::ChIModel & model);
+	Function<double> * CreateNetworkRHS(AstroModel::FireDiffuseModel & model);
 }
 
 #endif
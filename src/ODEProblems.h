@@ -19,6 +19,7 @@
 
 #include <vector>
 #include "ODEFunctions.h"
+#include "SparseLinearSolvers.h"
 #include "ResultSaver.h"
 #include "MetricComputeStrat.h"
 #include "AbstractFactory.h"
@@ -63,13 +64,14 @@ namespace ODE
 			
 			// ODE Solver
 			std::string solverClassName = param.getParam<std::string>("-SolverClass");
-			if (AstroModel::AbstractFactory<ODE::ODESolver<double, double> >::Factories[solverClassName])
+			if (AstroModel::AbstractFactory<ODE::ODESolver<Val, TStep> >::Factories[solverClassName])
 			{
-				solver = AstroModel::AbstractFactory<ODE::ODESolver<double, double> >::Factories[solverClassName]->Create();
+				solver = AstroModel::AbstractFactory<ODE::ODESolver<Val, TStep> >::Factories[solverClassName]->Create();
 				solver->SetStepSize(param.getParam<double>("-Step"));
 			}
 			else
 				std::cerr << "Couldn't create the following ODE solver : " << solverClassName << std::endl;
+			metrics.SetScheduler(&metricScheduler);
 		}
 
 		virtual ~ODEProblem()
@@ -120,10 +122,18 @@ namespace ODE
 			valNames.clear();
 			freeVals = false;
 		}
+		// Notifies the metric scheduler that a new integration step
+		// is about to be completed at time t
+		inline void NotifyNewStep(TStep t)
+		{
+			metricScheduler.SetTime(t, integrStep);
+		}
 		virtual void UpdateVals(double) 
 		{
 			metrics.template ComputeMetrics<AstroModel::NeedFrequentUpdateMetric>(*this);
 		}
+		// Returns true if the integration can stop before its end
+		virtual bool IsFinished() const { return false; }
 
 		virtual void SetFunct(Function<Val, TStep> * _f, bool _ff = false)
 		{
@@ -149,6 +159,45 @@ namespace ODE
 		inline unsigned int GetNbVals() const { return nbVals; }
 		inline Val GetVal(unsigned int i) const { return vals[i]; }
 
+		//===========================================================||
+		// Jacobian structure (used by implicit solvers)             ||
+		//===========================================================||
+		// Fills pattern[i] with the columns of the non zero entries of
+		// row i, returns false if unknown (the jacobian is then dense)
+		virtual bool GetJacobianPattern(std::vector<std::vector<unsigned int> > & ) const
+			{ return false; }
+		// Number of contiguous values per block (cell), the jacobian
+		// is preconditioned by its diagonal blocks
+		virtual unsigned int GetJacobianBlockSize() const { return 1; }
+		// Analytic jacobian, values must be written in the given pattern.
+		// Returns false if not available (finite differences are used)
+		virtual bool CompJacobian(TStep , SparseMatrix<Val> & ) { return false; }
+		// Multirate integration : the first values are fast and the 
+		// remaining ones are slow (everything is fast by default)
+		virtual unsigned int GetNbFastVals() const { return nbVals; }
+
+		//===========================================================||
+		// Operator splitting (used by splitting solvers)            ||
+		//===========================================================||
+		// Freezes external inputs for the step starting at t. Returns 
+		// false if the problem can't be split
+		virtual bool PrepareSplitStep(TStep ) { return false; }
+		// Derivatives of the values of a block without coupling terms,
+		// blocks (see GetJacobianBlockSize) are independent
+		virtual void CompLocalFunc(TStep , unsigned int , const Val *, Val *) const {}
+		// Integrates the coupling terms alone from t to t + h
+		virtual void IntegrateCoupling(TStep , TStep ) {}
+		// Called once the whole step of size h is done
+		virtual void FinishSplitStep(TStep , TStep ) {}
+
+		//===========================================================||
+		// Active set integration                                    ||
+		//===========================================================||
+		// Blocks whose values may have changed since time t. Returns 
+		// false if unknown (all values must then be considered)
+		virtual bool GetBlocksChangedSince(TStep , std::vector<unsigned int> & ) const
+			{ return false; }
+
 		virtual void AddPostfixToValName(Val * v, std::string pf) const
 		{
 			assert(v >= vals);
@@ -311,6 +360,8 @@ namespace ODE
 		// Metrics                                                   ||
 		//===========================================================||
 		AstroModel::SortedMetrics<ODEProblem<Val, TStep> > metrics;
+		// Shared by the metrics of all the derived classes
+		AstroModel::MetricScheduler metricScheduler;
 
 	};
 
@@ -20,10 +20,13 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <float.h>
+#include <math.h>
 
 #include "ODEFunctions.h"
 #include "ODEProblems.h"
 #include "ResultSaver.h"
+#include "ParallelTools.h"
 
 namespace ODE
 {
@@ -45,7 +48,8 @@ namespace ODE
 		virtual void Solve(ODEProblem<Val, StepT> & prob, StepT start, StepT end)
 		{
 TRACE(stepSize)
-			for (currTime = start ; currTime <= end ; currTime += stepSize)
+			for (currTime = start ; (currTime <= end) and not prob.IsFinished() ; 
+				currTime += stepSize)
 			{
 				DoStep(prob);
 				/*******/
@@ -55,6 +59,7 @@ TRACE(stepSize)
 					needReset = false;
 				}
 				/*******/
+				prob.NotifyNewStep(currTime);
 				prob.UpdateVals(currTime);
 			}
 		}
@@ -64,6 +69,8 @@ TRACE(stepSize)
 			assert(_sz > 0);
 			stepSize = _sz;
 		}
+		// Does the solver use the jacobian of the problem ?
+		virtual bool UsesJacobian() const { return false; }
 
 		virtual void ResetVals()
 		{
@@ -223,6 +230,542 @@ TRACE(stepSize)
 				prob.vals[i] = (tempVal[i] + k1[i] / 6.0 + k2[i] / 3.0 + k3[i] / 3.0 + k4[i] / 6.0);
 		}
 	};
+/**********************************************************************/
+/* Multirate Solver                                                   */
+/**********************************************************************/
+	// Fast values (see ODEProblem::GetNbFastVals) are integrated with 
+	// fourth order Runge Kutta at the given step size. Slow values are 
+	// integrated the same way with a K times larger step, once the fast 
+	// values have completed the corresponding K substeps. Slow values 
+	// are held constant during fast substeps; slow stages either see the 
+	// fast values of the beginning of the macro step (Hold) or a linear 
+	// interpolation between the beginning and the end of it (Linear).
+	template <typename Val = double, typename StepT = double> class MultirateSolver : public ODESolver<Val, StepT>
+	{
+	public:
+		static std::string ClassName;
+		enum FastInterpolation {
+			Hold = 0,
+			Linear = 1
+		};
+
+		MultirateSolver(ParamHandler & h = ParamHandler::GlobalParams) : 
+			ODESolver<Val, StepT>::ODESolver(), nbVals(0), nbFast(0), subStep(0)
+		{
+			nbSubSteps = std::max(1, h.getParam<int>("-MultirateSolver", 0));
+			interp = (FastInterpolation) h.getParam<int>("-MultirateSolver", 1);
+		}
+		MultirateSolver(std::ifstream & stream) : ODESolver<Val, StepT>::ODESolver(),
+			nbVals(0), nbFast(0), subStep(0)
+		{
+			LoadFromStream(stream);
+		}
+
+		virtual void Solve(ODEProblem<Val, StepT> & prob, StepT start, StepT end)
+		{
+			nbVals = prob.GetNbVals();
+			nbFast = std::min(prob.GetNbFastVals(), nbVals);
+			for (unsigned int i = 0 ; i < 4 ; ++i)
+				k[i].assign(nbVals, 0);
+			tempVal.assign(nbVals, 0);
+			fastStart.assign(prob.vals, prob.vals + nbFast);
+			fastEnd.assign(nbFast, 0);
+			subStep = 0;
+			solveEnd = end;
+
+			ODESolver<Val, StepT>::Solve(prob, start, end);
+			// The problem stopped the integration in a macro step
+			if (subStep > 0)
+				slowStep(prob, this->currTime);
+
+			for (unsigned int i = 0 ; i < 4 ; ++i)
+				k[i].clear();
+			tempVal.clear();
+			fastStart.clear();
+			fastEnd.clear();
+			nbVals = 0;
+			nbFast = 0;
+		}
+		// Return class name
+		virtual std::string GetClassName() const { return ClassName; }
+
+		//===========================================================||
+		// Standard Save and Load methods                            ||
+		//===========================================================||
+		virtual bool LoadFromStream(std::ifstream & stream)
+		{
+			ODESolver<Val, StepT>::LoadFromStream(stream);
+			int tmpInterp;
+			stream >> nbSubSteps;
+			stream >> tmpInterp;
+			interp = (FastInterpolation) tmpInterp;
+			return stream.good();
+		}
+		virtual bool SaveToStream(std::ofstream & stream) const
+		{
+			ODESolver<Val, StepT>::SaveToStream(stream);
+			stream 
+				<< nbSubSteps << std::endl
+				<< (int) interp << std::endl;
+			return stream.good();
+		}
+
+	protected:
+		unsigned int nbSubSteps;   // Number of fast steps per slow step (K)
+		FastInterpolation interp;  // Fast values seen by the slow stages
+
+		unsigned int nbVals;
+		unsigned int nbFast;
+		unsigned int subStep;
+		StepT solveEnd;
+		std::vector<Val> k[4];
+		std::vector<Val> tempVal;
+		std::vector<Val> fastStart;
+		std::vector<Val> fastEnd;
+
+		virtual void DoStep(ODEProblem<Val, StepT> & prob)
+		{
+			rungeKuttaStep(prob, 0, nbFast, this->currTime, this->stepSize, true);
+			if (nbFast == nbVals)
+				return;
+			// The last macro step is shortened to the remaining fast steps
+			if ((++subStep < nbSubSteps) and (this->currTime + this->stepSize <= solveEnd))
+				return;
+			slowStep(prob, this->currTime + this->stepSize);
+		}
+
+		// Slow macro step over the last subStep fast steps, ending at t
+		void slowStep(ODEProblem<Val, StepT> & prob, StepT t)
+		{
+			fastEnd.assign(prob.vals, prob.vals + nbFast);
+			StepT H = this->stepSize * subStep;
+			subStep = 0;
+			rungeKuttaStep(prob, nbFast, nbVals, t - H, H, false);
+			for (unsigned int i = 0 ; i < nbFast ; ++i)
+				prob.vals[i] = fastEnd[i];
+			fastStart.swap(fastEnd);
+		}
+
+		// Sets the fast values seen by a slow stage at fraction frac of 
+		// the macro step
+		void setFastVals(ODEProblem<Val, StepT> & prob, Val frac)
+		{
+			if (interp == Linear)
+				for (unsigned int i = 0 ; i < nbFast ; ++i)
+					prob.vals[i] = fastStart[i] + frac * (fastEnd[i] - fastStart[i]);
+			else
+				for (unsigned int i = 0 ; i < nbFast ; ++i)
+					prob.vals[i] = fastStart[i];
+		}
+
+		// Classical RK4 step on values [iStart, iEnd)
+		void rungeKuttaStep(ODEProblem<Val, StepT> & prob, unsigned int iStart, 
+			unsigned int iEnd, StepT t, StepT h, bool fast)
+		{
+			static const Val stageFrac[4] = {0.0, 0.5, 0.5, 1.0};
+			for (unsigned int i = iStart ; i < iEnd ; ++i)
+				tempVal[i] = prob.vals[i];
+
+			for (unsigned int s = 0 ; s < 4 ; ++s)
+			{
+				if (s > 0)
+					for (unsigned int i = iStart ; i < iEnd ; ++i)
+						prob.vals[i] = tempVal[i] + stageFrac[s] * k[s - 1][i];
+				if (fast)
+					prob.function->CompFastFunc(t + stageFrac[s] * h, prob.vals, &k[s][0]);
+				else
+				{
+					setFastVals(prob, stageFrac[s]);
+					prob.function->CompSlowFunc(t + stageFrac[s] * h, prob.vals, &k[s][0]);
+				}
+				for (unsigned int i = iStart ; i < iEnd ; ++i)
+					k[s][i] = h * k[s][i];
+			}
+
+			for (unsigned int i = iStart ; i < iEnd ; ++i)
+				prob.vals[i] = tempVal[i] + k[0][i] / 6.0 + k[1][i] / 3.0 + k[2][i] / 3.0 + k[3][i] / 6.0;
+		}
+	};
+
+/**********************************************************************/
+/* Strang Splitting Solver                                            */
+/**********************************************************************/
+	// Each step is split into a coupling half step, a full step of the 
+	// local (per block) dynamics and another coupling half step. Coupling
+	// terms are integrated by the problem (see IntegrateCoupling), local 
+	// dynamics with fourth order Runge Kutta substeps, blocks being 
+	// integrated in parallel. Problems that can't be split are integrated
+	// with plain fourth order Runge Kutta.
+	template <typename Val = double, typename StepT = double> class SplittingSolver : public ODESolver<Val, StepT>
+	{
+	public:
+		static std::string ClassName;
+
+		SplittingSolver(ParamHandler & h = ParamHandler::GlobalParams) : 
+			ODESolver<Val, StepT>::ODESolver(), nbVals(0), blockSize(1)
+		{
+			nbLocalSubSteps = std::max(1, h.getParam<int>("-SplittingSolver", 0));
+			nbThreads = std::max(1, h.getParam<int>("-SplittingSolver", 1));
+		}
+		SplittingSolver(std::ifstream & stream) : ODESolver<Val, StepT>::ODESolver(),
+			nbVals(0), blockSize(1)
+		{
+			LoadFromStream(stream);
+		}
+
+		virtual void Solve(ODEProblem<Val, StepT> & prob, StepT start, StepT end)
+		{
+			nbVals = prob.GetNbVals();
+			blockSize = std::max(1u, prob.GetJacobianBlockSize());
+			unsigned int size = std::max(nbVals, blockSize);
+			scratch.assign(GetNbParallelWorkers(nbVals / blockSize, nbThreads), 
+				std::vector<Val>(5 * size, 0));
+
+			ODESolver<Val, StepT>::Solve(prob, start, end);
+
+			scratch.clear();
+			nbVals = 0;
+		}
+		// Return class name
+		virtual std::string GetClassName() const { return ClassName; }
+
+		//===========================================================||
+		// Standard Save and Load methods                            ||
+		//===========================================================||
+		virtual bool LoadFromStream(std::ifstream & stream)
+		{
+			ODESolver<Val, StepT>::LoadFromStream(stream);
+			stream >> nbLocalSubSteps;
+			stream >> nbThreads;
+			return stream.good();
+		}
+		virtual bool SaveToStream(std::ofstream & stream) const
+		{
+			ODESolver<Val, StepT>::SaveToStream(stream);
+			stream 
+				<< nbLocalSubSteps << std::endl
+				<< nbThreads << std::endl;
+			return stream.good();
+		}
+
+	protected:
+		unsigned int nbLocalSubSteps; // Local substeps per step
+		unsigned int nbThreads;       // Threads integrating local dynamics
+
+		unsigned int nbVals;
+		unsigned int blockSize;
+		// Per thread buffers : stage values and 4 stage derivatives
+		std::vector<std::vector<Val> > scratch;
+		WorkerPool pool;
+
+		// Integrates the local dynamics of a block
+		struct LocalStep
+		{
+			SplittingSolver *solver;
+			ODEProblem<Val, StepT> *prob;
+			StepT t;
+			StepT h;
+			void operator()(unsigned int block, unsigned int thread)
+			{
+				solver->localStep(*prob, block, thread, t, h);
+			}
+		};
+
+		virtual void DoStep(ODEProblem<Val, StepT> & prob)
+		{
+			const StepT t = this->currTime;
+			const StepT h = this->stepSize;
+			if (not prob.PrepareSplitStep(t))
+			{
+				rungeKuttaStep(prob, t, h);
+				return;
+			}
+
+			prob.IntegrateCoupling(t, h / 2.0);
+
+			LocalStep task;
+			task.solver = this;
+			task.prob = &prob;
+			task.t = t;
+			task.h = h;
+			pool.ParallelFor(nbVals / blockSize, nbThreads, task);
+
+			prob.IntegrateCoupling(t + h / 2.0, h / 2.0);
+			prob.FinishSplitStep(t, h);
+		}
+
+		void localStep(ODEProblem<Val, StepT> & prob, unsigned int block, 
+			unsigned int thread, StepT t, StepT h)
+		{
+			const unsigned int bs = blockSize;
+			Val *y = prob.vals + block * bs;
+			Val *tmp = &scratch[thread][0];
+			Val *k1 = tmp + bs;
+			Val *k2 = tmp + 2 * bs;
+			Val *k3 = tmp + 3 * bs;
+			Val *k4 = tmp + 4 * bs;
+			const StepT hs = h / nbLocalSubSteps;
+			for (unsigned int sub = 0 ; sub < nbLocalSubSteps ; ++sub)
+			{
+				StepT ts = t + sub * hs;
+				prob.CompLocalFunc(ts, block, y, k1);
+				for (unsigned int i = 0 ; i < bs ; ++i)
+					tmp[i] = y[i] + hs / 2.0 * k1[i];
+				prob.CompLocalFunc(ts + hs / 2.0, block, tmp, k2);
+				for (unsigned int i = 0 ; i < bs ; ++i)
+					tmp[i] = y[i] + hs / 2.0 * k2[i];
+				prob.CompLocalFunc(ts + hs / 2.0, block, tmp, k3);
+				for (unsigned int i = 0 ; i < bs ; ++i)
+					tmp[i] = y[i] + hs * k3[i];
+				prob.CompLocalFunc(ts + hs, block, tmp, k4);
+				for (unsigned int i = 0 ; i < bs ; ++i)
+					y[i] += hs * (k1[i] / 6.0 + k2[i] / 3.0 + k3[i] / 3.0 + k4[i] / 6.0);
+			}
+		}
+
+		// Full RK4 step, for problems that can't be split
+		void rungeKuttaStep(ODEProblem<Val, StepT> & prob, StepT t, StepT h)
+		{
+			std::vector<Val> & buf = scratch[0];
+			Val *y0 = &buf[0];
+			Val *k = y0 + nbVals;
+			Val *acc = y0 + 2 * nbVals;
+			static const Val stageFrac[4] = {0.0, 0.5, 0.5, 1.0};
+			static const Val weights[4] = {1.0 / 6.0, 1.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0};
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+			{
+				y0[i] = prob.vals[i];
+				acc[i] = 0;
+			}
+			for (unsigned int s = 0 ; s < 4 ; ++s)
+			{
+				prob.function->CompFunc(t + stageFrac[s] * h, prob.vals, k);
+				for (unsigned int i = 0 ; i < nbVals ; ++i)
+				{
+					acc[i] += weights[s] * h * k[i];
+					if (s < 3)
+						prob.vals[i] = y0[i] + stageFrac[s + 1] * h * k[i];
+				}
+			}
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+				prob.vals[i] = y0[i] + acc[i];
+		}
+	};
+
+/**********************************************************************/
+/* Rosenbrock Solver (linearly implicit)                              */
+/**********************************************************************/
+	// Two stages L-stable Rosenbrock method (ROS2, gamma = 1 + 1/sqrt(2)).
+	// Since it is a W-method, the jacobian only needs to be approximate
+	// and can be kept for several steps. It is assembled on the sparsity
+	// pattern given by the problem, from CompJacobian if available, from 
+	// colored finite differences otherwise. Linear systems are solved with
+	// block Jacobi preconditioned BiCGSTAB.
+	template <typename Val = double, typename StepT = double> class RosenbrockSolver : public ODESolver<Val, StepT>
+	{
+	public:
+		static std::string ClassName;
+
+		RosenbrockSolver(ParamHandler & h = ParamHandler::GlobalParams) : 
+			ODESolver<Val, StepT>::ODESolver(), nbVals(0), blockSize(1), 
+			nbColors(0), stepsSinceJac(0), jacStep(0)
+		{
+			jacUpdatePeriod = std::max(1, h.getParam<int>("-RosenbrockSolver", 0));
+			linTol = h.getParam<double>("-RosenbrockSolver", 1);
+			linMaxIter = h.getParam<unsigned int>("-RosenbrockSolver", 2);
+		}
+		RosenbrockSolver(std::ifstream & stream) : ODESolver<Val, StepT>::ODESolver(),
+			nbVals(0), blockSize(1), nbColors(0), stepsSinceJac(0), jacStep(0)
+		{
+			LoadFromStream(stream);
+		}
+
+		virtual void Solve(ODEProblem<Val, StepT> & prob, StepT start, StepT end)
+		{
+			nbVals = prob.GetNbVals();
+			y0.assign(nbVals, 0);
+			f0.assign(nbVals, 0);
+			f1.assign(nbVals, 0);
+			k1.assign(nbVals, 0);
+			k2.assign(nbVals, 0);
+			rhs.assign(nbVals, 0);
+			setUpJacobian(prob);
+			stepsSinceJac = 0;
+
+			ODESolver<Val, StepT>::Solve(prob, start, end);
+
+			y0.clear();
+			f0.clear();
+			f1.clear();
+			k1.clear();
+			k2.clear();
+			rhs.clear();
+			nbVals = 0;
+		}
+		// Return class name
+		virtual std::string GetClassName() const { return ClassName; }
+		virtual bool UsesJacobian() const { return true; }
+
+		//===========================================================||
+		// Standard Save and Load methods                            ||
+		//===========================================================||
+		virtual bool LoadFromStream(std::ifstream & stream)
+		{
+			ODESolver<Val, StepT>::LoadFromStream(stream);
+			stream >> jacUpdatePeriod;
+			stream >> linTol;
+			stream >> linMaxIter;
+			return stream.good();
+		}
+		virtual bool SaveToStream(std::ofstream & stream) const
+		{
+			ODESolver<Val, StepT>::SaveToStream(stream);
+			stream 
+				<< jacUpdatePeriod << std::endl
+				<< linTol << std::endl
+				<< linMaxIter << std::endl;
+			return stream.good();
+		}
+
+	protected:
+		unsigned int jacUpdatePeriod; // Number of steps between jacobian updates
+		Val linTol;                   // Relative tolerance of the linear solver
+		unsigned int linMaxIter;      // Max number of linear solver iterations
+
+		unsigned int nbVals;
+		unsigned int blockSize;
+		SparseMatrix<Val> jac;   // Jacobian of the problem
+		SparseMatrix<Val> W;     // I - gamma * h * jac
+		std::vector<int> diagPos;
+		BlockJacobiPreconditioner<Val> precond;
+		// Colored finite differences
+		std::vector<unsigned int> colors;
+		unsigned int nbColors;
+		std::vector<std::vector<unsigned int> > colorCols;
+		std::vector<std::vector<std::pair<unsigned int, unsigned int> > > colEntries;
+		unsigned int stepsSinceJac;
+		StepT jacStep;
+
+		std::vector<Val> y0, f0, f1, k1, k2, rhs;
+
+		static inline Val Gamma() { return 1.0 + 1.0 / sqrt(2.0); }
+
+		virtual void DoStep(ODEProblem<Val, StepT> & prob)
+		{
+			const StepT h = this->stepSize;
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+				y0[i] = prob.vals[i];
+			prob.function->CompFunc(this->currTime, prob.vals, &f0[0]);
+
+			if ((stepsSinceJac == 0) or (jacStep != h))
+			{
+				updateJacobian(prob);
+				updateIterationMatrix(h);
+			}
+			stepsSinceJac = (stepsSinceJac + 1) % jacUpdatePeriod;
+
+			// W k1 = f(y0)
+			solveLinear(&f0[0], &k1[0]);
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+				prob.vals[i] = y0[i] + h * k1[i];
+
+			// W k2 = f(y0 + h k1) - 2 k1
+			prob.function->CompFunc(this->currTime + h, prob.vals, &f1[0]);
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+			{
+				rhs[i] = f1[i] - 2.0 * k1[i];
+				k2[i] = -k1[i];
+			}
+			solveLinear(&rhs[0], &k2[0]);
+
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+				prob.vals[i] = y0[i] + h * (1.5 * k1[i] + 0.5 * k2[i]);
+		}
+
+		// Builds the sparse structures and the column coloring
+		void setUpJacobian(ODEProblem<Val, StepT> & prob)
+		{
+			std::vector<std::vector<unsigned int> > pattern;
+			if (not prob.GetJacobianPattern(pattern))
+			{
+				pattern.assign(nbVals, std::vector<unsigned int>(nbVals));
+				for (unsigned int i = 0 ; i < nbVals ; ++i)
+					for (unsigned int j = 0 ; j < nbVals ; ++j)
+						pattern[i][j] = j;
+			}
+			assert(pattern.size() == nbVals);
+			// The diagonal is always needed for W
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+				pattern[i].push_back(i);
+			jac.SetPattern(pattern);
+			W.SetPattern(pattern);
+			blockSize = prob.GetJacobianBlockSize();
+
+			diagPos.assign(nbVals, -1);
+			colEntries.assign(nbVals, std::vector<std::pair<unsigned int, unsigned int> >());
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+			{
+				diagPos[i] = jac.Find(i, i);
+				for (unsigned int p = jac.rowStart[i] ; p < jac.rowStart[i + 1] ; ++p)
+					colEntries[jac.colInds[p]].push_back(std::make_pair(i, p));
+			}
+			nbColors = ComputeColumnColoring(jac, nbVals, colors);
+			colorCols.assign(nbColors, std::vector<unsigned int>());
+			for (unsigned int j = 0 ; j < nbVals ; ++j)
+				colorCols[colors[j]].push_back(j);
+		}
+
+		// Jacobian at y0 (prob.vals is restored to y0 afterwards)
+		void updateJacobian(ODEProblem<Val, StepT> & prob)
+		{
+			jac.SetZero();
+			if (prob.CompJacobian(this->currTime, jac))
+				return;
+
+			const Val sqrtEps = sqrt(DBL_EPSILON);
+			std::vector<Val> eps(nbVals);
+			for (unsigned int c = 0 ; c < nbColors ; ++c)
+			{
+				for (unsigned int k = 0 ; k < colorCols[c].size() ; ++k)
+				{
+					unsigned int j = colorCols[c][k];
+					eps[j] = sqrtEps * std::max(fabs(y0[j]), (Val)1e-3);
+					prob.vals[j] = y0[j] + eps[j];
+					// Exactly representable perturbation
+					eps[j] = prob.vals[j] - y0[j];
+				}
+				prob.function->CompFunc(this->currTime, prob.vals, &f1[0]);
+				for (unsigned int k = 0 ; k < colorCols[c].size() ; ++k)
+				{
+					unsigned int j = colorCols[c][k];
+					for (unsigned int e = 0 ; e < colEntries[j].size() ; ++e)
+						jac.values[colEntries[j][e].second] = 
+							(f1[colEntries[j][e].first] - f0[colEntries[j][e].first]) / eps[j];
+					prob.vals[j] = y0[j];
+				}
+			}
+		}
+
+		// W = I - gamma * h * J, and its preconditioner
+		void updateIterationMatrix(StepT h)
+		{
+			const Val gh = Gamma() * h;
+			for (unsigned int p = 0 ; p < jac.values.size() ; ++p)
+				W.values[p] = -gh * jac.values[p];
+			for (unsigned int i = 0 ; i < nbVals ; ++i)
+				W.values[diagPos[i]] += 1.0;
+			precond.Factorize(W, blockSize);
+			jacStep = h;
+		}
+
+		// Solves W x = b, x holds the initial guess
+		void solveLinear(const Val *b, Val *x)
+		{
+			if (SolveBiCGSTAB(W, precond, b, x, linTol, linMaxIter) < 0)
+				std::cerr << "Warning : Rosenbrock linear solver did not converge at t = "
+					<< this->currTime << std::endl;
+		}
+	};
 }
 
 #endif
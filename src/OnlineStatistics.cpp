@@ -0,0 +1,371 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#include "OnlineStatistics.h"
+
+#include <math.h>
+#include <algorithm>
+#include <gsl/gsl_statistics.h>
+
+using namespace std;
+
+//********************************************************************//
+//************* W E L F O R D   A C C U M U L A T O R ****************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+void WelfordAccumulator::Add(double x)
+{
+	if (count == 0)
+		min = max = x;
+	else
+	{
+		min = std::min(min, x);
+		max = std::max(max, x);
+	}
+	count += 1.0;
+	double delta = x - mean;
+	mean += delta / count;
+	m2 += delta * (x - mean);
+}
+
+//**********************************************************************
+//**********************************************************************
+void WelfordAccumulator::Merge(const WelfordAccumulator & other)
+{
+	if (other.count == 0)
+		return;
+	if (count == 0)
+	{
+		*this = other;
+		return;
+	}
+	double newCount = count + other.count;
+	double delta = other.mean - mean;
+	mean += delta * other.count / newCount;
+	m2 += other.m2 + delta * delta * count * other.count / newCount;
+	count = newCount;
+	min = std::min(min, other.min);
+	max = std::max(max, other.max);
+}
+
+//**********************************************************************
+//**********************************************************************
+double WelfordAccumulator::GetVar(bool corrected) const
+{
+	if (corrected)
+		return (count > 1) ? m2 / (count - 1.0) : 0;
+	return (count > 0) ? m2 / count : 0;
+}
+
+//**********************************************************************
+//**********************************************************************
+double WelfordAccumulator::GetStdDev() const
+{
+	return sqrt(GetVar());
+}
+
+//********************************************************************//
+//************************* T - D I G E S T **************************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+TDigest::TDigest(double _compression) : compression(_compression),
+	totalWeight(0), bufferWeight(0), min(0), max(0)
+{
+}
+
+//**********************************************************************
+//**********************************************************************
+void TDigest::Add(double x, double w)
+{
+	if (GetTotalWeight() == 0)
+		min = max = x;
+	else
+	{
+		min = std::min(min, x);
+		max = std::max(max, x);
+	}
+	buffer.push_back(Centroid(x, w));
+	bufferWeight += w;
+	if (buffer.size() >= 5 * compression)
+		compress();
+}
+
+//**********************************************************************
+//**********************************************************************
+void TDigest::Merge(const TDigest & other)
+{
+	if (other.GetTotalWeight() == 0)
+		return;
+	if (GetTotalWeight() == 0)
+	{
+		min = other.min;
+		max = other.max;
+	}
+	else
+	{
+		min = std::min(min, other.min);
+		max = std::max(max, other.max);
+	}
+	buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+	buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+	bufferWeight += other.totalWeight + other.bufferWeight;
+	compress();
+}
+
+//**********************************************************************
+//**********************************************************************
+void TDigest::Clear()
+{
+	centroids.clear();
+	buffer.clear();
+	totalWeight = 0;
+	bufferWeight = 0;
+	min = max = 0;
+}
+
+//**********************************************************************
+//**********************************************************************
+unsigned int TDigest::GetNbCentroids() const
+{
+	compress();
+	return centroids.size();
+}
+
+//**********************************************************************
+// k1 scale function : small centroids near the tails
+//**********************************************************************
+double TDigest::scaleK(double q) const
+{
+	return compression / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+
+//**********************************************************************
+//**********************************************************************
+double TDigest::scaleKInv(double k) const
+{
+	return (sin(k * 2.0 * M_PI / compression) + 1.0) / 2.0;
+}
+
+//**********************************************************************
+// Merges the buffer into the centroid list
+//**********************************************************************
+void TDigest::compress() const
+{
+	if (buffer.empty())
+		return;
+
+	buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+	std::sort(buffer.begin(), buffer.end());
+	totalWeight += bufferWeight;
+	bufferWeight = 0;
+	centroids.clear();
+
+	Centroid curr = buffer[0];
+	double weightSoFar = 0;
+	double qLimit = scaleKInv(scaleK(0) + 1.0) * totalWeight;
+	for (unsigned int i = 1 ; i < buffer.size() ; ++i)
+	{
+		if (weightSoFar + curr.weight + buffer[i].weight <= qLimit)
+		{
+			curr.weight += buffer[i].weight;
+			curr.mean += (buffer[i].mean - curr.mean) * buffer[i].weight / curr.weight;
+		}
+		else
+		{
+			weightSoFar += curr.weight;
+			centroids.push_back(curr);
+			qLimit = scaleKInv(scaleK(weightSoFar / totalWeight) + 1.0) * totalWeight;
+			curr = buffer[i];
+		}
+	}
+	centroids.push_back(curr);
+	buffer.clear();
+}
+
+//**********************************************************************
+// Interpolates between centroid centers, using min and max at the tails
+//**********************************************************************
+double TDigest::Quantile(double q) const
+{
+	compress();
+	if (centroids.empty())
+		return 0;
+	if (centroids.size() == 1)
+		return centroids[0].mean;
+
+	q = std::max(0.0, std::min(1.0, q));
+	double index = q * totalWeight;
+	if (index < centroids[0].weight / 2.0)
+		return min + (centroids[0].mean - min) * index / (centroids[0].weight / 2.0);
+
+	double cumul = centroids[0].weight / 2.0;
+	for (unsigned int i = 0 ; i + 1 < centroids.size() ; ++i)
+	{
+		double dw = (centroids[i].weight + centroids[i + 1].weight) / 2.0;
+		if (cumul + dw > index)
+		{
+			double z = (index - cumul) / dw;
+			return centroids[i].mean + z * (centroids[i + 1].mean - centroids[i].mean);
+		}
+		cumul += dw;
+	}
+	const Centroid & last = centroids.back();
+	double z = (index - cumul) / (last.weight / 2.0);
+	return last.mean + std::min(1.0, z) * (max - last.mean);
+}
+
+//********************************************************************//
+//*************** F I X E D   B I N   H I S T O G R A M **************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+FixedBinHistogram::FixedBinHistogram(double _min, double _max, unsigned int _nbBins) :
+	min(_min), max(_max), binWidth(_nbBins > 0 ? (_max - _min) / (double)_nbBins : 0),
+	counts(_nbBins, 0), underflow(0), overflow(0)
+{
+}
+
+//**********************************************************************
+//**********************************************************************
+void FixedBinHistogram::Add(double x)
+{
+	if (counts.empty())
+		return;
+	if (x < min)
+		underflow += 1.0;
+	else if (x >= max)
+		overflow += 1.0;
+	else
+		counts[std::min((unsigned int)counts.size() - 1, (unsigned int)((x - min) / binWidth))] += 1.0;
+}
+
+//**********************************************************************
+//**********************************************************************
+bool FixedBinHistogram::Merge(const FixedBinHistogram & other)
+{
+	if ((other.counts.size() != counts.size()) or (other.min != min) or (other.max != max))
+		return false;
+	for (unsigned int i = 0 ; i < counts.size() ; ++i)
+		counts[i] += other.counts[i];
+	underflow += other.underflow;
+	overflow += other.overflow;
+	return true;
+}
+
+//**********************************************************************
+//**********************************************************************
+void FixedBinHistogram::Clear()
+{
+	counts.assign(counts.size(), 0);
+	underflow = 0;
+	overflow = 0;
+}
+
+//**********************************************************************
+// Format : bin start, count (first and last lines are under / overflow)
+//**********************************************************************
+bool FixedBinHistogram::SaveToStream(std::ostream & stream) const
+{
+	stream << "-inf\t" << underflow << std::endl;
+	for (unsigned int i = 0 ; i < counts.size() ; ++i)
+		stream << GetBinStart(i) << "\t" << counts[i] << std::endl;
+	stream << max << "\t" << overflow << std::endl;
+	return stream.good();
+}
+
+//********************************************************************//
+//***************** O N L I N E   S T A T   P A R A M S **************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+OnlineStatParams::OnlineStatParams(ParamHandler & h)
+{
+	keepRaw = h.getParam<bool>("-OnlineStatsKeepRaw", 0);
+	compression = h.getParam<double>("-OnlineStats", 0);
+	nbBins = h.getParam<unsigned int>("-OnlineStats", 1);
+	binMin = h.getParam<double>("-OnlineStats", 2);
+	binMax = h.getParam<double>("-OnlineStats", 3);
+}
+
+//********************************************************************//
+//****************** O N L I N E   S T A T I S T I C *****************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+OnlineStatistic::OnlineStatistic(const OnlineStatParams & p) : keepRaw(p.keepRaw),
+	compression(p.compression), last(0), digest(p.compression > 0 ? p.compression : 1),
+	histogram(p.binMin, p.binMax, p.nbBins)
+{
+}
+
+//**********************************************************************
+//**********************************************************************
+void OnlineStatistic::Add(double x)
+{
+	last = x;
+	moments.Add(x);
+	if (keepRaw)
+		raw.push_back(x);
+	else if (compression > 0)
+		digest.Add(x);
+	histogram.Add(x);
+}
+
+//**********************************************************************
+//**********************************************************************
+void OnlineStatistic::Merge(const OnlineStatistic & other)
+{
+	if (other.GetCount() == 0)
+		return;
+	last = other.last;
+	moments.Merge(other.moments);
+	raw.insert(raw.end(), other.raw.begin(), other.raw.end());
+	digest.Merge(other.digest);
+	histogram.Merge(other.histogram);
+}
+
+//**********************************************************************
+//**********************************************************************
+void OnlineStatistic::Clear()
+{
+	last = 0;
+	moments.Clear();
+	digest.Clear();
+	histogram.Clear();
+	raw.clear();
+}
+
+//**********************************************************************
+//**********************************************************************
+double OnlineStatistic::Quantile(double q) const
+{
+	if (keepRaw)
+	{
+		if (raw.empty())
+			return 0;
+		std::vector<double> sorted(raw);
+		std::sort(sorted.begin(), sorted.end());
+		return gsl_stats_quantile_from_sorted_data(&sorted[0], 1, sorted.size(), q);
+	}
+	return digest.Quantile(q);
+}
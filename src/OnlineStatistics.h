@@ -0,0 +1,176 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#ifndef ONLINESTATISTICS_H
+#define ONLINESTATISTICS_H
+
+#include <iostream>
+#include <vector>
+
+#include "ParamHandler.h"
+
+// Single pass statistics. All accumulators can be merged, so that
+// partial results computed by parallel workers can be combined in any
+// order.
+
+/**********************************************************************/
+/* Mean / variance accumulator (Welford)                              */
+/**********************************************************************/
+class WelfordAccumulator
+{
+public:
+	WelfordAccumulator() : count(0), mean(0), m2(0), min(0), max(0) {}
+
+	void Add(double x);
+	// Combines two accumulators (Chan et al. pairwise update)
+	void Merge(const WelfordAccumulator & other);
+	void Clear() { *this = WelfordAccumulator(); }
+
+	inline double GetCount() const { return count; }
+	inline double GetMean() const { return mean; }
+	// Variance (divided by n, or n - 1 if corrected)
+	double GetVar(bool corrected = false) const;
+	double GetStdDev() const;
+	inline double GetMin() const { return min; }
+	inline double GetMax() const { return max; }
+
+protected:
+	double count;
+	double mean;
+	double m2;
+	double min;
+	double max;
+};
+
+/**********************************************************************/
+/* Quantile estimator (merging t-digest)                              */
+/**********************************************************************/
+class TDigest
+{
+public:
+	TDigest(double _compression = 100);
+
+	void Add(double x, double w = 1.0);
+	void Merge(const TDigest & other);
+	void Clear();
+
+	// Estimated value of quantile q (in [0, 1])
+	double Quantile(double q) const;
+	inline double GetTotalWeight() const { return totalWeight + bufferWeight; }
+	unsigned int GetNbCentroids() const;
+
+protected:
+	struct Centroid
+	{
+		double mean;
+		double weight;
+		Centroid(double m = 0, double w = 0) : mean(m), weight(w) {}
+		bool operator<(const Centroid & c) const { return mean < c.mean; }
+	};
+
+	double compression;
+	mutable std::vector<Centroid> centroids;
+	mutable std::vector<Centroid> buffer;
+	mutable double totalWeight;
+	mutable double bufferWeight;
+	double min;
+	double max;
+
+	// Merges buffered points into the centroids
+	void compress() const;
+	double scaleK(double q) const;
+	double scaleKInv(double k) const;
+};
+
+/**********************************************************************/
+/* Fixed bins histogram                                               */
+/**********************************************************************/
+class FixedBinHistogram
+{
+public:
+	FixedBinHistogram(double _min = 0, double _max = 1, unsigned int _nbBins = 0);
+
+	void Add(double x);
+	// Both histograms must share the same binning
+	bool Merge(const FixedBinHistogram & other);
+	void Clear();
+
+	inline unsigned int GetNbBins() const { return counts.size(); }
+	inline double GetBinStart(unsigned int i) const { return min + i * binWidth; }
+	inline double GetCount(unsigned int i) const { return counts[i]; }
+	inline double GetUnderflow() const { return underflow; }
+	inline double GetOverflow() const { return overflow; }
+
+	bool SaveToStream(std::ostream & stream) const;
+
+protected:
+	double min;
+	double max;
+	double binWidth;
+	std::vector<double> counts;
+	double underflow;
+	double overflow;
+};
+
+/**********************************************************************/
+/* Accumulator settings                                               */
+/**********************************************************************/
+class OnlineStatParams
+{
+public:
+	OnlineStatParams(ParamHandler & h = ParamHandler::GlobalParams);
+
+	bool keepRaw;        // Keep raw values (exact quantiles)
+	double compression;  // t-digest compression, quantiles are not tracked if 0
+	unsigned int nbBins; // Histogram bins, no histogram if 0
+	double binMin;
+	double binMax;
+};
+
+/**********************************************************************/
+/* Full online statistic : moments, quantiles, histogram, raw values  */
+/**********************************************************************/
+class OnlineStatistic
+{
+public:
+	OnlineStatistic(const OnlineStatParams & p = OnlineStatParams());
+
+	void Add(double x);
+	void Merge(const OnlineStatistic & other);
+	void Clear();
+
+	inline double GetCount() const { return moments.GetCount(); }
+	inline double GetMean() const { return moments.GetMean(); }
+	inline double GetStdDev() const { return moments.GetStdDev(); }
+	inline double GetLast() const { return last; }
+	// Exact if raw values are kept, estimated from the t-digest otherwise
+	double Quantile(double q) const;
+	inline bool HasQuantiles() const { return keepRaw or (compression > 0); }
+	inline const WelfordAccumulator & GetMoments() const { return moments; }
+	inline const FixedBinHistogram & GetHistogram() const { return histogram; }
+	inline const std::vector<double> & GetRawValues() const { return raw; }
+
+protected:
+	bool keepRaw;
+	double compression;
+	double last;
+	WelfordAccumulator moments;
+	TDigest digest;
+	FixedBinHistogram histogram;
+	std::vector<double> raw;
+};
+
+#endif
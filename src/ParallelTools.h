@@ -0,0 +1,163 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+  
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#ifndef PARALLELTOOLS_H
+#define PARALLELTOOLS_H
+
+#include "ResultSaver.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+/**********************************************************************/
+/* Static parallel loop                                               */
+/**********************************************************************/
+// Number of threads used by ParallelFor
+inline unsigned int GetNbParallelWorkers(unsigned int nbTasks, unsigned int nbThreads)
+{
+	return std::max(1u, std::min(nbThreads, nbTasks));
+}
+
+template <typename F> void ParallelForBlock(F *f, unsigned int begin, 
+	unsigned int end, unsigned int thread)
+{
+	for (unsigned int i = begin ; i < end ; ++i)
+		(*f)(i, thread);
+}
+
+// Threads other than the calling one save table rows as separate workers
+template <typename F> void ParallelForWorker(F *f, unsigned int begin, 
+	unsigned int end, unsigned int thread)
+{
+	ResultSaver::AcquireWorkerId();
+	ParallelForBlock(f, begin, end, thread);
+	ResultSaver::ReleaseWorkerId();
+}
+
+// Calls f(task, thread) for each task in [0, nbTasks[. Tasks are split 
+// in contiguous blocks, one per thread, so that results accumulated per 
+// thread can be reduced in a deterministic order. Returns the number of
+// threads actually used.
+template <typename F> unsigned int ParallelFor(unsigned int nbTasks, 
+	unsigned int nbThreads, F & f)
+{
+	nbThreads = GetNbParallelWorkers(nbTasks, nbThreads);
+	std::vector<std::thread> threads;
+	for (unsigned int k = 1 ; k < nbThreads ; ++k)
+		threads.push_back(std::thread(&ParallelForWorker<F>, &f, 
+			(k * nbTasks) / nbThreads, ((k + 1) * nbTasks) / nbThreads, k));
+	ParallelForBlock(&f, 0, nbTasks / nbThreads, 0);
+	for (unsigned int k = 0 ; k < threads.size() ; ++k)
+		threads[k].join();
+	return nbThreads;
+}
+
+/**********************************************************************/
+/* Persistent pool of worker threads                                  */
+/**********************************************************************/
+// Same partition of tasks as ParallelFor, but threads are started once
+// and then wait for work, for loops run at each step of a simulation. 
+// Copies of a pool start their own threads.
+class WorkerPool
+{
+public:
+	WorkerPool() : generation(0), nbActive(0), pending(0), stopping(false) {}
+	WorkerPool(const WorkerPool & ) : generation(0), nbActive(0), pending(0), 
+		stopping(false) {}
+	WorkerPool & operator=(const WorkerPool & ) { return *this; }
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (unsigned int k = 0 ; k < threads.size() ; ++k)
+			threads[k].join();
+	}
+
+	template <typename F> unsigned int ParallelFor(unsigned int nbTasks, 
+		unsigned int nbThreads, F & f)
+	{
+		nbThreads = GetNbParallelWorkers(nbTasks, nbThreads);
+		if (nbThreads == 1)
+		{
+			ParallelForBlock(&f, 0, nbTasks, 0);
+			return 1;
+		}
+		while (threads.size() < nbThreads - 1)
+			threads.push_back(std::thread(&WorkerPool::workerLoop, this, 
+				threads.size() + 1));
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = [&f, nbTasks, nbThreads](unsigned int k) 
+				{ ParallelForBlock(&f, (k * nbTasks) / nbThreads, 
+					((k + 1) * nbTasks) / nbThreads, k); };
+			nbActive = nbThreads - 1;
+			pending = nbActive;
+			++generation;
+		}
+		wake.notify_all();
+		ParallelForBlock(&f, 0, nbTasks / nbThreads, 0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return pending == 0; });
+		return nbThreads;
+	}
+
+protected:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::function<void(unsigned int)> job;
+	unsigned long int generation;
+	unsigned int nbActive;
+	unsigned int pending;
+	bool stopping;
+
+	// Thread k runs the k-th block of each loop it takes part in
+	void workerLoop(unsigned int k)
+	{
+		ResultSaver::AcquireWorkerId();
+		unsigned long int seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [this, seen] { return stopping or (generation != seen); });
+			if (stopping)
+				break;
+			seen = generation;
+			if (k > nbActive)
+				continue;
+			std::function<void(unsigned int)> currJob = job;
+			lock.unlock();
+			currJob(k);
+			lock.lock();
+			if (--pending == 0)
+				done.notify_one();
+		}
+		lock.unlock();
+		ResultSaver::ReleaseWorkerId();
+	}
+};
+
+#endif
@@ -96,7 +96,7 @@ namespace AstroModel
 			std::string detailedActivCells("DetailedActivatedCells");
 			if (saver.isSaving(detailedActivCells) and not allStates.empty())
 			{
-				std::ofstream & stream = saver.getStream();
+				std::ostream & stream = saver.getStream();
 				this->AddSavedFile(detailedActivCells, saver.getCurrFile());
 
 				stream << "Time";
@@ -120,7 +120,7 @@ namespace AstroModel
 				std::vector<std::set<unsigned int> > cumulCounts;
 				std::vector<unsigned int> nbEachState;
 
-				std::ofstream & stream = saver.getStream();
+				std::ostream & stream = saver.getStream();
 				this->AddSavedFile(propagActivCells, saver.getCurrFile());
 
 				stream << "Time";
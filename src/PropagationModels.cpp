@@ -25,6 +25,8 @@ string ThresholdModel::ClassName = "ThresholdPropagationModel";
 string ModifiedThresholdModel::ClassName = "ModifiedThresholdPropagationModel";
 string SecondOrdNeighbSERSModel::ClassName = "SecondOrdNeighbSERSModel";
 string SimpleThresholdSERSModel::ClassName = "SimpleThresholdSERSModel";
+string BitSlicedThresholdModel::ClassName = "BitSlicedThresholdModel";
+string BitSlicedSERSModel::ClassName = "BitSlicedSERSModel";
 
 //********************************************************************//
 //******************* U T I L I T Y   C L A S S E S ******************//
@@ -146,11 +148,11 @@ unsigned int ThresholdModel::chooseNode() const
 //**********************************************************************
 BooleanWrapper ThresholdModel::getNewState(unsigned int ind) const
 {
-	std::set<unsigned int> neighbs(this->network->GetNeighbors(ind).begin(), this->network->GetNeighbors(ind).end());
+	const std::vector<unsigned int> & neighbs = this->network->GetNeighbors(ind);
 
 	double nbActNeighb = 0;
-	for (std::set<unsigned int>::iterator it = neighbs.begin() ; it != neighbs.end() ; ++it)
-		if (this->states[*it])
+	for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+		if (this->states[neighbs[j]])
 			++nbActNeighb;
 	return (neighbs.size() > 0) ? (((nbActNeighb / ((double) neighbs.size())) > threshold) ? BooleanWrapper(true) : this->states[ind]) : this->states[ind];
 }
@@ -206,19 +208,18 @@ BooleanWrapper ModifiedThresholdModel::getNewState(unsigned int ind) const
 {
 	if (not this->states[ind])
 	{
-		std::set<unsigned int> neighbs(this->network->GetNeighbors(ind).begin(), this->network->GetNeighbors(ind).end());
-		std::set<unsigned int> tempNeighbs;
+		const std::vector<unsigned int> & neighbs = this->network->GetNeighbors(ind);
 
 		double tempUnAct = 0;
 		double nbActNeighb = 0;
-		for (std::set<unsigned int>::iterator it = neighbs.begin() ; it != neighbs.end() ; ++it)
-			if (this->states[*it])
+		for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+			if (this->states[neighbs[j]])
 			{
 				// Count how many un activated neighbors the neighbhoring node has
 				tempUnAct = 0;
-				tempNeighbs = std::set<unsigned int>(this->network->GetNeighbors(*it).begin(), this->network->GetNeighbors(*it).end());
-				for (std::set<unsigned int>::iterator it2 = tempNeighbs.begin() ; it2 != tempNeighbs.end() ; ++it2)
-					if (not this->states[*it2])
+				const std::vector<unsigned int> & tempNeighbs = this->network->GetNeighbors(neighbs[j]);
+				for (unsigned int l = 0 ; l < tempNeighbs.size() ; ++l)
+					if (not this->states[tempNeighbs[l]])
 						++tempUnAct;
 				// set activating potential of current neighbor
 				nbActNeighb += propConst / tempUnAct;
@@ -244,6 +245,7 @@ SERSModel::SERSModel(ParamHandler & h) :
 	transTime  = h.getParam<double>("-SERSModel", 2);
 	stimRadius = h.getParam<double>("-SERSModel", 3);
 	stimPoints = param.getParam<std::vector<int> >("-SERSModelStims", 0);
+	eventDriven = h.getParam<bool>("-SERSEventDriven", 0);
 	stimOrderInd = 0;
 }
 
@@ -388,14 +390,14 @@ SERStates SERSModel::getNewState(unsigned int ind) const
 	{
 		if (this->states[ind] == Susceptible)
 		{
-			return TrueWithProba(this->probaSusceptibleToExcited(ind)) ?
+			return trueWithProba(this->probaSusceptibleToExcited(ind), ind) ?
 				SERStates(Excited) : this->states[ind];
 		}
 		else if (this->states[ind] == Excited)
-			return TrueWithProba(this->probaExcitedToRefractory(ind)) ? 
+			return trueWithProba(this->probaExcitedToRefractory(ind), ind) ? 
 				SERStates(Refractory) : this->states[ind];
 		else if (this->states[ind] == Refractory)
-			return TrueWithProba(this->probaRefractoryToSusceptible(ind)) ? 
+			return trueWithProba(this->probaRefractoryToSusceptible(ind), ind) ? 
 				SERStates(Susceptible) : this->states[ind];
 		else
 			return this->states[ind];
@@ -404,6 +406,147 @@ SERStates SERSModel::getNewState(unsigned int ind) const
 		return SERStates(Excited);
 }
 
+//**********************************************************************
+// Next reaction method : each node holds a putative transition time in
+// an indexed heap, only the nodes around the one that changed state 
+// are updated
+//**********************************************************************
+int SERSModel::Simulate(ResultSaver saver)
+{
+	if (not eventDriven or states.empty())
+		return PropagationModel<SERStates, BooleanLink>::Simulate(saver);
+
+	int returnVal = 0;
+
+	// Save wanted data
+	if (this->DebugMode())
+		std::cout << "*** Saving metric data ***" << std::endl;
+	this->network->ComputeAndSaveMetrics(saver);
+
+	// Simulate
+	if (this->DebugMode())
+		std::cout << "*** Starting Simulation ***" << std::endl;
+
+	unsigned int nbNodes = states.size();
+	double tEnd = ((double) (end - start)) / ((double) nbNodes);
+	nextTransitions.Reset(nbNodes);
+	rates.assign(nbNodes, 0);
+	affectedMark.assign(nbNodes, 0);
+	currMark = 0;
+	for (unsigned int i = 0 ; i < nbNodes ; ++i)
+		scheduleTransition(i, 0);
+
+	currStep = start;
+	while (not nextTransitions.Empty() and (nextTransitions.TopKey() <= tEnd) and 
+		not this->isFinished())
+	{
+		unsigned int ind = nextTransitions.Top();
+		double t = nextTransitions.TopKey();
+		SERStatesType curr = states[ind];
+		if (curr == Susceptible)
+			states[ind] = SERStates(Excited);
+		else if (curr == Excited)
+			states[ind] = SERStates(Refractory);
+		else
+			states[ind] = SERStates(Susceptible);
+		currStep = std::min(end, start + (unsigned int) floor(t * nbNodes));
+
+		scheduleTransition(ind, t);
+		updateAround(ind, t);
+		// Metrics computations
+		metrics.ComputeMetricsDefault(*this);
+	}
+	// Last state
+	currStep = end;
+	metrics.ComputeMetricsDefault(*this);
+
+	// Save computed dynamic data and metrics
+	if (this->DebugMode())
+		std::cout << "*** Saving dynamic data ***" << std::endl;
+	if (not metrics.SaveMetricsDefault(saver))
+		returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+
+	return returnVal;
+}
+
+//**********************************************************************
+// The transition probabilities of a visit become rates (stimulated 
+// nodes never leave the excited state)
+//**********************************************************************
+double SERSModel::transitionRate(unsigned int ind) const
+{
+	if (allStimNodes.find(ind) != allStimNodes.end())
+		return 0;
+	double p = 0;
+	if (this->states[ind] == Susceptible)
+		p = this->probaSusceptibleToExcited(ind);
+	else if (this->states[ind] == Excited)
+		p = this->probaExcitedToRefractory(ind);
+	else if (this->states[ind] == Refractory)
+		p = this->probaRefractoryToSusceptible(ind);
+	return std::max(0.0, p);
+}
+
+//**********************************************************************
+//**********************************************************************
+void SERSModel::scheduleTransition(unsigned int ind, double t)
+{
+	rates[ind] = transitionRate(ind);
+	nextTransitions.Update(ind, (rates[ind] > 0) ? t + ExpRand(1.0 / rates[ind]) : HUGE_VAL);
+}
+
+//**********************************************************************
+//**********************************************************************
+void SERSModel::rescaleTransition(unsigned int ind, double t)
+{
+	double newRate = transitionRate(ind);
+	if (newRate == rates[ind])
+		return;
+	double tNext = nextTransitions.GetKey(ind);
+	if ((rates[ind] > 0) and (newRate > 0) and (tNext != HUGE_VAL))
+		nextTransitions.Update(ind, t + (rates[ind] / newRate) * (tNext - t));
+	else
+		nextTransitions.Update(ind, (newRate > 0) ? t + ExpRand(1.0 / newRate) : HUGE_VAL);
+	rates[ind] = newRate;
+}
+
+//**********************************************************************
+// Nodes at distance at most probaRadius of ind, each one is rescaled 
+// once
+//**********************************************************************
+void SERSModel::updateAround(unsigned int ind, double t)
+{
+	unsigned int radius = this->probaRadius();
+	if (radius == 0)
+		return;
+	if (++currMark == 0)
+	{
+		affectedMark.assign(affectedMark.size(), 0);
+		currMark = 1;
+	}
+	affected.clear();
+	affected.push_back(ind);
+	affectedMark[ind] = currMark;
+	unsigned int first = 0;
+	for (unsigned int r = 0 ; r < radius ; ++r)
+	{
+		unsigned int last = affected.size();
+		for (unsigned int k = first ; k < last ; ++k)
+		{
+			const std::vector<unsigned int> & neighbs = this->network->GetNeighbors(affected[k]);
+			for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+				if (affectedMark[neighbs[j]] != currMark)
+				{
+					affectedMark[neighbs[j]] = currMark;
+					affected.push_back(neighbs[j]);
+				}
+		}
+		first = last;
+	}
+	for (unsigned int k = 1 ; k < affected.size() ; ++k)
+		rescaleTransition(affected[k], t);
+}
+
 //**********************************************************************
 //**********************************************************************
 double SERSModel::probaSusceptibleToExcited(unsigned int ) const
@@ -486,22 +629,19 @@ ParamHandler SecondOrdNeighbSERSModel::BuildModelParamHandler()
 double SecondOrdNeighbSERSModel::probaSusceptibleToExcited(
 	unsigned int ind) const
 {
-	std::set<unsigned int> neighbs(this->network->GetNeighbors(ind).begin(), this->network->GetNeighbors(ind).end());
-	std::set<unsigned int> tempNeighbs;
+	const std::vector<unsigned int> & neighbs = this->network->GetNeighbors(ind);
 	double gamma = 0;
 
 	double tempUnAct = 0;
 	double sumAlphas = 0;
-	for (std::set<unsigned int>::iterator it = neighbs.begin() ; 
-			it != neighbs.end() ; ++it)
-		if (this->states[*it] == Excited)
+	for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+		if (this->states[neighbs[j]] == Excited)
 		{
 			// Count how many unactivated neighbors the neighbhoring node has
 			tempUnAct = 0;
-			tempNeighbs = std::set<unsigned int>(this->network->GetNeighbors(*it).begin(), this->network->GetNeighbors(*it).end());
-			for (std::set<unsigned int>::iterator it2 = tempNeighbs.begin() ;
-					it2 != tempNeighbs.end() ; ++it2)
-				if (this->states[*it2] != Excited)
+			const std::vector<unsigned int> & tempNeighbs = this->network->GetNeighbors(neighbs[j]);
+			for (unsigned int l = 0 ; l < tempNeighbs.size() ; ++l)
+				if (this->states[tempNeighbs[l]] != Excited)
 					++tempUnAct;
 			// add activating potential of current neighbor to total
 			// activating potential
@@ -582,14 +722,12 @@ ParamHandler SimpleThresholdSERSModel::BuildModelParamHandler()
 double SimpleThresholdSERSModel::probaSusceptibleToExcited(
 	unsigned int ind) const
 {
-	std::set<unsigned int> neighbs(this->network->GetNeighbors(ind).begin(), this->network->GetNeighbors(ind).end());
-	std::set<unsigned int> tempNeighbs;
+	const std::vector<unsigned int> & neighbs = this->network->GetNeighbors(ind);
 
 	// Counting the number of excited neighbors
 	double nbActNeighbs = 0;
-	for (std::set<unsigned int>::iterator it = neighbs.begin() ; 
-			it != neighbs.end() ; ++it)
-		if (this->states[*it] == Excited)
+	for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+		if (this->states[neighbs[j]] == Excited)
 			++nbActNeighbs;
 
 	double k = ((double) neighbs.size());
@@ -612,3 +750,204 @@ double SimpleThresholdSERSModel::probaRefractoryToSusceptible(
 {
 	return recoveryProba;
 }
+
+//********************************************************************//
+//****************** B I T - S L I C E D   L A N E S *****************//
+//********************************************************************//
+
+//**********************************************************************
+// Sizes the lanes for the given network
+//**********************************************************************
+void BitSlicedLanes::SetUp(const AbstractNetwork & net, unsigned int _nbReplicas)
+{
+	nbReplicas = _nbReplicas;
+	nbWords = (nbReplicas + 63) / 64;
+	unsigned int maxDegree = 0;
+	for (unsigned int i = 0 ; i < net.size() ; ++i)
+		maxDegree = std::max(maxDegree, (unsigned int) net.GetNeighbors(i).size());
+	// Thresholds go up to maxDegree + 1 (never reached)
+	nbPlanes = 1;
+	while ((nbPlanes < 32) and ((1ULL << nbPlanes) <= maxDegree + 1ULL))
+		++nbPlanes;
+	thresholds.assign(net.size() * nbWords * nbPlanes, 0);
+}
+
+//**********************************************************************
+// Draws the threshold of each node in each replica
+//**********************************************************************
+void BitSlicedLanes::DrawThresholds(const AbstractNetwork & net, double base, 
+	double spread, bool strict, unsigned long long int key)
+{
+	thresholds.assign(net.size() * nbWords * nbPlanes, 0);
+	for (unsigned int i = 0 ; i < net.size() ; ++i)
+	{
+		unsigned int k = net.GetNeighbors(i).size();
+		unsigned long long int nodeKey = CounterRandKey(key, i);
+		for (unsigned int r = 0 ; r < nbReplicas ; ++r)
+		{
+			double thresh = (spread != 0) ? 
+				base + spread * (CounterUnifRand(nodeKey, r) - 0.5) : base;
+			// Smallest count that crosses the threshold, the comparison 
+			// is the one of the asynchronous models
+			unsigned int c = k + 1;
+			if (k > 0)
+			{
+				double tk = thresh * k;
+				c = (tk >= k) ? k : ((tk > 1.0) ? (unsigned int) floor(tk) - 1 : 0);
+				while ((c <= k) and not (strict ? (((double) c / (double) k) > thresh) : 
+						(((double) c / (double) k) >= thresh)))
+					++c;
+			}
+			uint64_t *th = &thresholds[(i * nbWords + r / 64) * nbPlanes];
+			for (unsigned int b = 0 ; b < nbPlanes ; ++b)
+				if ((c >> b) & 1)
+					th[b] |= ((uint64_t) 1) << (r % 64);
+		}
+	}
+}
+
+//**********************************************************************
+// Lanes of word w in which node i has reached its threshold. Active 
+// neighbors are added in bit planes (carries stop as soon as they are 
+// null) and the counts are compared to the thresholds from the most 
+// significant plane.
+//**********************************************************************
+uint64_t BitSlicedLanes::AboveThreshold(const AbstractNetwork & net, 
+	const uint64_t *active, unsigned int i, unsigned int w) const
+{
+	uint64_t count[32];
+	for (unsigned int b = 0 ; b < nbPlanes ; ++b)
+		count[b] = 0;
+
+	const std::vector<unsigned int> & neighbs = net.GetNeighbors(i);
+	for (unsigned int j = 0 ; j < neighbs.size() ; ++j)
+	{
+		uint64_t carry = active[neighbs[j] * nbWords + w];
+		for (unsigned int b = 0 ; carry and (b < nbPlanes) ; ++b)
+		{
+			uint64_t tmp = count[b] & carry;
+			count[b] ^= carry;
+			carry = tmp;
+		}
+	}
+
+	const uint64_t *th = &thresholds[(i * nbWords + w) * nbPlanes];
+	uint64_t greater = 0;
+	uint64_t equal = ~((uint64_t) 0);
+	for (unsigned int b = nbPlanes ; b-- > 0 ; )
+	{
+		greater |= equal & count[b] & ~th[b];
+		equal &= ~(count[b] ^ th[b]);
+	}
+	return greater | equal;
+}
+
+//**********************************************************************
+// Word whose bits are independently true with probability p. Each 
+// random word either ORed (bit of p is 1) or ANDed (bit is 0) from the 
+// least significant bit of p halves the distance to the target.
+//**********************************************************************
+uint64_t BitSlicedLanes::BernoulliWord(double p, unsigned long long int key, 
+	unsigned long long int counter)
+{
+	uint64_t q = (p <= 0) ? 0 : (uint64_t) floor(std::min(p, 1.0) * 4294967296.0 + 0.5);
+	if (q == 0)
+		return 0;
+	if (q >= (1ULL << 32))
+		return ~((uint64_t) 0);
+	unsigned int b = 0;
+	while (not ((q >> b) & 1))
+		++b;
+	uint64_t word = 0;
+	for ( ; b < 32 ; ++b)
+	{
+		uint64_t rnd = CounterRandBits(key, counter * 32 + b);
+		word = ((q >> b) & 1) ? (word | rnd) : (word & rnd);
+	}
+	return word;
+}
+
+//********************************************************************//
+//********* B I T - S L I C E D   T H R E S H O L D   M O D E L ******//
+//********************************************************************//
+
+//**********************************************************************
+// Active nodes stay active, the others are activated in the lanes 
+// where they reached their threshold
+//**********************************************************************
+void BitSlicedThresholdModel::sweepNode(unsigned int i)
+{
+	const uint64_t *active = plane(planes, 0, 0);
+	const uint64_t *curr = plane(planes, 0, i);
+	uint64_t *next = plane(newPlanes, 0, i);
+	for (unsigned int w = 0 ; w < lanes.GetNbWords() ; ++w)
+	{
+		next[w] = curr[w];
+		if (curr[w] != lanes.LaneMask(w))
+			next[w] |= lanes.AboveThreshold(this->GetNetwork(), active, i, w);
+	}
+}
+
+//**********************************************************************
+//**********************************************************************
+void BitSlicedThresholdModel::drawThresholds(unsigned long long int key)
+{
+	lanes.DrawThresholds(this->GetNetwork(), threshold, threshSpread, true, key);
+}
+
+//********************************************************************//
+//************** B I T - S L I C E D   S E R S   M O D E L ***********//
+//********************************************************************//
+
+//**********************************************************************
+// Transitions of the simple threshold SERS model in all lanes, the 
+// random words of node i only depend on the sweep
+//**********************************************************************
+void BitSlicedSERSModel::sweepNode(unsigned int i)
+{
+	unsigned int nbWords = lanes.GetNbWords();
+	const uint64_t *excited = plane(planes, 0, 0);
+	const uint64_t *currE = plane(planes, 0, i);
+	const uint64_t *currR = plane(planes, 1, i);
+	uint64_t *nextE = plane(newPlanes, 0, i);
+	uint64_t *nextR = plane(newPlanes, 1, i);
+
+	if (allStimNodes.find(i) != allStimNodes.end())
+	{
+		for (unsigned int w = 0 ; w < nbWords ; ++w)
+		{
+			nextE[w] = lanes.LaneMask(w);
+			nextR[w] = 0;
+		}
+		return;
+	}
+
+	double pLeave = probaExcitedToRefractory(i);
+	double pRecov = probaRefractoryToSusceptible(i);
+	unsigned long long int nodeKey = CounterRandKey(sweepKey, i);
+	for (unsigned int w = 0 ; w < nbWords ; ++w)
+	{
+		unsigned long long int counter = 3 * ((unsigned long long int) sweepNb * nbWords + w);
+		uint64_t suscept = lanes.LaneMask(w) & ~currE[w] & ~currR[w];
+		uint64_t fire = 0;
+		if (suscept)
+		{
+			fire = suscept & lanes.AboveThreshold(this->GetNetwork(), excited, i, w);
+			if (suscept & ~fire)
+				fire |= suscept & BitSlicedLanes::BernoulliWord(spontaneousFiring, nodeKey, counter);
+		}
+		uint64_t leave = currE[w] ? 
+			(currE[w] & BitSlicedLanes::BernoulliWord(pLeave, nodeKey, counter + 1)) : 0;
+		uint64_t recover = currR[w] ? 
+			(currR[w] & BitSlicedLanes::BernoulliWord(pRecov, nodeKey, counter + 2)) : 0;
+		nextE[w] = fire | (currE[w] & ~leave);
+		nextR[w] = leave | (currR[w] & ~recover);
+	}
+}
+
+//**********************************************************************
+//**********************************************************************
+void BitSlicedSERSModel::drawThresholds(unsigned long long int key)
+{
+	lanes.DrawThresholds(this->GetNetwork(), relativeThreshold, threshSpread, false, key);
+}
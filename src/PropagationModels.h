@@ -18,9 +18,13 @@
 #define PROPAGATIONMODEL_H
 
 #include <set>
+#include <stdint.h>
 #include "Model.h"
 #include "CouplingFunction.h"
 #include "ErrorCodes.h"
+#include "ParallelTools.h"
+#include "IndexedHeap.h"
+#include "utility.h"
 
 namespace AstroModel
 {
@@ -91,6 +95,7 @@ namespace AstroModel
 	{
 	public:
 		static std::string ClassName;
+		typedef SortedMetrics<PropagationModel<StateType, LinkType> > MetricsType;
 		//===========================================================||
 		// Constructors / Destructor                                 ||
 		//===========================================================||
@@ -99,11 +104,15 @@ namespace AstroModel
 		{
 			start = h.getParam<unsigned int>("-PropagModelSim", 0);
 			end   = h.getParam<unsigned int>("-PropagModelSim", 1);
+			syncSweeps = h.getParam<bool>("-PropagModelSync", 0);
+			nbThreads  = std::max(1, h.getParam<int>("-PropagModelSync", 1));
 		}
 		// Constructor from stream
 		PropagationModel(std::ifstream & stream, ParamHandler & h = ParamHandler::GlobalParams) :
 			NetworkDynamicsModel<LinkType>::NetworkDynamicsModel(h)
 		{
+			syncSweeps = h.getParam<bool>("-PropagModelSync", 0);
+			nbThreads  = std::max(1, h.getParam<int>("-PropagModelSync", 1));
 			PropagationModel<StateType, LinkType>::LoadFromStream(stream);
 		}
 		// Destructor
@@ -121,6 +130,9 @@ namespace AstroModel
 			NetworkDynamicsModel<LinkType>::Initialize();
 			currStep = start;
 			states = std::vector<StateType>(this->GetNetwork().size(), StateType());
+			newStates.clear();
+			sweepNb = 0;
+			sweepKey = syncSweeps ? NewCounterRandKey() : 0;
 
 			metrics.InitializeMetricsDefault();
 		}
@@ -141,8 +153,17 @@ namespace AstroModel
 
 			for (currStep = start ; (currStep <= end) and not this->isFinished() ; ++currStep)
 			{
-				unsigned int ind = this->chooseNode();
-				states[ind] = this->getNewState(ind);
+				if (syncSweeps)
+				{
+					// A sweep counts as one asynchronous step per node
+					sweep();
+					currStep += std::max(1u, GetNbNodes()) - 1;
+				}
+				else
+				{
+					unsigned int ind = this->chooseNode();
+					states[ind] = this->getNewState(ind);
+				}
 				// Metrics computations
 				metrics.ComputeMetricsDefault(*this);
 			}
@@ -186,6 +207,7 @@ namespace AstroModel
 			params += NetworkDynamicsModel<LinkType>::BuildModelParamHandler();
 			params <= "PropagationModelStart", start;
 			params <= "PropagationModelEnd", end;
+			params <= "PropagationModelSync", syncSweeps;
 			params += metrics.BuildModelParamHandler();
 			return params;
 		}
@@ -230,16 +252,49 @@ namespace AstroModel
 
 	protected:
 		std::vector<StateType> states;
+		std::vector<StateType> newStates; // States computed by a sweep
 
 		unsigned int start;
 		unsigned int end;
 		unsigned int currStep;
 
-		SortedMetrics<PropagationModel<StateType, LinkType> > metrics;
+		bool syncSweeps;         // Update all nodes at once from the previous states
+		unsigned int nbThreads;  // Threads sharing the nodes of a sweep
+		unsigned int sweepNb;    // Number of sweeps since Initialize
+		unsigned long long int sweepKey; // Random stream of the sweeps
+		WorkerPool pool;         // Threads of the sweeps
+
+		MetricsType metrics;
 
 		virtual unsigned int chooseNode() const = 0;
 		virtual StateType getNewState(unsigned int ind) const = 0;
 		virtual bool isFinished() const = 0;
+
+		// Random draws of getNewState, during sweeps the draw of node ind 
+		// only depends on the sweep so that threads don't share a generator
+		inline bool trueWithProba(double p, unsigned int ind) const
+		{
+			return syncSweeps ? (CounterUnifRand(CounterRandKey(sweepKey, ind), sweepNb) < p) : 
+				TrueWithProba(p);
+		}
+
+		// Nodes of a sweep run by the worker pool
+		struct SweepTask
+		{
+			PropagationModel<StateType, LinkType> *model;
+			void operator()(unsigned int ind, unsigned int )
+				{ model->newStates[ind] = model->getNewState(ind); }
+		};
+		// Computes the new state of every node from the current states
+		void sweep()
+		{
+			newStates.resize(states.size());
+			SweepTask task;
+			task.model = this;
+			pool.ParallelFor(states.size(), nbThreads, task);
+			states.swap(newStates);
+			++sweepNb;
+		}
 	};
 
 /**********************************************************************/
@@ -359,6 +414,7 @@ namespace AstroModel
 		SERSModel(std::ifstream & stream, ParamHandler & h = ParamHandler::GlobalParams) :
 			PropagationModel<SERStates, BooleanLink>::PropagationModel(h)
 		{
+			eventDriven = h.getParam<bool>("-SERSEventDriven", 0);
 			SERSModel::LoadFromStream(stream);
 		}
 
@@ -367,6 +423,8 @@ namespace AstroModel
 		//===========================================================||
 		// Initializes the model
 		virtual void Initialize(ResultSaver saver = ResultSaver::NullSaver);
+		// Launch simulation
+		virtual int Simulate(ResultSaver saver);
 		// Loads the model from a stream
 		virtual bool LoadFromStream(std::ifstream & stream);
 		// Saves the model to a stream
@@ -399,12 +457,35 @@ namespace AstroModel
 		mutable std::vector<unsigned int> stimOrder;
 		mutable unsigned int stimOrderInd;
 
+		// Event driven simulation (next reaction method), each node 
+		// leaves its state at a rate equal to its transition probability
+		// so that mean dwell times are the ones of the stepped model
+		bool eventDriven;
+		IndexedHeap nextTransitions; // Putative transition time of each node
+		std::vector<double> rates;   // Rates used to draw these times
+		std::vector<unsigned int> affected;   // Nodes whose rate may change
+		std::vector<unsigned int> affectedMark;
+		unsigned int currMark;
+
 		virtual unsigned int chooseNode() const;
 		virtual bool isFinished() const;
 		virtual SERStates getNewState(unsigned int ind) const;
 		virtual double probaSusceptibleToExcited(unsigned int ind) const;
 		virtual double probaExcitedToRefractory(unsigned int ind) const;
 		virtual double probaRefractoryToSusceptible(unsigned int ind) const;
+		// Distance up to which the state of a node changes the 
+		// probabilities of the others
+		virtual unsigned int probaRadius() const { return 0; }
+
+		// Rate at which node ind leaves its current state
+		double transitionRate(unsigned int ind) const;
+		// Draws a new transition time for node ind
+		void scheduleTransition(unsigned int ind, double t);
+		// Updates the transition time of node ind after a rate change, 
+		// the remaining time is rescaled to the new rate
+		void rescaleTransition(unsigned int ind, double t);
+		// Rescales the transitions of the nodes around node ind
+		void updateAround(unsigned int ind, double t);
 	};
 
 /**********************************************************************/
@@ -448,6 +529,8 @@ namespace AstroModel
 		double minTransTimeFact;
 
 		virtual double probaSusceptibleToExcited(unsigned int ind) const;
+		// The neighbors of the excited neighbors are counted
+		virtual unsigned int probaRadius() const { return 2; }
 	};
 
 /**********************************************************************/
@@ -497,8 +580,298 @@ namespace AstroModel
 		virtual double probaSusceptibleToExcited(unsigned int ind) const;
 		virtual double probaExcitedToRefractory(unsigned int ind) const;
 		virtual double probaRefractoryToSusceptible(unsigned int ind) const;
+		virtual unsigned int probaRadius() const { return 1; }
+	};
+
+/**********************************************************************/
+/* Bit-sliced replicas : packed states and neighbor counts            */
+/**********************************************************************/
+	// The states of a node in nbReplicas replicas are packed in words of 
+	// 64 lanes (lane l of word w is replica 64 * w + l). The number of 
+	// active neighbors of a node is accumulated in bit planes so that it
+	// is compared to the thresholds of all lanes of a word at once.
+	class BitSlicedLanes
+	{
+	public:
+		BitSlicedLanes() : nbReplicas(0), nbWords(0), nbPlanes(0) {}
+
+		// Sizes the lanes for the given network
+		void SetUp(const AbstractNetwork & net, unsigned int _nbReplicas);
+		// Draws the threshold of each node in each replica : the smallest
+		// number of active neighbors c such that c / k > thresh (c / k >= 
+		// thresh if not strict), with thresh = base + spread * (U - 0.5)
+		void DrawThresholds(const AbstractNetwork & net, double base, 
+			double spread, bool strict, unsigned long long int key);
+		// Lanes of word w in which node i has reached its threshold, 
+		// active holds nbWords words per node
+		uint64_t AboveThreshold(const AbstractNetwork & net, 
+			const uint64_t *active, unsigned int i, unsigned int w) const;
+
+		// Word whose bits are independently true with probability p 
+		// (rounded to 2^-32)
+		static uint64_t BernoulliWord(double p, unsigned long long int key, 
+			unsigned long long int counter);
+
+		inline unsigned int GetNbReplicas() const { return nbReplicas; }
+		inline unsigned int GetNbWords() const { return nbWords; }
+		// Lanes of word w that hold a replica
+		inline uint64_t LaneMask(unsigned int w) const
+		{
+			unsigned int nb = std::min(64u, nbReplicas - 64 * w);
+			return (nb == 64) ? ~((uint64_t) 0) : ((((uint64_t) 1) << nb) - 1);
+		}
+
+	protected:
+		unsigned int nbReplicas;
+		unsigned int nbWords;     // Words per node
+		unsigned int nbPlanes;    // Bits needed to count up to max degree + 1
+		// Bit planes of the thresholds, plane b of word w of node i is 
+		// at ((i * nbWords) + w) * nbPlanes + b
+		std::vector<uint64_t> thresholds;
+	};
+
+/**********************************************************************/
+/* Bit-sliced replicas of a propagation model                         */
+/**********************************************************************/
+	// Runs nbReplicas replicas of ModelType on the same network with 
+	// synchronous sweeps. States are packed in nbStatePlanes bit planes 
+	// (plane p of word w of node i is at (p * nbNodes + i) * nbWords + w).
+	// The metrics of each replica are computed after every sweep (on a 
+	// copy of the model metrics) and saved in a Replica sub directory.
+	template <typename ModelType, typename StateType, unsigned int nbStatePlanes>
+	class BitSlicedModel : public ModelType
+	{
+	public:
+		//===========================================================||
+		// Constructors / Destructor                                 ||
+		//===========================================================||
+		// Constructor
+		BitSlicedModel(ParamHandler & h) : ModelType(h)
+		{
+			nbReplicas   = std::max(1, h.getParam<int>("-BitSliced", 0));
+			threshSpread = h.getParam<double>("-BitSliced", 1);
+		}
+		// Constructor from stream
+		BitSlicedModel(std::ifstream & stream, ParamHandler & h = ParamHandler::GlobalParams) : 
+			ModelType(stream, h)
+		{
+			nbReplicas   = std::max(1, h.getParam<int>("-BitSliced", 0));
+			threshSpread = h.getParam<double>("-BitSliced", 1);
+		}
+		// Destructor
+		virtual ~BitSlicedModel()
+		{
+			freeReplicaMetrics();
+		}
+
+		//===========================================================||
+		// Standard model methods                                    ||
+		//===========================================================||
+		// Initializes the model, all replicas start from the same states
+		virtual void Initialize(ResultSaver saver = ResultSaver::NullSaver)
+		{
+			ModelType::Initialize(saver);
+			lanes.SetUp(this->GetNetwork(), nbReplicas);
+			unsigned int nbWords = lanes.GetNbWords();
+			planes.assign(nbStatePlanes * this->states.size() * nbWords, 0);
+			for (unsigned int i = 0 ; i < this->states.size() ; ++i)
+				for (unsigned int w = 0 ; w < nbWords ; ++w)
+					for (unsigned int p = 0 ; p < nbStatePlanes ; ++p)
+						if (laneBit(this->states[i], p))
+							planes[(p * this->states.size() + i) * nbWords + w] = lanes.LaneMask(w);
+			this->sweepNb = 0;
+			this->sweepKey = NewCounterRandKey();
+			drawThresholds(NewCounterRandKey());
+		}
+
+		// Launch simulation
+		virtual int Simulate(ResultSaver saver)
+		{
+			int returnVal = 0;
+
+			// Save wanted data
+			if (this->DebugMode())
+				std::cout << "*** Saving metric data ***" << std::endl;
+			this->network->ComputeAndSaveMetrics(saver);
+
+			// Simulate
+			if (this->DebugMode())
+				std::cout << "*** Starting Simulation ***" << std::endl;
+
+			bool record = not this->metrics.GetMetricsRaw().empty();
+			if (record)
+				setUpReplicaMetrics();
+			newPlanes.resize(planes.size());
+			SweepLanesTask task;
+			task.model = this;
+			for (this->currStep = this->start ; (this->currStep <= this->end) and 
+				not this->isFinished() ; ++this->currStep)
+			{
+				this->pool.ParallelFor(this->states.size(), this->nbThreads, task);
+				planes.swap(newPlanes);
+				++this->sweepNb;
+				// A sweep counts as one asynchronous step per node
+				this->currStep += std::max(1u, this->GetNbNodes()) - 1;
+				for (unsigned int r = 0 ; record and (r < nbReplicas) ; ++r)
+				{
+					unpackReplica(planes, r);
+					replicaMetrics(r).ComputeMetricsDefault(*this);
+				}
+			}
+
+			// Save the metrics of each replica
+			if (this->DebugMode())
+				std::cout << "*** Saving dynamic data ***" << std::endl;
+			for (unsigned int r = 0 ; record and (r < nbReplicas) ; ++r)
+				if (not replicaMetrics(r).SaveMetricsDefault(saver("Replica" + StringifyFixed(r))))
+					returnVal |= MODEL_METRIC_SAVING_PROBLEM;
+			freeReplicaMetrics();
+
+			return returnVal;
+		}
+
+		//===========================================================||
+		// Special model parameters handling method                  ||
+		//===========================================================||
+		virtual ParamHandler BuildModelParamHandler()
+		{
+			ParamHandler params;
+			params += ModelType::BuildModelParamHandler();
+			params <= "BitSlicedReplicas", nbReplicas;
+			params <= "BitSlicedThreshSpread", threshSpread;
+			return params;
+		}
+
+	protected:
+		unsigned int nbReplicas;
+		double threshSpread;   // Width of the per replica threshold distribution
+		BitSlicedLanes lanes;
+		std::vector<uint64_t> planes;
+		std::vector<uint64_t> newPlanes;
+		// Copies of the model metrics for all replicas but the last one,
+		// which uses the model metrics
+		std::vector<typename ModelType::MetricsType *> copiedMetrics;
+
+		// Computes the new planes of node i (in newPlanes) from planes
+		virtual void sweepNode(unsigned int i) = 0;
+		// Draws the threshold of each node in each replica
+		virtual void drawThresholds(unsigned long long int key) = 0;
+		// Bit of plane p that encodes state s
+		virtual bool laneBit(const StateType & s, unsigned int p) const = 0;
+		// State encoded by the bits of lane l of word w of node i
+		virtual StateType laneState(const std::vector<uint64_t> & pl, 
+			unsigned int i, unsigned int w, unsigned int l) const = 0;
+
+		// Plane p of node i
+		inline uint64_t *plane(std::vector<uint64_t> & pl, unsigned int p, unsigned int i)
+			{ return &pl[(p * this->states.size() + i) * lanes.GetNbWords()]; }
+		inline const uint64_t *plane(const std::vector<uint64_t> & pl, unsigned int p, 
+			unsigned int i) const
+			{ return &pl[(p * this->states.size() + i) * lanes.GetNbWords()]; }
+		// Nodes of a sweep run by the worker pool
+		struct SweepLanesTask
+		{
+			BitSlicedModel<ModelType, StateType, nbStatePlanes> *model;
+			void operator()(unsigned int i, unsigned int ) { model->sweepNode(i); }
+		};
+		// Metrics of replica r
+		inline typename ModelType::MetricsType & replicaMetrics(unsigned int r)
+			{ return (r < copiedMetrics.size()) ? *copiedMetrics[r] : this->metrics; }
+		// Copies the model metrics for each replica and initializes them
+		void setUpReplicaMetrics()
+		{
+			typedef typename ModelType::MetricsType::value_type::first_type MetricPtr;
+			freeReplicaMetrics();
+			for (unsigned int r = 0 ; r + 1 < nbReplicas ; ++r)
+			{
+				copiedMetrics.push_back(new typename ModelType::MetricsType());
+				for (unsigned int k = 0 ; k < this->metrics.size() ; ++k)
+					copiedMetrics[r]->push_back(std::make_pair(
+						dynamic_cast<MetricPtr>(this->metrics[k].first->BuildCopy()), true));
+			}
+			for (unsigned int r = 0 ; r < nbReplicas ; ++r)
+				replicaMetrics(r).InitializeMetricsDefault();
+		}
+		void freeReplicaMetrics()
+		{
+			for (unsigned int r = 0 ; r < copiedMetrics.size() ; ++r)
+				delete copiedMetrics[r];
+			copiedMetrics.clear();
+		}
+		// Copies the states of replica r into states
+		void unpackReplica(const std::vector<uint64_t> & pl, unsigned int r)
+		{
+			for (unsigned int i = 0 ; i < this->states.size() ; ++i)
+				this->states[i] = laneState(pl, i, r / 64, r % 64);
+		}
+	};
+
+/**********************************************************************/
+/* Bit-sliced threshold model                                         */
+/**********************************************************************/
+	class BitSlicedThresholdModel : 
+		public BitSlicedModel<ThresholdModel, BooleanWrapper, 1>
+	{
+	public:
+		static std::string ClassName;
+		//===========================================================||
+		// Constructors / Destructor                                 ||
+		//===========================================================||
+		// Constructor
+		BitSlicedThresholdModel(ParamHandler & h) : 
+			BitSlicedModel<ThresholdModel, BooleanWrapper, 1>::BitSlicedModel(h) {}
+		// Constructor from stream
+		BitSlicedThresholdModel(std::ifstream & stream, ParamHandler & h = ParamHandler::GlobalParams) :
+			BitSlicedModel<ThresholdModel, BooleanWrapper, 1>::BitSlicedModel(stream, h) {}
+
+		// Return class name
+		virtual std::string GetClassName() const { return ClassName; }
+
+	protected:
+		virtual void sweepNode(unsigned int i);
+		virtual void drawThresholds(unsigned long long int key);
+		virtual bool laneBit(const BooleanWrapper & s, unsigned int ) const
+			{ return s; }
+		virtual BooleanWrapper laneState(const std::vector<uint64_t> & pl, 
+			unsigned int i, unsigned int w, unsigned int l) const
+			{ return BooleanWrapper((plane(pl, 0, i)[w] >> l) & 1); }
+	};
+
+/**********************************************************************/
+/* Bit-sliced simple threshold SERS model                             */
+/**********************************************************************/
+	// Plane 0 holds the excited lanes, plane 1 the refractory ones
+	class BitSlicedSERSModel : 
+		public BitSlicedModel<SimpleThresholdSERSModel, SERStates, 2>
+	{
+	public:
+		static std::string ClassName;
+		//===========================================================||
+		// Constructors / Destructor                                 ||
+		//===========================================================||
+		// Constructor
+		BitSlicedSERSModel(ParamHandler & h) : 
+			BitSlicedModel<SimpleThresholdSERSModel, SERStates, 2>::BitSlicedModel(h) {}
+		// Constructor from stream
+		BitSlicedSERSModel(std::ifstream & stream, ParamHandler & h = ParamHandler::GlobalParams) :
+			BitSlicedModel<SimpleThresholdSERSModel, SERStates, 2>::BitSlicedModel(stream, h) {}
+
+		// Return class name
+		virtual std::string GetClassName() const { return ClassName; }
+
+	protected:
+		virtual void sweepNode(unsigned int i);
+		virtual void drawThresholds(unsigned long long int key);
+		virtual bool laneBit(const SERStates & s, unsigned int p) const
+			{ return (SERStatesType) s == ((p == 0) ? Excited : Refractory); }
+		virtual SERStates laneState(const std::vector<uint64_t> & pl, 
+			unsigned int i, unsigned int w, unsigned int l) const
+		{
+			if ((plane(pl, 0, i)[w] >> l) & 1)
+				return SERStates(Excited);
+			return ((plane(pl, 1, i)[w] >> l) & 1) ? SERStates(Refractory) : SERStates(Susceptible);
+		}
 	};
 }
 
 #endif
-
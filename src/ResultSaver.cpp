@@ -20,7 +20,6 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <boost/filesystem/convenience.hpp>
 
 using namespace std;
 
@@ -29,31 +28,34 @@ using namespace std;
 //********************************************************************//
 
 ResultSaver::ParamTablesMap ResultSaver::paramsToSave;
-std::map<std::string, bool> ResultSaver::headersWriten;
-int ResultSaver::instCount = 0;
+std::mutex ResultSaver::tablesMutex;
+thread_local unsigned int ResultSaver::workerId = 0;
+std::set<unsigned int> ResultSaver::usedWorkerIds;
 
-ofstream ResultSaver::voidStream;
+std::ostream ResultSaver::voidStream(0);
 ResultSaver ResultSaver::NullSaver;
 
 //**********************************************************************
 //**********************************************************************
 bool ResultSaver::createDir(std::string path)
 {
-	return boost::filesystem::exists(path) ? boost::filesystem::is_directory(path) : boost::filesystem::create_directories(path);
+	return AsyncFileWriter::CreateDir(path);
 }
 
 //**********************************************************************
 //**********************************************************************
-ResultSaver::ResultSaver(bool _saving) : saving(_saving), path(""), name(""), ext("dat")
+ResultSaver::ResultSaver(bool _saving) : saving(_saving), path(""), name(""), ext("dat"),
+	stream(&buffer)
 {
-	++instCount;
 }
 
 //**********************************************************************
 //**********************************************************************
-ResultSaver::ResultSaver(string _path, string _name, string _ext) : saving(true), path(_path), name(_name), ext(_ext)
+ResultSaver::ResultSaver(string _path, string _name, string _ext) : saving(true), path(_path), name(_name), ext(_ext),
+	stream(&buffer)
 {
-	++instCount;
+	// Only the root directory is created synchronously, sub directories
+	// are created by the writer threads when files are opened.
 	if (not createDir(path))
 		cerr << "Couldn't create directory : " << path << endl;
 }
@@ -61,21 +63,22 @@ ResultSaver::ResultSaver(string _path, string _name, string _ext) : saving(true)
 //**********************************************************************
 //**********************************************************************
 ResultSaver::ResultSaver(const ResultSaver & rs) : 
-	saving(rs.saving), path(rs.path), name(rs.name), ext(rs.ext), toSave(rs.toSave)
+	saving(rs.saving), path(rs.path), name(rs.name), ext(rs.ext), stream(&buffer), 
+	toSave(rs.toSave)
 {
-	++instCount;
 }
 
 //**********************************************************************
 //**********************************************************************
 ResultSaver & ResultSaver::operator=(const ResultSaver & rs)
 {
+	buffer.Close();
+	stream.clear();
 	saving = rs.saving;
 	path = rs.path;
 	name = rs.name;
 	ext = rs.ext;
 	toSave = rs.toSave;
-	++instCount;
 	return *this;
 }
 
@@ -83,28 +86,22 @@ ResultSaver & ResultSaver::operator=(const ResultSaver & rs)
 //**********************************************************************
 ResultSaver::~ResultSaver()
 {
-	--instCount;
-	if (instCount == 0)
-		flushTableFiles();
-	if (stream.is_open())
-		stream.close();
+	buffer.Close();
 }
 
 //**********************************************************************
 //**********************************************************************
-std::ofstream & ResultSaver::getStream() 
+std::ostream & ResultSaver::getStream() 
 {
-	if ((not stream.is_open()) and (path != ""))
+	if ((not saving) or (path == ""))
+		return voidStream;
+	std::string currFile = getCurrFile();
+	if (buffer.GetPath() != currFile)
 	{
-		if (not createDir(path))
-		{
-			cerr << "Couldn't create directory : " << path << endl;
-			return voidStream;
-		}
-		else
-			stream.open((path + "/" + name + "." + ext).c_str(), ios_base::app);
+		buffer.Open(currFile);
+		stream.clear();
 	}
-	return saving ? stream : voidStream;
+	return stream;
 }
 
 //**********************************************************************
@@ -113,8 +110,6 @@ ResultSaver ResultSaver::operator()(string subDir)
 {
 	ResultSaver temp(*this);
 	temp.path += "/" + subDir;
-	if (temp.stream.is_open())
-		temp.stream.close();
 	return temp;
 }
 
@@ -124,16 +119,15 @@ bool ResultSaver::isSaving(string objName)
 {
 	if (toSave.find(objName) != toSave.end())
 	{
-		if ((objName != name) and stream.is_open())
-			stream.close();
 		name = objName;
 		return true;
 	}
 	else
 	{
+		std::lock_guard<std::mutex> lock(tablesMutex);
 		bool found = false;
 		for (ParamTablesMap::iterator it = paramsToSave.begin() ; it != paramsToSave.end() and (not found) ; ++it)
-			found = (it->second.second.find(objName) != it->second.second.end());
+			found = (it->second.columns.find(objName) != it->second.columns.end());
 		return found;
 	}
 }
@@ -151,63 +145,142 @@ ResultSaver & ResultSaver::operator,(string objToSave)
 //**********************************************************************
 ResultSaver & ResultSaver::operator|(string paramToSave)
 {
+	std::lock_guard<std::mutex> lock(tablesMutex);
 	ParamTablesMap::iterator it;
-	if ((it = paramsToSave.find(lastAddedName)) != paramsToSave.end())
-		it->second.second.insert(pair<string, ValueHolder*>(paramToSave, 0));
-	else
+	if ((it = paramsToSave.find(lastAddedName)) == paramsToSave.end())
+		it = paramsToSave.insert(make_pair(lastAddedName, ParamTable(path, ext))).first;
+	it->second.columns.insert(paramToSave);
+	// Rows that are being filled get the new column
+	for (map<unsigned int, TableRow>::iterator r = it->second.rows.begin() ; 
+			r != it->second.rows.end() ; ++r)
+		r->second.insert(make_pair(paramToSave, (ValueHolder*)0));
+	return *this;
+}
+
+//**********************************************************************
+//**********************************************************************
+bool ResultSaver::Flush(std::vector<std::string> *errs)
+{
+	flushTableFiles();
+	AsyncFileWriter & writer = AsyncFileWriter::Instance();
+	bool ok = writer.Flush(errs);
+	// Merge worker shards at the end of their table files
 	{
-		paramsToSave.insert(pair<string, ParamTable>(lastAddedName,ParamTable(path, map<string, ValueHolder*>())));
-		paramsToSave[lastAddedName].second.insert(pair<string, ValueHolder*>(paramToSave, 0));
-		headersWriten.insert(make_pair(lastAddedName, false));
+		std::lock_guard<std::mutex> lock(tablesMutex);
+		for (ParamTablesMap::iterator i = paramsToSave.begin() ; i != paramsToSave.end() ; ++i)
+		{
+			for (set<unsigned int>::iterator w = i->second.shards.begin() ; 
+					w != i->second.shards.end() ; ++w)
+				writer.AppendFile(getTableFile(i->first, i->second, 0),
+					getTableFile(i->first, i->second, *w));
+			i->second.shards.clear();
+		}
 	}
-	return *this;
+	ok &= writer.Flush(errs);
+	return ok;
+}
+
+//**********************************************************************
+// Indices are reused so that the number of shard files is bounded by 
+// the number of simultaneous workers
+//**********************************************************************
+void ResultSaver::AcquireWorkerId()
+{
+	std::lock_guard<std::mutex> lock(tablesMutex);
+	unsigned int id = 1;
+	while (usedWorkerIds.count(id))
+		++id;
+	usedWorkerIds.insert(id);
+	workerId = id;
+}
+
+//**********************************************************************
+//**********************************************************************
+void ResultSaver::ReleaseWorkerId()
+{
+	std::lock_guard<std::mutex> lock(tablesMutex);
+	usedWorkerIds.erase(workerId);
+	workerId = 0;
 }
 
 //**********************************************************************
 //**********************************************************************
 void ResultSaver::flushTableFiles()
 {
+	std::lock_guard<std::mutex> lock(tablesMutex);
 	for (ParamTablesMap::iterator i = paramsToSave.begin() ; i != paramsToSave.end() ; ++i)
-	{
-		if (stream.is_open() and (name != i->first))
-			stream.close();
-		name = i->first;
-		std::string oldPath(path);
-		path = i->second.first;
-
-		flushLine(i->first, true);
+		for (map<unsigned int, TableRow>::iterator r = i->second.rows.begin() ; 
+				r != i->second.rows.end() ; ++r)
+		{
+			bool anyVal = false;
+			for (TableRow::iterator j = r->second.begin() ; j != r->second.end() ; ++j)
+				anyVal |= (j->second != 0);
+			if (anyVal)
+				flushLine(i->first, i->second, r->first, true);
+		}
+}
 
-		path = oldPath;
+//**********************************************************************
+// Returns the row filled by the given worker (tablesMutex must be held)
+//**********************************************************************
+ResultSaver::TableRow & ResultSaver::getRow(ParamTable & table, unsigned int worker)
+{
+	map<unsigned int, TableRow>::iterator r = table.rows.find(worker);
+	if (r == table.rows.end())
+	{
+		r = table.rows.insert(make_pair(worker, TableRow())).first;
+		for (set<string>::const_iterator c = table.columns.begin() ; c != table.columns.end() ; ++c)
+			r->second.insert(make_pair(*c, (ValueHolder*)0));
 	}
+	return r->second;
 }
 
 //**********************************************************************
+// Worker 0 writes in the table file, other workers in shard files
 //**********************************************************************
-void ResultSaver::flushLine(std::string tableName, bool flushAll)
+std::string ResultSaver::getTableFile(const std::string & tableName, 
+	const ParamTable & table, unsigned int worker)
 {
-	map<string, ValueHolder*> &map = paramsToSave[tableName].second;
+	std::string file = table.path + "/" + tableName + "." + table.ext;
+	if (worker > 0)
+		file += ".worker" + StringifyFixed(worker);
+	return file;
+}
+
+//**********************************************************************
+// Formats a row and hands it to the writer threads (tablesMutex held)
+//**********************************************************************
+void ResultSaver::flushLine(const std::string & tableName, ParamTable & table,
+	unsigned int worker, bool flushAll)
+{
+	TableRow & row = getRow(table, worker);
+	bool writing = (table.path != "");
+	std::ostringstream line;
 	// Write headers
-	if (not headersWriten[tableName] and (path != ""))
+	if (not table.headerWriten and writing)
 	{
-		for (std::map<string, ValueHolder*>::iterator j = map.begin() ; j != map.end() ; ++j)
+		std::ostringstream header;
+		for (TableRow::iterator j = row.begin() ; j != row.end() ; ++j)
 		{
-			if (j != map.begin())
-				getStream() << "\t";
-			getStream() << j->first;
+			if (j != row.begin())
+				header << "\t";
+			header << j->first;
 		}
-		getStream() << endl;
-		headersWriten[tableName] = true;
+		header << endl;
+		std::string headerStr = header.str();
+		AsyncFileWriter::Instance().Append(getTableFile(tableName, table, 0), headerStr);
+		table.headerWriten = true;
 	}
 	// Write data
-	for (std::map<string, ValueHolder*>::iterator j = map.begin() ; j != map.end() ; ++j)
+	for (TableRow::iterator j = row.begin() ; j != row.end() ; ++j)
 	{
 		if (j->second)
 		{
-			if (path != "")
+			if (writing)
 			{
-				if (j != map.begin())
-					getStream() << "\t";
-				j->second->ToStream(getStream());
+				if (j != row.begin())
+					line << "\t";
+				j->second->ToStream(line);
 			}
 			if (flushAll or not(j->second->keepValue))
 			{
@@ -215,15 +288,21 @@ void ResultSaver::flushLine(std::string tableName, bool flushAll)
 				j->second = 0;
 			}
 		}
-		else if (path != "")
+		else if (writing)
 		{
-			if (j != map.begin())
-				getStream() << "\t";
-			getStream() << "NA";
+			if (j != row.begin())
+				line << "\t";
+			line << "NA";
 		}
 	}
-	if (path != "")
-		getStream() << std::endl;
+	if (writing)
+	{
+		line << std::endl;
+		std::string lineStr = line.str();
+		AsyncFileWriter::Instance().Append(getTableFile(tableName, table, worker), lineStr);
+		if (worker > 0)
+			table.shards.insert(worker);
+	}
 }
 
 //**********************************************************************
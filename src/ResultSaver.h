@@ -19,6 +19,7 @@
 
 #include "Savable.h"
 #include "utility.h"
+#include "AsyncFileWriter.h"
 
 #include <iostream>
 #include <fstream>
@@ -27,6 +28,7 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <mutex>
 
 #define SYS_OK_CODE 0
 
@@ -37,7 +39,7 @@ public:
 	bool keepValue;
 
 	ValueHolder(bool _keepVal = false) : keepValue(_keepVal) {}
-	virtual void ToStream(std::ofstream &) {};
+	virtual void ToStream(std::ostream &) {};
 
 	virtual ~ValueHolder() {}
 };
@@ -50,7 +52,7 @@ protected:
 public:
 	SpecialValueHolder(const T & _val, bool _keepVal = false) : 
 		ValueHolder::ValueHolder(_keepVal), value(_val) {}
-	virtual void ToStream(std::ofstream & stream)
+	virtual void ToStream(std::ostream & stream)
 	{
 		stream << value;
 	}
@@ -88,7 +90,19 @@ public:
 class ResultSaver : public SaveAndLoadFromStream
 {
 public:
-	typedef std::pair<std::string /*table file path*/, std::map<std::string /*column name*/, ValueHolder*> > ParamTable;
+	typedef std::map<std::string /*column name*/, ValueHolder*> TableRow;
+	struct ParamTable
+	{
+		std::string path;                          // table file directory
+		std::string ext;                           // table file extension
+		std::set<std::string> columns;
+		std::map<unsigned int /*worker*/, TableRow> rows; // row being filled by each worker
+		std::set<unsigned int> shards;             // workers having written in a shard file
+		bool headerWriten;
+
+		ParamTable(std::string _p = "", std::string _e = "dat") : 
+			path(_p), ext(_e), headerWriten(false) {}
+	};
 	typedef std::map<std::string /*table name*/, ParamTable> ParamTablesMap;
 
 protected:
@@ -96,20 +110,27 @@ protected:
 	std::string path;
 	std::string name;
 	std::string ext;
-	std::ofstream stream;
+	AsyncStreamBuf buffer;
+	std::ostream stream;
 
 	std::string lastAddedName;
 
 	std::set<std::string> toSave;
 
+	// Tables are shared by all savers, rows are kept per worker
 	static ParamTablesMap paramsToSave;
-	static std::map<std::string, bool> headersWriten;
-	static int instCount;
+	static std::mutex tablesMutex;
+	static thread_local unsigned int workerId;
+	static std::set<unsigned int> usedWorkerIds;
 
-	static std::ofstream voidStream;
+	static std::ostream voidStream;
 
-	void flushTableFiles();
-	void flushLine(std::string tableName, bool flushAll = false);
+	static void flushTableFiles();
+	static void flushLine(const std::string & tableName, ParamTable & table,
+		unsigned int worker, bool flushAll = false);
+	static TableRow & getRow(ParamTable & table, unsigned int worker);
+	static std::string getTableFile(const std::string & tableName, 
+		const ParamTable & table, unsigned int worker);
 
 	static bool createDir(std::string path);
 public:
@@ -125,7 +146,9 @@ public:
 
 	inline operator bool() const { return saving; }
 
-	std::ofstream & getStream();
+	// Returns a stream on the current file. Data is written asynchronously
+	// by the writer threads, use Flush to wait for it to reach the disk.
+	std::ostream & getStream();
 	std::string getCurrFile() const { return path + "/" + name + "." + ext; }
 	inline const std::string & GetCurrPath() const { return path; }
 	ResultSaver operator()(std::string subDir);
@@ -146,75 +169,90 @@ public:
 
 	void AddAttributesToTable(std::string destTable, std::string srcTable)
 	{
-		ParamTablesMap::const_iterator it;
-		if ((it = paramsToSave.find(srcTable)) != paramsToSave.end())
+		std::set<std::string> columns;
 		{
-			for (std::map<std::string , ValueHolder*>::const_iterator it2 = it->second.second.begin() ; 
-				it2 != it->second.second.end() ; ++it2)
-				(*this <= destTable) | it2->first;
+			std::lock_guard<std::mutex> lock(tablesMutex);
+			ParamTablesMap::const_iterator it;
+			if ((it = paramsToSave.find(srcTable)) != paramsToSave.end())
+				columns = it->second.columns;
 		}
+		for (std::set<std::string>::const_iterator it2 = columns.begin() ; it2 != columns.end() ; ++it2)
+			(*this <= destTable) | *it2;
 	}
 
 	void KeepValue(std::string tableName, std::string paramName, bool keepVal)
 	{
+		std::lock_guard<std::mutex> lock(tablesMutex);
 		ParamTablesMap::iterator i;
 		if ((i = paramsToSave.find(tableName)) != paramsToSave.end())
 		{
-			std::map<std::string, ValueHolder*>::iterator it;
-			if ((it = i->second.second.find(paramName)) != i->second.second.end())
+			TableRow & row = getRow(i->second, workerId);
+			TableRow::iterator it;
+			if (((it = row.find(paramName)) != row.end()) and it->second)
 				it->second->keepValue = keepVal;
 		}
 	}
 
 	template <typename T> void Param(std::string paramName, const T &val)
 	{
+		std::lock_guard<std::mutex> lock(tablesMutex);
 		for (ParamTablesMap::iterator i = paramsToSave.begin() ; i != paramsToSave.end() ; ++i)
 		{
-			std::map<std::string, ValueHolder*>::iterator it;
-			if ((it = i->second.second.find(paramName)) != i->second.second.end())
+			if (i->second.columns.find(paramName) == i->second.columns.end())
+				continue;
+			const std::string & tablePath = i->second.path;
+			if (((tablePath != "") and saving) or ((tablePath == "") and (not saving)))
 			{
-				if (stream.is_open() and (name != i->first))
-					stream.close();
-				name = i->first;
-				std::string oldPath(path);
-				path = i->second.first;
-
-				if (((path != "") and saving) or ((path == "") and (not saving)))
+				TableRow & row = getRow(i->second, workerId);
+				TableRow::iterator it = row.find(paramName);
+				if (not it->second)
+					it->second = new SpecialValueHolder<T>(val);
+				else // If the value was already writen
 				{
-					if (not it->second)
-						it->second = new SpecialValueHolder<T>(val);
-					else // If the value was already writen
+					bool allWriten = true;
+					for (TableRow::iterator j = row.begin() ; j != row.end() ; ++j)
+						allWriten = allWriten and j->second;
+					if (allWriten) // If all values have already been writen
 					{
-						bool allWriten = true;
-						for (std::map<std::string, ValueHolder*>::iterator j = i->second.second.begin() ; j != i->second.second.end() ; ++j)
-						{
-							allWriten = allWriten and j->second;
-						}
-						if (allWriten) // If all values have already been writen
-						{
-							flushLine(i->first);
-							it->second = new SpecialValueHolder<T>(val);
-						}
+						flushLine(i->first, i->second, workerId);
+						it->second = new SpecialValueHolder<T>(val);
 					}
 				}
-				path = oldPath;
 			}
 		}
 	}
 
 	double GetParamVal(std::string tableName, std::string paramName) const
 	{
-		ParamTablesMap::const_iterator it = paramsToSave.find(tableName);
+		std::lock_guard<std::mutex> lock(tablesMutex);
+		ParamTablesMap::iterator it = paramsToSave.find(tableName);
 		if (it != paramsToSave.end())
 		{
-			std::map<std::string, ValueHolder*>::const_iterator paramIt = it->second.second.find(paramName);
+			const TableRow & row = getRow(it->second, workerId);
+			TableRow::const_iterator paramIt = row.find(paramName);
 			SpecialValueHolder<double>* spVh = 0;
-			if ((paramIt != it->second.second.end()) and (spVh = dynamic_cast<SpecialValueHolder<double>*>(paramIt->second)))
+			if ((paramIt != row.end()) and (spVh = dynamic_cast<SpecialValueHolder<double>*>(paramIt->second)))
 				return spVh->GetVal();
 		}
 		return 0;
 	}
 
+	//===========================================================||
+	// Asynchronous writing handling                             ||
+	//===========================================================||
+	// Sets the worker index of the calling thread, table rows of
+	// workers other than 0 are written to shard files until Flush.
+	static void SetWorkerId(unsigned int id) { workerId = id; }
+	static unsigned int GetWorkerId() { return workerId; }
+	// Gives the smallest free worker index (> 0) to the calling thread,
+	// released when the thread stops working (cf ParallelFor)
+	static void AcquireWorkerId();
+	static void ReleaseWorkerId();
+	// Writes pending table rows, waits for the writer threads to
+	// process all queued data and merges table shards. Returns false
+	// if any error occured, errors are then appended to errs.
+	static bool Flush(std::vector<std::string> *errs = 0);
+
 	//===========================================================||
 	// Standard Save and Load methods                            ||
 	//===========================================================||
@@ -226,4 +264,3 @@ public:
 };
 
 #endif
-
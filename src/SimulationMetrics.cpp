@@ -84,6 +84,7 @@ bool PropagationDistanceStat::ComputeMetric(const AbstractRepeatSimulation & man
 		GetSpecificMetric<Metric, PropagationDistance>(manag.GetAllMetrics());
 
 	nbWaves.push_back(propDist->size());
+	OnlineStatistic emptyStat(statParams);
 	for (unsigned int w = 0 ; w < propDist->size() ; ++w)
 	{
 		// nb Cells in wave by clustering coeff of initiator
@@ -98,8 +99,10 @@ bool PropagationDistanceStat::ComputeMetric(const AbstractRepeatSimulation & man
 			if (p != 0)
 				maxSpeed = std::max(maxSpeed, (*propDist)[w].propagation[p].spatialDist / ((*propDist)[w].propagation[p].time - startTime));
 			
-			spatialDistByCellNb[(*propDist)[w].propagation[p].cellNb].push_back((*propDist)[w].propagation[p].spatialDist);
-			spatialDistByCellDist[(*propDist)[w].propagation[p].cellDist].push_back((*propDist)[w].propagation[p].spatialDist);
+			spatialDistByCellNb.insert(make_pair((*propDist)[w].propagation[p].cellNb, 
+				emptyStat)).first->second.Add((*propDist)[w].propagation[p].spatialDist);
+			spatialDistByCellDist.insert(make_pair((*propDist)[w].propagation[p].cellDist, 
+				emptyStat)).first->second.Add((*propDist)[w].propagation[p].spatialDist);
 
 		}
 	}
@@ -126,7 +129,7 @@ bool PropagationDistanceStat::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(spatialDistByNbCellName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(spatialDistByNbCellName, saver.getCurrFile());
 
 		stream << "CellNb\tSpatialDistMean\tSpatialDistStdDev" << endl;
@@ -134,15 +137,15 @@ bool PropagationDistanceStat::SaveMetric(ResultSaver saver) const
 		{
 			stream
 				<< it->first << "\t"
-				<< ComputeMean(it->second) << "\t"
-				<< ComputeStdDev(it->second) << endl;
+				<< it->second.GetMean() << "\t"
+				<< it->second.GetStdDev() << endl;
 		}
 
 		allSaved &= stream.good();
 	}
 	if (saver.isSaving(spatialDistByCellDistName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(spatialDistByCellDistName, saver.getCurrFile());
 
 		stream << "CellDist\tSpatialDistMean\tSpatialDistStdDev" << endl;
@@ -150,15 +153,15 @@ bool PropagationDistanceStat::SaveMetric(ResultSaver saver) const
 		{
 			stream
 				<< it->first << "\t"
-				<< ComputeMean(it->second) << "\t"
-				<< ComputeStdDev(it->second) << endl;
+				<< it->second.GetMean() << "\t"
+				<< it->second.GetStdDev() << endl;
 		}
 
 		allSaved &= stream.good();
 	}
 	if (saver.isSaving(maxNbCellDistributionName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(maxNbCellDistributionName, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < maxNbCells.size() ; ++i)
@@ -168,7 +171,7 @@ bool PropagationDistanceStat::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(NbCellByClustCoeffName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(NbCellByClustCoeffName, saver.getCurrFile());
 
 		stream << "ClusteringCoefficient\tNumberOfInvolvedCells" << endl;
@@ -181,7 +184,7 @@ bool PropagationDistanceStat::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(maxWaveSpeedDistributionName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(maxWaveSpeedDistributionName, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < maxWaveSpeed.size() ; ++i)
@@ -191,7 +194,7 @@ bool PropagationDistanceStat::SaveMetric(ResultSaver saver) const
 	}
 	if (saver.isSaving(nbWavesDistribName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(nbWavesDistribName, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < nbWaves.size() ; ++i)
@@ -298,7 +301,7 @@ bool NetworkTopologyStats::SaveMetric(ResultSaver saver) const
 	static const string CellToCellDistName("CellToCellDistStats");
 	if (saver.isSaving(CellToCellDistName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(CellToCellDistName, saver.getCurrFile());
 
 		stream << "MeanDist\tStdDevDist\tMinDist" << endl;
@@ -360,6 +363,7 @@ bool NetworkTopologyStats::SaveToStream(std::ofstream & stream) const
 //**********************************************************************
 ScalarStatisticsMetric::ScalarStatisticsMetric()
 {
+	quantsToSave = ParamHandler::GlobalParams.getParam<std::vector<double> >("-OnlineStatsQuants", 0);
 }
 
 //**********************************************************************
@@ -367,6 +371,7 @@ ScalarStatisticsMetric::ScalarStatisticsMetric()
 //**********************************************************************
 ScalarStatisticsMetric::ScalarStatisticsMetric(std::ifstream & stream)
 {
+	quantsToSave = ParamHandler::GlobalParams.getParam<std::vector<double> >("-OnlineStatsQuants", 0);
 	LoadFromStream(stream);
 }
 
@@ -398,7 +403,7 @@ bool ScalarStatisticsMetric::ComputeMetric(
 			{
 				if (it->second < DEFAULT_MAX_VAL-1)
 				{
-					fullScalars[modifStatName(allMetrics[i]->ModifStatName(it->first))].push_back(it->second);
+					getScalar(modifStatName(allMetrics[i]->ModifStatName(it->first))).Add(it->second);
 					scalarsChanged = true;
 				}
 			}
@@ -424,7 +429,7 @@ bool ScalarStatisticsMetric::ComputeMetric(
 			cellInds.insert(stimMetrs[i]->GetCumulStimCells().begin(),
 				stimMetrs[i]->GetCumulStimCells().end());
 		}
-		fullScalars[totStimParamName].push_back(cellInds.size());
+		getScalar(totStimParamName).Add(cellInds.size());
 
 		scalarsChanged = true;
 	}
@@ -435,9 +440,9 @@ bool ScalarStatisticsMetric::ComputeMetric(
 	if (actCells)
 	{
 		if (fullScalars.find(totStimParamName) != fullScalars.end())
-			fullScalars["TotalNonStimActivatedCells"].push_back(
+			getScalar("TotalNonStimActivatedCells").Add(
 				actCells->GetCumulActCells() - 
-				fullScalars[totStimParamName].back());
+				fullScalars.find(totStimParamName)->second.GetLast());
 
 		scalarsChanged = true;
 	}
@@ -456,7 +461,7 @@ bool ScalarStatisticsMetric::ComputeMetric(
 				signalActCells.insert(refOnProp[i].involvedCells.begin(), 
 					refOnProp[i].involvedCells.end());
 		}
-		fullScalars["ChIDefaultStimActivatedCells"].push_back(signalActCells.size());
+		getScalar("ChIDefaultStimActivatedCells").Add(signalActCells.size());
 
 		scalarsChanged = true;
 	}
@@ -471,9 +476,9 @@ bool ScalarStatisticsMetric::ComputeMetric(
 
 		for (std::map<std::string, std::set<unsigned int> >::const_iterator
 				it = cumStates.begin() ; it != cumStates.end() ; ++it)
-			fullScalars[it->first + "_CUMUL"].push_back(it->second.size());
+			getScalar(it->first + "_CUMUL").Add(it->second.size());
 
-		fullScalars["PropagModelNbStimNodes"].push_back(
+		getScalar("PropagModelNbStimNodes").Add(
 			stateCellSav->GetNbStimulatedNodes());
 
 		scalarsChanged = true;
@@ -542,13 +547,13 @@ bool ScalarStatisticsMetric::ComputeMetric(
 		ThresholdDetermination>(sim.GetAllMetrics());
 	if (threshDeterMetr)
 	{
-		fullScalars["ThreshDetermSecondNeighbThresh"].push_back(
+		getScalar("ThreshDetermSecondNeighbThresh").Add(
 			threshDeterMetr->GetSecondNeighbThresh());
-		fullScalars["ThreshDetermSecondNeighbThreshUnder10s"].push_back(
+		getScalar("ThreshDetermSecondNeighbThreshUnder10s").Add(
 			threshDeterMetr->GetSecondNeighbThreshUnderTime(10.0));
-		fullScalars["ThreshDetermSecondNeighbThreshUnder15s"].push_back(
+		getScalar("ThreshDetermSecondNeighbThreshUnder15s").Add(
 			threshDeterMetr->GetSecondNeighbThreshUnderTime(15.0));
-		fullScalars["ThreshDetermSecondNeighbThreshUnder20s"].push_back(
+		getScalar("ThreshDetermSecondNeighbThreshUnder20s").Add(
 			threshDeterMetr->GetSecondNeighbThreshUnderTime(20.0));
 	}
 
@@ -568,7 +573,7 @@ bool ScalarStatisticsMetric::SaveMetric(ResultSaver saver) const
 	static const string scalarStatsName("ScalarStatistics");
 	if (saver.isSaving(scalarStatsName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(scalarStatsName, saver.getCurrFile());
 
 		for (std::map<std::string, double>::const_iterator it = 
@@ -583,6 +588,36 @@ bool ScalarStatisticsMetric::SaveMetric(ResultSaver saver) const
 
 		allSaved &= stream.good();
 	}
+	static const string scalarHistName("ScalarHistograms");
+	if (saver.isSaving(scalarHistName) and (statParams.nbBins > 0))
+	{
+		ostream & stream = saver.getStream();
+		this->AddSavedFile(scalarHistName, saver.getCurrFile());
+
+		for (std::map<std::string, OnlineStatistic>::const_iterator it = 
+				fullScalars.begin() ; it != fullScalars.end() ; ++it)
+		{
+			stream << it->first << std::endl;
+			it->second.GetHistogram().SaveToStream(stream);
+		}
+		allSaved &= stream.good();
+	}
+	static const string scalarRawName("ScalarRawValues");
+	if (saver.isSaving(scalarRawName) and statParams.keepRaw)
+	{
+		ostream & stream = saver.getStream();
+		this->AddSavedFile(scalarRawName, saver.getCurrFile());
+
+		for (std::map<std::string, OnlineStatistic>::const_iterator it = 
+				fullScalars.begin() ; it != fullScalars.end() ; ++it)
+		{
+			stream << it->first;
+			for (unsigned int i = 0 ; i < it->second.GetRawValues().size() ; ++i)
+				stream << "\t" << it->second.GetRawValues()[i];
+			stream << std::endl;
+		}
+		allSaved &= stream.good();
+	}
 
 	return allSaved;
 }
@@ -626,14 +661,29 @@ bool ScalarStatisticsMetric::SaveToStream(std::ofstream & stream) const
 //**********************************************************************
 void ScalarStatisticsMetric::updateScalarStats()
 {
-	for (std::map<std::string, std::vector<double> >::iterator it = 
+	for (std::map<std::string, OnlineStatistic>::iterator it = 
 		fullScalars.begin() ; it != fullScalars.end() ; ++it)
 	{
-		scalarStats[it->first + "_Mean"] = ComputeMean(it->second);
-		scalarStats[it->first + "_StdDev"] = ComputeStdDev(it->second);
+		scalarStats[it->first + "_Mean"] = it->second.GetMean();
+		scalarStats[it->first + "_StdDev"] = it->second.GetStdDev();
+		if (it->second.HasQuantiles())
+			for (unsigned int i = 0 ; i < quantsToSave.size() ; ++i)
+				scalarStats[it->first + "_Quant_" + Stringify(quantsToSave[i])] = 
+					it->second.Quantile(quantsToSave[i]);
 	}
 }
 
+//**********************************************************************
+// Returns the accumulator of the given scalar
+//**********************************************************************
+OnlineStatistic & ScalarStatisticsMetric::getScalar(const std::string & name)
+{
+	std::map<std::string, OnlineStatistic>::iterator it = fullScalars.find(name);
+	if (it == fullScalars.end())
+		it = fullScalars.insert(make_pair(name, OnlineStatistic(statParams))).first;
+	return it->second;
+}
+
 //**********************************************************************
 // Make sure that the stat name is compatible with MySQL
 //**********************************************************************
@@ -727,7 +777,7 @@ bool GridSearchMetric::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(indexesFile))
 	{
-		std::ofstream & stream = saver.getStream();
+		std::ostream & stream = saver.getStream();
 		this->AddSavedFile(indexesFile, saver.getCurrFile());
 		
 		for (unsigned int i = 0 ; i < paramNames.size() ; ++i)
@@ -761,7 +811,7 @@ bool GridSearchMetric::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(pathFile))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(pathFile, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < paths.size() ; ++i)
@@ -772,7 +822,7 @@ bool GridSearchMetric::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(scalarStatsFile) and not scalarStatsByParam.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(scalarStatsFile, saver.getCurrFile());
 
 		for (unsigned int i = 0 ; i < paramNames.size() ; ++i)
@@ -807,7 +857,7 @@ bool GridSearchMetric::SaveMetric(ResultSaver saver) const
 
 	if (saver.isSaving(condParamReplace))
 	{
-		std::ofstream & stream = saver.getStream();
+		std::ostream & stream = saver.getStream();
 		this->AddSavedFile(indexesFile, saver.getCurrFile());
 
 		unsigned int strW = ceil(log(savedFilesByParam.size() *
@@ -845,7 +895,7 @@ bool GridSearchMetric::SaveMetric(ResultSaver saver) const
 						tmpSav <= tmpFileName;
 						if (tmpSav.isSaving(tmpFileName))
 						{
-							std::ofstream & subStream = tmpSav.getStream();
+							std::ostream & subStream = tmpSav.getStream();
 							this->AddSavedFile(tmpFileName, tmpSav.getCurrFile());
 
 							subStream << foundName->second.size() << std::endl;
@@ -20,6 +20,7 @@
 #include "MetricComputeStrat.h"
 #include "ChIModelMetrics.h"
 #include "NetworkMetrics.h"
+#include "OnlineStatistics.h"
 
 #include <vector>
 
@@ -74,8 +75,9 @@ namespace AstroModel
 		//===========================================================||
 
 	protected:
-		typedef std::map<unsigned int, std::vector<double> > SDistByCellMapType;
-		typedef std::map<double, std::vector<double> > SDistByCDistT;
+		typedef std::map<unsigned int, OnlineStatistic> SDistByCellMapType;
+		typedef std::map<double, OnlineStatistic> SDistByCDistT;
+		OnlineStatParams statParams;
 		std::vector<std::pair<double, double> > nbCellsByClustCoeff;
 
 		SDistByCellMapType spatialDistByCellNb;
@@ -173,7 +175,9 @@ namespace AstroModel
 			{ return scalarStats; }
 
 	protected:
-		std::map<std::string, std::vector<double> > fullScalars;
+		OnlineStatParams statParams;
+		std::vector<double> quantsToSave;
+		std::map<std::string, OnlineStatistic> fullScalars;
 		std::map<std::string, 
 			std::vector<std::vector<double> > > fullDistribs;
 		std::map<std::string, double> scalarStats;
@@ -182,6 +186,8 @@ namespace AstroModel
 		// Specific ScalarStatisticsMetric methods                   ||
 		//===========================================================||
 		void updateScalarStats();
+		// Returns the accumulator of the given scalar
+		OnlineStatistic & getScalar(const std::string & name);
 		std::string modifStatName(const std::string & str) const;
 	};
 
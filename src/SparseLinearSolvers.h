@@ -0,0 +1,306 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+  
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#ifndef SPARSELINEARSOLVERS_H
+#define SPARSELINEARSOLVERS_H
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <assert.h>
+
+namespace ODE
+{
+/**********************************************************************/
+/* Sparse matrix (compressed rows)                                    */
+/**********************************************************************/
+	template <typename Val = double> class SparseMatrix
+	{
+	public:
+		SparseMatrix() : nbRows(0) {}
+
+		// Builds the structure, pattern[i] holds the columns of row i
+		void SetPattern(const std::vector<std::vector<unsigned int> > & pattern)
+		{
+			nbRows = pattern.size();
+			rowStart.assign(nbRows + 1, 0);
+			colInds.clear();
+			for (unsigned int i = 0 ; i < nbRows ; ++i)
+			{
+				std::vector<unsigned int> cols(pattern[i]);
+				std::sort(cols.begin(), cols.end());
+				cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+				colInds.insert(colInds.end(), cols.begin(), cols.end());
+				rowStart[i + 1] = colInds.size();
+			}
+			values.assign(colInds.size(), 0);
+		}
+		void SetZero()
+		{
+			std::fill(values.begin(), values.end(), 0);
+		}
+		// Position of entry (i, j) in values, -1 if it isn't in the pattern
+		int Find(unsigned int i, unsigned int j) const
+		{
+			std::vector<unsigned int>::const_iterator it = std::lower_bound(
+				colInds.begin() + rowStart[i], colInds.begin() + rowStart[i + 1], j);
+			if ((it == colInds.begin() + rowStart[i + 1]) or (*it != j))
+				return -1;
+			return it - colInds.begin();
+		}
+		// y = A x
+		void Multiply(const Val *x, Val *y) const
+		{
+			for (unsigned int i = 0 ; i < nbRows ; ++i)
+			{
+				Val tmp = 0;
+				for (unsigned int p = rowStart[i] ; p < rowStart[i + 1] ; ++p)
+					tmp += values[p] * x[colInds[p]];
+				y[i] = tmp;
+			}
+		}
+
+		inline unsigned int GetNbRows() const { return nbRows; }
+		inline unsigned int GetNbNonZeros() const { return colInds.size(); }
+
+		std::vector<unsigned int> rowStart;
+		std::vector<unsigned int> colInds;
+		std::vector<Val> values;
+
+	protected:
+		unsigned int nbRows;
+	};
+
+/**********************************************************************/
+/* Column coloring for finite difference jacobians                    */
+/**********************************************************************/
+	// Greedy coloring : two columns sharing a row never have the same 
+	// color, so that all columns of a color can be perturbed at once.
+	// Returns the number of colors.
+	template <typename Val> unsigned int ComputeColumnColoring(
+		const SparseMatrix<Val> & A, unsigned int nbCols, std::vector<unsigned int> & colors)
+	{
+		// Rows of each column
+		std::vector<std::vector<unsigned int> > colRows(nbCols);
+		for (unsigned int i = 0 ; i < A.GetNbRows() ; ++i)
+			for (unsigned int p = A.rowStart[i] ; p < A.rowStart[i + 1] ; ++p)
+				colRows[A.colInds[p]].push_back(i);
+
+		const unsigned int noColor = (unsigned int) -1;
+		colors.assign(nbCols, noColor);
+		std::vector<unsigned int> forbidden;
+		unsigned int nbColors = 0;
+		for (unsigned int j = 0 ; j < nbCols ; ++j)
+		{
+			for (unsigned int r = 0 ; r < colRows[j].size() ; ++r)
+			{
+				unsigned int i = colRows[j][r];
+				for (unsigned int p = A.rowStart[i] ; p < A.rowStart[i + 1] ; ++p)
+					if (colors[A.colInds[p]] != noColor)
+					{
+						if (forbidden.size() <= colors[A.colInds[p]])
+							forbidden.resize(colors[A.colInds[p]] + 1, noColor);
+						forbidden[colors[A.colInds[p]]] = j;
+					}
+			}
+			unsigned int c = 0;
+			while ((c < forbidden.size()) and (forbidden[c] == j))
+				++c;
+			colors[j] = c;
+			nbColors = std::max(nbColors, c + 1);
+		}
+		return nbColors;
+	}
+
+/**********************************************************************/
+/* Block Jacobi preconditioner                                        */
+/**********************************************************************/
+	// Dense LU factorization (partial pivoting) of the diagonal blocks
+	template <typename Val = double> class BlockJacobiPreconditioner
+	{
+	public:
+		BlockJacobiPreconditioner() : blockSize(1) {}
+
+		void Factorize(const SparseMatrix<Val> & A, unsigned int _bs)
+		{
+			blockSize = std::max(1u, _bs);
+			unsigned int n = A.GetNbRows();
+			unsigned int bs = blockSize;
+			unsigned int nbBlocks = (n + bs - 1) / bs;
+			lu.assign(nbBlocks * bs * bs, 0);
+			piv.assign(nbBlocks * bs, 0);
+			for (unsigned int b = 0 ; b < nbBlocks ; ++b)
+			{
+				Val *m = &lu[b * bs * bs];
+				unsigned int first = b * bs;
+				unsigned int size = std::min(bs, n - first);
+				// Extract diagonal block (missing rows are the identity)
+				for (unsigned int r = 0 ; r < bs ; ++r)
+					m[r * bs + r] = 1;
+				for (unsigned int r = 0 ; r < size ; ++r)
+				{
+					m[r * bs + r] = 0;
+					for (unsigned int p = A.rowStart[first + r] ; p < A.rowStart[first + r + 1] ; ++p)
+						if ((A.colInds[p] >= first) and (A.colInds[p] < first + size))
+							m[r * bs + A.colInds[p] - first] = A.values[p];
+				}
+				// LU with partial pivoting
+				for (unsigned int k = 0 ; k < bs ; ++k)
+				{
+					unsigned int pr = k;
+					for (unsigned int r = k + 1 ; r < bs ; ++r)
+						if (fabs(m[r * bs + k]) > fabs(m[pr * bs + k]))
+							pr = r;
+					piv[first + k] = pr;
+					if (pr != k)
+						for (unsigned int c = 0 ; c < bs ; ++c)
+							std::swap(m[k * bs + c], m[pr * bs + c]);
+					// Singular block : the pivot is replaced by 1
+					if (m[k * bs + k] == 0)
+						m[k * bs + k] = 1;
+					for (unsigned int r = k + 1 ; r < bs ; ++r)
+					{
+						m[r * bs + k] /= m[k * bs + k];
+						for (unsigned int c = k + 1 ; c < bs ; ++c)
+							m[r * bs + c] -= m[r * bs + k] * m[k * bs + c];
+					}
+				}
+			}
+		}
+		// z = M^-1 r
+		void Apply(const Val *r, Val *z, unsigned int n) const
+		{
+			unsigned int bs = blockSize;
+			std::vector<Val> tmp(bs);
+			for (unsigned int first = 0 ; first < n ; first += bs)
+			{
+				const Val *m = &lu[(first / bs) * bs * bs];
+				unsigned int size = std::min(bs, n - first);
+				for (unsigned int k = 0 ; k < bs ; ++k)
+					tmp[k] = (k < size) ? r[first + k] : 0;
+				// Forward substitution (with row swaps)
+				for (unsigned int k = 0 ; k < bs ; ++k)
+				{
+					std::swap(tmp[k], tmp[piv[first + k]]);
+					for (unsigned int c = 0 ; c < k ; ++c)
+						tmp[k] -= m[k * bs + c] * tmp[c];
+				}
+				// Backward substitution
+				for (int k = bs - 1 ; k >= 0 ; --k)
+				{
+					for (unsigned int c = k + 1 ; c < bs ; ++c)
+						tmp[k] -= m[k * bs + c] * tmp[c];
+					tmp[k] /= m[k * bs + k];
+				}
+				for (unsigned int k = 0 ; k < size ; ++k)
+					z[first + k] = tmp[k];
+			}
+		}
+
+	protected:
+		unsigned int blockSize;
+		std::vector<Val> lu;
+		std::vector<unsigned int> piv;
+	};
+
+/**********************************************************************/
+/* Preconditioned BiCGSTAB                                            */
+/**********************************************************************/
+	// Solves A x = b, x holds the initial guess. Stops when the residual
+	// norm is below tol * |b|. Returns the number of iterations, or -1 
+	// if it did not converge.
+	template <typename Val> int SolveBiCGSTAB(const SparseMatrix<Val> & A, 
+		const BlockJacobiPreconditioner<Val> & M, const Val *b, Val *x, 
+		Val tol, unsigned int maxIter)
+	{
+		unsigned int n = A.GetNbRows();
+		std::vector<Val> r(n), r0(n), p(n, 0), v(n, 0), s(n), t(n), y(n), z(n);
+		A.Multiply(x, &r[0]);
+		Val normB = 0;
+		Val normR = 0;
+		for (unsigned int i = 0 ; i < n ; ++i)
+		{
+			r[i] = b[i] - r[i];
+			r0[i] = r[i];
+			normB += b[i] * b[i];
+			normR += r[i] * r[i];
+		}
+		normB = sqrt(normB);
+		if (normB == 0)
+			normB = 1;
+		if (sqrt(normR) <= tol * normB)
+			return 0;
+
+		Val rho = 1, alpha = 1, omega = 1;
+		for (unsigned int it = 1 ; it <= maxIter ; ++it)
+		{
+			Val rhoNew = 0;
+			for (unsigned int i = 0 ; i < n ; ++i)
+				rhoNew += r0[i] * r[i];
+			if (rhoNew == 0)
+				return -1;
+			Val beta = (rhoNew / rho) * (alpha / omega);
+			rho = rhoNew;
+			for (unsigned int i = 0 ; i < n ; ++i)
+				p[i] = r[i] + beta * (p[i] - omega * v[i]);
+			M.Apply(&p[0], &y[0], n);
+			A.Multiply(&y[0], &v[0]);
+			Val r0v = 0;
+			for (unsigned int i = 0 ; i < n ; ++i)
+				r0v += r0[i] * v[i];
+			if (r0v == 0)
+				return -1;
+			alpha = rho / r0v;
+			Val normS = 0;
+			for (unsigned int i = 0 ; i < n ; ++i)
+			{
+				s[i] = r[i] - alpha * v[i];
+				normS += s[i] * s[i];
+			}
+			if (sqrt(normS) <= tol * normB)
+			{
+				for (unsigned int i = 0 ; i < n ; ++i)
+					x[i] += alpha * y[i];
+				return it;
+			}
+			M.Apply(&s[0], &z[0], n);
+			A.Multiply(&z[0], &t[0]);
+			Val tt = 0, ts = 0;
+			for (unsigned int i = 0 ; i < n ; ++i)
+			{
+				tt += t[i] * t[i];
+				ts += t[i] * s[i];
+			}
+			if (tt == 0)
+				return -1;
+			omega = ts / tt;
+			normR = 0;
+			for (unsigned int i = 0 ; i < n ; ++i)
+			{
+				x[i] += alpha * y[i] + omega * z[i];
+				r[i] = s[i] - omega * t[i];
+				normR += r[i] * r[i];
+			}
+			if (sqrt(normR) <= tol * normB)
+				return it;
+			if (omega == 0)
+				return -1;
+		}
+		return -1;
+	}
+}
+
+#endif
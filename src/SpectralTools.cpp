@@ -0,0 +1,148 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#include "SpectralTools.h"
+
+using namespace std;
+
+//********************************************************************//
+//*************** R E A L   F F T   P L A N   C A C H E **************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+RealFFTPlanCache::~RealFFTPlanCache()
+{
+	Clear();
+}
+
+//**********************************************************************
+//**********************************************************************
+const gsl_fft_real_wavetable * RealFFTPlanCache::Get(unsigned int n)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<unsigned int, gsl_fft_real_wavetable *>::iterator it = wavetables.find(n);
+	if (it != wavetables.end())
+		return it->second;
+	gsl_fft_real_wavetable *wavetable = gsl_fft_real_wavetable_alloc(n);
+	wavetables[n] = wavetable;
+	return wavetable;
+}
+
+//**********************************************************************
+//**********************************************************************
+void RealFFTPlanCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (std::map<unsigned int, gsl_fft_real_wavetable *>::iterator it = 
+			wavetables.begin() ; it != wavetables.end() ; ++it)
+		gsl_fft_real_wavetable_free(it->second);
+	wavetables.clear();
+}
+
+//********************************************************************//
+//**************** R E A L   F F T   W O R K S P A C E ***************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+RealFFTWorkspace::~RealFFTWorkspace()
+{
+	if (workspace)
+		gsl_fft_real_workspace_free(workspace);
+}
+
+//**********************************************************************
+// The workspace is only reallocated when the length changes
+//**********************************************************************
+double * RealFFTWorkspace::GetBuffer(unsigned int _n)
+{
+	if (_n != n)
+	{
+		n = _n;
+		if (workspace)
+			gsl_fft_real_workspace_free(workspace);
+		workspace = gsl_fft_real_workspace_alloc(n);
+		buffer.resize(n);
+	}
+	return &buffer[0];
+}
+
+//**********************************************************************
+//**********************************************************************
+void RealFFTWorkspace::Transform(const gsl_fft_real_wavetable * wavetable)
+{
+	assert(workspace and wavetable);
+	gsl_fft_real_transform(&buffer[0], 1, n, wavetable, workspace);
+}
+
+//********************************************************************//
+//***************** W A V E L E T   W O R K S P A C E ****************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+WaveletWorkspace::~WaveletWorkspace()
+{
+	if (workspace)
+		gsl_wavelet_workspace_free(workspace);
+	if (interp)
+		gsl_interp_free(interp);
+}
+
+//**********************************************************************
+//**********************************************************************
+const double * WaveletWorkspace::Transform(const gsl_wavelet * wavelet, 
+	const std::vector<double> & sig, unsigned int iStart, unsigned int iEnd, 
+	unsigned int _newN)
+{
+	if ((iEnd - iStart) != n)
+	{
+		n = iEnd - iStart;
+		if (interp)
+			gsl_interp_free(interp);
+		interp = gsl_interp_alloc(gsl_interp_linear, n);
+		xa.resize(n);
+		ya.resize(n);
+	}
+	if (_newN != newN)
+	{
+		newN = _newN;
+		if (workspace)
+			gsl_wavelet_workspace_free(workspace);
+		workspace = gsl_wavelet_workspace_alloc(newN);
+		data.resize(newN);
+	}
+
+	// Compute the interpolation for upsampling
+	for (unsigned int i = 0 ; i < n ; ++i)
+	{
+		xa[i] = i;
+		ya[i] = sig[iStart + i];
+	}
+	gsl_interp_init(interp, &xa[0], &ya[0], n);
+	gsl_interp_accel *tmpAcc = gsl_interp_accel_alloc();
+
+	// Upsampling of signal to make it a power of 2
+	for (unsigned int i = 0 ; i < newN ; ++i)
+		data[i] = gsl_interp_eval(interp, &xa[0], &ya[0], 
+			((double)i)/((double)newN - 1.0)*((double)n - 1.0), tmpAcc);
+	gsl_interp_accel_free(tmpAcc);
+
+	// Compute actual wavelet transform
+	gsl_wavelet_transform_forward(wavelet, &data[0], 1, newN, workspace);
+	return &data[0];
+}
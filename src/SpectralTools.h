@@ -0,0 +1,128 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#ifndef SPECTRALTOOLS_H
+#define SPECTRALTOOLS_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <math.h>
+#include <assert.h>
+
+// Needed to avoid conflicting declarations between wavelet and fft
+#ifndef GSL_DISABLE_DEPRECATED
+#define GSL_DISABLE_DEPRECATED
+#endif
+#include <gsl/gsl_wavelet.h>
+#include <gsl/gsl_fft_real.h>
+#include <gsl/gsl_interp.h>
+
+#include "ParallelTools.h"
+
+/**********************************************************************/
+/* Real FFT wavetables, cached by signal length                       */
+/**********************************************************************/
+// Wavetables are only read by the transforms, they are shared by all
+// threads.
+class RealFFTPlanCache
+{
+public:
+	RealFFTPlanCache() {}
+	~RealFFTPlanCache();
+
+	// Returns the wavetable for signals of length n (built on first use)
+	const gsl_fft_real_wavetable * Get(unsigned int n);
+	void Clear();
+
+protected:
+	std::mutex mutex;
+	std::map<unsigned int, gsl_fft_real_wavetable *> wavetables;
+
+private:
+	RealFFTPlanCache(const RealFFTPlanCache &);
+	RealFFTPlanCache & operator=(const RealFFTPlanCache &);
+};
+
+/**********************************************************************/
+/* Real FFT workspace, one per thread                                 */
+/**********************************************************************/
+class RealFFTWorkspace
+{
+public:
+	RealFFTWorkspace() : workspace(0), n(0) {}
+	~RealFFTWorkspace();
+
+	// Returns a buffer of length n
+	double * GetBuffer(unsigned int _n);
+	// Transforms the buffer in place, the result is in half-complex format
+	void Transform(const gsl_fft_real_wavetable * wavetable);
+	// Modulus of the j-th coefficient (0 <= j < n) of the last transform
+	inline double Modulus(unsigned int j) const;
+
+protected:
+	gsl_fft_real_workspace *workspace;
+	unsigned int n;
+	std::vector<double> buffer;
+
+private:
+	RealFFTWorkspace(const RealFFTWorkspace &);
+	RealFFTWorkspace & operator=(const RealFFTWorkspace &);
+};
+
+//**********************************************************************
+// Coefficients j and n - j of a real signal have the same modulus
+//**********************************************************************
+inline double RealFFTWorkspace::Modulus(unsigned int j) const
+{
+	unsigned int k = (2 * j <= n) ? j : n - j;
+	if (k == 0)
+		return fabs(buffer[0]);
+	if (2 * k == n)
+		return fabs(buffer[n - 1]);
+	return sqrt(buffer[2*k-1]*buffer[2*k-1] + buffer[2*k]*buffer[2*k]);
+}
+
+/**********************************************************************/
+/* Wavelet transform workspace, one per thread                        */
+/**********************************************************************/
+class WaveletWorkspace
+{
+public:
+	WaveletWorkspace() : workspace(0), interp(0), n(0), newN(0) {}
+	~WaveletWorkspace();
+
+	// Resamples sig[iStart, iEnd[ on _newN points (linear interpolation) 
+	// and computes its forward transform, returns the coefficients
+	const double * Transform(const gsl_wavelet * wavelet, const std::vector<double> & sig,
+		unsigned int iStart, unsigned int iEnd, unsigned int _newN);
+
+protected:
+	gsl_wavelet_workspace *workspace;
+	gsl_interp *interp;
+	unsigned int n;
+	unsigned int newN;
+	std::vector<double> xa;
+	std::vector<double> ya;
+	std::vector<double> data;
+
+private:
+	WaveletWorkspace(const WaveletWorkspace &);
+	WaveletWorkspace & operator=(const WaveletWorkspace &);
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#include "SpikeQueue.h"
+
+#include <math.h>
+#include <algorithm>
+#include <assert.h>
+
+using namespace AstroModel;
+using namespace std;
+
+//********************************************************************//
+//********************** S P I K E   Q U E U E ***********************//
+//********************************************************************//
+
+//**********************************************************************
+//**********************************************************************
+SpikeQueue::SpikeQueue() : buckets(1), tStart(0), resolution(1),
+	currBucket(0), nbQueued(0), nbDelivered(0)
+{
+}
+
+//**********************************************************************
+// One bucket per resolution step over the largest delay, plus the
+// current one
+//**********************************************************************
+void SpikeQueue::SetUp(double _tStart, double _resolution, double maxDelay)
+{
+	assert(_resolution > 0);
+	tStart = _tStart;
+	resolution = _resolution;
+	currBucket = 0;
+	nbQueued = 0;
+	nbDelivered = 0;
+	due.clear();
+	buckets.assign((unsigned int) ceil(std::max(0.0, maxDelay) / resolution) + 2,
+		std::vector<Spike>());
+}
+
+//**********************************************************************
+//**********************************************************************
+unsigned long int SpikeQueue::bucketOf(double t) const
+{
+	if (t <= tStart)
+		return 0;
+	return (unsigned long int) floor((t - tStart) / resolution);
+}
+
+//**********************************************************************
+//**********************************************************************
+void SpikeQueue::Push(double t, unsigned int syn)
+{
+	// Late spikes go to the oldest bucket
+	unsigned long int b = std::max(bucketOf(t), currBucket);
+	if (b - currBucket >= buckets.size())
+		grow(b);
+	buckets[b % buckets.size()].push_back(Spike(syn, t));
+	++nbQueued;
+}
+
+//**********************************************************************
+// Every bucket before the one of t is emptied, only the spikes due at
+// or before t are taken from the last one
+//**********************************************************************
+const std::vector<SpikeQueue::Spike> & SpikeQueue::PopDue(double t)
+{
+	due.clear();
+	if (nbQueued == 0)
+	{
+		currBucket = std::max(bucketOf(t), currBucket);
+		return due;
+	}
+
+	unsigned long int nb = buckets.size();
+	unsigned long int last = std::max(bucketOf(t), currBucket);
+	unsigned long int end = std::min(last, currBucket + nb - 1);
+	for (unsigned long int b = currBucket ; b <= end ; ++b)
+	{
+		std::vector<Spike> & bucket = buckets[b % nb];
+		if (b < last)
+		{
+			due.insert(due.end(), bucket.begin(), bucket.end());
+			bucket.clear();
+		}
+		else
+		{
+			unsigned int kept = 0;
+			for (unsigned int i = 0 ; i < bucket.size() ; ++i)
+				if (bucket[i].t <= t)
+					due.push_back(bucket[i]);
+				else
+					bucket[kept++] = bucket[i];
+			bucket.resize(kept);
+		}
+	}
+	currBucket = last;
+
+	std::sort(due.begin(), due.end());
+	nbQueued -= due.size();
+	nbDelivered += due.size();
+	return due;
+}
+
+//**********************************************************************
+//**********************************************************************
+void SpikeQueue::grow(unsigned long int b)
+{
+	unsigned long int nb = buckets.size();
+	while (b - currBucket >= nb)
+		nb *= 2;
+
+	std::vector<std::vector<Spike> > newBuckets(nb);
+	for (unsigned long int i = currBucket ; i < currBucket + buckets.size() ; ++i)
+		newBuckets[i % nb].swap(buckets[i % buckets.size()]);
+	buckets.swap(newBuckets);
+}
@@ -0,0 +1,73 @@
+/*----------------------------------------------------------------------------
+  AstroSim: Simulation of astrocyte networks Ca2+ dynamics
+  Copyright (c) 2016-2017 Jules Lallouette
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+----------------------------------------------------------------------------*/
+
+#ifndef SPIKEQUEUE_H
+#define SPIKEQUEUE_H
+
+#include <vector>
+
+namespace AstroModel
+{
+/**********************************************************************/
+/* Delayed spikes waiting for delivery to their synapse               */
+/**********************************************************************/
+	// Ring buffer of time buckets. Spikes are pushed in the bucket of
+	// their delivery time and popped in batches sorted by synapse index.
+	// The ring grows if a delay exceeds its span.
+	class SpikeQueue
+	{
+	public:
+		struct Spike
+		{
+			unsigned int syn; // Index of the target synapse
+			double t;         // Delivery time
+			Spike(unsigned int _s = 0, double _t = 0) : syn(_s), t(_t) {}
+			bool operator<(const Spike & s) const
+				{ return (syn < s.syn) or ((syn == s.syn) and (t < s.t)); }
+		};
+
+		SpikeQueue();
+
+		// Empties the queue, buckets are resolution wide from tStart
+		void SetUp(double _tStart, double _resolution, double maxDelay);
+		// Queues a spike delivered to synapse syn at time t
+		void Push(double t, unsigned int syn);
+		// Removes the spikes due at or before t, sorted by synapse
+		const std::vector<Spike> & PopDue(double t);
+
+		inline bool Empty() const { return nbQueued == 0; }
+		inline unsigned long int GetNbQueued() const { return nbQueued; }
+		// Number of spikes delivered by the last PopDue call
+		inline unsigned int GetLastNbDelivered() const { return due.size(); }
+		// Number of spikes delivered since SetUp
+		inline unsigned long int GetNbDelivered() const { return nbDelivered; }
+
+	protected:
+		std::vector<std::vector<Spike> > buckets;
+		std::vector<Spike> due;
+		double tStart;
+		double resolution;
+		unsigned long int currBucket; // Absolute index of the oldest bucket
+		unsigned long int nbQueued;
+		unsigned long int nbDelivered;
+
+		unsigned long int bucketOf(double t) const;
+		// Doubles the number of buckets until bucket b fits
+		void grow(unsigned long int b);
+	};
+}
+
+#endif
@@ -96,7 +96,7 @@ bool StimulatedCells::SaveMetric(ResultSaver saver) const
 	// Saving
 	if (saver.isSaving(stimulationsName) and not stimulations.empty())
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(stimulationsName, saver.getCurrFile());
 		
 		if (not stimFileHasBeenSaved)
@@ -183,7 +183,7 @@ bool MeanPathStimMetric::SaveMetric(ResultSaver saver) const
 	std::string mpsName("MeanPathStimInfos");
 	if (saver.isSaving(mpsName))
 	{
-		ofstream & stream = saver.getStream();
+		ostream & stream = saver.getStream();
 		this->AddSavedFile(mpsName, saver.getCurrFile());
 		
 		stream << "EffectiveMeanPathLength" << endl;
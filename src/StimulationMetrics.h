@@ -70,6 +70,8 @@ namespace AstroModel
 			{ return stimCells; }
 		virtual const std::string & GetCurrOrigin() const
 			{ return currOrigin; }
+		// Next save starts a new stimulations file (with its header)
+		static void NewStimulationsFile() { stimFileHasBeenSaved = false; }
 
 	protected:
 		double lastT;
@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <algorithm>
 
 #include <gsl/gsl_sf_exp.h>
 
@@ -93,6 +94,11 @@ void Stimulable::Initialize()
 	// Initialize stimulation strategies
 	for (unsigned int i = 0 ; i < stimStrats.size() ; ++i)
 		stimStrats[i]->Initialize();
+	// Nothing is stimulated anymore
+	for (unsigned int i = 0 ; i < stimStrats.size() ; ++i)
+		stimStrats[i]->ClearStimChanges();
+	stimCount.clear();
+	stimIndex.clear();
 	// Initialize stimulation strategies mask
 	if (stimStratActMask.size() != stimStrats.size())
 		stimStratActMask = std::vector<int>(stimStrats.size(), true);
@@ -107,18 +113,43 @@ void Stimulable::Stimulate(double t)
 	{
 		if (stimStratActMask[i] != 0)
 			stimStrats[i]->Stimulate(*this, t);
+		// Strategies reinitialized on their own also have changes
+		mergeStimChanges(*stimStrats[i]);
 	}
 }
 
 //**********************************************************************
-// Is the given cell currently stimulated ?
+// Merges the pending state changes of a strategy in the index
 //**********************************************************************
-bool Stimulable::IsStimulated(unsigned int ind) const 
+void Stimulable::mergeStimChanges(StimulationStrat & strat)
 {
-	bool isStim = false;
-	for (unsigned int i = 0 ; i < stimStrats.size() ; ++i)
-		isStim |= stimStrats[i]->IsStimulated(ind);
-	return isStim; 
+	const std::vector<std::pair<unsigned int, bool> > & changes = strat.GetStimChanges();
+	for (unsigned int k = 0 ; k < changes.size() ; ++k)
+	{
+		unsigned int i = changes[k].first;
+		if (i >= stimCount.size())
+		{
+			stimCount.resize(i + 1, 0);
+			stimIndex.resize(i + 1, false);
+		}
+		if (changes[k].second)
+		{
+			if (stimCount[i]++ == 0)
+			{
+				stimIndex[i] = true;
+				stimIndexChanged(i, true);
+			}
+		}
+		else if (stimCount[i] > 0)
+		{
+			if (--stimCount[i] == 0)
+			{
+				stimIndex[i] = false;
+				stimIndexChanged(i, false);
+			}
+		}
+	}
+	strat.ClearStimChanges();
 }
 
 //********************************************************************//
@@ -244,8 +275,88 @@ std::vector<Metric *> Stimulable::GetAllMetrics() const
 //**********************************************************************
 // Default Constructor
 //**********************************************************************
-StimulableCellNetwork::StimulableCellNetwork(ParamHandler & h) : Stimulable::Stimulable(h)
+StimulableCellNetwork::StimulableCellNetwork(ParamHandler & h) : Stimulable::Stimulable(h),
+	nbBlockedLinks(0)
+{
+}
+
+//**********************************************************************
+// Initializes the model
+//**********************************************************************
+void StimulableCellNetwork::Initialize()
+{
+	Stimulable::Initialize();
+	decoupled.clear();
+	blockedLinks.clear();
+	nbBlockedLinks = 0;
+	nearStimCount.clear();
+	nearStimIndex.clear();
+}
+
+//**********************************************************************
+// Cell i and its neighbors are (or are no longer) near a stimulated cell
+//**********************************************************************
+void StimulableCellNetwork::stimIndexChanged(unsigned int i, bool stim)
 {
+	if (nearStimCount.size() != GetNbCells())
+	{
+		nearStimCount.assign(GetNbCells(), 0);
+		nearStimIndex.assign(GetNbCells(), false);
+	}
+	assert(i < nearStimCount.size());
+	const std::vector<unsigned int> & neighbs = GetNeighbors(i);
+	for (unsigned int k = 0 ; k <= neighbs.size() ; ++k)
+	{
+		unsigned int j = (k < neighbs.size()) ? neighbs[k] : i;
+		if (stim)
+			nearStimIndex[j] = (++nearStimCount[j] > 0);
+		else if (nearStimCount[j] > 0)
+			nearStimIndex[j] = (--nearStimCount[j] > 0);
+	}
+}
+
+//**********************************************************************
+// Blocks or unblocks the gap junctions of cell i. The link between i 
+// and j is blocked while i or j is decoupled, links are only counted
+// when cell i starts or stops being decoupled.
+//**********************************************************************
+void StimulableCellNetwork::DecoupleCell(unsigned int i, bool decouple)
+{
+	if (decoupled.size() != GetNbCells())
+	{
+		decoupled.assign(GetNbCells(), 0);
+		blockedLinks.assign(GetNbCells(), 0);
+		nbBlockedLinks = 0;
+	}
+	assert(i < decoupled.size());
+	if (decouple)
+	{
+		if (decoupled[i]++ != 0)
+			return;
+	}
+	else if ((decoupled[i] == 0) or (--decoupled[i] != 0))
+		return;
+
+	// Links whose other end is decoupled stay blocked
+	const std::vector<unsigned int> & neighbs = GetNeighbors(i);
+	for (unsigned int k = 0 ; k < neighbs.size() ; ++k)
+	{
+		unsigned int j = neighbs[k];
+		if ((j == i) or decoupled[j])
+			continue;
+		if (decouple)
+		{
+			++blockedLinks[i];
+			++blockedLinks[j];
+			++nbBlockedLinks;
+		}
+		else
+		{
+			--blockedLinks[i];
+			--blockedLinks[j];
+			--nbBlockedLinks;
+		}
+	}
 }
 
 //********************************************************************//
@@ -286,10 +397,20 @@ bool StimulationStrat::SaveMetrics(ResultSaver saver) const
 //**********************************************************************
 void StimulationStrat::Initialize()
 {
-	stimulated.clear();
+	resetStimulated(0);
 	metrics.InitializeMetricsDefault();
 }
 
+//**********************************************************************
+// Stops all stimulations and resizes stimulated to nb cells
+//**********************************************************************
+void StimulationStrat::resetStimulated(unsigned int nb)
+{
+	for (unsigned int i = 0 ; i < stimulated.size() ; ++i)
+		setStimulated(i, false);
+	stimulated.assign(nb, false);
+}
+
 //**********************************************************************
 // Loads the cell from a stream
 //**********************************************************************
@@ -336,11 +457,21 @@ void NetworkStimulationStrat::stimulate(Stimulable & model)
 	if (scn)
 	{
 		if (scn->GetNbCells() != stimulated.size())
-			stimulated = vector<bool>(scn->GetNbCells(), false);
+			resetStimulated(scn->GetNbCells());
 		stimulateNet(*scn);
 	}
 }
 
+//**********************************************************************
+// Draws the random sequence for the given network model
+//**********************************************************************
+void NetworkStimulationStrat::DrawRandomSequence(Stimulable & model)
+{
+	StimulableCellNetwork *scn = dynamic_cast<StimulableCellNetwork*>(&model);
+	if (scn)
+		drawRandomSequence(*scn);
+}
+
 //********************************************************************//
 //*************** D E F A U L T   S T I M   S T R A T ****************//
 //********************************************************************//
@@ -457,14 +588,14 @@ void DefaultStimStrat::stimulateNet(StimulableCellNetwork & model)
 		{
 			assert(model.GetNbCells() > cellsToStim[i].ind);
 
-			this->stimulated[cellsToStim[i].ind] = true;
+			this->setStimulated(cellsToStim[i].ind, true);
 
 			this->stimulateSpecific(&model, cellsToStim[i].ind);
 
 			tempTreated[cellsToStim[i].ind] = true;
 		}
 		else if (not tempTreated[cellsToStim[i].ind])
-			this->stimulated[cellsToStim[i].ind] = false;
+			this->setStimulated(cellsToStim[i].ind, false);
 	}
 }
 
@@ -621,7 +752,8 @@ bool DefaultStimStrat::SaveToStream(std::ofstream & stream) const
 //**********************************************************************
 //Default Constructor from paramHandler
 //**********************************************************************
-PoissonianStimStrat::PoissonianStimStrat(ParamHandler & h)
+PoissonianStimStrat::PoissonianStimStrat(ParamHandler & h) : streamKey(0),
+	streamNbCells(0), tMax(0)
 {
 	period = h.getParam<double>("-poissStim", 0);
 	stimTime = h.getParam<double>("-poissStim", 1);
@@ -651,7 +783,8 @@ PoissonianStimStrat::PoissonianStimStrat(double _T, double _s,
 	bool _in, bool _ugs, double _gqr, double _poc) : 
 	period(_T), stimTime(_s), IP3Bias(bias), onlyDriveToSpike(_oS), 
 	useCaSpontRelease(_cSR), caThresh(_ct), isolateNodes(_in), useGluStim(_ugs),
-	gluQuantalRelease(_gqr), poissOmegaC(_poc), funct(_f), freeFunct(not _f)
+	gluQuantalRelease(_gqr), poissOmegaC(_poc), funct(_f), freeFunct(not _f),
+	streamKey(0), streamNbCells(0), tMax(0)
 {
 	if (not funct)
 		funct = new SigmoidCoupling();
@@ -661,7 +794,7 @@ PoissonianStimStrat::PoissonianStimStrat(double _T, double _s,
 // Constructor from stream
 //**********************************************************************
 PoissonianStimStrat::PoissonianStimStrat(std::ifstream & stream) :
-	funct(0)
+	funct(0), streamKey(0), streamNbCells(0), tMax(0)
 {
 	LoadFromStream(stream);
 }
@@ -676,7 +809,9 @@ PoissonianStimStrat::~PoissonianStimStrat()
 }
 
 //**********************************************************************
-// Stimulates the cells according to planned stimulations
+// Stimulates the cells according to planned stimulations. Only the
+// starts and stops that are due are taken from the calendar, and only
+// the currently stimulated cells are stimulated.
 //**********************************************************************
 void PoissonianStimStrat::stimulateNet(StimulableCellNetwork & model)
 {
@@ -685,43 +820,67 @@ void PoissonianStimStrat::stimulateNet(StimulableCellNetwork & model)
 	if (cellTags.size() != nbCells)
 		parseCellTags(model);
 
-	if (spikeTrain.size() != nbCells)
-		generateSpikeTrain(nbCells, model.GetTEnd());
-	if (spikeInd.size() != nbCells)
-		spikeInd = std::vector<unsigned int>(nbCells, 0);
-	if (isolateNodes and gjcShutDown.size() != nbCells)
-		gjcShutDown = std::vector<std::vector<int> >(nbCells, std::vector<int>(nbCells, 0));
+	drawRandomSequence(model);
+	if (currSpike.size() != nbCells)
+	{
+		tMax = model.GetTEnd();
+		resetSpikeTrains(nbCells);
+		buildCalendar();
+	}
 
-	for (unsigned int i = 0 ; i < this->stimulated.size() ; ++i)
+	// A cell changes state at most once per call, due events are all
+	// taken before new ones are scheduled. They are handled in cell order.
+	dueCells.clear();
+	while ((not calendar.empty()) and (this->tCurr > calendar.top().first))
 	{
-		if (spikeInd[i] < spikeTrain[i].size())
+		if (nextEvent[calendar.top().second] == calendar.top().first)
+			dueCells.push_back(calendar.top().second);
+		calendar.pop();
+	}
+	std::sort(dueCells.begin(), dueCells.end());
+	dueCells.erase(std::unique(dueCells.begin(), dueCells.end()), dueCells.end());
+
+	for (unsigned int k = 0 ; k < dueCells.size() ; ++k)
+	{
+		unsigned int i = dueCells[k];
+		// If the currend cell is being stimulated and should stop being stimulated
+		if (this->stimulated[i])
 		{
-			// If the currend cell is being stimulated and should stop being stimulated
-			if (this->stimulated[i] and ((this->tCurr > spikeTrain[i][spikeInd[i]].second)))
-			{
-				stopStimAndSetNextSpike(i);
-				if (isolateNodes)
-					unIsolateANode(i, model);
-			}
-			// If the current cell needs to be stimulated
-			else if (not this->stimulated[i] and (this->tCurr > spikeTrain[i][spikeInd[i]].first))
-			{
-				this->stimulated[i] = true;
-				if (isolateNodes)
-					isolateANode(i, model);
-			}
+			stopStimAndSetNextSpike(i);
+			if (isolateNodes)
+				unIsolateANode(i, model);
 		}
+		// If the current cell needs to be stimulated
+		else
+		{
+			this->setStimulated(i, true);
+			setActive(i, true);
+			scheduleNextEvent(i);
+			if (isolateNodes)
+				isolateANode(i, model);
+		}
+	}
 
-		// Stimulate
+	// Stimulate
+	if (isolateNodes)
+		return;
+	ChIModel *chimod = onlyDriveToSpike ? dynamic_cast<ChIModel*>(&model) : 0;
+	for (unsigned int k = 0 ; k < activeCells.size() ; )
+	{
+		unsigned int i = activeCells[k];
 		bool toStim = !(cellTags[i] & 0x1000000);
-		if (toStim and this->stimulated[i] and not isolateNodes)
+		if (toStim)
 		{
 			stimulateSpecific(&model, i);
 
-			ChIModel *chimod;
-			if ((chimod = dynamic_cast<ChIModel*>(&model)) and onlyDriveToSpike and (chimod->GetDynVal(i, ChICell::Ca) >= caThresh))
+			if (chimod and (chimod->GetDynVal(i, ChICell::Ca) >= caThresh))
+			{
+				// The last active cell takes the place of cell i
 				stopStimAndSetNextSpike(i);
+				continue;
+			}
 		}
+		++k;
 	}
 }
 
@@ -739,7 +898,7 @@ void PoissonianStimStrat::stimulateSpecific(StimulableCellNetwork *model, unsign
 		{
 			const ChICell & cell = chimod->GetCell(ind);
 			double Calc = chimod->GetDynVal(ind, ChICell::Ca);
-			double glu = gluQuantalRelease * gsl_sf_exp(-poissOmegaC*(this->tCurr - spikeTrain[ind][spikeInd[ind]].first));
+			double glu = gluQuantalRelease * gsl_sf_exp(-poissOmegaC*(this->tCurr - currSpike[ind].first));
 			chimod->ModifFluxes(ind, - cell.vbeta * (pow(glu, 0.7) / (pow(glu, 0.7) + 
 				pow(cell.kR + cell.kP*(Calc / (Calc + cell.kpi)), 0.7))));
 		}
@@ -759,19 +918,51 @@ void PoissonianStimStrat::stimulateSpecific(StimulableCellNetwork *model, unsign
 void PoissonianStimStrat::Initialize()
 {
 	StimulationStrat::Initialize();
-	spikeInd.clear();
-	spikeTrain.clear();
-	gjcShutDown.clear();
+	currSpike.clear();
+	spikeCount.clear();
+	streamNbCells = 0;
 	cellTags.clear();
+	calendar = std::priority_queue<StimEvent, std::vector<StimEvent>, 
+		std::greater<StimEvent> >();
+	activeCells.clear();
 }
 
 //**********************************************************************
-// Initialize stimulation strategy but don't delete spikeTrain
+// Initialize stimulation strategy but keep the same random stream, spike
+// trains are drawn again identically
 //**********************************************************************
 void PoissonianStimStrat::InitializeWithSameRandomSequence()
 {
 	StimulationStrat::Initialize();
-	spikeInd.clear();
+	currSpike.clear();
+	calendar = std::priority_queue<StimEvent, std::vector<StimEvent>, 
+		std::greater<StimEvent> >();
+	activeCells.clear();
+}
+
+//**********************************************************************
+// Initialize stimulation strategy with the random stream of other, 
+// spike trains are drawn identically to the ones of other
+//**********************************************************************
+void PoissonianStimStrat::InitializeWithRandomSequenceOf(const RandomStimStrat & other)
+{
+	const PoissonianStimStrat & poiss = dynamic_cast<const PoissonianStimStrat &>(other);
+	streamKey = poiss.streamKey;
+	streamNbCells = poiss.streamNbCells;
+	InitializeWithSameRandomSequence();
+}
+
+//**********************************************************************
+// A new stream key is drawn when the number of cells changes
+//**********************************************************************
+void PoissonianStimStrat::drawRandomSequence(StimulableCellNetwork & model)
+{
+	if (streamNbCells != model.GetNbCells())
+	{
+		streamKey = NewCounterRandKey();
+		streamNbCells = model.GetNbCells();
+		currSpike.clear();
+	}
 }
 
 //**********************************************************************
@@ -779,12 +970,69 @@ void PoissonianStimStrat::InitializeWithSameRandomSequence()
 //**********************************************************************
 void PoissonianStimStrat::stopStimAndSetNextSpike(unsigned int i)
 {
-	this->stimulated[i] = false;
+	this->setStimulated(i, false);
+	setActive(i, false);
 	// Take the next spike
-	while ((spikeInd[i] < spikeTrain[i].size()) and 
-			(spikeTrain[i][spikeInd[i]].first < this->tCurr))
-		++spikeInd[i];
+	while (hasSpike(i) and (currSpike[i].first < this->tCurr))
+		drawNextSpike(i);
+	scheduleNextEvent(i);
+}
+
+//**********************************************************************
+// Schedules the events of all cells from their current state
+//**********************************************************************
+void PoissonianStimStrat::buildCalendar()
+{
+	unsigned int nbCells = currSpike.size();
+	std::vector<StimEvent> events;
+	events.reserve(nbCells);
+	nextEvent.assign(nbCells, -HUGE_VAL);
+	activeCells.clear();
+	activePos.assign(nbCells, 0);
+	for (unsigned int i = 0 ; i < nbCells ; ++i)
+	{
+		if (this->stimulated[i])
+			setActive(i, true);
+		if (hasSpike(i))
+		{
+			nextEvent[i] = this->stimulated[i] ? currSpike[i].second : currSpike[i].first;
+			events.push_back(std::make_pair(nextEvent[i], i));
+		}
+	}
+	calendar = std::priority_queue<StimEvent, std::vector<StimEvent>, 
+		std::greater<StimEvent> >(std::greater<StimEvent>(), events);
+}
 
+//**********************************************************************
+// A stimulated cell stops at the end of its current spike, the others
+// start at the beginning of their next spike
+//**********************************************************************
+void PoissonianStimStrat::scheduleNextEvent(unsigned int i)
+{
+	if (hasSpike(i))
+	{
+		nextEvent[i] = this->stimulated[i] ? currSpike[i].second : currSpike[i].first;
+		calendar.push(std::make_pair(nextEvent[i], i));
+	}
+	else
+		nextEvent[i] = -HUGE_VAL;
+}
+
+//**********************************************************************
+//**********************************************************************
+void PoissonianStimStrat::setActive(unsigned int i, bool active)
+{
+	if (active)
+	{
+		activePos[i] = activeCells.size();
+		activeCells.push_back(i);
+	}
+	else if ((activePos[i] < activeCells.size()) and (activeCells[activePos[i]] == i))
+	{
+		activeCells[activePos[i]] = activeCells.back();
+		activePos[activeCells.back()] = activePos[i];
+		activeCells.pop_back();
+	}
 }
 
 //**********************************************************************
@@ -866,10 +1114,11 @@ bool PoissonianStimStrat::SaveToStream(std::ofstream & stream) const
 
 //**********************************************************************
 // Returns a random value from an exponential distribution of mean 'mean'
+// drawn from the stream of cell i
 //**********************************************************************
-double PoissonianStimStrat::expDelay(double mean)
+double PoissonianStimStrat::expDelay(double mean, unsigned int i)
 {
-	return ExpRand(mean);
+	return CounterExpRand(mean, CounterRandKey(streamKey, i), spikeCount[i]++);
 }
 
 //**********************************************************************
@@ -881,46 +1130,37 @@ double PoissonianStimStrat::activationTime(double mean)
 }
 
 //**********************************************************************
-// Generate a spike train
+// Restarts the spike trains of all cells. As before, trains start 
+// NB_POISS_START_DELAY periods before 0 and the first spike is the 
+// first one after 0.
 //**********************************************************************
-void PoissonianStimStrat::generateSpikeTrain(unsigned int nbCells, double tMax)
+void PoissonianStimStrat::resetSpikeTrains(unsigned int nbCells)
 {
-	spikeTrain.clear();
-	spikeTrain = std::vector<std::vector<std::pair<double, double> > >(
-		nbCells, std::vector<std::pair<double, double> >());
-
-	// For each cell
+	currSpike.assign(nbCells, std::make_pair(-period * NB_POISS_START_DELAY, 0.0));
+	spikeCount.assign(nbCells, 0);
 	for (unsigned int i = 0 ; i < nbCells ; ++i)
-	{
-		// If the cell needs to be stimulated
+		do {
+			drawNextSpike(i);
+		} while (currSpike[i].first < 0);
+}
 
-		spikeTrain[i].push_back(std::make_pair(-period * NB_POISS_START_DELAY, 0));
-		// Add spikes separated by exponentially distributed delays until tMax is reached
-		while (spikeTrain[i].back().first <= tMax)
-		{
-			spikeTrain[i].back().first += expDelay(period);
-			spikeTrain[i].back().second = spikeTrain[i].back().first + activationTime(stimTime);
-			if ((spikeTrain[i].back().first >= 0) and (spikeTrain[i].back().first < tMax))
-				spikeTrain[i].push_back(std::make_pair(spikeTrain[i].back().first, 
-					spikeTrain[i].back().first + activationTime(stimTime)));
-		}
-	}
+//**********************************************************************
+// Spikes after tMax are never reached, no need to draw further
+//**********************************************************************
+void PoissonianStimStrat::drawNextSpike(unsigned int i)
+{
+	if (not hasSpike(i))
+		return;
+	currSpike[i].first += expDelay(period, i);
+	currSpike[i].second = currSpike[i].first + activationTime(stimTime);
 }
 
 //**********************************************************************
-// Isolate a node
+// Isolate a node, its gap junctions are blocked by the model
 //**********************************************************************
 void PoissonianStimStrat::isolateANode(unsigned int i, StimulableCellNetwork & model)
 {
-	const std::vector<unsigned int> & neighb = model.GetNeighbors(i);
-	for (unsigned int j = 0 ; j < neighb.size() ; ++j)
-	{
-		CouplingFunction *cf = dynamic_cast<CouplingFunction*>(
-			model.GetNetwork().GetAbstractEdge(i, neighb[j]));
-		cf->ChangeStrength(0.0);
-		gjcShutDown[i][neighb[j]]++;
-		gjcShutDown[neighb[j]][i]++;
-	}
+	model.DecoupleCell(i, true);
 }
 
 //**********************************************************************
@@ -928,16 +1168,7 @@ void PoissonianStimStrat::isolateANode(unsigned int i, StimulableCellNetwork & m
 //**********************************************************************
 void PoissonianStimStrat::unIsolateANode(unsigned int i, StimulableCellNetwork & model)
 {
-	const std::vector<unsigned int> & neighb = model.GetNeighbors(i);
-	for (unsigned int j = 0 ; j < neighb.size() ; ++j)
-	{
-		gjcShutDown[i][neighb[j]]--;
-		gjcShutDown[neighb[j]][i]--;
-		if (gjcShutDown[i][neighb[j]] == 0)
-		{
-			model.GetNetwork().GetAbstractEdge(i, neighb[j])->UpdateEdge();
-		}
-	}
+	model.DecoupleCell(i, false);
 }
 
 //**********************************************************************
@@ -1009,20 +1240,19 @@ RandomMonoStim::~RandomMonoStim()
 //**********************************************************************
 void RandomMonoStim::stimulateNet(StimulableCellNetwork & model)
 {
-	if (stimTrain.size() != model.GetNbCells())
-		generateStimTrain(model.GetNbCells(), model.GetTEnd());
+	drawRandomSequence(model);
 
 	double t = this->tCurr;
 	if (this->stimulated[stimTrain[currStimInd]] and (currStimStart + stimLength < t))
 	{
 		currPauseStart = t;
-		this->stimulated[stimTrain[currStimInd]] = false;
+		this->setStimulated(stimTrain[currStimInd], false);
 	}
 	else if (not this->stimulated[stimTrain[currStimInd]] and (currPauseStart + pauseLength < t))
 	{
 		currStimStart = t;
 		currStimInd++;
-		this->stimulated[stimTrain[currStimInd]] = true;
+		this->setStimulated(stimTrain[currStimInd], true);
 	}
 
 	if (this->stimulated[stimTrain[currStimInd]])
@@ -1060,6 +1290,16 @@ void RandomMonoStim::generateStimTrain(unsigned int nbCells, double tMax)
 	}
 }
 
+//**********************************************************************
+// Generates the stimulation train if there is none (Initialize clears
+// it), so that no random number is drawn during the simulation
+//**********************************************************************
+void RandomMonoStim::drawRandomSequence(StimulableCellNetwork & model)
+{
+	if (stimTrain.empty())
+		generateStimTrain(model.GetNbCells(), model.GetTEnd());
+}
+
 //**********************************************************************
 // Initialize the stimulation strategy as if it were just created
 //**********************************************************************
@@ -1083,6 +1323,15 @@ void RandomMonoStim::InitializeWithSameRandomSequence()
 	currStimInd = 0;
 }
 
+//**********************************************************************
+// Initialize stimulation strategy with the spikeTrain of other
+//**********************************************************************
+void RandomMonoStim::InitializeWithRandomSequenceOf(const RandomStimStrat & other)
+{
+	stimTrain = dynamic_cast<const RandomMonoStim &>(other).stimTrain;
+	InitializeWithSameRandomSequence();
+}
+
 //**********************************************************************
 // Returns a param handler of the stimulation strat parameters
 //**********************************************************************
@@ -1236,11 +1485,11 @@ void ThresholdDeterminationStimStrat::stimulateNet(StimulableCellNetwork & model
 					double diffIP3 = model2->GetDynVal(i, ChICell::IP3) - IP3Bias;
 					model2->ModifFluxes(i, (*funct)(diffIP3));
 				}
-				this->stimulated[i] = true;
+				this->setStimulated(i, true);
 			}
 			else
 			{
-				this->stimulated[i] = false;
+				this->setStimulated(i, false);
 				neverSpiked[i] = false;
 			}
 		}
@@ -1387,6 +1636,15 @@ MeanPathStimStrat::~MeanPathStimStrat()
 // Stimulates the cells according to planend stimulations
 //**********************************************************************
 void MeanPathStimStrat::stimulateNet(StimulableCellNetwork & model)
+{
+	drawRandomSequence(model);
+	DefaultStimStrat::stimulate(model);
+}
+
+//**********************************************************************
+// Chooses the stimulated cells if they aren't chosen yet
+//**********************************************************************
+void MeanPathStimStrat::drawRandomSequence(StimulableCellNetwork & model)
 {
 	if (not stimCellsChosen)
 	{
@@ -1443,8 +1701,6 @@ void MeanPathStimStrat::stimulateNet(StimulableCellNetwork & model)
 
 		stimCellsChosen = true;
 	}
-
-	DefaultStimStrat::stimulate(model);
 }
 
 //**********************************************************************
@@ -24,6 +24,7 @@
 //#include "StimulationMetrics.h"
 
 #include <string>
+#include <queue>
 
 namespace AstroModel
 {
@@ -77,8 +78,9 @@ namespace AstroModel
 		//===========================================================||
 		// Returns all metrics and submetrics
 		virtual std::vector<Metric *> GetAllMetrics() const;
-		// Is the given cell currently stimulated ?
-		virtual bool IsStimulated(unsigned int ind) const;
+		// Is the given cell currently stimulated ? (by any strategy)
+		virtual bool IsStimulated(unsigned int ind) const
+			{ return (ind < stimIndex.size()) and stimIndex[ind]; }
 		// Returns true if the given stimulation strat is added to the model and activated
 		virtual bool IsStimStratActivated(std::string) const;
 		// Return tEnd
@@ -91,6 +93,15 @@ namespace AstroModel
 		std::vector<int> stimStratActMask;
 		// Stimulation strategies
 		std::vector<StimulationStrat *> stimStrats;
+		// Merged index of the stimulated cells, only updated when a 
+		// strategy starts or stops stimulating a cell
+		std::vector<unsigned int> stimCount; // Strategies stimulating each cell
+		std::vector<bool> stimIndex;         // Cells stimulated by any strategy
+
+		// Merges the pending state changes of a strategy in the index
+		void mergeStimChanges(StimulationStrat & strat);
+		// Called when cell i starts or stops being stimulated by any strategy
+		virtual void stimIndexChanged(unsigned int , bool ) {}
 	};
 
 /**********************************************************************/
@@ -102,6 +113,9 @@ namespace AstroModel
 		// Constructor
 		StimulableCellNetwork(ParamHandler & h = ParamHandler::GlobalParams);
 
+		// Initializes the stimulable object, no cell is decoupled
+		virtual void Initialize();
+
 		// Returns the number of cells in the model
 		virtual unsigned int GetNbCells() const = 0;
 		// Returns a const ref on the network
@@ -110,6 +124,34 @@ namespace AstroModel
 		virtual const std::vector<unsigned int> & GetNeighbors(unsigned int i) const = 0;
 		// Set all cells to equilibrium
 		virtual void SetAllCellsToEquilibrium() = 0;
+
+		//===========================================================||
+		// Gap junction blocking                                     ||
+		//===========================================================||
+		// Blocks (or unblocks) the gap junctions of cell i. Calls are
+		// counted, a cell decoupled twice must be recoupled twice.
+		void DecoupleCell(unsigned int i, bool decouple = true);
+		// Are there blocked links ?
+		inline bool HasBlockedLinks() const { return nbBlockedLinks != 0; }
+		// Is the link between i and j blocked ? (flux kernels treat 
+		// the coupling function of a blocked link as null)
+		inline bool IsLinkBlocked(unsigned int i, unsigned int j) const
+			{ return (nbBlockedLinks != 0) and blockedLinks[i] and (decoupled[i] or decoupled[j]); }
+
+		// Is the given cell or one of its neighbors currently stimulated ?
+		inline bool IsStimulatedOrAdjacent(unsigned int i) const
+			{ return (i < nearStimIndex.size()) and nearStimIndex[i]; }
+
+	protected:
+		std::vector<unsigned int> decoupled;    // Number of blocks of each cell
+		std::vector<unsigned int> blockedLinks; // Number of blocked links of each cell
+		unsigned int nbBlockedLinks;            // Number of blocked links
+		// Number of stimulated cells among each cell and its neighbors
+		std::vector<unsigned int> nearStimCount;
+		std::vector<bool> nearStimIndex;
+
+		// Updates the neighborhood index
+		virtual void stimIndexChanged(unsigned int i, bool stim);
 	};
 
 /**********************************************************************/
@@ -150,6 +192,9 @@ namespace AstroModel
 		virtual std::string GetClassName() const = 0;
 		// Initializes the stimulation strategy
 		virtual void Initialize();
+		// Draws from the global generator what the strategy would 
+		// otherwise draw during its first stimulation of the model
+		virtual void DrawRandomSequence(Stimulable & ) {}
 
 		//===========================================================||
 		// Standard Save and Load methods                            ||
@@ -179,19 +224,38 @@ namespace AstroModel
 		inline bool IsStimulated(unsigned int ind) const 
 			{ return (ind < stimulated.size()) ? stimulated[ind] : false; };
 		inline unsigned int GetSize() const { return stimulated.size(); }
+		// State changes (cell, new state) since the last call to 
+		// ClearStimChanges, in chronological order
+		inline const std::vector<std::pair<unsigned int, bool> > & GetStimChanges() const
+			{ return stimChanges; }
+		inline void ClearStimChanges() { stimChanges.clear(); }
 		inline double GetTime() const { return tCurr; }
 		// Returns all metrics and submetrics
 		virtual std::vector<Metric *> GetAllMetrics() const;
 
 	protected:
 		double tCurr; // Current time
-		// State of each cell (being stimulated or not)
+		// State of each cell (being stimulated or not), only modified 
+		// through setStimulated and resetStimulated
 		std::vector<bool> stimulated; 
+		// Changes of stimulated not yet merged by the model
+		std::vector<std::pair<unsigned int, bool> > stimChanges;
 
 		SortedMetrics<StimulationStrat> metrics;
 
 		// Stimulates the given model
 		virtual void stimulate(Stimulable & model) = 0;
+		// Starts or stops the stimulation of cell i
+		inline void setStimulated(unsigned int i, bool stim)
+		{
+			if (stimulated[i] != stim)
+			{
+				stimulated[i] = stim;
+				stimChanges.push_back(std::make_pair(i, stim));
+			}
+		}
+		// Stops all stimulations and resizes stimulated to nb cells
+		void resetStimulated(unsigned int nb);
 	};
 
 /**********************************************************************/
@@ -199,6 +263,9 @@ namespace AstroModel
 /**********************************************************************/
 	class NetworkStimulationStrat : public StimulationStrat
 	{
+	public:
+		// Draws the random sequence for the given network model
+		virtual void DrawRandomSequence(Stimulable & model);
 
 	protected:
 		// Actually stimulate with appropriate method
@@ -207,6 +274,8 @@ namespace AstroModel
 		virtual void stimulate(Stimulable & model);
 		// Stimulates the given network model 
 		virtual void stimulateNet(StimulableCellNetwork & model) = 0;
+		// Draws the random sequence of the strategy if it isn't drawn yet
+		virtual void drawRandomSequence(StimulableCellNetwork & ) {}
 	};
 
 /**********************************************************************/
@@ -218,6 +287,9 @@ namespace AstroModel
 		// Initializes the stimulation strategy with the same random 
 		// sequence that it already has.
 		virtual void InitializeWithSameRandomSequence() = 0;
+		// Initializes the stimulation strategy with the random sequence
+		// of another strategy of the same class
+		virtual void InitializeWithRandomSequenceOf(const RandomStimStrat & other) = 0;
 	};
 
 /**********************************************************************/
@@ -331,8 +403,10 @@ namespace AstroModel
 		//===========================================================||
 		// Specific Stimulation Strategy methods                     ||
 		//===========================================================||
-		// Initialize stimulation strategy but don't delete spikeTrain
+		// Initialize stimulation strategy but keep the same random stream
 		virtual void InitializeWithSameRandomSequence();
+		// Initialize stimulation strategy with the random stream of other
+		virtual void InitializeWithRandomSequenceOf(const RandomStimStrat & other);
 
 		//===========================================================||
 		// Special model parameters handling method                  ||
@@ -359,37 +433,66 @@ namespace AstroModel
 		CouplingFunction *funct; // Coupling function to bias cell for stimulation
 		bool freeFunct;          // Need to free the coupling function on death ?
 
-		// Position in spike train for each cell [cell ind](spikeTrain ind)
-		std::vector<unsigned int> spikeInd;
-
-		// Spike Train [cell ind][spike Ind](start Time, end time)
-		std::vector<std::vector<std::pair<double, double> > > spikeTrain;
-
-		// counts the number of time each GJC has been shut down
-		std::vector<std::vector<int> > gjcShutDown;
+		// Spike trains are drawn on demand from one counter based random
+		// stream per cell, only the pending spike of each cell is kept
+		unsigned long long int streamKey;
+		unsigned int streamNbCells; // 0 if a new stream must be drawn
+		double tMax;                // No spike starts after tMax
+		// Current spike of each cell [cell ind](start Time, end time)
+		std::vector<std::pair<double, double> > currSpike;
+		// Number of values drawn from the stream of each cell
+		std::vector<unsigned long int> spikeCount;
 
 		// Check cell tags to determine whether a cell must be stimulated
 		std::vector<unsigned long int> cellTags;
 
+		// Stimulation calendar : the next start or stop time of each cell
+		// (time, cell). Outdated events are detected with nextEvent.
+		typedef std::pair<double, unsigned int> StimEvent;
+		std::priority_queue<StimEvent, std::vector<StimEvent>, 
+			std::greater<StimEvent> > calendar;
+		std::vector<double> nextEvent;
+		std::vector<unsigned int> dueCells;
+		// Currently stimulated cells and their position in activeCells
+		std::vector<unsigned int> activeCells;
+		std::vector<unsigned int> activePos;
+
 		//===========================================================||
 		// Standard Stimulation Strategy methods                     ||
 		//===========================================================||
 		// Strategy main method, stimulates the given model
 		virtual void stimulateNet(StimulableCellNetwork & model);
+		// Draws the key of the random stream
+		virtual void drawRandomSequence(StimulableCellNetwork & model);
 		// Actually stimulate with appropriate method
 		virtual void stimulateSpecific(StimulableCellNetwork *model, unsigned int ind) const;
 		// Get to next spike for a given cell
 		virtual void stopStimAndSetNextSpike(unsigned int i);
 
+		//===========================================================||
+		// Stimulation calendar                                      ||
+		//===========================================================||
+		// Schedules the events of all cells from their current state
+		void buildCalendar();
+		// Schedules the next start or stop of cell i
+		void scheduleNextEvent(unsigned int i);
+		// Adds or removes cell i from the active cells
+		void setActive(unsigned int i, bool active);
+
 		//===========================================================||
 		// Utility mathematical functions                            ||
 		//===========================================================||
-		// Returns a random value from an exponential distribution
-		double expDelay(double mean);
+		// Returns a random value from an exponential distribution, 
+		// drawn from the stream of cell i
+		double expDelay(double mean, unsigned int i);
 		// Returns a time during which a cell is going to stay activated
 		double activationTime(double mean);
-		// Generate a spike train
-		void generateSpikeTrain(unsigned int nbCells, double tMax);
+		// Restarts the spike trains of all cells from their beginning
+		void resetSpikeTrains(unsigned int nbCells);
+		// Draws the spike following the current one for cell i
+		void drawNextSpike(unsigned int i);
+		// Is there a current spike for cell i ?
+		inline bool hasSpike(unsigned int i) const { return currSpike[i].first < tMax; }
 
 		// Isolate a node
 		void isolateANode(unsigned int i, StimulableCellNetwork & model);
@@ -439,6 +542,8 @@ namespace AstroModel
 		//===========================================================||
 		// Initialize stimulation strategy but don't delete spikeTrain
 		virtual void InitializeWithSameRandomSequence();
+		// Initialize stimulation strategy with the spikeTrain of other
+		virtual void InitializeWithRandomSequenceOf(const RandomStimStrat & other);
 
 		//===========================================================||
 		// Special model parameters handling method                  ||
@@ -455,6 +560,8 @@ namespace AstroModel
 		virtual void stimulateSpecific(StimulableCellNetwork *model, unsigned int ind) const;
 		// Generates stimulation train
 		virtual void generateStimTrain(unsigned int nbCells, double tMax);
+		// Generates the stimulation train if there is none
+		virtual void drawRandomSequence(StimulableCellNetwork & model);
 
 		//===========================================================||
 		// Parameters and local variables                            ||
@@ -608,6 +715,8 @@ namespace AstroModel
 		//===========================================================||
 		// Strategy main method, stimulates the given model
 		virtual void stimulateNet(StimulableCellNetwork & model);
+		// Chooses the stimulated cells if they aren't chosen yet
+		virtual void drawRandomSequence(StimulableCellNetwork & model);
 	};
 
 /**********************************************************************/
@@ -32,8 +32,8 @@ using namespace std;
 //**********************************************************************
 Synapse::Synapse(const NeuronNetModel * _model, double *_dv, bool _fv, 
 	unsigned int _nbdv) : 
-	funct(0), model(_model), preSynNeur(0), postSynNeur(0), 
-	dynVals(_dv), freeDynVals(_fv), nbDynVals(_nbdv)
+	funct(0), model(_model), preSynNeur(0), postSynNeur(0), index(0),
+	delay(0), dynVals(_dv), freeDynVals(_fv), nbDynVals(_nbdv)
 {
 }
 
@@ -41,16 +41,17 @@ Synapse::Synapse(const NeuronNetModel * _model, double *_dv, bool _fv,
 // Cosntructor from stream
 //**********************************************************************
 Synapse::Synapse(std::ifstream & ) : funct(0), model(0), 
-	preSynNeur(0), postSynNeur(0), dynVals(0), freeDynVals(false),
-	nbDynVals(0)
+	preSynNeur(0), postSynNeur(0), index(0), delay(0), dynVals(0), 
+	freeDynVals(false), nbDynVals(0)
 {
 }
 
 //**********************************************************************
 // Copy constructor
 //**********************************************************************
-Synapse::Synapse(const Synapse & s) : model(s.model), 
-	dynVals(s.dynVals), freeDynVals(s.freeDynVals), nbDynVals(s.nbDynVals)
+Synapse::Synapse(const Synapse & s) : model(s.model), index(s.index),
+	delay(s.delay), dynVals(s.dynVals), freeDynVals(s.freeDynVals), 
+	nbDynVals(s.nbDynVals)
 {
 	if (freeDynVals)
 	{
@@ -261,6 +262,16 @@ void TMSynapse::PresynSpike(double)
 	dynVals[x] -= dynVals[u]*dynVals[x];
 }
 
+//**********************************************************************
+// Exact relaxation between presynaptic spikes
+//**********************************************************************
+void TMSynapse::AdvanceExactly(double dt)
+{
+	dynVals[x] = 1.0 - (1.0 - dynVals[x]) * gsl_sf_exp(-Od * dt);
+	dynVals[u] = dynVals[u] * gsl_sf_exp(-Of * dt);
+	dynVals[gamma] = dynVals[gamma] * gsl_sf_exp(-Oc * dt);
+}
+
 //**********************************************************************
 // Update value names in ODEProblem
 //**********************************************************************
@@ -339,6 +350,13 @@ double TMSynapse::GetGluVal() const
 	return dynVals[TMSynapse::gamma];
 }
 
+//**********************************************************************
+//**********************************************************************
+const double * TMSynapse::GetGluSource() const
+{
+	return dynVals + TMSynapse::gamma;
+}
+
 //**********************************************************************
 //**********************************************************************
 unsigned int TMSynapse::GetNbDynVal() const
@@ -450,6 +468,14 @@ void TMSynapseOptim::PresynSpike(double t)
 	lastSpikeTime = t;
 }
 
+//**********************************************************************
+// Exact relaxation between presynaptic spikes
+//**********************************************************************
+void TMSynapseOptim::AdvanceExactly(double dt)
+{
+	dynVals[gammaOpt] = dynVals[gammaOpt] * gsl_sf_exp(-Oc * dt);
+}
+
 //**********************************************************************
 // Update value names in ODEProblem
 //**********************************************************************
@@ -465,6 +491,13 @@ double TMSynapseOptim::GetGluVal() const
 	return dynVals[TMSynapseOptim::gammaOpt];
 }
 
+//**********************************************************************
+//**********************************************************************
+const double * TMSynapseOptim::GetGluSource() const
+{
+	return dynVals + TMSynapseOptim::gammaOpt;
+}
+
 //**********************************************************************
 //**********************************************************************
 unsigned int TMSynapseOptim::GetNbDynVal() const
@@ -67,6 +67,11 @@ namespace AstroModel
 		virtual void PresynSpike(double t) = 0;
 		// Update value names in ODEProblem
 		virtual void SetValNamesPostfix(std::string pf) = 0;
+		// Returns true if the dynamics can be solved exactly between
+		// presynaptic spikes
+		virtual bool HasExactSolution() const { return false; }
+		// Advances the dynamical values by dt without presynaptic spike
+		virtual void AdvanceExactly(double ) {}
 
 		//===========================================================||
 		// Special model parameters handling method                  ||
@@ -85,6 +90,12 @@ namespace AstroModel
 		virtual void SetPreSynNeur(Neuron *_n);
 		virtual void SetPostSynNeur(Neuron *_n);
 		virtual const NeuronNetModel * GetModel() const;
+		// Index in the model synapses, used by the spike queue
+		inline unsigned int GetIndex() const { return index; }
+		inline void SetIndex(unsigned int _i) { index = _i; }
+		// Axonal delay of the presynaptic spikes
+		inline double GetDelay() const { return delay; }
+		inline void SetDelay(double _d) { delay = _d; }
 
 	protected:
 		//===========================================================||
@@ -98,6 +109,9 @@ namespace AstroModel
 		// Pointer to the post-synaptic neuron
 		Neuron *postSynNeur;
 
+		unsigned int index;
+		double delay;
+
 		//===========================================================||
 		// Dynamic values                                            ||
 		//===========================================================||
@@ -135,6 +149,10 @@ namespace AstroModel
 		// Accessors                                                 ||
 		//===========================================================||
 		virtual double GetGluVal() const = 0;
+		// Address of the dynamic value GetGluVal reads
+		virtual const double * GetGluSource() const = 0;
+		// Fraction of the glutamate that reaches the astrocytes
+		virtual double GetSpillOverFraction() const { return 0.025; }
 	};
 
 /**********************************************************************/
@@ -197,6 +215,9 @@ namespace AstroModel
 		virtual std::string GetClassName() const { return ClassName; }
 		// Update edge values in case parameters were changed
 		virtual void UpdateEdge();
+		// x, u and gamma relax exponentially between spikes
+		virtual bool HasExactSolution() const { return true; }
+		virtual void AdvanceExactly(double dt);
 
 		//===========================================================||
 		// Standard Save and Load methods                            ||
@@ -215,6 +236,8 @@ namespace AstroModel
 		// Accessors                                                 ||
 		//===========================================================||
 		virtual double GetGluVal() const;
+		virtual const double * GetGluSource() const;
+		virtual double GetSpillOverFraction() const { return spillOvFract; }
 		virtual unsigned int GetNbDynVal() const;
 		// Change dynamic values to given pointer
 		//virtual void SetDynVals(double *_dv, bool _f);
@@ -295,11 +318,14 @@ namespace AstroModel
 		virtual void SetValNamesPostfix(std::string pf);
 		// Return class name
 		virtual std::string GetClassName() const { return ClassName; }
+		// Only gamma is integrated, x and u are updated at spikes
+		virtual void AdvanceExactly(double dt);
 
 		//===========================================================||
 		// Accessors                                                 ||
 		//===========================================================||
 		virtual double GetGluVal() const;
+		virtual const double * GetGluSource() const;
 		virtual unsigned int GetNbDynVal() const;
 
 	protected:
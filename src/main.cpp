@@ -52,6 +52,7 @@ int main(int argc, char * argv[])
 	ParamHandler & handler = ParamHandler::GlobalParams;
 
 	bool debug,  save,  load,  saveModel,  loadModel,  useSubDir,
+		singlePrec, validatePrec, propModSync, sersEventDriven,
 		saveSim, loadSim, splitGrid, simulate, useParamsFromFile,
 		notSpacialNetwork,      normLinkStrength,     showNbSims,
 		onlySpikePoiss,   useModTransTimeSERS,  useToroidalSpace,
@@ -63,7 +64,8 @@ int main(int argc, char * argv[])
 		functTopoUseMinForBidir,  threshCaSpontRel,  preRunToEqu,
 		frmFileUseSparse, frmFileUseValAsStrengths, propOnlyOneWave,
 		waveDetectUPOPANS, poissIsolateNode, poissUseGluStim,
-		starLikeMakeSquare;
+		starLikeMakeSquare, onlStatKeepRaw, useActiveSet, neurEventDriven,
+		fdEventDriven, threshDetBisect, stochResConcurrent, activeSetValidate;
 	double tStart,    tEnd,    Step,   F,   IPBias,   savingStep, 
 		poissPeriod,   poissLength,  propMinDelay,  propMaxDelay, 
 		randStimLength,	     randPauseLength,     propInstWindow, 
@@ -88,16 +90,24 @@ int main(int argc, char * argv[])
 		wavltDromFreqThreRat,               wavltPowrThreshFract, 
 		defStimCouplStrength, slbInterCellDist, slbInterCompDist,
 		voroMaxLinkDist, KStimVal, KStimIncrRate, ThreshDetCouplStr,
-		poissGluQuantalRel, poissOmegaC, somaCouplStr;
+		poissGluQuantalRel, poissOmegaC, somaCouplStr, onlStatCompression,
+		onlStatBinMin, onlStatBinMax, activSamplingPeriod, rosenLinTol,
+		activeSetTol, activeSetWakeFlux, neurEventSampleStep, synDelay,
+		synDelayJitter, bitSlicedThreshSpread, fdEventSampleStep, fdEventTol,
+		threshDetRestTol;
 	int N, Nastr,   Nneur,   desiredNb,    seed,    swNeighbDist, 
 		thresholdStimRad,   functTopoCommonMethod,  maxRadToSave, 
-		DefaultCouplingMethod, shellScrambleStartNode;
+		DefaultCouplingMethod, shellScrambleStartNode, saverNbWriters,
+		saverQueueSize, spectraThreads, rosenJacPeriod,
+		multirateNbSubSteps, multirateInterp, splitNbSubSteps, splitNbThreads,
+		propModSyncThreads, bitSlicedReplicas, threshDetBisectThreads;
 	unsigned int dim,      regularDegree,     spatialScaleFreeNl, 
 		hccStart,     hccEnd,     hccRepeat,     propModSimStart, 
 		propModSimEnd,   repeatSim,   nbSinks,   threshDetDegree, 
 		mplNbStims,          mpltExp,          transEntropNbBins, 
 		threshDetnbStimulated,  threshDetSinks,  slbBranchLength,
-		slbNbBraches, slbNbEndBall, somaRadius;
+		slbNbBraches, slbNbEndBall, somaRadius, onlStatNbBins, rosenLinMaxIter,
+		batchReplicas;
 	string modelLoadingPath,     resultFileName,      subDirPath, 
 		simLoadingPath,      simSavingPath,      modelSavingPath, 
 		savingPath,         loadingPath,         defaultGridName, 
@@ -128,7 +138,7 @@ int main(int argc, char * argv[])
 		paramEndValues,     paramStepValues,     condParStartVal,
 		condParEndVal,       condParStepVal,      propStartQuant, 
 		propEndQuant, propStepQuant, propStartRatio, propEndRatio, 
-		propStepRatio;
+		propStepRatio, onlStatQuants;
 
 	handler <= "-useParams", useParamsFromFile = false, paramsFilePath = "";
 
@@ -142,6 +152,9 @@ int main(int argc, char * argv[])
 	handler <= "-SolverClass", solverClassName = "ODERungeKuttaSolverDouble";
 	handler.AddAllowedValsList("-SolverClass", 0, 
 		AbstractFactory<ODE::ODESolver<double, double> >::GetFactoriesNames());
+	handler <= "-RosenbrockSolver", rosenJacPeriod = 1, rosenLinTol = 1e-8, rosenLinMaxIter = 100;
+	handler <= "-MultirateSolver", multirateNbSubSteps = 10, multirateInterp = 1;
+	handler <= "-SplittingSolver", splitNbSubSteps = 1, splitNbThreads = 1;
 
 	handler <= "-Sim", simulate = false;
 	handler <= "-showNbSims", showNbSims = false;
@@ -155,11 +168,14 @@ int main(int argc, char * argv[])
 	handler <= "-DParVal", paramNames, paramVals;
 
 	handler <= "-PropagModelSim", propModSimStart = 0, propModSimEnd = 100;
+	handler <= "-PropagModelSync", propModSync = false, propModSyncThreads = 1;
+	handler <= "-BitSliced", bitSlicedReplicas = 64, bitSlicedThreshSpread = 0;
 	handler <= "-ThresholdMod", thresholdMod = 0.1, thresholdStimRad = 1;
 	handler <= "-ModThreshModel", modThreshModel = 1.0, ModThreshBval = 0;
 	handler <= "-ModThreshStim", modThreshStim;
 	handler <= "-SERSModel", SersPeriod = 9, SersActTime = 5, SersTransTime = 3.5, SERSStimRad = 1;
 	handler <= "-SERSModelStims", SERSmodStim;
+	handler <= "-SERSEventDriven", sersEventDriven = false;
 	handler <= "-SecOrdSERSModel", SersA = 0.06, SersB = 0.4;
 	handler <= "-SecOrdSERSModelModTransT", useModTransTimeSERS = false, minModTransTimeFactSERS = 0.1;
 	handler <= "-SimpleThreshSERSModel", simpleThreshSERSThresh = 0.2, simpleThreshSERSSpontFire = 0.0, simpleThreshSERSRecovProba = 0.25;
@@ -178,13 +194,20 @@ int main(int argc, char * argv[])
 	handler <= "-XtraCellKStim", KStimVal = 3.0, KStimIncrRate = 1.0e-14;
 	handler <= "-seed", seed = time(0);
 	handler <= "-PreRunTimeToEq", preRunToEqu = false, preRunTime = 20;
+	handler <= "-ActiveSet", useActiveSet = false, activeSetTol = 1e-3, activeSetWakeFlux = 1e-8, 
+		activeSetValidate = false;
+	handler <= "-FireDiffuseEventDriven", fdEventDriven = false, fdEventSampleStep = 0, fdEventTol = 1e-6;
 
 	handler <= "-SaveResults", resultFileName = "AstroRes";
 	handler <= "-SavingStep", savingStep = 0.1;
 	handler <= "-SubDir", useSubDir = false, subDirPath;
 	handler <= "-GridCondReplPath", gridCondReplPath;
 	handler <= "-Path", mainPath = ".";
+	handler <= "-AsyncSaver", saverNbWriters = 1, saverQueueSize = 1024;
 	handler <= "-repeat", repeatSim = 1;
+	handler <= "-BatchReplicas", batchReplicas = 1;
+	// Only used by the batches of repeat simulations (cf -BatchReplicas)
+	handler <= "-SinglePrecision", singlePrec = false, validatePrec = false;
 
 	handler <= "-CorrelParams", correlMaxLag = 10;
 	handler <= "-TransferEntropy", transEntropTimeEmbed = 1.0, transEntropNbBins = 2;
@@ -201,6 +224,7 @@ int main(int argc, char * argv[])
 	handler <= "-FourierTransUseShortTimeFFT", fourTrUseSTFFT = false, fourTrSTFFTWinSize = 50, fourTrSTFFTWinStep = 1, fourTrDomFreqThrRat = 0.05;
 	handler <= "-WaveletTransformElems", wavltTrNames, wavltTrElems;
 	handler <= "-WaveletTransform", wavltMinFreqToSave = 0.025, wavltMaxFreqToSave = 0.3, wavltStepFreqToSave = 0.025, wavltDromFreqThreRat = 0.05, wavltPowrThreshFract = 0.6;
+	handler <= "-SpectraThreads", spectraThreads = 1;
 
 	handler <= "-commDetect", commPrecision = 0.000001;
 
@@ -254,6 +278,7 @@ int main(int argc, char * argv[])
 	handler <= "-spatialScaleFree", spatialScaleFreeRc = 0.0001, spatialScaleFreeNl = 5;
 	handler <= "-SWParams", swRewireProb = 0, swNeighbDist = 1;
 	handler <= "-ThreshDetermNet", threshDetDegree = 10, threshDetSinks = 2;
+	handler <= "-ThreshDetermBisect", threshDetBisect = false, threshDetBisectThreads = 1, threshDetRestTol = 1e-3;
 	handler <= "-functTopoUseThresh", functTopoUseThresh = false, functTopoThresh = 0.1;
 	handler <= "-functTopoDirectedLinks", functTopoDirectedLinks = false;
 	handler <= "-functTopoAutoThresh", functTopoStdDevCoeff = 1.5;
@@ -282,8 +307,12 @@ int main(int argc, char * argv[])
 
 	handler <= "-WaveDetectUPOPANS", waveDetectUPOPANS = false;
 	handler <= "-activParams", activCaThresh = 0.7e-3, freqEstTimeWin = 10, fluxComputDelay = 7;
+	handler <= "-activSamplingPeriod", activSamplingPeriod = -1;
 	handler <= "-propDelays", propMinDelay = 5.0, propMaxDelay = 20.0, propInstWindow = 5.0, cellDistIncr = 1.0;
 	handler <= "-propOnlyOneWave", propOnlyOneWave = false;
+	handler <= "-OnlineStats", onlStatCompression = 0, onlStatNbBins = 0, onlStatBinMin = 0, onlStatBinMax = 1;
+	handler <= "-OnlineStatsKeepRaw", onlStatKeepRaw = false;
+	handler <= "-OnlineStatsQuants", onlStatQuants;
 	handler <= "-propSaveQuant", DefaultVal(propStartQuant, 0.0), DefaultVal(propEndQuant, 1.0), DefaultVal(propStepQuant, 0.1);
 	handler <= "-propSaveRatio", DefaultVal(propStartRatio, 0.1), DefaultVal(propEndRatio, 1.0), DefaultVal(propStepRatio, 0.1);
 	handler <= "-dim", dim = 2;
@@ -375,6 +404,8 @@ int main(int argc, char * argv[])
 	// RepeatSimulationThresholdModel
 	// RepeatSimulationModifiedThresholdModel
 	// RepeatSimulationSERSModel
+	// RepeatSimulationBitSlicedThresholdModel
+	// RepeatSimulationBitSlicedSERSModel
 	// RepeatSimulationChIModelThresholdDetermination
 
 	handler <= "-NeuronClass", neuronClassName = SFALIFNeuron::ClassName;
@@ -382,6 +413,9 @@ int main(int argc, char * argv[])
 
 	handler <= "-DummyNeuronSpikeTrain", dummyNeurSpTrainPath;
 
+	handler <= "-NeuronEventDriven", neurEventDriven = false, neurEventSampleStep = 0;
+	handler <= "-SynapticDelay", synDelay = 0, synDelayJitter = 0;
+
 	handler <= "-SynapseClass", synapseClassName = TMSynapse::ClassName;
 	handler.AddAllowedValsList("-SynapseClass", 0, AbstractFactory<Synapse>::GetFactoriesNames());
 
@@ -402,6 +436,7 @@ int main(int argc, char * argv[])
 	handler <= "-StochRes", stochResSigStimClass = DefaultStimStrat::ClassName, stochResNoiseStimClass = PoissonianStimStrat::ClassName;
 	handler.AddAllowedValsList("-StochRes", 0, AbstractFactory<StimulationStrat>::GetFactoriesNames());
 	handler.AddAllowedValsList("-StochRes", 1, AbstractFactory<StimulationStrat>::GetFactoriesNames());
+	handler <= "-StochResConcurrent", stochResConcurrent = false;
 
 	handler <= "-aM", metricNames;
 	handler.AddAllowedValsList("-aM", 0, AbstractFactory<Metric>::GetFactoriesNames());
@@ -446,6 +481,7 @@ int main(int argc, char * argv[])
 		mainPath = ".";
 
 	globalRNG.SetSeed(seed);
+	AsyncFileWriter::Configure(saverNbWriters, saverQueueSize);
 
 	stringstream path;
 	path << mainPath << "/data";
@@ -725,5 +761,9 @@ TRACE("Delete subSim")
 	if (subSim)
 		delete subSim;
 
+	// Wait for all results to be writen
+	if (not ResultSaver::Flush())
+		returnVal |= RESULT_SAVING_PROBLEM;
+
 	return returnVal;
 }
@@ -85,6 +85,57 @@ double ExpRand(double mean)
 	return gsl_ran_exponential(globalRNG.rng, mean);
 }
 
+//**********************************************************************
+// SplitMix64 finalizer, a bijection on 64 bits integers with good 
+// avalanche properties
+//**********************************************************************
+static inline unsigned long long int mix64(unsigned long long int z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+//**********************************************************************
+// New stream key, drawn from the global RNG so that it depends on the 
+// seed
+//**********************************************************************
+unsigned long long int NewCounterRandKey()
+{
+	unsigned long long int hi = (unsigned long long int) (UnifRand() * 4294967296.0);
+	unsigned long long int lo = (unsigned long long int) (UnifRand() * 4294967296.0);
+	return mix64((hi << 32) | lo);
+}
+
+//**********************************************************************
+// Key of the sub stream ind of stream key
+//**********************************************************************
+unsigned long long int CounterRandKey(unsigned long long int key, unsigned long long int ind)
+{
+	return mix64(key + mix64(ind + 0x9e3779b97f4a7c15ULL));
+}
+
+//**********************************************************************
+// Uniform value in ]0, 1[
+//**********************************************************************
+double CounterUnifRand(unsigned long long int key, unsigned long long int counter)
+{
+	return ((double) (CounterRandBits(key, counter) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+//**********************************************************************
+// 64 uniform random bits
+//**********************************************************************
+unsigned long long int CounterRandBits(unsigned long long int key, unsigned long long int counter)
+{
+	return mix64(key ^ mix64(counter * 0x9e3779b97f4a7c15ULL + key));
+}
+
+double CounterExpRand(double mean, unsigned long long int key, unsigned long long int counter)
+{
+	return - mean * log(CounterUnifRand(key, counter));
+}
+
 double GammaRand(double a, double b)
 {
 	return gsl_ran_gamma(globalRNG.rng, a, b);
@@ -247,7 +298,7 @@ vector<vector<double> > LoadSparseMatrix(std::ifstream & stream, double fillVal)
 	return mat;
 }
 
-bool SaveSparseMatrix(std::ofstream & stream, const vector<vector<double> > & mat)
+bool SaveSparseMatrix(std::ostream & stream, const vector<vector<double> > & mat)
 {
 	stream << mat.size() << endl;
 	for (unsigned int i = 0 ; i < mat.size() ; ++i)
@@ -266,7 +317,7 @@ bool SaveSparseMatrix(std::ofstream & stream, const vector<vector<double> > & ma
 	return stream.good();
 }
 
-bool SaveFullMatrix(ofstream & stream, const vector<vector<double> > & mat)
+bool SaveFullMatrix(ostream & stream, const vector<vector<double> > & mat)
 {
 	for (unsigned int i = 0 ; i < mat.size() ; ++i)
 	{
@@ -396,16 +447,6 @@ double lgamma(double x)
 }
 
 
-// Compute quick approximation to tanh
-float fast_tanh(float x)
-{
-  float x2 = x * x;
-  float a = x * (135135.0f + x2 * (17325.0f + x2 * (378.0f + x2)));
-  float b = 135135.0f + x2 * (62370.0f + x2 * (3150.0f + x2 * 28.0f));
-  float th = a / b;
-  return (th < -1.0f) ? -1.0f : ((th > 1.0f) ? 1.0f : th);
-}
-
 //**********************************************************************
 // Rank values in matrix
 //**********************************************************************
@@ -256,9 +256,25 @@ double GaussianRand(double mean = 0.0, double sd = 1.0);
 double UnifRand();
 double ExpRand(double mean);
 double GammaRand(double a, double b);
+// Counter based random numbers : the value only depends on (key, counter),
+// a stream is a key and values are drawn in any order without state
+unsigned long long int NewCounterRandKey();
+unsigned long long int CounterRandKey(unsigned long long int key, unsigned long long int ind);
+double CounterUnifRand(unsigned long long int key, unsigned long long int counter);
+unsigned long long int CounterRandBits(unsigned long long int key, unsigned long long int counter);
+double CounterExpRand(double mean, unsigned long long int key, unsigned long long int counter);
 bool TrueWithProba(double p);
 double lgamma(double x);
-float fast_tanh(float x);
+// Compute quick approximation to tanh (inline, used in coupling
+// functions)
+inline float fast_tanh(float x)
+{
+  float x2 = x * x;
+  float a = x * (135135.0f + x2 * (17325.0f + x2 * (378.0f + x2)));
+  float b = 135135.0f + x2 * (62370.0f + x2 * (3150.0f + x2 * 28.0f));
+  float th = a / b;
+  return (th < -1.0f) ? -1.0f : ((th > 1.0f) ? 1.0f : th);
+}
 
 double ComputeMean(const std::vector<double> & vals);
 double ComputeSum(const std::vector<double> & vals);
@@ -280,10 +296,10 @@ void ComputeAndAddQuantiles(std::map<std::string, double>& scalStats, std::strin
 void ComputeAndAddRatioFreq(std::map<std::string, double>& scalStats, std::string name, std::vector<double> & vect, std::vector<double> ratios, double totalTime);
 
 std::vector<std::vector<double> > LoadSparseMatrix(std::ifstream & stream, double fillVal = 1.0);
-bool SaveSparseMatrix(std::ofstream & stream, const std::vector<std::vector<double> > & mat);
+bool SaveSparseMatrix(std::ostream & stream, const std::vector<std::vector<double> > & mat);
 
 std::vector<std::vector<double> > LoadFullMatrix(std::ifstream & stream);
-bool SaveFullMatrix(std::ofstream & stream, const std::vector<std::vector<double> > & mat);
+bool SaveFullMatrix(std::ostream & stream, const std::vector<std::vector<double> > & mat);
 
 void RandomSwapsOnVector(std::vector<unsigned int> & vect);
 